@@ -52,94 +52,122 @@ static VOID ParseVersion(LPCSTR lpWinVer, PWIN_VER_ENTRY pWinVerEntry) {
 	}
 }
 
-BOOL WinVerParseConfig(HKEY hWinVer) {
-	K22_REG_VARS();
-
-	if (K22_REG_READ_VALUE(hWinVer, "ModeFlags", &fWinVerModes, cbValue)) {
-		K22_D("WinVer mode: %08lx", fWinVerModes);
+static BOOL WinVerParseValue(LPSTR szName, LPCSTR szValue) {
+	LPSTR lpModuleName = NULL;
+	WIN_VER_MODE eMode = MODE_MATCH_ANY;
+	LPSTR lpSeparator  = NULL;
+	if ((lpSeparator = strchr(szName, ';')) != NULL) {
+		// found module;mode separator
+		*lpSeparator = '\0';
+		lpModuleName = szName;
+		eMode		 = StringToMode(lpSeparator + 1);
+	} else if (strchr(szName, '.') != NULL) {
+		// found file extension separator
+		lpModuleName = szName;
+	} else if (szName[0] != '\0') {
+		// no separator, but string not empty
+		eMode = StringToMode(szName);
+	} else {
+		// default value from registry
+		bFoundDefault = TRUE;
 	}
 
-	K22_REG_ENUM_VALUE(hWinVer, szName, cbName, szValue, cbValue) {
-		if (_stricmp(szName, "ModeFlags") == 0) // skip ModeFlags value
-			continue;
-		LPSTR lpModuleName = NULL;
-		WIN_VER_MODE eMode = MODE_MATCH_ANY;
-		LPSTR lpSeparator  = NULL;
-		if ((lpSeparator = strchr(szName, ';')) != NULL) {
-			// found module;mode separator
-			*lpSeparator = '\0';
-			lpModuleName = szName;
-			eMode		 = StringToMode(lpSeparator + 1);
-		} else if (strchr(szName, '.') != NULL) {
-			// found file extension separator
-			lpModuleName = szName;
-		} else if (szName[0] != '\0') {
-			// no separator, but string not empty
-			eMode = StringToMode(szName);
-		} else {
-			// default value from registry
-			bFoundDefault = TRUE;
-		}
-
-		PWIN_VER_ENTRY pWinVerEntry;
-		K22_LL_FIND(
-			pWinVerEntries,
-			pWinVerEntry,
-			(
-				// compare by module name (can be null)
-				_stricmp(
-					lpModuleName ? lpModuleName : "",
-					pWinVerEntry->lpModuleName ? pWinVerEntry->lpModuleName : ""
-				) == 0
-			) && eMode == pWinVerEntry->eMode
-		);
+	// module names are matched case-insensitively, by their atoms
+	PK22_ATOM pModuleAtom = NULL;
+	if (lpModuleName && (pModuleAtom = K22AtomAdd(lpModuleName, strlen(lpModuleName))) == NULL)
+		return FALSE;
+
+	PWIN_VER_ENTRY pWinVerEntry;
+	K22_LL_FIND(
+		pWinVerEntries,
+		pWinVerEntry,
+		pModuleAtom == pWinVerEntry->pModuleAtom && eMode == pWinVerEntry->eMode
+	);
 
-		if (pWinVerEntry == NULL) {
-			K22_LL_ALLOC_APPEND(pWinVerEntries, pWinVerEntry);
-			if (lpModuleName && !K22StringDup(lpModuleName, strlen(lpModuleName), &pWinVerEntry->lpModuleName))
-				return FALSE;
-			pWinVerEntry->eMode = eMode;
-		} else {
-			K22_V(
-				"WinVer: will replace %s/%s",
-				pWinVerEntry->lpModuleName ? pWinVerEntry->lpModuleName : "*",
-				ModeToString(pWinVerEntry->eMode)
-			);
-		}
-
-		ParseVersion(szValue, pWinVerEntry);
-
-		K22_D(
-			"WinVer: setting %ld.%ld.%ld for %s/%s",
-			pWinVerEntry->dwMajor,
-			pWinVerEntry->dwMinor,
-			pWinVerEntry->dwBuild,
+	if (pWinVerEntry == NULL) {
+		K22_LL_ALLOC_APPEND(pWinVerEntries, pWinVerEntry);
+		pWinVerEntry->pModuleAtom  = pModuleAtom;
+		pWinVerEntry->lpModuleName = pModuleAtom ? pModuleAtom->szName : NULL;
+		pWinVerEntry->eMode		   = eMode;
+	} else {
+		K22_V(
+			"WinVer: will replace %s/%s",
 			pWinVerEntry->lpModuleName ? pWinVerEntry->lpModuleName : "*",
 			ModeToString(pWinVerEntry->eMode)
 		);
 	}
 
-	if (!bFoundDefault) {
-		// add real version as default, if not set before
-		PWIN_VER_ENTRY pWinVerEntry;
-		K22_LL_ALLOC_APPEND(pWinVerEntries, pWinVerEntry);
-		ParseVersion(NULL, pWinVerEntry);
-		K22_D(
-			"WinVer: setting %ld.%ld.%ld as default",
-			pWinVerEntry->dwMajor,
-			pWinVerEntry->dwMinor,
-			pWinVerEntry->dwBuild
-		);
+	ParseVersion(szValue, pWinVerEntry);
+
+	K22_D(
+		"WinVer: setting %ld.%ld.%ld for %s/%s",
+		pWinVerEntry->dwMajor,
+		pWinVerEntry->dwMinor,
+		pWinVerEntry->dwBuild,
+		pWinVerEntry->lpModuleName ? pWinVerEntry->lpModuleName : "*",
+		ModeToString(pWinVerEntry->eMode)
+	);
+	return TRUE;
+}
+
+BOOL WinVerParseConfig() {
+	// read the merged WinVer key - no registry calls
+	if (K22ConfigGetDword("WinVer", "ModeFlags", &fWinVerModes)) {
+		K22_D("WinVer mode: %08lx", fWinVerModes);
+	}
+
+	PK22_CONFIG_KEY pWinVer = K22ConfigGetKey("WinVer");
+	if (pWinVer == NULL)
+		return TRUE;
+	PK22_CONFIG_VALUE pValue;
+	K22_LL_FOREACH(pWinVer->pValues, pValue) {
+		if (pValue->dwType != REG_SZ || _stricmp(pValue->lpName, "ModeFlags") == 0) // skip ModeFlags value
+			continue;
+		// the name is modified while parsing, the store is read-only
+		CHAR szName[256 + 1];
+		if (FAILED(StringCbCopy(szName, sizeof(szName), pValue->lpName)))
+			continue;
+		if (!WinVerParseValue(szName, pValue->pData))
+			return FALSE;
 	}
+	return TRUE;
+}
+
+BOOL WinVerParseSection(LPSTR lpSection, LPSTR lpName, DWORD cchName, LPSTR lpValue, DWORD cchValue) {
+	// [WinVer] section of the configuration file; values are strings, ModeFlags is hexadecimal
+	if (lpSection[0] != '\0')
+		return TRUE;
+	if (_stricmp(lpName, "ModeFlags") == 0) {
+		sscanf(lpValue, "%lx", &fWinVerModes);
+		K22_D("WinVer mode: %08lx", fWinVerModes);
+		return TRUE;
+	}
+	return WinVerParseValue(lpName, lpValue);
+}
 
+BOOL WinVerAddDefault() {
+	// add real version as default, if not set before
+	if (bFoundDefault)
+		return TRUE;
+	PWIN_VER_ENTRY pWinVerEntry;
+	K22_LL_ALLOC_APPEND(pWinVerEntries, pWinVerEntry);
+	ParseVersion(NULL, pWinVerEntry);
+	bFoundDefault = TRUE;
+	K22_D(
+		"WinVer: setting %ld.%ld.%ld as default",
+		pWinVerEntry->dwMajor,
+		pWinVerEntry->dwMinor,
+		pWinVerEntry->dwBuild
+	);
 	return TRUE;
 }
 
 PWIN_VER_ENTRY WinVerGetConfig(LPCSTR lpModuleName, WIN_VER_MODE eMode) {
-	// find a matching entry
+	// find a matching entry; a module name without an atom isn't configured
+	PK22_ATOM pModuleAtom = K22AtomFind(lpModuleName, strlen(lpModuleName));
 	PWIN_VER_ENTRY pWinVerEntry, pModuleMatch = NULL, pModeMatch = NULL, pDefault = NULL;
 	K22_LL_FOREACH(pWinVerEntries, pWinVerEntry) {
-		BOOL bModuleMatch = pWinVerEntry->lpModuleName && _stricmp(pWinVerEntry->lpModuleName, lpModuleName) == 0;
+		BOOL bModuleMatch = pModuleAtom && pWinVerEntry->pModuleAtom == pModuleAtom;
 		BOOL bModeMatch	  = pWinVerEntry->eMode == eMode;
 		if (bModuleMatch && bModeMatch)
 			return pWinVerEntry;
@@ -6,7 +6,10 @@ BOOL APIENTRY DllMain(HANDLE hDll, DWORD dwReason, LPVOID lpContext) {
 	if (dwReason != DLL_PROCESS_ATTACH)
 		return TRUE;
 	// read configuration
-	K22ConfigReadKey("WinVer", WinVerParseConfig);
+	WinVerParseConfig();
+	K22ConfigReadSection("WinVer", WinVerParseSection);
+	if (pWinVerEntries)
+		WinVerAddDefault();
 	// enable all modes if entries are set
 	if (fWinVerModes == 0 && pWinVerEntries)
 		fWinVerModes = 0xFFFFFFFF;
@@ -14,11 +14,12 @@ typedef enum WIN_VER_MODE {
 } WIN_VER_MODE;
 
 typedef struct WIN_VER_ENTRY {
-	LPSTR lpModuleName; // optional, module name to match
-	WIN_VER_MODE eMode; // optional, spoofing mode to match
-	DWORD dwMajor;		// major version number
-	DWORD dwMinor;		// minor version number
-	DWORD dwBuild;		// build number
+	LPSTR lpModuleName;	   // optional, module name to match (szName of pModuleAtom)
+	PK22_ATOM pModuleAtom; // optional, module name to match
+	WIN_VER_MODE eMode;	   // optional, spoofing mode to match
+	DWORD dwMajor;		   // major version number
+	DWORD dwMinor;		   // minor version number
+	DWORD dwBuild;		   // build number
 	struct WIN_VER_ENTRY *pPrev;
 	struct WIN_VER_ENTRY *pNext;
 } WIN_VER_ENTRY, *PWIN_VER_ENTRY;
@@ -26,7 +27,9 @@ typedef struct WIN_VER_ENTRY {
 extern DWORD fWinVerModes;
 extern PWIN_VER_ENTRY pWinVerEntries;
 
-BOOL WinVerParseConfig(HKEY hWinVer);
+BOOL WinVerParseConfig();
+BOOL WinVerParseSection(LPSTR lpSection, LPSTR lpName, DWORD cchName, LPSTR lpValue, DWORD cchValue);
+BOOL WinVerAddDefault();
 PWIN_VER_ENTRY WinVerGetConfig(LPCSTR lpModuleName, WIN_VER_MODE eMode);
 
 K22_HOOK_DEF(DWORD, GetVersion, ());
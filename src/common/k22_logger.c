@@ -239,7 +239,7 @@ static BOOL K22AppendError(LPCSTR lpMessage) {
 	memset(pError, 0, sizeof(*pError));
 	K22_LL_APPEND(pErrors, pError);
 	pError->cchMessage = strlen(lpMessage);
-	K22StringDup(lpMessage, pError->cchMessage, &pError->lpMessage);
+	pError->lpMessage  = _strdup(lpMessage);
 	return TRUE;
 }
 
@@ -0,0 +1,86 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-10.
+
+#include "kernel22.h"
+
+#define K22_PAGE_SIZE		0x1000
+#define K22_PAGE_WRITABLE	(PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY)
+#define K22_PAGE_EXECUTABLE (PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY)
+
+static ULONG_PTR K22UnlockBatchFind(PK22_UNLOCK_BATCH pBatch, ULONG_PTR ulAddress) {
+	// return end of the unlocked region containing ulAddress, or 0 if not unlocked yet
+	for (DWORD i = 0; i < pBatch->dwCount; i++) {
+		ULONG_PTR ulRegionStart = (ULONG_PTR)pBatch->stRegion[i].lpAddress;
+		ULONG_PTR ulRegionEnd	= ulRegionStart + pBatch->stRegion[i].cbSize;
+		if (ulAddress >= ulRegionStart && ulAddress < ulRegionEnd)
+			return ulRegionEnd;
+	}
+	return 0;
+}
+
+BOOL K22UnlockBatchAdd(PK22_UNLOCK_BATCH pBatch, LPVOID lpAddress, SIZE_T cbSize) {
+	// Make the pages of [lpAddress, lpAddress + cbSize) writable, until K22UnlockBatchRestore() is called.
+	// Pages already unlocked by this batch, or writable anyway, are skipped without any syscalls.
+	// The range is split on memory region boundaries, so that every region gets its own protection back.
+	// Partially overlapping regions are fine, as the batch is restored in reverse order.
+	// On failure, the entire batch is restored already.
+	ULONG_PTR ulStart = (ULONG_PTR)lpAddress & ~(ULONG_PTR)(K22_PAGE_SIZE - 1);
+	ULONG_PTR ulEnd	  = ((ULONG_PTR)lpAddress + cbSize + K22_PAGE_SIZE - 1) & ~(ULONG_PTR)(K22_PAGE_SIZE - 1);
+
+	while (ulStart < ulEnd) {
+		ULONG_PTR ulUnlockedEnd = K22UnlockBatchFind(pBatch, ulStart);
+		if (ulUnlockedEnd != 0) {
+			ulStart = ulUnlockedEnd;
+			continue;
+		}
+
+		MEMORY_BASIC_INFORMATION stInfo;
+		if (VirtualQuery((LPCVOID)ulStart, &stInfo, sizeof(stInfo)) == 0) {
+			K22_F_ERR("Couldn't query memory at %p", (LPVOID)ulStart);
+			goto Error;
+		}
+		ULONG_PTR ulChunkEnd = (ULONG_PTR)stInfo.BaseAddress + stInfo.RegionSize;
+		if (ulChunkEnd > ulEnd)
+			ulChunkEnd = ulEnd;
+		if (stInfo.Protect & K22_PAGE_WRITABLE) {
+			ulStart = ulChunkEnd;
+			continue;
+		}
+
+		if (pBatch->dwCount == K22_UNLOCK_BATCH_MAX) {
+			K22_F("Couldn't unlock memory at %p - too many regions", (LPVOID)ulStart);
+			goto Error;
+		}
+		// keep code executable, in case the range shares its pages with code
+		DWORD dwNewProtect = (stInfo.Protect & K22_PAGE_EXECUTABLE) ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE;
+		LPVOID lpChunk	   = (LPVOID)ulStart;
+		SIZE_T cbChunk	   = ulChunkEnd - ulStart;
+		DWORD dwOldProtect;
+		if (!VirtualProtect(lpChunk, cbChunk, dwNewProtect, &dwOldProtect)) {
+			K22_F_ERR("Couldn't unlock memory at %p (%lu bytes)", lpChunk, (DWORD)cbChunk);
+			goto Error;
+		}
+		pBatch->stRegion[pBatch->dwCount].lpAddress	   = lpChunk;
+		pBatch->stRegion[pBatch->dwCount].cbSize	   = cbChunk;
+		pBatch->stRegion[pBatch->dwCount].dwOldProtect = dwOldProtect;
+		pBatch->dwCount++;
+		ulStart = ulChunkEnd;
+	}
+	return TRUE;
+
+Error:
+	K22UnlockBatchRestore(pBatch);
+	return FALSE;
+}
+
+VOID K22UnlockBatchRestore(PK22_UNLOCK_BATCH pBatch) {
+	while (pBatch->dwCount) {
+		pBatch->dwCount--;
+		DWORD dwUnused;
+		VirtualProtect(
+			pBatch->stRegion[pBatch->dwCount].lpAddress,
+			pBatch->stRegion[pBatch->dwCount].cbSize,
+			pBatch->stRegion[pBatch->dwCount].dwOldProtect,
+			&dwUnused
+		);
+	}
+}
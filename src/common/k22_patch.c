@@ -32,24 +32,23 @@ BOOL K22PatchImportTable(BYTE bSource, LPVOID lpImageBase) {
 		RETURN_K22_F("Image does not import any DLLs! (no first thunk)");
 	PULONG_PTR pFirstThunk = RVA(dwFirstThunkRva);
 
-	// patch the import table
-	K22WithUnlocked(*pK22Header) {
-		K22WithUnlocked(*pNt) {
-			K22WithUnlockedLength(pImportDescriptor, sizeof(*pImportDescriptor) * 2) {
-				K22WithUnlockedLength(pFirstThunk, sizeof(*pFirstThunk) * 2) {
-					if (bSource != K22_SOURCE_NONE) {
-						if (!K22PatchImportTableImpl(bSource, pK22Header, pNt, pImportDescriptor, pFirstThunk))
-							return FALSE;
-					} else {
-						if (!K22RestoreImportTableImpl(pK22Header, pNt, pImportDescriptor, pFirstThunk))
-							return FALSE;
-					}
-				}
-			}
-		}
-	}
+	// unlock all modified structures at once
+	K22_UNLOCK_BATCH stBatch = {0};
+	if (!K22UnlockBatchAdd(&stBatch, pK22Header, sizeof(*pK22Header)) ||
+		!K22UnlockBatchAdd(&stBatch, pNt, sizeof(*pNt)) ||
+		!K22UnlockBatchAdd(&stBatch, pImportDescriptor, sizeof(*pImportDescriptor) * 2) ||
+		!K22UnlockBatchAdd(&stBatch, pFirstThunk, sizeof(*pFirstThunk) * 2))
+		return FALSE;
 
-	return TRUE;
+	// patch the import table
+	BOOL bRet;
+	K22WithUnlockedBatch(&stBatch) {
+		if (bSource != K22_SOURCE_NONE)
+			bRet = K22PatchImportTableImpl(bSource, pK22Header, pNt, pImportDescriptor, pFirstThunk);
+		else
+			bRet = K22RestoreImportTableImpl(pK22Header, pNt, pImportDescriptor, pFirstThunk);
+	}
+	return bRet;
 }
 
 #if !K22_VERIFIER
@@ -0,0 +1,180 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-16.
+
+#include "kernel22.h"
+
+// API set schema of the running system (PEB->ApiSetMap), parsed once at startup.
+// Every API set becomes a DllApiSet entry pointing to its default host DLL. The entries are stored in a hash table,
+// keyed by the lowercase name without ".dll" - the part that the loader compares, too. Schema v6 matches any version
+// of an API set (its entries are hashed without the last "-<version>"), so the version is stripped there only;
+// v2 and v4 compare the whole name.
+// Registry DllApiSet entries take precedence over the schema (see K22FindDllApiSet()).
+
+static DWORD K22ApiSetKeyLength(LPCSTR lpName, DWORD cchName, ULONG ulVersion) {
+	// get length of the API set name without ".dll" (and the last "-<version>" for schema v6); 0 if it's not an API set
+	if (cchName <= 4 || (_strnicmp(lpName, "api-", 4) != 0 && _strnicmp(lpName, "ext-", 4) != 0))
+		return 0;
+	if (_strnicmp(lpName + cchName - 4, ".dll", 4) == 0)
+		cchName -= 4;
+	if (ulVersion < 6)
+		return cchName;
+	while (cchName != 0 && lpName[cchName - 1] != '-') {
+		cchName--;
+	}
+	return cchName != 0 ? cchName - 1 : 0;
+}
+
+static DWORD K22ApiSetString(PBYTE pMap, ULONG ulOffset, ULONG cbLength, LPSTR lpOutput, DWORD cchOutput) {
+	// convert a schema string to lowercase ANSI; 0 if it's empty, too long or not ASCII
+	PCWSTR pString = (PCWSTR)(pMap + ulOffset);
+	DWORD cchInput = cbLength / sizeof(WCHAR);
+	if (cchInput == 0 || cchInput >= cchOutput)
+		return 0;
+	for (DWORD i = 0; i < cchInput; i++) {
+		if (pString[i] > 0x7F)
+			return 0;
+		lpOutput[i] = (CHAR)pString[i];
+	}
+	lpOutput[cchInput] = '\0';
+	return K22StringLower(lpOutput, lpOutput, cchOutput);
+}
+
+static BOOL K22ApiSetAdd(PBYTE pMap, ULONG ulName, ULONG cbName, ULONG ulHost, ULONG cbHost, BOOL bAddPrefix) {
+	CHAR szName[MAX_PATH];
+	CHAR szHost[MAX_PATH];
+	DWORD cchName = 0;
+	// schema versions before 6 store names without the "api-" prefix (but "ext-" names are complete)
+	if (bAddPrefix && !(cbName >= 4 * sizeof(WCHAR) && _wcsnicmp((PCWSTR)(pMap + ulName), L"ext-", 4) == 0)) {
+		strcpy(szName, "api-");
+		cchName = 4;
+	}
+	DWORD cchString = K22ApiSetString(pMap, ulName, cbName, szName + cchName, sizeof(szName) - cchName - 4);
+	DWORD cchHost	= K22ApiSetString(pMap, ulHost, cbHost, szHost, sizeof(szHost));
+	if (cchString == 0 || cchHost == 0)
+		// API set without a host - not implemented on this system
+		return TRUE;
+	cchName += cchString;
+	strcpy(szName + cchName, ".dll");
+	cchName += 4;
+
+	DWORD cchKey = K22ApiSetKeyLength(szName, cchName, *(PULONG)pMap);
+	if (cchKey == 0)
+		return TRUE;
+	PK22_DLL_API_SET pDllApiSet;
+	HASH_FIND(hh, pK22Data->pDllBuild->pDllApiSetSchema, szName, cchKey, pDllApiSet);
+	if (pDllApiSet != NULL)
+		// another version of the same API set - the loader would find the first one, too
+		return TRUE;
+
+	K22_ARENA_CALLOC(pDllApiSet);
+	if (!K22StringDup(szName, cchName, &pDllApiSet->lpSourceDll))
+		return FALSE;
+	if (!K22StringDup(szHost, cchHost, &pDllApiSet->lpTargetDll))
+		return FALSE;
+	pDllApiSet->cchSourceDll = cchName;
+	HASH_ADD_KEYPTR(hh, pK22Data->pDllBuild->pDllApiSetSchema, pDllApiSet->lpSourceDll, cchKey, pDllApiSet);
+	return TRUE;
+}
+
+BOOL K22ApiSetInitialize() {
+	PBYTE pMap = NtCurrentPeb()->ApiSetMap;
+	if (pMap == NULL) {
+		K22_D("API set schema not available");
+		return TRUE;
+	}
+
+	// add the default host (the value with no importer name) of every API set
+	ULONG ulVersion							   = *(PULONG)pMap;
+	pK22Data->pDllBuild->ulApiSetSchemaVersion = ulVersion;
+	switch (ulVersion) {
+		case 2: {
+			PAPI_SET_NAMESPACE_ARRAY_V2 pNamespace = (PVOID)pMap;
+			for (ULONG i = 0; i < pNamespace->Count; i++) {
+				PAPI_SET_NAMESPACE_ENTRY_V2 pEntry = &pNamespace->Array[i];
+				PAPI_SET_VALUE_ARRAY_V2 pValues	   = (PVOID)(pMap + pEntry->DataOffset);
+				for (ULONG j = 0; j < pValues->Count; j++) {
+					PAPI_SET_VALUE_ENTRY_V2 pValue = &pValues->Array[j];
+					if (pValue->NameLength != 0)
+						continue;
+					if (!K22ApiSetAdd(
+							pMap,
+							pEntry->NameOffset,
+							pEntry->NameLength,
+							pValue->ValueOffset,
+							pValue->ValueLength,
+							TRUE
+						))
+						return FALSE;
+					break;
+				}
+			}
+			break;
+		}
+
+		case 4: {
+			PAPI_SET_NAMESPACE_ARRAY_V4 pNamespace = (PVOID)pMap;
+			for (ULONG i = 0; i < pNamespace->Count; i++) {
+				PAPI_SET_NAMESPACE_ENTRY_V4 pEntry = &pNamespace->Array[i];
+				PAPI_SET_VALUE_ARRAY_V4 pValues	   = (PVOID)(pMap + pEntry->DataOffset);
+				for (ULONG j = 0; j < pValues->Count; j++) {
+					PAPI_SET_VALUE_ENTRY_V4 pValue = &pValues->Array[j];
+					if (pValue->NameLength != 0)
+						continue;
+					if (!K22ApiSetAdd(
+							pMap,
+							pEntry->NameOffset,
+							pEntry->NameLength,
+							pValue->ValueOffset,
+							pValue->ValueLength,
+							TRUE
+						))
+						return FALSE;
+					break;
+				}
+			}
+			break;
+		}
+
+		case 6: {
+			PAPI_SET_NAMESPACE_V6 pNamespace   = (PVOID)pMap;
+			PAPI_SET_NAMESPACE_ENTRY_V6 pEntry = (PVOID)(pMap + pNamespace->EntryOffset);
+			for (ULONG i = 0; i < pNamespace->Count; i++, pEntry++) {
+				PAPI_SET_VALUE_ENTRY_V6 pValue = (PVOID)(pMap + pEntry->ValueOffset);
+				for (ULONG j = 0; j < pEntry->ValueCount; j++, pValue++) {
+					if (pValue->NameLength != 0)
+						continue;
+					if (!K22ApiSetAdd(
+							pMap,
+							pEntry->NameOffset,
+							pEntry->NameLength,
+							pValue->ValueOffset,
+							pValue->ValueLength,
+							FALSE
+						))
+						return FALSE;
+					break;
+				}
+			}
+			break;
+		}
+
+		default:
+			K22_W("Unsupported API set schema version %lu", ulVersion);
+			return TRUE;
+	}
+
+	K22_D("Parsed API set schema v%lu - %lu API sets", ulVersion, HASH_CNT(hh, pK22Data->pDllBuild->pDllApiSetSchema));
+	return TRUE;
+}
+
+PK22_DLL_API_SET K22ApiSetFind(PK22_DLL_RULES pDll, LPCSTR lpModuleName) {
+	// find the system's API set entry of lpModuleName (any version, with schema v6)
+	if (pDll->pDllApiSetSchema == NULL)
+		return NULL;
+	CHAR szKey[MAX_PATH];
+	DWORD cchKey = K22StringLower(lpModuleName, szKey, sizeof(szKey));
+	if ((cchKey = K22ApiSetKeyLength(szKey, cchKey, pDll->ulApiSetSchemaVersion)) == 0)
+		return NULL;
+	PK22_DLL_API_SET pDllApiSet;
+	HASH_FIND(hh, pDll->pDllApiSetSchema, szKey, cchKey, pDllApiSet);
+	return pDllApiSet;
+}
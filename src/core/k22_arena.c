@@ -0,0 +1,64 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-14.
+
+#include "kernel22.h"
+
+// Bump allocator for data that lives as long as the process - configuration strings, rule entries, module data.
+// Memory is taken from the system in large zero-filled blocks, allocations are never freed individually.
+// Short-lived data (the resolver's temporaries) lives on the stack instead.
+
+#define K22_ARENA_BLOCK_SIZE 0x10000
+#define K22_ARENA_ALIGN		 16
+#define K22_ARENA_HEADER	 ((sizeof(K22_ARENA_BLOCK) + K22_ARENA_ALIGN - 1) & ~(SIZE_T)(K22_ARENA_ALIGN - 1))
+
+static PK22_ARENA_BLOCK K22ArenaBlockAlloc(SIZE_T cbSize) {
+	SIZE_T cbBlock			= max(K22_ARENA_BLOCK_SIZE, K22_ARENA_HEADER + cbSize);
+	PK22_ARENA_BLOCK pBlock = VirtualAlloc(NULL, cbBlock, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (pBlock == NULL)
+		return NULL;
+	pBlock->cbSize = cbBlock - K22_ARENA_HEADER;
+	pBlock->cbUsed = 0;
+	pK22Data->stArena.cbReserved += cbBlock;
+	pK22Data->stArena.dwBlocks++;
+	return pBlock;
+}
+
+PVOID K22ArenaAlloc(SIZE_T cbSize) {
+	// return zero-filled memory, aligned for any data type
+	cbSize = (cbSize + K22_ARENA_ALIGN - 1) & ~(SIZE_T)(K22_ARENA_ALIGN - 1);
+	PVOID pData;
+
+	AcquireSRWLockExclusive(&pK22Data->stArena.stLock);
+	PK22_ARENA_BLOCK pBlock = pK22Data->stArena.pBlock;
+	if (pBlock == NULL || pBlock->cbSize - pBlock->cbUsed < cbSize) {
+		PK22_ARENA_BLOCK pNew = K22ArenaBlockAlloc(cbSize);
+		if (pNew == NULL) {
+			ReleaseSRWLockExclusive(&pK22Data->stArena.stLock);
+			return NULL;
+		}
+		if (pBlock != NULL && cbSize > K22_ARENA_BLOCK_SIZE / 4) {
+			// large allocation - keep filling the current block
+			pNew->pNext	  = pBlock->pNext;
+			pBlock->pNext = pNew;
+		} else {
+			pNew->pNext				 = pBlock;
+			pK22Data->stArena.pBlock = pNew;
+		}
+		pBlock = pNew;
+	}
+	pData = (LPBYTE)pBlock + K22_ARENA_HEADER + pBlock->cbUsed;
+	pBlock->cbUsed += cbSize;
+	pK22Data->stArena.cbAllocated += cbSize;
+	pK22Data->stArena.dwAllocations++;
+	ReleaseSRWLockExclusive(&pK22Data->stArena.stLock);
+	return pData;
+}
+
+VOID K22ArenaLogStats() {
+	K22_I(
+		"Arena: %lu allocations, %lu bytes (%lu blocks, %lu bytes reserved)",
+		pK22Data->stArena.dwAllocations,
+		(DWORD)pK22Data->stArena.cbAllocated,
+		pK22Data->stArena.dwBlocks,
+		(DWORD)pK22Data->stArena.cbReserved
+	);
+}
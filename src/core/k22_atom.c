@@ -0,0 +1,82 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-14.
+
+#include "kernel22.h"
+
+// Atom table - interned lowercase module base names and symbol names.
+// Every distinct name (compared case-insensitively, like _stricmp) is stored once, with its hash and length.
+// Names mapped to atoms can then be matched by comparing pointers.
+// Atoms live in the arena and are never removed. Lookups of names that were never interned return NULL,
+// so that matching names against configuration doesn't grow the table.
+
+#define K22_ATOM_BUCKETS_MIN 256
+
+static PK22_ATOM K22AtomLookup(LPCSTR lpName, DWORD cchName, DWORD dwHash) {
+	// find an atom; the table lock must be held
+	if (pK22Data->stAtoms.dwBuckets == 0)
+		return NULL;
+	PK22_ATOM pAtom = pK22Data->stAtoms.ppBuckets[dwHash & (pK22Data->stAtoms.dwBuckets - 1)];
+	for (/**/; pAtom != NULL; pAtom = pAtom->pNext) {
+		if (pAtom->dwHash == dwHash && pAtom->cchName == cchName && K22StringEqualsN(pAtom->szName, lpName, cchName))
+			return pAtom;
+	}
+	return NULL;
+}
+
+static BOOL K22AtomGrow() {
+	// double the number of buckets once there are as many atoms; the old bucket array stays in the arena
+	DWORD dwBuckets = max(pK22Data->stAtoms.dwBuckets * 2, K22_ATOM_BUCKETS_MIN);
+	PK22_ATOM *ppBuckets;
+	K22_ARENA_LENGTH(ppBuckets, dwBuckets * sizeof(*ppBuckets));
+	for (DWORD i = 0; i < pK22Data->stAtoms.dwBuckets; i++) {
+		PK22_ATOM pAtom, pNext;
+		for (pAtom = pK22Data->stAtoms.ppBuckets[i]; pAtom != NULL; pAtom = pNext) {
+			DWORD dwBucket		= pAtom->dwHash & (dwBuckets - 1);
+			pNext				= pAtom->pNext;
+			pAtom->pNext		= ppBuckets[dwBucket];
+			ppBuckets[dwBucket] = pAtom;
+		}
+	}
+	pK22Data->stAtoms.ppBuckets = ppBuckets;
+	pK22Data->stAtoms.dwBuckets = dwBuckets;
+	return TRUE;
+}
+
+PK22_ATOM K22AtomAdd(LPCSTR lpName, DWORD cchName) {
+	// intern lpName, return the existing atom if it's been interned before
+	DWORD dwHash = K22StringHash(lpName, cchName);
+	AcquireSRWLockExclusive(&pK22Data->stAtoms.stLock);
+	PK22_ATOM pAtom = K22AtomLookup(lpName, cchName, dwHash);
+	if (pAtom == NULL) {
+		if (pK22Data->stAtoms.dwCount >= pK22Data->stAtoms.dwBuckets && !K22AtomGrow())
+			goto Error;
+		if ((pAtom = K22ArenaAlloc(sizeof(*pAtom) + cchName + 1)) == NULL)
+			goto Error;
+		pAtom->dwHash  = dwHash;
+		pAtom->cchName = cchName;
+		// lpName doesn't have to be NULL-terminated; the arena is zero-filled
+		K22StringLowerN(lpName, pAtom->szName, cchName);
+		PK22_ATOM *ppBucket = &pK22Data->stAtoms.ppBuckets[dwHash & (pK22Data->stAtoms.dwBuckets - 1)];
+		pAtom->pNext		= *ppBucket;
+		*ppBucket			= pAtom;
+		pK22Data->stAtoms.dwCount++;
+	}
+	ReleaseSRWLockExclusive(&pK22Data->stAtoms.stLock);
+	return pAtom;
+
+Error:
+	ReleaseSRWLockExclusive(&pK22Data->stAtoms.stLock);
+	K22_F("Couldn't add atom %.*s", cchName, lpName);
+	return NULL;
+}
+
+PK22_ATOM K22AtomFind(LPCSTR lpName, DWORD cchName) {
+	return K22AtomFindHash(lpName, cchName, K22StringHash(lpName, cchName));
+}
+
+PK22_ATOM K22AtomFindHash(LPCSTR lpName, DWORD cchName, DWORD dwHash) {
+	// find the atom of lpName, with a precomputed K22StringHash(); NULL if it was never interned
+	AcquireSRWLockShared(&pK22Data->stAtoms.stLock);
+	PK22_ATOM pAtom = K22AtomLookup(lpName, cchName, dwHash);
+	ReleaseSRWLockShared(&pK22Data->stAtoms.stLock);
+	return pAtom;
+}
@@ -45,11 +45,31 @@ BOOL K22CoreMain(PIMAGE_K22_HEADER pK22Header, LPVOID lpContext) {
 		K22_I("Registering DLL notification callback");
 		if (LdrRegisterDllNotification(0, K22CoreDllNotification, NULL, &pCookie) != ERROR_SUCCESS)
 			RETURN_K22_F_ERR("Couldn't register DLL notification");
+		// loaded modules can be tracked from now on
+		if (!K22ModuleIndexEnable())
+			goto Error;
 	}
 
 	// hook Library Loader functions (ntdll)
 	if (!K22LdrApiHookCreate())
 		goto Error;
+	// hook functions that invalidate the DLL search cache (kernel32)
+	if (!K22SearchHookCreate())
+		goto Error;
+
+	// map the import binding cache, if enabled
+	if (!K22BindCacheOpen())
+		goto Error;
+	// prepare lazy binding of modules loaded after startup, if enabled
+	if (!K22LazyInitialize())
+		goto Error;
+	// start the parallel resolver workers, if enabled
+	if (!K22ParallelInitialize())
+		goto Error;
+
+	// measure the time taken to resolve the process and its static dependencies
+	LARGE_INTEGER stStartTime;
+	QueryPerformanceCounter(&stStartTime);
 
 	// don't call any initialization routines in ntdll
 	pK22Data->fDelayDllInit = TRUE;
@@ -66,8 +86,28 @@ BOOL K22CoreMain(PIMAGE_K22_HEADER pK22Header, LPVOID lpContext) {
 	if (!K22CallInitRoutines(lpContext))
 		goto Error;
 
+	LARGE_INTEGER stEndTime, stFrequency;
+	QueryPerformanceCounter(&stEndTime);
+	QueryPerformanceFrequency(&stFrequency);
+	K22_I(
+		"Startup took %lu ms - %lu modules loaded, %lu left to ntdll.dll",
+		(DWORD)((stEndTime.QuadPart - stStartTime.QuadPart) * 1000 / stFrequency.QuadPart),
+		pK22Data->stStats.lModules,
+		pK22Data->stStats.lModulesSkipped
+	);
+
+	K22ArenaLogStats();
+
+	// store imports resolved during startup for the next run
+	if (!K22BindCacheWrite())
+		goto Error;
+	// reload the rules when the configuration changes, if enabled
+	if (!K22WatchInitialize())
+		goto Error;
+
 	if (pK22Data->stConfig.dwDllNotificationMode == 1) {
 		K22_W("Unregistering DLL notification callback by registry setting");
+		K22ModuleIndexDisable();
 		if (LdrUnregisterDllNotification(pCookie) != ERROR_SUCCESS)
 			RETURN_K22_F_ERR("Couldn't unregister DLL notification");
 	}
@@ -78,9 +118,12 @@ BOOL K22CoreMain(PIMAGE_K22_HEADER pK22Header, LPVOID lpContext) {
 
 Error:
 	// unregister DLL notification if any initialization error occurs
+	K22ModuleIndexDisable();
+	K22BindCacheClose();
 	if (LdrUnregisterDllNotification(pCookie) != ERROR_SUCCESS)
 		RETURN_K22_F_ERR("Couldn't unregister DLL notification");
 	K22LdrApiHookRemove();
+	K22SearchHookRemove();
 	return FALSE;
 }
 
@@ -93,7 +136,14 @@ static BOOL K22CoreDllNotification(DWORD dwReason, PLDR_DLL_NOTIFICATION_DATA pD
 			PLDR_DATA_TABLE_ENTRY pLdrEntry = pK22ModuleData->pLdrEntry;
 			K22_D("DLL @ %p: %ls - loaded with entry @ %p", lpImageBase, lpModuleName, pLdrEntry->EntryPoint);
 			K22DisableInitRoutine(lpImageBase);
-			if (!K22ClearBoundImportTable(lpImageBase) || !K22ProcessImports(lpImageBase)) {
+			InterlockedIncrement(&pK22Data->stStats.lModules);
+			if (!K22HasRoutedImports(lpImageBase)) {
+				// no rule applies - leave the imports (and bound imports) to ntdll.dll
+				K22_D("DLL @ %p: %ls - no imports affected by rules", lpImageBase, lpModuleName);
+				InterlockedIncrement(&pK22Data->stStats.lModulesSkipped);
+				break;
+			}
+			if (!K22ProcessImports(lpImageBase)) {
 				pK22ModuleData->fDllNotificationFailed = TRUE;
 				return FALSE;
 			}
@@ -101,6 +151,9 @@ static BOOL K22CoreDllNotification(DWORD dwReason, PLDR_DLL_NOTIFICATION_DATA pD
 
 		case LDR_DLL_NOTIFICATION_REASON_UNLOADED:
 			K22_D("DLL @ %p: %ls - unloaded", lpImageBase, lpModuleName);
+			K22CacheInvalidate(lpImageBase);
+			K22ModuleIndexRemove(lpImageBase);
+			K22BindCacheRecordRemove(lpImageBase);
 			break;
 
 		default:
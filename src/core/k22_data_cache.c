@@ -0,0 +1,635 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-17.
+
+#include "kernel22.h"
+
+// Persistent cache of the parsed configuration (DllExtra, DllApiSet, DllRedirect, DllRewrite), one file per process
+// name. The cache is keyed by the last write times of the registry keys (and the configuration file) that the rules
+// are read from - if none of them has changed since the file was written, the rules are rebuilt from the file,
+// without enumerating the registry.
+// The file stays mapped read-only, strings of the rules point directly into it; only the list entries and hash tables
+// (which are pointer-based) are allocated in the arena.
+// The first process that reads the cache (or the registry) also publishes it in a named section, keyed by the user,
+// integrity level, install directory, process name and generation. Other processes of the same configuration attach to
+// the section instead of opening the file - the cache only contains offsets, so it can be mapped anywhere.
+// The section is read-only for everyone once it's complete, and only trusted if this process' user owns it.
+
+#define K22_CONFIG_CACHE_HASH_INIT 14695981039346656037ULL
+
+#define K22_CONFIG_CACHE_PTR(dwOffset) ((LPVOID)((ULONG_PTR)pK22Data->stConfigCache.pHeader + (dwOffset)))
+
+static ULONGLONG K22ConfigCacheHash(ULONGLONG ullHash, LPCVOID pData, DWORD cbData) {
+	// FNV-1a, 64-bit
+	for (DWORD i = 0; i < cbData; i++) {
+		ullHash = (ullHash ^ ((LPBYTE)pData)[i]) * 1099511628211ULL;
+	}
+	return ullHash;
+}
+
+static ULONGLONG K22ConfigCacheHashKey(ULONGLONG ullHash, HKEY hKey) {
+	// hash the last write time of hKey, and the names and last write times of its subkeys
+	// (writing a value only changes the time of its own key)
+	FILETIME ftLastWrite = {0};
+	RegQueryInfoKey(hKey, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &ftLastWrite);
+	ullHash = K22ConfigCacheHash(ullHash, &ftLastWrite, sizeof(ftLastWrite));
+
+	CHAR szName[256 + 1];
+	DWORD cbName;
+	for (DWORD dwIndex = 0; /**/; dwIndex++) {
+		cbName = sizeof(szName) - 1;
+		if (RegEnumKeyEx(hKey, dwIndex, szName, &cbName, NULL, NULL, NULL, &ftLastWrite) != ERROR_SUCCESS)
+			break;
+		ullHash = K22ConfigCacheHash(ullHash, szName, cbName + 1);
+		ullHash = K22ConfigCacheHash(ullHash, &ftLastWrite, sizeof(ftLastWrite));
+	}
+	return ullHash;
+}
+
+static ULONGLONG K22ConfigCacheGeneration() {
+	// hash the state of all registry keys that the rules are read from
+	ULONGLONG ullHash = K22_CONFIG_CACHE_HASH_INIT;
+	// the install directory is included, as it's substituted in '@' paths
+	ullHash = K22ConfigCacheHash(ullHash, pK22Data->stConfig.lpInstallDir, pK22Data->stConfig.cchInstallDir + 1);
+	// the configuration file, if any
+	if (pK22Data->stConfigFile.lpData != NULL) {
+		LPCSTR lpPath = pK22Data->stConfigFile.lpPath;
+		ullHash		  = K22ConfigCacheHash(ullHash, lpPath, strlen(lpPath) + 1);
+		ullHash		  = K22ConfigCacheHash(ullHash, &pK22Data->stConfigFile.ftLastWrite, sizeof(FILETIME));
+		ullHash		  = K22ConfigCacheHash(ullHash, &pK22Data->stConfigFile.cbData, sizeof(SIZE_T));
+	}
+	// subkeys of the main key: Global and PerApp (which changes when per-app keys are added or removed)
+	ullHash = K22ConfigCacheHashKey(ullHash, pK22Data->stReg.hMain);
+	for (DWORD i = 0; i < 2; i++) {
+		HKEY hConfig = pK22Data->stReg.hConfig[i];
+		if (hConfig == NULL) {
+			ullHash = K22ConfigCacheHash(ullHash, &i, sizeof(i));
+			continue;
+		}
+		// DllExtra, DllApiSet, DllRedirect, DllRewrite
+		ullHash = K22ConfigCacheHashKey(ullHash, hConfig);
+		// per-DLL subkeys of DllRewrite
+		HKEY hDllRewrite;
+		if (K22_REG_OPEN_KEY(hConfig, "DllRewrite", hDllRewrite)) {
+			ullHash = K22ConfigCacheHashKey(ullHash, hDllRewrite);
+			RegCloseKey(hDllRewrite);
+		}
+	}
+	return ullHash;
+}
+
+static BOOL K22ConfigCacheStringValid(DWORD dwOffset, BOOL bOptional) {
+	// check that a string of the cache file is terminated within the file
+	if (dwOffset == 0)
+		return bOptional;
+	return dwOffset < pK22Data->stConfigCache.cbView &&
+		   memchr(K22_CONFIG_CACHE_PTR(dwOffset), '\0', pK22Data->stConfigCache.cbView - dwOffset) != NULL;
+}
+
+static LPSTR K22ConfigCacheString(DWORD dwOffset) {
+	return dwOffset != 0 ? K22_CONFIG_CACHE_PTR(dwOffset) : NULL;
+}
+
+static BOOL K22ConfigCacheTableFits(DWORD dwOffset, DWORD dwCount, SIZE_T cbEntry) {
+	return (ULONGLONG)dwOffset + (ULONGLONG)dwCount * cbEntry <= pK22Data->stConfigCache.cbView;
+}
+
+static BOOL K22ConfigCacheValidate() {
+	// validate the whole file upfront - the rules can't be rolled back once they're added
+	PK22_CONFIG_CACHE_HEADER pHeader = pK22Data->stConfigCache.pHeader;
+	if (pHeader->dwMagic != K22_CONFIG_CACHE_MAGIC || pHeader->dwVersion != K22_CONFIG_CACHE_VERSION) {
+		K22_D("Configuration cache has an unknown format");
+		return FALSE;
+	}
+	if (pHeader->dwSize < sizeof(*pHeader) || pHeader->dwSize > pK22Data->stConfigCache.cbView) {
+		K22_D("Configuration cache is truncated");
+		return FALSE;
+	}
+	// sections are rounded up to whole pages - only use the cache itself
+	pK22Data->stConfigCache.cbView = pHeader->dwSize;
+	if (pHeader->ullGeneration != pK22Data->stConfigCache.ullGeneration) {
+		K22_D("Configuration cache is outdated");
+		return FALSE;
+	}
+	if (!K22ConfigCacheTableFits(pHeader->dwDllExtra, pHeader->dwDllExtraCount, sizeof(K22_CONFIG_CACHE_ENTRY)) ||
+		!K22ConfigCacheTableFits(pHeader->dwDllApiSet, pHeader->dwDllApiSetCount, sizeof(K22_CONFIG_CACHE_API_SET)) ||
+		!K22ConfigCacheTableFits(pHeader->dwDllRedirect, pHeader->dwDllRedirectCount, sizeof(K22_CONFIG_CACHE_ENTRY)) ||
+		!K22ConfigCacheTableFits(pHeader->dwDllRewrite, pHeader->dwDllRewriteCount, sizeof(K22_CONFIG_CACHE_REWRITE)) ||
+		!K22ConfigCacheTableFits(pHeader->dwSymbols, pHeader->dwSymbolCount, sizeof(K22_CONFIG_CACHE_SYMBOL))) {
+		K22_D("Configuration cache is truncated");
+		return FALSE;
+	}
+
+	PK22_CONFIG_CACHE_ENTRY pDllExtra = K22_CONFIG_CACHE_PTR(pHeader->dwDllExtra);
+	for (DWORD i = 0; i < pHeader->dwDllExtraCount; i++) {
+		if (!K22ConfigCacheStringValid(pDllExtra[i].dwSource, FALSE) ||
+			!K22ConfigCacheStringValid(pDllExtra[i].dwTarget, FALSE))
+			goto Corrupted;
+	}
+	PK22_CONFIG_CACHE_API_SET pDllApiSet = K22_CONFIG_CACHE_PTR(pHeader->dwDllApiSet);
+	for (DWORD i = 0; i < pHeader->dwDllApiSetCount; i++) {
+		if (!K22ConfigCacheStringValid(pDllApiSet[i].dwSourceDll, FALSE) ||
+			!K22ConfigCacheStringValid(pDllApiSet[i].dwSourceSymbol, TRUE) ||
+			!K22ConfigCacheStringValid(pDllApiSet[i].dwTargetDll, FALSE))
+			goto Corrupted;
+	}
+	PK22_CONFIG_CACHE_ENTRY pDllRedirect = K22_CONFIG_CACHE_PTR(pHeader->dwDllRedirect);
+	for (DWORD i = 0; i < pHeader->dwDllRedirectCount; i++) {
+		if (!K22ConfigCacheStringValid(pDllRedirect[i].dwSource, FALSE) ||
+			!K22ConfigCacheStringValid(pDllRedirect[i].dwTarget, FALSE))
+			goto Corrupted;
+	}
+	PK22_CONFIG_CACHE_REWRITE pDllRewrite = K22_CONFIG_CACHE_PTR(pHeader->dwDllRewrite);
+	for (DWORD i = 0; i < pHeader->dwDllRewriteCount; i++) {
+		if (!K22ConfigCacheStringValid(pDllRewrite[i].dwSourceDll, FALSE) ||
+			!K22ConfigCacheStringValid(pDllRewrite[i].dwDefaultDll, TRUE) ||
+			!K22ConfigCacheStringValid(pDllRewrite[i].dwCatchAllDll, TRUE) ||
+			(ULONGLONG)pDllRewrite[i].dwFirstSymbol + pDllRewrite[i].dwSymbolCount > pHeader->dwSymbolCount)
+			goto Corrupted;
+	}
+	PK22_CONFIG_CACHE_SYMBOL pSymbols = K22_CONFIG_CACHE_PTR(pHeader->dwSymbols);
+	for (DWORD i = 0; i < pHeader->dwSymbolCount; i++) {
+		if (!K22ConfigCacheStringValid(pSymbols[i].dwSourceSymbol, FALSE) ||
+			!K22ConfigCacheStringValid(pSymbols[i].dwTargetDll, FALSE) ||
+			!K22ConfigCacheStringValid(pSymbols[i].dwTargetSymbol, FALSE))
+			goto Corrupted;
+	}
+	return TRUE;
+
+Corrupted:
+	K22_D("Configuration cache is corrupted");
+	return FALSE;
+}
+
+static BOOL K22ConfigCacheLoad() {
+	// rebuild the rule lists and their indexes, just like K22ConfigParse*() would
+	PK22_CONFIG_CACHE_HEADER pHeader = pK22Data->stConfigCache.pHeader;
+
+	PK22_CONFIG_CACHE_ENTRY pExtra = K22_CONFIG_CACHE_PTR(pHeader->dwDllExtra);
+	for (DWORD i = 0; i < pHeader->dwDllExtraCount; i++) {
+		PK22_DLL_EXTRA pDllExtra;
+		K22_LL_ALLOC_APPEND(pK22Data->pDllBuild->pDllExtra, pDllExtra);
+		pDllExtra->lpKey	   = K22ConfigCacheString(pExtra[i].dwSource);
+		pDllExtra->lpTargetDll = K22ConfigCacheString(pExtra[i].dwTarget);
+	}
+
+	PK22_CONFIG_CACHE_API_SET pApiSet = K22_CONFIG_CACHE_PTR(pHeader->dwDllApiSet);
+	for (DWORD i = 0; i < pHeader->dwDllApiSetCount; i++) {
+		PK22_DLL_API_SET pDllApiSet;
+		K22_LL_ALLOC_APPEND(pK22Data->pDllBuild->pDllApiSet, pDllApiSet);
+		pDllApiSet->lpSourceDll	 = K22ConfigCacheString(pApiSet[i].dwSourceDll);
+		pDllApiSet->cchSourceDll = strlen(pDllApiSet->lpSourceDll);
+		pDllApiSet->lpTargetDll	 = K22ConfigCacheString(pApiSet[i].dwTargetDll);
+		LPCSTR lpSourceSymbol	 = K22ConfigCacheString(pApiSet[i].dwSourceSymbol);
+		if (lpSourceSymbol != NULL) {
+			pDllApiSet->pSourceSymbol = K22AtomAdd(lpSourceSymbol, strlen(lpSourceSymbol));
+			if (pDllApiSet->pSourceSymbol == NULL)
+				return FALSE;
+			pDllApiSet->lpSourceSymbol = pDllApiSet->pSourceSymbol->szName;
+		}
+	}
+	// the entries were written in sorted order
+	K22ConfigIndexDllApiSet();
+
+	PK22_CONFIG_CACHE_ENTRY pRedirect = K22_CONFIG_CACHE_PTR(pHeader->dwDllRedirect);
+	for (DWORD i = 0; i < pHeader->dwDllRedirectCount; i++) {
+		PK22_DLL_REDIRECT pDllRedirect;
+		K22_LL_ALLOC_APPEND(pK22Data->pDllBuild->pDllRedirect, pDllRedirect);
+		pDllRedirect->lpSourceDll = K22ConfigCacheString(pRedirect[i].dwSource);
+		pDllRedirect->lpTargetDll = K22ConfigCacheString(pRedirect[i].dwTarget);
+		HASH_ADD_KEYPTR(
+			hh,
+			pK22Data->pDllBuild->pDllRedirectIndex,
+			pDllRedirect->lpSourceDll,
+			strlen(pDllRedirect->lpSourceDll),
+			pDllRedirect
+		);
+	}
+
+	PK22_CONFIG_CACHE_REWRITE pRewrite = K22_CONFIG_CACHE_PTR(pHeader->dwDllRewrite);
+	PK22_CONFIG_CACHE_SYMBOL pSymbols  = K22_CONFIG_CACHE_PTR(pHeader->dwSymbols);
+	for (DWORD i = 0; i < pHeader->dwDllRewriteCount; i++) {
+		PK22_DLL_REWRITE pDllRewrite;
+		K22_LL_ALLOC_APPEND(pK22Data->pDllBuild->pDllRewrite, pDllRewrite);
+		pDllRewrite->lpSourceDll   = K22ConfigCacheString(pRewrite[i].dwSourceDll);
+		pDllRewrite->lpDefaultDll  = K22ConfigCacheString(pRewrite[i].dwDefaultDll);
+		pDllRewrite->lpCatchAllDll = K22ConfigCacheString(pRewrite[i].dwCatchAllDll);
+		HASH_ADD_KEYPTR(
+			hh,
+			pK22Data->pDllBuild->pDllRewriteIndex,
+			pDllRewrite->lpSourceDll,
+			strlen(pDllRewrite->lpSourceDll),
+			pDllRewrite
+		);
+
+		PK22_CONFIG_CACHE_SYMBOL pSymbol = &pSymbols[pRewrite[i].dwFirstSymbol];
+		for (DWORD j = 0; j < pRewrite[i].dwSymbolCount; j++, pSymbol++) {
+			PK22_DLL_REWRITE_SYMBOL pDllRewriteSymbol;
+			LPCSTR lpSourceSymbol	= K22ConfigCacheString(pSymbol->dwSourceSymbol);
+			PK22_ATOM pSourceSymbol = K22AtomAdd(lpSourceSymbol, strlen(lpSourceSymbol));
+			if (pSourceSymbol == NULL)
+				return FALSE;
+			K22_LL_ALLOC_APPEND(pDllRewrite->pSymbols, pDllRewriteSymbol);
+			pDllRewriteSymbol->pSourceSymbol  = pSourceSymbol;
+			pDllRewriteSymbol->lpSourceSymbol = pSourceSymbol->szName;
+			pDllRewriteSymbol->lpTargetDll	  = K22ConfigCacheString(pSymbol->dwTargetDll);
+			pDllRewriteSymbol->lpTargetSymbol = K22ConfigCacheString(pSymbol->dwTargetSymbol);
+			K22SymbolRefParse(&pDllRewriteSymbol->stTarget, pDllRewriteSymbol->lpTargetSymbol);
+			HASH_ADD(hh, pDllRewrite->pSymbolIndex, pSourceSymbol, sizeof(PK22_ATOM), pDllRewriteSymbol);
+		}
+	}
+	return TRUE;
+}
+
+static VOID K22ConfigCacheUnmap() {
+	if (pK22Data->stConfigCache.pHeader == NULL)
+		return;
+	UnmapViewOfFile(pK22Data->stConfigCache.pHeader);
+	pK22Data->stConfigCache.pHeader = NULL;
+	pK22Data->stConfigCache.cbView	= 0;
+}
+
+static BOOL K22ConfigCacheReadToken() {
+	// get the user and the integrity level of this process, which the section is named and secured by
+	HANDLE hToken;
+	struct {
+		TOKEN_USER stUser;
+		BYTE bSid[SECURITY_MAX_SID_SIZE];
+	} stUser;
+	struct {
+		TOKEN_MANDATORY_LABEL stLabel;
+		BYTE bSid[SECURITY_MAX_SID_SIZE];
+	} stLabel;
+	DWORD cbInfo;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &hToken)) {
+		K22_W_ERR("Couldn't open process token");
+		return FALSE;
+	}
+	BOOL bToken = GetTokenInformation(hToken, TokenUser, &stUser, sizeof(stUser), &cbInfo) &&
+				  GetTokenInformation(hToken, TokenIntegrityLevel, &stLabel, sizeof(stLabel), &cbInfo);
+	CloseHandle(hToken);
+	if (!bToken) {
+		K22_W_ERR("Couldn't read process token");
+		return FALSE;
+	}
+
+	PSID pUserSid  = stUser.stUser.User.Sid;
+	PSID pLabelSid = stLabel.stLabel.Label.Sid;
+	LPSTR lpUserSid;
+	LPSTR lpLabelSid;
+	if (!ConvertSidToStringSid(pUserSid, &lpUserSid)) {
+		K22_W_ERR("Couldn't convert user SID");
+		return FALSE;
+	}
+	if (!ConvertSidToStringSid(pLabelSid, &lpLabelSid)) {
+		K22_W_ERR("Couldn't convert integrity level SID");
+		LocalFree(lpUserSid);
+		return FALSE;
+	}
+	BOOL bRet = K22StringDup(lpUserSid, strlen(lpUserSid), &pK22Data->stConfigCache.lpUserSid) &&
+				K22StringDup(lpLabelSid, strlen(lpLabelSid), &pK22Data->stConfigCache.lpLabelSid) &&
+				(pK22Data->stConfigCache.pUserSid = K22ArenaAlloc(GetLengthSid(pUserSid))) != NULL &&
+				CopySid(GetLengthSid(pUserSid), pK22Data->stConfigCache.pUserSid, pUserSid);
+	LocalFree(lpUserSid);
+	LocalFree(lpLabelSid);
+	return bRet;
+}
+
+static BOOL K22ConfigCacheIsOwned(HANDLE hSection) {
+	// check that the section was created by this process' user - another user of the session might have created
+	// a section of the same name
+	PSID pOwner;
+	PSECURITY_DESCRIPTOR pDescriptor;
+	DWORD dwError = GetSecurityInfo(
+		hSection,
+		SE_KERNEL_OBJECT,
+		OWNER_SECURITY_INFORMATION,
+		&pOwner,
+		NULL,
+		NULL,
+		NULL,
+		&pDescriptor
+	);
+	if (dwError != ERROR_SUCCESS) {
+		SetLastError(dwError);
+		K22_W_ERR("Couldn't read owner of configuration section");
+		return FALSE;
+	}
+	BOOL bOwned = EqualSid(pOwner, pK22Data->stConfigCache.pUserSid);
+	LocalFree(pDescriptor);
+	return bOwned;
+}
+
+static BOOL K22ConfigCacheAttach() {
+	// map the section published by another process, if there is one
+	LPCSTR lpSection = pK22Data->stConfigCache.lpSection;
+	if (lpSection == NULL)
+		return FALSE;
+	HANDLE hSection = OpenFileMapping(FILE_MAP_READ | READ_CONTROL, FALSE, lpSection);
+	if (hSection == NULL) {
+		K22_D("Configuration section not found - %s", lpSection);
+		return FALSE;
+	}
+	if (!K22ConfigCacheIsOwned(hSection)) {
+		K22_W("Configuration section is not owned by this user - %s", lpSection);
+		CloseHandle(hSection);
+		return FALSE;
+	}
+	pK22Data->stConfigCache.pHeader = MapViewOfFile(hSection, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hSection);
+	if (pK22Data->stConfigCache.pHeader == NULL) {
+		K22_W_ERR("Couldn't map configuration section - %s", lpSection);
+		return FALSE;
+	}
+	MEMORY_BASIC_INFORMATION stInfo;
+	if (VirtualQuery(pK22Data->stConfigCache.pHeader, &stInfo, sizeof(stInfo)) != 0)
+		pK22Data->stConfigCache.cbView = stInfo.RegionSize;
+
+	// the magic is written last, once the section is complete (see K22ConfigCachePublish())
+	if (pK22Data->stConfigCache.cbView < sizeof(K22_CONFIG_CACHE_HEADER) ||
+		*(volatile DWORD *)&pK22Data->stConfigCache.pHeader->dwMagic != K22_CONFIG_CACHE_MAGIC) {
+		K22_D("Configuration section is not complete - %s", lpSection);
+		K22ConfigCacheUnmap();
+		return FALSE;
+	}
+	MemoryBarrier();
+	if (!K22ConfigCacheValidate()) {
+		K22ConfigCacheUnmap();
+		return FALSE;
+	}
+	K22_D("Attached to configuration section - %s", lpSection);
+	return TRUE;
+}
+
+static BOOL K22ConfigCacheMapFile() {
+	// map the cache file, if it's valid
+	LPCSTR lpPath					= pK22Data->stConfigCache.lpPath;
+	pK22Data->stConfigCache.pHeader = K22FileMapRead(lpPath, &pK22Data->stConfigCache.cbView);
+	if (pK22Data->stConfigCache.pHeader == NULL) {
+		if (GetLastError() == ERROR_FILE_NOT_FOUND || GetLastError() == ERROR_PATH_NOT_FOUND)
+			K22_D("Configuration cache not found - %s", lpPath);
+		else
+			K22_W_ERR("Couldn't map configuration cache - %s", lpPath);
+		return FALSE;
+	}
+	if (pK22Data->stConfigCache.cbView < sizeof(K22_CONFIG_CACHE_HEADER) || !K22ConfigCacheValidate()) {
+		K22ConfigCacheUnmap();
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static VOID K22ConfigCachePublish(LPCVOID pBuffer, DWORD cbBuffer) {
+	// copy the cache to a new named section, for other processes to attach
+	// the section exists as long as any process has it open or mapped - this process keeps its handle until exit
+	LPCSTR lpSection = pK22Data->stConfigCache.lpSection;
+	if (lpSection == NULL)
+		return;
+
+	// owned by this user, who can only read it (OW - no implicit rights of the owner to change the DACL);
+	// no read or write up from lower integrity levels
+	CHAR szDescriptor[512];
+	PSECURITY_DESCRIPTOR pDescriptor;
+	if (FAILED(StringCbPrintf(
+			szDescriptor,
+			sizeof(szDescriptor),
+			"O:%sD:P(A;;GR;;;%s)(A;;RC;;;OW)S:(ML;;NWNR;;;%s)",
+			pK22Data->stConfigCache.lpUserSid,
+			pK22Data->stConfigCache.lpUserSid,
+			pK22Data->stConfigCache.lpLabelSid
+		)) ||
+		!ConvertStringSecurityDescriptorToSecurityDescriptor(szDescriptor, SDDL_REVISION_1, &pDescriptor, NULL)) {
+		K22_W_ERR("Couldn't build security descriptor of configuration section");
+		return;
+	}
+	SECURITY_ATTRIBUTES stAttributes = {
+		.nLength			  = sizeof(stAttributes),
+		.lpSecurityDescriptor = pDescriptor,
+		.bInheritHandle		  = FALSE,
+	};
+	// the handle returned on creation has full access regardless of the DACL - it's only used to fill the section
+	HANDLE hSection = CreateFileMapping(INVALID_HANDLE_VALUE, &stAttributes, PAGE_READWRITE, 0, cbBuffer, lpSection);
+	LocalFree(pDescriptor);
+	if (hSection == NULL) {
+		K22_W_ERR("Couldn't create configuration section - %s", lpSection);
+		return;
+	}
+	if (GetLastError() == ERROR_ALREADY_EXISTS) {
+		// published by another process in the meantime
+		CloseHandle(hSection);
+		return;
+	}
+	PK22_CONFIG_CACHE_HEADER pHeader = MapViewOfFile(hSection, FILE_MAP_WRITE, 0, 0, 0);
+	if (pHeader == NULL) {
+		K22_W_ERR("Couldn't map configuration section - %s", lpSection);
+		CloseHandle(hSection);
+		return;
+	}
+	// copy everything but the magic, which marks the section as complete
+	memcpy(&pHeader->dwVersion, (const BYTE *)pBuffer + sizeof(DWORD), cbBuffer - sizeof(DWORD));
+	InterlockedExchange((volatile LONG *)&pHeader->dwMagic, K22_CONFIG_CACHE_MAGIC);
+	UnmapViewOfFile(pHeader);
+	// keep a read-only handle - nothing can map the section for writing anymore (the source handle is always closed)
+	if (!DuplicateHandle(
+			GetCurrentProcess(),
+			hSection,
+			GetCurrentProcess(),
+			&pK22Data->stConfigCache.hSection,
+			FILE_MAP_READ | READ_CONTROL,
+			FALSE,
+			DUPLICATE_CLOSE_SOURCE
+		)) {
+		K22_W_ERR("Couldn't reopen configuration section - %s", lpSection);
+		pK22Data->stConfigCache.hSection = NULL;
+		return;
+	}
+	K22_D("Published configuration section - %s", lpSection);
+}
+
+BOOL K22ConfigCacheOpen() {
+	// read the rules from the shared section or the cache file, if they're up to date
+	// if pHeader is NULL afterwards, the rules have to be read from the registry
+	if (!pK22Data->stConfig.bConfigCache)
+		return TRUE;
+	pK22Data->stConfigCache.ullGeneration = K22ConfigCacheGeneration();
+
+	// InstallDir\DLL_xx\ConfigCache\<process name>.k22conf
+	CHAR szPath[MAX_PATH];
+	if (FAILED(StringCbPrintf(
+			szPath,
+			sizeof(szPath),
+			"%sConfigCache\\%s.k22conf",
+			pK22Data->stConfig.lpInstallDir,
+			pK22Data->lpProcessName
+		))) {
+		K22_W("Configuration cache path too long");
+		return TRUE;
+	}
+	if (!K22StringDup(szPath, strlen(szPath), &pK22Data->stConfigCache.lpPath))
+		return FALSE;
+
+	// Local\K22Config-<user SID>-<integrity level SID>-<install dir hash>-<process name>-<generation>
+	// without the token, the cache file is still used, but not shared
+	CHAR szSection[MAX_PATH];
+	if (K22ConfigCacheReadToken()) {
+		if (FAILED(StringCbPrintf(
+				szSection,
+				sizeof(szSection),
+				"Local\\K22Config-%s-%s-%08lx-%s-%016llx",
+				pK22Data->stConfigCache.lpUserSid,
+				pK22Data->stConfigCache.lpLabelSid,
+				K22StringHash(pK22Data->stConfig.lpInstallDir, pK22Data->stConfig.cchInstallDir),
+				pK22Data->lpProcessName,
+				pK22Data->stConfigCache.ullGeneration
+			)))
+			K22_W("Configuration section name too long");
+		else if (!K22StringDup(szSection, strlen(szSection), &pK22Data->stConfigCache.lpSection))
+			return FALSE;
+	}
+
+	if (!K22ConfigCacheAttach()) {
+		if (!K22ConfigCacheMapFile())
+			return TRUE;
+		K22ConfigCachePublish(pK22Data->stConfigCache.pHeader, pK22Data->stConfigCache.cbView);
+	}
+
+	if (!K22ConfigCacheLoad())
+		return FALSE;
+	PK22_CONFIG_CACHE_HEADER pHeader = pK22Data->stConfigCache.pHeader;
+	K22_I(
+		"Configuration cache loaded - %lu rules, %lu symbols",
+		pHeader->dwDllExtraCount + pHeader->dwDllApiSetCount + pHeader->dwDllRedirectCount +
+			pHeader->dwDllRewriteCount,
+		pHeader->dwSymbolCount
+	);
+	return TRUE;
+}
+
+static DWORD K22ConfigCacheLength(LPCSTR lpString) {
+	return lpString != NULL ? strlen(lpString) + 1 : 0;
+}
+
+static DWORD K22ConfigCachePut(LPBYTE pBuffer, PDWORD pdwString, LPCSTR lpString) {
+	// copy a string to the string area, return its offset
+	if (lpString == NULL)
+		return 0;
+	DWORD dwString = *pdwString;
+	strcpy((LPSTR)pBuffer + dwString, lpString);
+	*pdwString += strlen(lpString) + 1;
+	return dwString;
+}
+
+BOOL K22ConfigCacheWrite() {
+	// store the rules read from the registry
+	// called right after parsing, before any other rules (i.e. API set schema) are added
+	if (pK22Data->stConfigCache.lpPath == NULL || pK22Data->stConfigCache.pHeader != NULL)
+		return TRUE;
+
+	// count all entries and strings
+	DWORD dwDllExtraCount	 = 0;
+	DWORD dwDllApiSetCount	 = 0;
+	DWORD dwDllRedirectCount = 0;
+	DWORD dwDllRewriteCount	 = 0;
+	DWORD dwSymbolCount		 = 0;
+	DWORD cbStrings			 = 0;
+	PK22_DLL_EXTRA pDllExtra;
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllExtra, pDllExtra) {
+		cbStrings += K22ConfigCacheLength(pDllExtra->lpKey) + K22ConfigCacheLength(pDllExtra->lpTargetDll);
+		dwDllExtraCount++;
+	}
+	PK22_DLL_API_SET pDllApiSet;
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllApiSet, pDllApiSet) {
+		cbStrings += K22ConfigCacheLength(pDllApiSet->lpSourceDll) +
+					 K22ConfigCacheLength(pDllApiSet->lpSourceSymbol) + K22ConfigCacheLength(pDllApiSet->lpTargetDll);
+		dwDllApiSetCount++;
+	}
+	PK22_DLL_REDIRECT pDllRedirect;
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllRedirect, pDllRedirect) {
+		cbStrings += K22ConfigCacheLength(pDllRedirect->lpSourceDll) + K22ConfigCacheLength(pDllRedirect->lpTargetDll);
+		dwDllRedirectCount++;
+	}
+	PK22_DLL_REWRITE pDllRewrite;
+	PK22_DLL_REWRITE_SYMBOL pDllRewriteSymbol;
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllRewrite, pDllRewrite) {
+		cbStrings += K22ConfigCacheLength(pDllRewrite->lpSourceDll) + K22ConfigCacheLength(pDllRewrite->lpDefaultDll) +
+					 K22ConfigCacheLength(pDllRewrite->lpCatchAllDll);
+		dwDllRewriteCount++;
+		K22_LL_FOREACH(pDllRewrite->pSymbols, pDllRewriteSymbol) {
+			cbStrings += K22ConfigCacheLength(pDllRewriteSymbol->lpSourceSymbol) +
+						 K22ConfigCacheLength(pDllRewriteSymbol->lpTargetDll) +
+						 K22ConfigCacheLength(pDllRewriteSymbol->lpTargetSymbol);
+			dwSymbolCount++;
+		}
+	}
+
+	// lay out the file - header, tables, then strings
+	K22_CONFIG_CACHE_HEADER stHeader = {
+		.dwMagic			= K22_CONFIG_CACHE_MAGIC,
+		.dwVersion			= K22_CONFIG_CACHE_VERSION,
+		.ullGeneration		= pK22Data->stConfigCache.ullGeneration,
+		.dwDllExtraCount	= dwDllExtraCount,
+		.dwDllApiSetCount	= dwDllApiSetCount,
+		.dwDllRedirectCount = dwDllRedirectCount,
+		.dwDllRewriteCount	= dwDllRewriteCount,
+		.dwSymbolCount		= dwSymbolCount,
+	};
+	stHeader.dwDllExtra	   = sizeof(stHeader);
+	stHeader.dwDllApiSet   = stHeader.dwDllExtra + dwDllExtraCount * sizeof(K22_CONFIG_CACHE_ENTRY);
+	stHeader.dwDllRedirect = stHeader.dwDllApiSet + dwDllApiSetCount * sizeof(K22_CONFIG_CACHE_API_SET);
+	stHeader.dwDllRewrite  = stHeader.dwDllRedirect + dwDllRedirectCount * sizeof(K22_CONFIG_CACHE_ENTRY);
+	stHeader.dwSymbols	   = stHeader.dwDllRewrite + dwDllRewriteCount * sizeof(K22_CONFIG_CACHE_REWRITE);
+	DWORD dwString		   = stHeader.dwSymbols + dwSymbolCount * sizeof(K22_CONFIG_CACHE_SYMBOL);
+	DWORD cbBuffer		   = dwString + cbStrings;
+	stHeader.dwSize		   = cbBuffer;
+
+	LPBYTE pBuffer;
+	K22_MALLOC_LENGTH(pBuffer, cbBuffer);
+	memcpy(pBuffer, &stHeader, sizeof(stHeader));
+	PK22_CONFIG_CACHE_ENTRY pExtra	   = (PVOID)(pBuffer + stHeader.dwDllExtra);
+	PK22_CONFIG_CACHE_API_SET pApiSet  = (PVOID)(pBuffer + stHeader.dwDllApiSet);
+	PK22_CONFIG_CACHE_ENTRY pRedirect  = (PVOID)(pBuffer + stHeader.dwDllRedirect);
+	PK22_CONFIG_CACHE_REWRITE pRewrite = (PVOID)(pBuffer + stHeader.dwDllRewrite);
+	PK22_CONFIG_CACHE_SYMBOL pSymbol   = (PVOID)(pBuffer + stHeader.dwSymbols);
+
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllExtra, pDllExtra) {
+		pExtra->dwSource = K22ConfigCachePut(pBuffer, &dwString, pDllExtra->lpKey);
+		pExtra->dwTarget = K22ConfigCachePut(pBuffer, &dwString, pDllExtra->lpTargetDll);
+		pExtra++;
+	}
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllApiSet, pDllApiSet) {
+		pApiSet->dwSourceDll	= K22ConfigCachePut(pBuffer, &dwString, pDllApiSet->lpSourceDll);
+		pApiSet->dwSourceSymbol = K22ConfigCachePut(pBuffer, &dwString, pDllApiSet->lpSourceSymbol);
+		pApiSet->dwTargetDll	= K22ConfigCachePut(pBuffer, &dwString, pDllApiSet->lpTargetDll);
+		pApiSet++;
+	}
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllRedirect, pDllRedirect) {
+		pRedirect->dwSource = K22ConfigCachePut(pBuffer, &dwString, pDllRedirect->lpSourceDll);
+		pRedirect->dwTarget = K22ConfigCachePut(pBuffer, &dwString, pDllRedirect->lpTargetDll);
+		pRedirect++;
+	}
+	DWORD dwSymbol = 0;
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllRewrite, pDllRewrite) {
+		pRewrite->dwSourceDll	= K22ConfigCachePut(pBuffer, &dwString, pDllRewrite->lpSourceDll);
+		pRewrite->dwDefaultDll	= K22ConfigCachePut(pBuffer, &dwString, pDllRewrite->lpDefaultDll);
+		pRewrite->dwCatchAllDll = K22ConfigCachePut(pBuffer, &dwString, pDllRewrite->lpCatchAllDll);
+		pRewrite->dwFirstSymbol = dwSymbol;
+		K22_LL_FOREACH(pDllRewrite->pSymbols, pDllRewriteSymbol) {
+			pSymbol->dwSourceSymbol = K22ConfigCachePut(pBuffer, &dwString, pDllRewriteSymbol->lpSourceSymbol);
+			pSymbol->dwTargetDll	= K22ConfigCachePut(pBuffer, &dwString, pDllRewriteSymbol->lpTargetDll);
+			pSymbol->dwTargetSymbol = K22ConfigCachePut(pBuffer, &dwString, pDllRewriteSymbol->lpTargetSymbol);
+			pSymbol++;
+			dwSymbol++;
+		}
+		pRewrite->dwSymbolCount = dwSymbol - pRewrite->dwFirstSymbol;
+		pRewrite++;
+	}
+
+	// another process may still have an older file mapped - it will be replaced on a later start
+	if (K22FileReplace(pK22Data->stConfigCache.lpPath, pBuffer, cbBuffer))
+		K22_I(
+			"Configuration cache written - %lu rules, %lu symbols",
+			dwDllExtraCount + dwDllApiSetCount + dwDllRedirectCount + dwDllRewriteCount,
+			dwSymbolCount
+		);
+	K22ConfigCachePublish(pBuffer, cbBuffer);
+	K22_FREE(pBuffer);
+	return TRUE;
+}
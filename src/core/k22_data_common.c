@@ -28,7 +28,7 @@ static BOOL K22DataInitialize(LPVOID lpImageBase) {
 	pK22Data->pNt			= RVA(pK22Data->pDosHeader->e_lfanew);
 	pK22Data->fIs64Bit		= pK22Data->pNt->stFile.Machine == IMAGE_FILE_MACHINE_AMD64;
 
-	K22_MALLOC_LENGTH(pK22Data->lpProcessDir, MAX_PATH + 1);
+	K22_ARENA_LENGTH(pK22Data->lpProcessDir, MAX_PATH + 1);
 	GetModuleFileName(NULL, pK22Data->lpProcessDir, MAX_PATH + 1);
 	LPSTR lpProcessName = pK22Data->lpProcessName = pK22Data->lpProcessDir;
 	while (*lpProcessName) {
@@ -57,6 +57,10 @@ static BOOL K22DataInitialize(LPVOID lpImageBase) {
 		K22_D("Per-app configuration key found");
 	}
 
+	// merge the values of both keys, to read them from memory from now on
+	if (!K22ConfigStoreInitialize())
+		return FALSE;
+
 	TCHAR szInstallDir[MAX_PATH + 1];
 	DWORD cbInstallDir = sizeof(szInstallDir);
 	if (!(cbInstallDir = K22ConfigReadValueGlobal("InstallDir", szInstallDir, cbInstallDir)))
@@ -66,50 +70,100 @@ static BOOL K22DataInitialize(LPVOID lpImageBase) {
 		szInstallDir[cbInstallDir++] = '\\';
 	strcpy(szInstallDir + cbInstallDir, pK22Data->fIs64Bit ? "DLL_64\\" : "DLL_32\\");
 	cbInstallDir += 7;
-	pK22Data->stConfig.lpInstallDir	 = _strdup(szInstallDir);
+	if (!K22StringDup(szInstallDir, cbInstallDir, &pK22Data->stConfig.lpInstallDir))
+		return FALSE;
 	pK22Data->stConfig.cchInstallDir = cbInstallDir;
 
 	K22ConfigReadValueGlobal("LogLevel", &pK22Data->stConfig.dwLogLevel, sizeof(DWORD));
 	K22ConfigReadValueGlobal("DllNotificationMode", &pK22Data->stConfig.dwDllNotificationMode, sizeof(DWORD));
 	K22ConfigReadValueGlobal("DebugImportResolver", &pK22Data->stConfig.bDebugImportResolver, sizeof(BOOL));
-
-	if (!K22ConfigReadKey("DllExtra", K22ConfigParseDllExtra))
+	K22ConfigReadValue("BindCache", &pK22Data->stConfig.bBindCache, sizeof(BOOL));
+	K22ConfigReadValue("ConfigCache", &pK22Data->stConfig.bConfigCache, sizeof(BOOL));
+	K22ConfigReadValue("ConfigWatch", &pK22Data->stConfig.bConfigWatch, sizeof(BOOL));
+	K22ConfigReadValue("LazyBinding", &pK22Data->stConfig.bLazyBinding, sizeof(BOOL));
+	K22ConfigReadValue("ParallelResolve", &pK22Data->stConfig.dwParallelResolve, sizeof(DWORD));
+
+	// size of the rules, without the API set schema - reported once they're replaced (see k22_data_watch.c)
+	SIZE_T cbArena = pK22Data->stArena.cbAllocated;
+	K22_ARENA_CALLOC(pK22Data->pDllBuild);
+	if (!K22ConfigOpenFile())
 		return FALSE;
-	if (!K22ConfigReadKey("DllApiSet", K22ConfigParseDllApiSet))
+	// read the rules from the configuration cache, or from the registry and the configuration file if it's outdated
+	if (!K22ConfigCacheOpen())
 		return FALSE;
-	if (!K22ConfigReadKey("DllRedirect", K22ConfigParseDllRedirect))
+	if (pK22Data->stConfigCache.pHeader == NULL) {
+		if (!K22ConfigParseRules(pK22Data->stConfigFile.lpData, pK22Data->stConfigFile.cbData))
+			return FALSE;
+		if (!K22ConfigCacheWrite())
+			return FALSE;
+	}
+	if (!K22ConfigCompileRoutes())
 		return FALSE;
-	if (!K22ConfigReadKey("DllRewrite", K22ConfigParseDllRewrite))
+	pK22Data->pDllBuild->cbArena = pK22Data->stArena.cbAllocated - cbArena;
+	if (!K22ApiSetInitialize())
 		return FALSE;
+	K22ConfigIndexRuleFilter();
+	// make the rules visible to the resolver
+	K22DataPublishRules();
 
 	return TRUE;
 }
 
+static LPSTR K22DataStringToLower(PCUNICODE_STRING pString) {
+	// convert to a lowercase ANSI string in the arena
+	// DBCS code pages need up to two bytes per character - ask for the exact size, including the terminator
+	ULONG cbString = RtlUnicodeStringToAnsiSize(pString);
+	if (cbString == 0 || cbString > MAXWORD)
+		return NULL;
+	ANSI_STRING stString = {
+		.Length		   = 0,
+		.MaximumLength = (USHORT)cbString,
+		.Buffer		   = K22ArenaAlloc(cbString),
+	};
+	if (stString.Buffer == NULL || !NT_SUCCESS(RtlUnicodeStringToAnsiString(&stString, pString, FALSE)))
+		return NULL;
+	return _strlwr(stString.Buffer);
+}
+
+static PK22_ATOM K22DataStringToAtom(PCUNICODE_STRING pString) {
+	// convert to ANSI on the stack and intern it (DBCS code pages need up to two bytes per character)
+	CHAR szString[MAX_PATH * 2];
+	ANSI_STRING stString = {
+		.Length		   = 0,
+		.MaximumLength = sizeof(szString),
+		.Buffer		   = szString,
+	};
+	if (!NT_SUCCESS(RtlUnicodeStringToAnsiString(&stString, pString, FALSE)))
+		return NULL;
+	return K22AtomAdd(stString.Buffer, stString.Length);
+}
+
 static BOOL K22DataInitializeModule(LPVOID lpImageBase) {
 	PIMAGE_K22_HEADER pK22Header = K22_DOS_HDR_DATA(lpImageBase);
 
 	PK22_MODULE_DATA pK22ModuleData;
-	K22_CALLOC(pK22ModuleData);
+	K22_ARENA_CALLOC(pK22ModuleData);
 
 	pK22ModuleData->lpModuleBase = lpImageBase;
 	pK22ModuleData->pNt			 = RVA(pK22ModuleData->pDosHeader->e_lfanew);
 	pK22ModuleData->fIsProcess	 = lpImageBase == pK22Data->lpProcessBase;
 
 	// find the module path and base name
-	K22_LDR_ENUM(pLdrEntry, InLoadOrderModuleList, InLoadOrderLinks) {
+	// modules are usually initialized when they are loaded - start from the most recent one
+	K22_LDR_ENUM_REVERSE(pLdrEntry, InLoadOrderModuleList, InLoadOrderLinks) {
 		if (pLdrEntry->DllBase != lpImageBase)
 			continue;
-		ANSI_STRING stName;
 		// store data table entry
 		pK22ModuleData->pLdrEntry = pLdrEntry;
 		// convert to ANSI, then to lowercase and store in module data
-		RtlUnicodeStringToAnsiString(&stName, &pLdrEntry->FullDllName, TRUE);
-		_strlwr(stName.Buffer);
-		pK22ModuleData->lpModulePath = stName.Buffer;
-		// same for module name
-		RtlUnicodeStringToAnsiString(&stName, &pLdrEntry->BaseDllName, TRUE);
-		_strlwr(stName.Buffer);
-		pK22ModuleData->lpModuleName = stName.Buffer;
+		pK22ModuleData->lpModulePath = K22DataStringToLower(&pLdrEntry->FullDllName);
+		if (pK22ModuleData->lpModulePath == NULL)
+			RETURN_K22_E("Couldn't convert module path of %p - %ls", lpImageBase, pLdrEntry->FullDllName.Buffer);
+		// intern the module name
+		pK22ModuleData->pModuleAtom = K22DataStringToAtom(&pLdrEntry->BaseDllName);
+		if (pK22ModuleData->pModuleAtom == NULL)
+			RETURN_K22_E("Couldn't convert module name of %p - %ls", lpImageBase, pLdrEntry->BaseDllName.Buffer);
+		pK22ModuleData->lpModuleName = pK22ModuleData->pModuleAtom->szName;
 		break;
 	}
 
@@ -117,5 +171,6 @@ static BOOL K22DataInitializeModule(LPVOID lpImageBase) {
 		pK22Header->dwCoreMagic	 = K22_CORE_MAGIC;
 		pK22Header->lpModuleData = pK22ModuleData;
 	}
+	K22ModuleIndexAdd(pK22ModuleData);
 	return TRUE;
 }
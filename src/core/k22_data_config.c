@@ -9,17 +9,17 @@ DWORD K22ConfigReadValueGlobal(LPCSTR lpName, PVOID pValue, DWORD cbValue) {
 }
 
 DWORD K22ConfigReadValue(LPCSTR lpName, PVOID pValue, DWORD cbValue) {
-	for (PHKEY pConfig = &pK22Data->stReg.hConfig[1]; pConfig >= &pK22Data->stReg.hConfig[0]; pConfig--) {
-		HKEY hConfig = *pConfig;
-		if (hConfig == NULL)
-			continue;
-		if (RegGetValue(hConfig, NULL, lpName, RRF_RT_ANY, NULL, pValue, &cbValue) == ERROR_SUCCESS)
-			return cbValue;
-	}
-	return 0;
+	// read a value of the per-app or the global key, from the merged configuration (see k22_data_store.c)
+	PK22_CONFIG_VALUE pConfigValue = K22ConfigGetValue(NULL, lpName);
+	if (pConfigValue == NULL || pConfigValue->cbData > cbValue)
+		return 0;
+	memcpy(pValue, pConfigValue->pData, pConfigValue->cbData);
+	return pConfigValue->cbData;
 }
 
 BOOL K22ConfigReadKey(LPCSTR lpName, BOOL (*pProc)(HKEY)) {
+	// call pProc for the global key, then for the per-app key - this reads the registry on every call
+	// plugins should prefer K22ConfigGetKey(), which has both keys merged in memory
 	for (PHKEY pConfig = &pK22Data->stReg.hConfig[0]; pConfig <= &pK22Data->stReg.hConfig[1]; pConfig++) {
 		HKEY hConfig = *pConfig;
 		if (hConfig == NULL)
@@ -36,27 +36,141 @@ BOOL K22ConfigReadKey(LPCSTR lpName, BOOL (*pProc)(HKEY)) {
 	return TRUE;
 }
 
+// Configuration file - an INI-style alternative to the registry keys, given in the ConfigFile value.
+// Sections are named like the registry keys under Global, i.e. [DllRedirect] or [DllRewrite\foo.dll]; per-app rules
+// go to [PerApp\<process name>\DllRedirect] etc. Rules of the file are applied after (and override) the registry.
+// The file is indexed once (see k22_ini.c), then only the lines of matching sections are read.
+
+BOOL K22ConfigOpenFile() {
+	// map the configuration file given in the ConfigFile value, if any
+	// the file stays mapped, as plugins can read their sections later
+	CHAR szPath[MAX_PATH];
+	DWORD cbPath = K22ConfigReadValue("ConfigFile", szPath, sizeof(szPath));
+	if (cbPath <= 1)
+		return TRUE;
+	if (!K22StringDupFileName(szPath, cbPath - 1, &pK22Data->stConfigFile.lpPath))
+		return FALSE;
+	LPCSTR lpPath = pK22Data->stConfigFile.lpPath;
+
+	WIN32_FILE_ATTRIBUTE_DATA stAttributes;
+	if (!GetFileAttributesEx(lpPath, GetFileExInfoStandard, &stAttributes)) {
+		K22_W_ERR("Configuration file not found - %s", lpPath);
+		return TRUE;
+	}
+	pK22Data->stConfigFile.ftLastWrite = stAttributes.ftLastWriteTime;
+	pK22Data->stConfigFile.lpData	   = K22FileMapRead(lpPath, &pK22Data->stConfigFile.cbData);
+	if (pK22Data->stConfigFile.lpData == NULL) {
+		K22_W_ERR("Couldn't map configuration file - %s", lpPath);
+		return TRUE;
+	}
+	if (!K22IniParse(
+			&pK22Data->stConfigFile.stIni,
+			pK22Data->stConfigFile.lpData,
+			pK22Data->stConfigFile.cbData,
+			K22ArenaAlloc
+		))
+		return FALSE;
+	K22_I("Configuration file mapped - %s", lpPath);
+	return TRUE;
+}
+
+static BOOL K22ConfigViewCopy(PK22_STRING_VIEW pView, LPSTR lpOutput, DWORD cchOutput) {
+	// copy to a NULL-terminated buffer, which the parsers can modify
+	if (pView->cchData >= cchOutput)
+		return FALSE;
+	memcpy(lpOutput, pView->lpData, pView->cchData);
+	lpOutput[pView->cchData] = '\0';
+	return TRUE;
+}
+
+static BOOL K22ConfigReadView(PK22_INI_FILE pIni, LPCSTR lpName, BOOL (*pProc)(LPSTR, LPSTR, DWORD, LPSTR, DWORD)) {
+	// K22ConfigReadSection() of a particular view of the file
+	// same limits as K22_REG_VARS()
+	CHAR szSection[256 + 1], szName[256 + 1], szValue[256 + 1];
+
+	for (DWORD i = 0; i < 2; i++) {
+		CHAR szPrefix[MAX_PATH];
+		HRESULT hResult;
+		if (i == 0)
+			hResult = StringCbCopy(szPrefix, sizeof(szPrefix), lpName);
+		else
+			hResult = StringCbPrintf(szPrefix, sizeof(szPrefix), "PerApp\\%s\\%s", pK22Data->lpProcessName, lpName);
+		if (FAILED(hResult))
+			continue;
+		DWORD cchPrefix = strlen(szPrefix);
+
+		PK22_INI_SECTION pSection;
+		K22_LL_FOREACH(pIni->pSections, pSection) {
+			K22_STRING_VIEW stSection = pSection->stName;
+			if (stSection.cchData < cchPrefix || !K22StringEqualsN(stSection.lpData, szPrefix, cchPrefix))
+				continue;
+			// [prefix] or [prefix\subsection]
+			stSection.lpData += cchPrefix;
+			stSection.cchData -= cchPrefix;
+			if (stSection.cchData != 0) {
+				if (stSection.lpData[0] != '\\')
+					continue;
+				stSection.lpData++;
+				stSection.cchData--;
+			}
+			if (!K22ConfigViewCopy(&stSection, szSection, sizeof(szSection))) {
+				K22_W("Configuration file line %lu is too long", pSection->dwLine);
+				continue;
+			}
+
+			K22_INI_READER stReader;
+			K22_STRING_VIEW stName, stValue;
+			K22IniReadSection(&stReader, pSection);
+			while (K22IniRead(&stReader, &stName, &stValue)) {
+				if (!K22ConfigViewCopy(&stName, szName, sizeof(szName)) ||
+					!K22ConfigViewCopy(&stValue, szValue, sizeof(szValue))) {
+					K22_W("Configuration file line %lu is too long", stReader.dwLine);
+					continue;
+				}
+				if (!pProc(szSection, szName, stName.cchData, szValue, stValue.cchData))
+					return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+BOOL K22ConfigReadSection(LPCSTR lpName, BOOL (*pProc)(LPSTR, LPSTR, DWORD, LPSTR, DWORD)) {
+	// call pProc(lpSubsection, lpName, cchName, lpValue, cchValue) for every value of the configuration file,
+	// in sections [lpName] and [lpName\<subsection>] (the subsection is an empty string for the former),
+	// then in the same sections of this process ([PerApp\<process name>\lpName], ...)
+	if (pK22Data->stConfigFile.lpData == NULL)
+		return TRUE;
+	return K22ConfigReadView(&pK22Data->stConfigFile.stIni, lpName, pProc);
+}
+
+static BOOL K22ConfigSetDllExtra(LPSTR lpName, DWORD cchName, LPSTR lpValue, DWORD cchValue) {
+	PK22_DLL_EXTRA pDllExtra;
+	K22_LL_FIND(
+		pK22Data->pDllBuild->pDllExtra,
+		pDllExtra,
+		// comparison
+		strcmp(lpName, pDllExtra->lpKey) == 0
+	);
+	if (pDllExtra == NULL) {
+		K22_LL_ALLOC_APPEND(pK22Data->pDllBuild->pDllExtra, pDllExtra);
+		if (!K22StringDup(lpName, cchName, &pDllExtra->lpKey))
+			return FALSE;
+	} else {
+		K22_V(" - DLL Extra: will replace '%s'", pDllExtra->lpKey);
+	}
+	if (!K22StringDupFileName(lpValue, cchValue, &pDllExtra->lpTargetDll))
+		return FALSE;
+	K22_D(" - DLL Extra: setting '%s' (%s)", pDllExtra->lpKey, pDllExtra->lpTargetDll);
+	return TRUE;
+}
+
 BOOL K22ConfigParseDllExtra(HKEY hDllExtra) {
 	K22_REG_VARS();
 
 	K22_REG_ENUM_VALUE(hDllExtra, szName, cbName, szValue, cbValue) {
-		PK22_DLL_EXTRA pDllExtra;
-		K22_LL_FIND(
-			pK22Data->stDll.pDllExtra,
-			pDllExtra,
-			// comparison
-			strcmp(szName, pDllExtra->lpKey) == 0
-		);
-		if (pDllExtra == NULL) {
-			K22_LL_ALLOC_APPEND(pK22Data->stDll.pDllExtra, pDllExtra);
-			if (!K22StringDup(szName, cbName, &pDllExtra->lpKey))
-				return FALSE;
-		} else {
-			K22_V(" - DLL Extra: will replace '%s'", pDllExtra->lpKey);
-		}
-		if (!K22StringDupFileName(szValue, cbValue - 1, &pDllExtra->lpTargetDll))
+		if (!K22ConfigSetDllExtra(szName, cbName, szValue, cbValue - 1))
 			return FALSE;
-		K22_D(" - DLL Extra: setting '%s' (%s)", pDllExtra->lpKey, pDllExtra->lpTargetDll);
 	}
 	return TRUE;
 }
@@ -65,26 +179,91 @@ static INT K22DllApiSetCompare(PVOID pDllApiSet1, PVOID pDllApiSet2) {
 	return _stricmp(((PK22_DLL_API_SET)pDllApiSet1)->lpSourceDll, ((PK22_DLL_API_SET)pDllApiSet2)->lpSourceDll);
 }
 
+VOID K22ConfigIndexDllApiSet() {
+	// rebuild the hash table of API sets, keyed by name without level/version (api-ms-aaa-bbb-lX-Y-Z.dll)
+	// entries of the same API set are chained in pGroupNext, in the order of the sorted list
+	HASH_CLEAR(hh, pK22Data->pDllBuild->pDllApiSetIndex);
+	PK22_DLL_API_SET pDllApiSet;
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllApiSet, pDllApiSet) {
+		pDllApiSet->pGroupNext	  = NULL;
+		pDllApiSet->pGroupLast	  = NULL;
+		pDllApiSet->fGroupSymbols = FALSE;
+		DWORD cchKey			  = K22DllApiSetKeyLength(pDllApiSet->lpSourceDll);
+		if (cchKey == 0)
+			continue;
+		PK22_DLL_API_SET pGroup;
+		HASH_FIND(hh, pK22Data->pDllBuild->pDllApiSetIndex, pDllApiSet->lpSourceDll, cchKey, pGroup);
+		if (pGroup == NULL) {
+			pGroup				   = pDllApiSet;
+			pDllApiSet->pGroupLast = pDllApiSet;
+			HASH_ADD_KEYPTR(hh, pK22Data->pDllBuild->pDllApiSetIndex, pDllApiSet->lpSourceDll, cchKey, pDllApiSet);
+		} else {
+			pGroup->pGroupLast->pGroupNext = pDllApiSet;
+			pGroup->pGroupLast			   = pDllApiSet;
+		}
+		if (pDllApiSet->lpSourceSymbol != NULL)
+			pGroup->fGroupSymbols = TRUE;
+	}
+}
+
+static VOID K22ConfigSortDllApiSet() {
+	// sort the list; this is an optimization used together with "pDllApiSetDefault" in K22FindDllApiSet()
+	K22_LL_SORT(pK22Data->pDllBuild->pDllApiSet, K22DllApiSetCompare);
+	K22ConfigIndexDllApiSet();
+}
+
+static BOOL K22ConfigAddDllApiSet(LPSTR lpName, DWORD cchName, LPSTR lpValue, DWORD cchValue) {
+	PK22_DLL_API_SET pDllApiSet;
+	K22_LL_ALLOC_APPEND(pK22Data->pDllBuild->pDllApiSet, pDllApiSet);
+	if (!K22StringDupDllTarget(lpName, cchName, &pDllApiSet->lpSourceDll, &pDllApiSet->lpSourceSymbol))
+		return FALSE;
+	if (!K22StringDup(lpValue, cchValue, &pDllApiSet->lpTargetDll))
+		return FALSE;
+	// source names are only used for case-insensitive matching
+	_strlwr(pDllApiSet->lpSourceDll);
+	pDllApiSet->cchSourceDll = strlen(pDllApiSet->lpSourceDll);
+	if (pDllApiSet->lpSourceSymbol) {
+		pDllApiSet->pSourceSymbol = K22AtomAdd(pDllApiSet->lpSourceSymbol, strlen(pDllApiSet->lpSourceSymbol));
+		if (pDllApiSet->pSourceSymbol == NULL)
+			return FALSE;
+		pDllApiSet->lpSourceSymbol = pDllApiSet->pSourceSymbol->szName;
+	}
+
+	K22_V(
+		" - DLL ApiSet: setting %s!%s -> %s",
+		pDllApiSet->lpSourceDll,
+		pDllApiSet->lpSourceSymbol ? pDllApiSet->lpSourceSymbol : "*",
+		pDllApiSet->lpTargetDll
+	);
+	return TRUE;
+}
+
 BOOL K22ConfigParseDllApiSet(HKEY hDllApiSet) {
 	K22_REG_VARS();
 
 	K22_REG_ENUM_VALUE(hDllApiSet, szName, cbName, szValue, cbValue) {
-		PK22_DLL_API_SET pDllApiSet;
-		K22_LL_ALLOC_APPEND(pK22Data->stDll.pDllApiSet, pDllApiSet);
-		if (!K22StringDupDllTarget(szName, cbName, &pDllApiSet->lpSourceDll, &pDllApiSet->lpSourceSymbol))
-			return FALSE;
-		if (!K22StringDup(szValue, cbValue - 1, &pDllApiSet->lpTargetDll))
+		if (!K22ConfigAddDllApiSet(szName, cbName, szValue, cbValue - 1))
 			return FALSE;
+	}
+	K22ConfigSortDllApiSet();
+	return TRUE;
+}
 
-		K22_V(
-			" - DLL ApiSet: setting %s!%s -> %s",
-			pDllApiSet->lpSourceDll,
-			pDllApiSet->lpSourceSymbol ? pDllApiSet->lpSourceSymbol : "*",
-			pDllApiSet->lpTargetDll
-		);
+static BOOL K22ConfigSetDllRedirect(LPSTR lpName, DWORD cchName, LPSTR lpValue, DWORD cchValue) {
+	PK22_DLL_REDIRECT pDllRedirect;
+	_strlwr(lpName);
+	HASH_FIND(hh, pK22Data->pDllBuild->pDllRedirectIndex, lpName, cchName, pDllRedirect);
+	if (pDllRedirect == NULL) {
+		K22_LL_ALLOC_APPEND(pK22Data->pDllBuild->pDllRedirect, pDllRedirect);
+		if (!K22StringDup(lpName, cchName, &pDllRedirect->lpSourceDll))
+			return FALSE;
+		HASH_ADD_KEYPTR(hh, pK22Data->pDllBuild->pDllRedirectIndex, pDllRedirect->lpSourceDll, cchName, pDllRedirect);
+	} else {
+		K22_V(" - DLL Redirect: will replace %s", pDllRedirect->lpSourceDll);
 	}
-	// sort the list; this is an optimization used together with "pDllApiSetDefault" in K22FindDllApiSet()
-	K22_LL_SORT(pK22Data->stDll.pDllApiSet, K22DllApiSetCompare);
+	if (!K22StringDupFileName(lpValue, cchValue, &pDllRedirect->lpTargetDll))
+		return FALSE;
+	K22_D(" - DLL Redirect: setting %s -> %s", pDllRedirect->lpSourceDll, pDllRedirect->lpTargetDll);
 	return TRUE;
 }
 
@@ -92,23 +271,90 @@ BOOL K22ConfigParseDllRedirect(HKEY hDllRedirect) {
 	K22_REG_VARS();
 
 	K22_REG_ENUM_VALUE(hDllRedirect, szName, cbName, szValue, cbValue) {
-		PK22_DLL_REDIRECT pDllRedirect;
-		K22_LL_FIND(
-			pK22Data->stDll.pDllRedirect,
-			pDllRedirect,
-			// comparison
-			strcmp(szName, pDllRedirect->lpSourceDll) == 0
-		);
-		if (pDllRedirect == NULL) {
-			K22_LL_ALLOC_APPEND(pK22Data->stDll.pDllRedirect, pDllRedirect);
-			if (!K22StringDup(szName, cbName, &pDllRedirect->lpSourceDll))
-				return FALSE;
-		} else {
-			K22_V(" - DLL Redirect: will replace %s", pDllRedirect->lpModuleName);
-		}
-		if (!K22StringDupFileName(szValue, cbValue - 1, &pDllRedirect->lpTargetDll))
+		if (!K22ConfigSetDllRedirect(szName, cbName, szValue, cbValue - 1))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL K22ConfigGetDllRewrite(LPSTR lpSourceDll, DWORD cchSourceDll, PK22_DLL_REWRITE *ppDllRewrite) {
+	PK22_DLL_REWRITE pDllRewrite;
+	_strlwr(lpSourceDll);
+	HASH_FIND(hh, pK22Data->pDllBuild->pDllRewriteIndex, lpSourceDll, cchSourceDll, pDllRewrite);
+	if (pDllRewrite == NULL) {
+		K22_LL_ALLOC_APPEND(pK22Data->pDllBuild->pDllRewrite, pDllRewrite);
+		if (!K22StringDup(lpSourceDll, cchSourceDll, &pDllRewrite->lpSourceDll))
+			return FALSE;
+		HASH_ADD_KEYPTR(hh, pK22Data->pDllBuild->pDllRewriteIndex, pDllRewrite->lpSourceDll, cchSourceDll, pDllRewrite);
+	}
+	*ppDllRewrite = pDllRewrite;
+	return TRUE;
+}
+
+static BOOL K22ConfigSetDllRewriteDefault(PK22_DLL_REWRITE pDllRewrite, LPSTR lpValue, DWORD cchValue) {
+	if (!K22StringDupFileName(lpValue, cchValue, &pDllRewrite->lpDefaultDll))
+		return FALSE;
+	K22_D(" - DLL Rewrite: setting %s!? (missing) -> %s", pDllRewrite->lpSourceDll, pDllRewrite->lpDefaultDll);
+	return TRUE;
+}
+
+static BOOL K22ConfigSetDllRewrite(
+	PK22_DLL_REWRITE pDllRewrite,
+	LPSTR lpName,
+	DWORD cchName,
+	LPSTR lpValue,
+	DWORD cchValue
+) {
+	// set a value of a DLL's rewrite rules - Default (missing symbols), '*' (Catch-All) or a symbol name
+	if (lpName[0] == '\0')
+		return K22ConfigSetDllRewriteDefault(pDllRewrite, lpValue, cchValue);
+	if (lpName[0] == '*') {
+		if (!K22StringDupFileName(lpValue, cchValue, &pDllRewrite->lpCatchAllDll))
+			return FALSE;
+		K22_D(" - DLL Rewrite: setting %s!* (all) -> %s", pDllRewrite->lpSourceDll, pDllRewrite->lpCatchAllDll);
+		return TRUE;
+	}
+
+	PK22_DLL_REWRITE_SYMBOL pSymbol;
+	// source symbols are matched case-insensitively, by their atoms
+	PK22_ATOM pSourceSymbol = K22AtomAdd(lpName, cchName);
+	if (pSourceSymbol == NULL)
+		return FALSE;
+	HASH_FIND(hh, pDllRewrite->pSymbolIndex, &pSourceSymbol, sizeof(PK22_ATOM), pSymbol);
+	if (pSymbol == NULL) {
+		K22_LL_ALLOC_APPEND(pDllRewrite->pSymbols, pSymbol);
+		pSymbol->pSourceSymbol	= pSourceSymbol;
+		pSymbol->lpSourceSymbol = pSourceSymbol->szName;
+		HASH_ADD(hh, pDllRewrite->pSymbolIndex, pSourceSymbol, sizeof(PK22_ATOM), pSymbol);
+	} else {
+		K22_V(" - DLL Rewrite: will replace %s!%s", pDllRewrite->lpSourceDll, pSymbol->lpSourceSymbol);
+	}
+	if (!K22StringDupDllTarget(lpValue, cchValue, &pSymbol->lpTargetDll, &pSymbol->lpTargetSymbol))
+		return FALSE;
+	if (pSymbol->lpTargetSymbol == NULL) {
+		// keep the original case of the symbol name
+		if (!K22StringDup(lpName, cchName, &pSymbol->lpTargetSymbol))
+			return FALSE;
+	}
+	K22SymbolRefParse(&pSymbol->stTarget, pSymbol->lpTargetSymbol);
+	K22_D(
+		" - DLL Rewrite: setting %s!%s -> %s!%s",
+		pDllRewrite->lpSourceDll,
+		pSymbol->lpSourceSymbol,
+		pSymbol->lpTargetDll,
+		pSymbol->lpTargetSymbol
+	);
+	return TRUE;
+}
+
+static BOOL K22ConfigParseDllRewriteItem(HKEY hDllRewriteItem, PK22_DLL_REWRITE pDllRewrite) {
+	// a separate function, so that the enumeration doesn't reset the index of the subkey enumeration
+	K22_REG_VARS();
+
+	// the Default value is enumerated with an empty name
+	K22_REG_ENUM_VALUE(hDllRewriteItem, szName, cbName, szValue, cbValue) {
+		if (!K22ConfigSetDllRewrite(pDllRewrite, szName, cbName, szValue, cbValue - 1))
 			return FALSE;
-		K22_D(" - DLL Redirect: setting %s -> %s", pDllRedirect->lpSourceDll, pDllRedirect->lpTargetDll);
 	}
 	return TRUE;
 }
@@ -118,77 +364,257 @@ BOOL K22ConfigParseDllRewrite(HKEY hDllRewrite) {
 
 	K22_REG_ENUM_VALUE(hDllRewrite, szName, cbName, szValue, cbValue) {
 		PK22_DLL_REWRITE pDllRewrite;
-		K22_LL_FIND(
-			pK22Data->stDll.pDllRewrite,
-			pDllRewrite,
-			// comparison
-			strcmp(szName, pDllRewrite->lpSourceDll) == 0
-		);
-		if (pDllRewrite == NULL) {
-			K22_LL_ALLOC_APPEND(pK22Data->stDll.pDllRewrite, pDllRewrite);
-			if (!K22StringDup(szName, cbName, &pDllRewrite->lpSourceDll))
-				return FALSE;
-		}
-		if (!K22StringDupFileName(szValue, cbValue - 1, &pDllRewrite->lpDefaultDll))
+		if (!K22ConfigGetDllRewrite(szName, cbName, &pDllRewrite))
+			return FALSE;
+		if (!K22ConfigSetDllRewriteDefault(pDllRewrite, szValue, cbValue - 1))
 			return FALSE;
-		K22_D(" - DLL Rewrite: setting %s!? (missing) -> %s", pDllRewrite->lpSourceDll, pDllRewrite->lpDefaultDll);
 	}
 
 	K22_REG_ENUM_KEY(hDllRewrite, szName, cbName) {
 		PK22_DLL_REWRITE pDllRewrite;
-		K22_LL_FIND(
-			pK22Data->stDll.pDllRewrite,
-			pDllRewrite,
-			// comparison
-			strcmp(szName, pDllRewrite->lpSourceDll) == 0
-		);
-		if (pDllRewrite == NULL) {
-			K22_LL_ALLOC_APPEND(pK22Data->stDll.pDllRewrite, pDllRewrite);
-			if (!K22StringDup(szName, cbName, &pDllRewrite->lpSourceDll))
-				return FALSE;
-		}
+		if (!K22ConfigGetDllRewrite(szName, cbName, &pDllRewrite))
+			return FALSE;
 		HKEY hDllRewriteItem;
 		K22_REG_REQUIRE_KEY(hDllRewrite, szName, hDllRewriteItem);
-		if (K22_REG_READ_VALUE(hDllRewriteItem, NULL, szValue, cbValue)) {
-			if (!K22StringDupFileName(szValue, cbValue - 1, &pDllRewrite->lpDefaultDll))
-				return FALSE;
-			K22_D(" - DLL Rewrite: setting %s!? (missing) -> %s", pDllRewrite->lpSourceDll, pDllRewrite->lpDefaultDll);
-		}
-		if (K22_REG_READ_VALUE(hDllRewriteItem, "*", szValue, cbValue)) {
-			if (!K22StringDupFileName(szValue, cbValue - 1, &pDllRewrite->lpCatchAllDll))
-				return FALSE;
-			K22_D(" - DLL Rewrite: setting %s!* (all) -> %s", pDllRewrite->lpSourceDll, pDllRewrite->lpCatchAllDll);
-		}
-		K22_REG_ENUM_VALUE(hDllRewriteItem, szName, cbName, szValue, cbValue) {
-			if (szName[0] == '\0' || szName[0] == '*') // skip Default and Catch-All values
-				continue;
-			PK22_DLL_REWRITE_SYMBOL pSymbol;
-			K22_LL_FIND(
-				pDllRewrite->pSymbols,
-				pSymbol,
-				// comparison
-				strcmp(szName, pSymbol->lpSourceSymbol) == 0
-			);
-			if (pSymbol == NULL) {
-				K22_LL_ALLOC_APPEND(pDllRewrite->pSymbols, pSymbol);
-				if (!K22StringDup(szName, cbName, &pSymbol->lpSourceSymbol))
-					return FALSE;
-			} else {
-				K22_V(" - DLL Rewrite: will replace %s!%s", pDllRewrite->lpSourceDll, pSymbol->lpSourceSymbol);
-			}
-			if (!K22StringDupDllTarget(szValue, cbValue - 1, &pSymbol->lpTargetDll, &pSymbol->lpTargetSymbol))
-				return FALSE;
-			if (pSymbol->lpTargetSymbol == NULL) {
-				pSymbol->lpTargetSymbol = pSymbol->lpSourceSymbol;
-			}
-			K22_D(
-				" - DLL Rewrite: setting %s!%s -> %s!%s",
-				pDllRewrite->lpSourceDll,
-				pSymbol->lpSourceSymbol,
-				pSymbol->lpTargetDll,
-				pSymbol->lpTargetSymbol
-			);
+		BOOL bSuccess = K22ConfigParseDllRewriteItem(hDllRewriteItem, pDllRewrite);
+		RegCloseKey(hDllRewriteItem);
+		if (!bSuccess)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static BOOL K22ConfigFileDllExtra(LPSTR lpSection, LPSTR lpName, DWORD cchName, LPSTR lpValue, DWORD cchValue) {
+	if (lpSection[0] != '\0')
+		return TRUE;
+	return K22ConfigSetDllExtra(lpName, cchName, lpValue, cchValue);
+}
+
+static BOOL K22ConfigFileDllApiSet(LPSTR lpSection, LPSTR lpName, DWORD cchName, LPSTR lpValue, DWORD cchValue) {
+	if (lpSection[0] != '\0')
+		return TRUE;
+	return K22ConfigAddDllApiSet(lpName, cchName, lpValue, cchValue);
+}
+
+static BOOL K22ConfigFileDllRedirect(LPSTR lpSection, LPSTR lpName, DWORD cchName, LPSTR lpValue, DWORD cchValue) {
+	if (lpSection[0] != '\0')
+		return TRUE;
+	return K22ConfigSetDllRedirect(lpName, cchName, lpValue, cchValue);
+}
+
+static BOOL K22ConfigFileDllRewrite(LPSTR lpSection, LPSTR lpName, DWORD cchName, LPSTR lpValue, DWORD cchValue) {
+	// [DllRewrite] has default DLLs of source DLLs, [DllRewrite\<source DLL>] has the rules of a single DLL
+	PK22_DLL_REWRITE pDllRewrite;
+	if (lpSection[0] == '\0') {
+		if (!K22ConfigGetDllRewrite(lpName, cchName, &pDllRewrite))
+			return FALSE;
+		return K22ConfigSetDllRewriteDefault(pDllRewrite, lpValue, cchValue);
+	}
+	if (!K22ConfigGetDllRewrite(lpSection, strlen(lpSection), &pDllRewrite))
+		return FALSE;
+	return K22ConfigSetDllRewrite(pDllRewrite, lpName, cchName, lpValue, cchValue);
+}
+
+BOOL K22ConfigParseFile(LPCSTR lpData, SIZE_T cbData) {
+	// read the rules of a view of the configuration file, after the registry keys
+	if (lpData == NULL)
+		return TRUE;
+	// the view mapped at startup is indexed already (see K22ConfigOpenFile()), reloads map a new one
+	K22_INI_FILE stIni;
+	PK22_INI_FILE pIni = &pK22Data->stConfigFile.stIni;
+	if (lpData != pK22Data->stConfigFile.lpData) {
+		if (!K22IniParse(&stIni, lpData, cbData, K22ArenaAlloc))
+			return FALSE;
+		pIni = &stIni;
+	}
+	if (pIni->dwErrors != 0)
+		K22_W("Configuration file has %lu invalid lines, first one is %lu", pIni->dwErrors, pIni->dwErrorLine);
+
+	if (!K22ConfigReadView(pIni, "DllExtra", K22ConfigFileDllExtra))
+		return FALSE;
+	if (!K22ConfigReadView(pIni, "DllApiSet", K22ConfigFileDllApiSet))
+		return FALSE;
+	K22ConfigSortDllApiSet();
+	if (!K22ConfigReadView(pIni, "DllRedirect", K22ConfigFileDllRedirect))
+		return FALSE;
+	if (!K22ConfigReadView(pIni, "DllRewrite", K22ConfigFileDllRewrite))
+		return FALSE;
+	return TRUE;
+}
+
+BOOL K22ConfigParseRules(LPCSTR lpData, SIZE_T cbData) {
+	// read all rules into pDllBuild - the registry keys, then a view of the configuration file
+	if (!K22ConfigReadKey("DllExtra", K22ConfigParseDllExtra))
+		return FALSE;
+	if (!K22ConfigReadKey("DllApiSet", K22ConfigParseDllApiSet))
+		return FALSE;
+	if (!K22ConfigReadKey("DllRedirect", K22ConfigParseDllRedirect))
+		return FALSE;
+	if (!K22ConfigReadKey("DllRewrite", K22ConfigParseDllRewrite))
+		return FALSE;
+	return K22ConfigParseFile(lpData, cbData);
+}
+
+static PK22_DLL_REDIRECT K22ConfigCollapseRedirect(PK22_DLL_REDIRECT pDllRedirect) {
+	// find the last entry of the redirect chain starting at pDllRedirect, and store it in all visited entries
+	static DWORD dwChainWalk = 0;
+	dwChainWalk++;
+
+	PK22_DLL_REDIRECT pChainLast = pDllRedirect;
+	while (pChainLast->pChainLast == NULL) {
+		pChainLast->dwChainWalk = dwChainWalk;
+		PK22_DLL_REDIRECT pNext;
+		K22_FIND_BY_PATH(pK22Data->pDllBuild->pDllRedirectIndex, pChainLast->lpTargetDll, pNext);
+		if (pNext == NULL || pNext == pChainLast)
+			break;
+		if (pNext->dwChainWalk == dwChainWalk) {
+			// stop right before closing the loop
+			K22_W(" - DLL Redirect: cycle detected, %s -> %s", pChainLast->lpTargetDll, pNext->lpTargetDll);
+			break;
 		}
+		pChainLast = pNext;
+	}
+	if (pChainLast->pChainLast != NULL)
+		// reached a chain collapsed before
+		pChainLast = pChainLast->pChainLast;
+
+	// walk the chain again, until reaching a collapsed entry
+	for (PK22_DLL_REDIRECT pEntry = pDllRedirect; pEntry != NULL && pEntry->pChainLast == NULL; /**/) {
+		pEntry->pChainLast = pChainLast;
+		// K22_FIND_BY_PATH() clears its output first - it can't be the entry the name is read from
+		PK22_DLL_REDIRECT pNext;
+		K22_FIND_BY_PATH(pK22Data->pDllBuild->pDllRedirectIndex, pEntry->lpTargetDll, pNext);
+		pEntry = pNext;
+	}
+	return pChainLast;
+}
+
+static BOOL K22ConfigCompileRoute(LPCSTR lpSourceDll) {
+	// compile the rules applying to lpSourceDll, after DllApiSet
+	PK22_DLL_ROUTE_ENTRY pRouteEntry;
+	HASH_FIND(hh, pK22Data->pDllBuild->pDllRouteIndex, lpSourceDll, strlen(lpSourceDll), pRouteEntry);
+	if (pRouteEntry != NULL)
+		return TRUE;
+	K22_ARENA_CALLOC(pRouteEntry);
+	pRouteEntry->lpSourceDll = lpSourceDll;
+
+	LPCSTR lpModuleName = lpSourceDll;
+	PK22_DLL_REDIRECT pDllRedirect;
+	K22_FIND_BY_PATH(pK22Data->pDllBuild->pDllRedirectIndex, lpModuleName, pDllRedirect);
+	if (pDllRedirect != NULL) {
+		pDllRedirect			 = K22ConfigCollapseRedirect(pDllRedirect);
+		pRouteEntry->lpTargetDll = lpModuleName = pDllRedirect->lpTargetDll;
+		pRouteEntry->ppModule	 = &pDllRedirect->pModule; // cache module in the last redirect entry
+	}
+	K22_FIND_BY_PATH(pK22Data->pDllBuild->pDllRewriteIndex, lpModuleName, pRouteEntry->pDllRewrite);
+
+	HASH_ADD_KEYPTR(hh, pK22Data->pDllBuild->pDllRouteIndex, lpSourceDll, strlen(lpSourceDll), pRouteEntry);
+	K22_V(
+		" - DLL Route: %s -> %s%s",
+		lpSourceDll,
+		lpModuleName,
+		pRouteEntry->pDllRewrite != NULL ? " (rewritten)" : ""
+	);
+	return TRUE;
+}
+
+BOOL K22ConfigCompileRoutes() {
+	// compile DllRedirect and DllRewrite rules into a single table, keyed by lowercase source DLL
+	// redirect chains are collapsed here, so that every lookup is a single table probe
+	// names that aren't keys of any rule have no route; names with paths also match by base name
+	// entries of a previous compilation stay in the arena
+	HASH_CLEAR(hh, pK22Data->pDllBuild->pDllRouteIndex);
+	PK22_DLL_REDIRECT pDllRedirect;
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllRedirect, pDllRedirect) {
+		pDllRedirect->pChainLast = NULL;
+	}
+
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllRedirect, pDllRedirect) {
+		if (!K22ConfigCompileRoute(pDllRedirect->lpSourceDll))
+			return FALSE;
+	}
+	PK22_DLL_REWRITE pDllRewrite;
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllRewrite, pDllRewrite) {
+		if (!K22ConfigCompileRoute(pDllRewrite->lpSourceDll))
+			return FALSE;
 	}
+	K22_D("Compiled %lu DLL routes", HASH_CNT(hh, pK22Data->pDllBuild->pDllRouteIndex));
 	return TRUE;
 }
+
+static VOID K22RuleFilterBits(LPCSTR lpName, DWORD cchName, PDWORD pdwBit1, PDWORD pdwBit2) {
+	// double hashing - FNV-1a (K22StringHash()) and an independent, case-insensitive hash with a different seed
+	// the second one is the (odd) step, so the two bits never coincide in the power-of-two filter
+	DWORD dwHash1 = K22StringHash(lpName, cchName);
+	DWORD dwHash2 = 0x9E3779B9;
+	for (DWORD i = 0; i < cchName; i++) {
+		CHAR cInput = lpName[i];
+		if (cInput >= 'A' && cInput <= 'Z')
+			cInput += 'a' - 'A';
+		dwHash2 = (dwHash2 ^ (BYTE)cInput) * 0x01000193;
+		dwHash2 ^= dwHash2 >> 15;
+	}
+	*pdwBit1 = dwHash1 % K22_RULE_FILTER_BITS;
+	*pdwBit2 = (dwHash1 + (dwHash2 | 1)) % K22_RULE_FILTER_BITS;
+}
+
+static VOID K22RuleFilterAdd(LPCSTR lpName, DWORD cchName) {
+	DWORD dwBit1, dwBit2;
+	K22RuleFilterBits(lpName, cchName, &dwBit1, &dwBit2);
+	PBYTE pbFilter = pK22Data->pDllBuild->bRuleFilter;
+	pbFilter[dwBit1 / 8] |= 1 << (dwBit1 % 8);
+	pbFilter[dwBit2 / 8] |= 1 << (dwBit2 % 8);
+}
+
+static BOOL K22RuleFilterTest(PBYTE pbFilter, LPCSTR lpName, DWORD cchName) {
+	DWORD dwBit1, dwBit2;
+	K22RuleFilterBits(lpName, cchName, &dwBit1, &dwBit2);
+	return (pbFilter[dwBit1 / 8] & (1 << (dwBit1 % 8))) && (pbFilter[dwBit2 / 8] & (1 << (dwBit2 % 8)));
+}
+
+VOID K22ConfigIndexRuleFilter() {
+	// rebuild the membership filter of source DLL names of all DllApiSet, DllRedirect and DllRewrite rules
+	// API sets are added by name without level/version (api-ms-aaa-bbb-lX-Y-Z.dll), like in pDllApiSetIndex
+	memset(pK22Data->pDllBuild->bRuleFilter, 0, sizeof(pK22Data->pDllBuild->bRuleFilter));
+	DWORD dwCount = 0;
+
+	PK22_DLL_API_SET pDllApiSet;
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllApiSet, pDllApiSet) {
+		DWORD cchKey = K22DllApiSetKeyLength(pDllApiSet->lpSourceDll);
+		K22RuleFilterAdd(pDllApiSet->lpSourceDll, cchKey ? cchKey : strlen(pDllApiSet->lpSourceDll));
+		dwCount++;
+	}
+	PK22_DLL_REDIRECT pDllRedirect;
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllRedirect, pDllRedirect) {
+		K22RuleFilterAdd(pDllRedirect->lpSourceDll, strlen(pDllRedirect->lpSourceDll));
+		dwCount++;
+	}
+	PK22_DLL_REWRITE pDllRewrite;
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllRewrite, pDllRewrite) {
+		K22RuleFilterAdd(pDllRewrite->lpSourceDll, strlen(pDllRewrite->lpSourceDll));
+		dwCount++;
+	}
+	// API sets of the system, whose host DLL has rules - their imports must reach the rules, too
+	PK22_DLL_API_SET pTmp;
+	HASH_ITER(hh, pK22Data->pDllBuild->pDllApiSetSchema, pDllApiSet, pTmp) {
+		PK22_DLL_ROUTE_ENTRY pRouteEntry;
+		K22_FIND_BY_PATH(pK22Data->pDllBuild->pDllRouteIndex, pDllApiSet->lpTargetDll, pRouteEntry);
+		if (pRouteEntry == NULL)
+			continue;
+		DWORD cchKey = K22DllApiSetKeyLength(pDllApiSet->lpSourceDll);
+		K22RuleFilterAdd(pDllApiSet->lpSourceDll, cchKey ? cchKey : strlen(pDllApiSet->lpSourceDll));
+		dwCount++;
+	}
+	K22_D("Rule filter built from %lu source DLLs", dwCount);
+}
+
+BOOL K22ConfigRuleFilterMatches(LPCSTR lpModuleName) {
+	// check if any rule might apply to an imported module name
+	// false positives are possible (resolved normally), false negatives are not
+	// both tests must use the same filter, in case the rules are replaced in the meantime
+	PBYTE pbFilter = pK22Data->pDll->bRuleFilter;
+	DWORD cchKey   = K22DllApiSetKeyLength(lpModuleName);
+	if (cchKey != 0 && K22RuleFilterTest(pbFilter, lpModuleName, cchKey))
+		return TRUE;
+	return K22RuleFilterTest(pbFilter, lpModuleName, strlen(lpModuleName));
+}
@@ -0,0 +1,137 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-11.
+
+#include "kernel22.h"
+
+// Index of loaded modules, by base name, full path and image base.
+// Seeded once in K22CoreMain(), then updated on every DLL load/unload notification.
+// When the DLL notification callback is not active, the index is disabled and the loader lists are walked instead.
+
+BOOL K22ModuleIndexEnable() {
+	AcquireSRWLockExclusive(&pK22Data->stModules.stLock);
+	pK22Data->stModules.fEnabled = TRUE;
+	ReleaseSRWLockExclusive(&pK22Data->stModules.stLock);
+
+	// add all modules loaded so far, in load order
+	K22_LDR_ENUM(pLdrEntry, InLoadOrderModuleList, InLoadOrderLinks) {
+		PK22_MODULE_DATA pK22ModuleData = K22DataGetModule(pLdrEntry->DllBase);
+		if (pK22ModuleData == NULL)
+			return FALSE;
+		K22ModuleIndexAdd(pK22ModuleData);
+	}
+	K22_D("Module index enabled - %lu modules", HASH_CNT(hhBase, pK22Data->stModules.pByBase));
+	return TRUE;
+}
+
+VOID K22ModuleIndexDisable() {
+	AcquireSRWLockExclusive(&pK22Data->stModules.stLock);
+	pK22Data->stModules.fEnabled = FALSE;
+	HASH_CLEAR(hhName, pK22Data->stModules.pByName);
+	HASH_CLEAR(hhPath, pK22Data->stModules.pByPath);
+	HASH_CLEAR(hhBase, pK22Data->stModules.pByBase);
+	ReleaseSRWLockExclusive(&pK22Data->stModules.stLock);
+	K22_D("Module index disabled");
+}
+
+VOID K22ModuleIndexAdd(PK22_MODULE_DATA pK22ModuleData) {
+	if (pK22ModuleData->pModuleAtom == NULL || pK22ModuleData->lpModulePath == NULL)
+		return;
+
+	AcquireSRWLockExclusive(&pK22Data->stModules.stLock);
+	PK22_MODULE_DATA pFound;
+	HASH_FIND(hhBase, pK22Data->stModules.pByBase, &pK22ModuleData->lpModuleBase, sizeof(LPVOID), pFound);
+	if (pK22Data->stModules.fEnabled && pFound == NULL) {
+		DWORD cchModulePath = strlen(pK22ModuleData->lpModulePath);
+		HASH_ADD(hhBase, pK22Data->stModules.pByBase, lpModuleBase, sizeof(LPVOID), pK22ModuleData);
+		HASH_ADD_KEYPTR(
+			hhPath,
+			pK22Data->stModules.pByPath,
+			pK22ModuleData->lpModulePath,
+			cchModulePath,
+			pK22ModuleData
+		);
+		// keep the first loaded module of each name, like a walk of the load order list would find
+		HASH_FIND(hhName, pK22Data->stModules.pByName, &pK22ModuleData->pModuleAtom, sizeof(PK22_ATOM), pFound);
+		if (pFound == NULL) {
+			HASH_ADD(hhName, pK22Data->stModules.pByName, pModuleAtom, sizeof(PK22_ATOM), pK22ModuleData);
+			pK22ModuleData->fIndexedByName = TRUE;
+		}
+	}
+	ReleaseSRWLockExclusive(&pK22Data->stModules.stLock);
+}
+
+VOID K22ModuleIndexRemove(LPVOID lpImageBase) {
+	AcquireSRWLockExclusive(&pK22Data->stModules.stLock);
+	PK22_MODULE_DATA pK22ModuleData;
+	HASH_FIND(hhBase, pK22Data->stModules.pByBase, &lpImageBase, sizeof(LPVOID), pK22ModuleData);
+	if (pK22ModuleData != NULL) {
+		HASH_DELETE(hhBase, pK22Data->stModules.pByBase, pK22ModuleData);
+		HASH_DELETE(hhPath, pK22Data->stModules.pByPath, pK22ModuleData);
+		if (pK22ModuleData->fIndexedByName) {
+			HASH_DELETE(hhName, pK22Data->stModules.pByName, pK22ModuleData);
+			pK22ModuleData->fIndexedByName = FALSE;
+			// index another loaded module with the same name, if any
+			K22_LDR_ENUM(pLdrEntry, InLoadOrderModuleList, InLoadOrderLinks) {
+				PK22_MODULE_DATA pOther;
+				HASH_FIND(hhBase, pK22Data->stModules.pByBase, &pLdrEntry->DllBase, sizeof(LPVOID), pOther);
+				if (pOther == NULL || pOther->pModuleAtom != pK22ModuleData->pModuleAtom)
+					continue;
+				HASH_ADD(hhName, pK22Data->stModules.pByName, pModuleAtom, sizeof(PK22_ATOM), pOther);
+				pOther->fIndexedByName = TRUE;
+				break;
+			}
+		}
+	}
+	ReleaseSRWLockExclusive(&pK22Data->stModules.stLock);
+}
+
+PK22_MODULE_DATA K22ModuleIndexFind(LPCSTR lpModuleName) {
+	// find a loaded module by its full path, or by its base name (see K22PathMatches())
+	BOOL bIsPath					= strchr(lpModuleName, '\\') != NULL;
+	PK22_MODULE_DATA pK22ModuleData = NULL;
+
+	AcquireSRWLockShared(&pK22Data->stModules.stLock);
+	if (pK22Data->stModules.fEnabled) {
+		if (bIsPath) {
+			CHAR szKey[MAX_PATH];
+			DWORD cchKey = K22StringLower(lpModuleName, szKey, sizeof(szKey));
+			if (cchKey != 0)
+				HASH_FIND(hhPath, pK22Data->stModules.pByPath, szKey, cchKey, pK22ModuleData);
+		} else {
+			// every loaded module's name is interned - no atom means no such module
+			PK22_ATOM pModuleAtom = K22AtomFind(lpModuleName, strlen(lpModuleName));
+			if (pModuleAtom != NULL)
+				HASH_FIND(hhName, pK22Data->stModules.pByName, &pModuleAtom, sizeof(PK22_ATOM), pK22ModuleData);
+		}
+		ReleaseSRWLockShared(&pK22Data->stModules.stLock);
+		return pK22ModuleData;
+	}
+	ReleaseSRWLockShared(&pK22Data->stModules.stLock);
+
+	// index not available - walk the load order list
+	// convert the name once, compare it with the loader's names directly
+	WCHAR szModuleName[MAX_PATH];
+	UNICODE_STRING stModuleName = {
+		.Length		   = 0,
+		.MaximumLength = sizeof(szModuleName),
+		.Buffer		   = szModuleName,
+	};
+	if (!K22StringToUnicode(lpModuleName, &stModuleName))
+		return NULL;
+	K22_LDR_ENUM(pLdrEntry, InLoadOrderModuleList, InLoadOrderLinks) {
+		// paths must match fully, names match the base name (like K22PathMatches())
+		PUNICODE_STRING pName = bIsPath ? &pLdrEntry->FullDllName : &pLdrEntry->BaseDllName;
+		if (RtlEqualUnicodeString(pName, &stModuleName, TRUE))
+			return K22DataGetModule(pLdrEntry->DllBase);
+	}
+	return NULL;
+}
+
+PK22_MODULE_DATA K22ModuleIndexFindBase(LPVOID lpImageBase) {
+	// find an indexed module by its image base; NULL if the index is disabled
+	PK22_MODULE_DATA pK22ModuleData = NULL;
+	AcquireSRWLockShared(&pK22Data->stModules.stLock);
+	if (pK22Data->stModules.fEnabled)
+		HASH_FIND(hhBase, pK22Data->stModules.pByBase, &lpImageBase, sizeof(LPVOID), pK22ModuleData);
+	ReleaseSRWLockShared(&pK22Data->stModules.stLock);
+	return pK22ModuleData;
+}
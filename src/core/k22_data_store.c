@@ -0,0 +1,191 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-18.
+
+#include "kernel22.h"
+
+// Merged configuration - values of the Global and PerApp\<process name> keys (and their subkeys), read once at startup.
+// Per-app values replace global values of the same name; a key exists if any of the two has it.
+// The store is read-only afterwards, so that K22ConfigReadValue() and plugins read it from memory, without locking.
+// Rule keys (DllExtra, DllApiSet, DllRedirect, DllRewrite) aren't stored - the core parses them into its own tables
+// (or reads them from the configuration cache) and they would only take space here.
+
+static BOOL K22StoreIsRuleKey(LPCSTR lpName) {
+	return _stricmp(lpName, "DllExtra") == 0 || _stricmp(lpName, "DllApiSet") == 0 ||
+		   _stricmp(lpName, "DllRedirect") == 0 || _stricmp(lpName, "DllRewrite") == 0;
+}
+
+static BOOL K22StoreGetKey(PK22_CONFIG_KEY pParent, LPCSTR lpName, PK22_CONFIG_KEY *ppKey) {
+	// find or add a subkey of pParent
+	CHAR szPath[MAX_PATH];
+	HRESULT hResult;
+	if (pParent->lpPath[0] == '\0')
+		hResult = StringCbCopy(szPath, sizeof(szPath), lpName);
+	else
+		hResult = StringCbPrintf(szPath, sizeof(szPath), "%s\\%s", pParent->lpPath, lpName);
+	if (FAILED(hResult))
+		RETURN_K22_E("Configuration key path is too long - %s\\%s", pParent->lpPath, lpName);
+	DWORD cchPath = K22StringLower(szPath, szPath, sizeof(szPath));
+
+	PK22_CONFIG_KEY pKey;
+	HASH_FIND(hh, pK22Data->stStore.pKeyIndex, szPath, cchPath, pKey);
+	if (pKey == NULL) {
+		K22_LL_ALLOC_APPEND(pParent->pSubkeys, pKey);
+		if (!K22StringDup(szPath, cchPath, &pKey->lpPath))
+			return FALSE;
+		pKey->lpName = pKey->lpPath + cchPath - strlen(lpName);
+		HASH_ADD_KEYPTR(hh, pK22Data->stStore.pKeyIndex, pKey->lpPath, cchPath, pKey);
+		pK22Data->stStore.dwKeys++;
+	}
+	*ppKey = pKey;
+	return TRUE;
+}
+
+static BOOL K22StoreSetValue(
+	PK22_CONFIG_KEY pKey,
+	LPCSTR lpName,
+	DWORD cchName,
+	DWORD dwType,
+	const BYTE *pData,
+	DWORD cbData,
+	BOOL fPerApp
+) {
+	// add a value to pKey, or replace the value of the same name
+	PK22_ATOM pNameAtom = K22AtomAdd(lpName, cchName);
+	if (pNameAtom == NULL)
+		return FALSE;
+	PK22_CONFIG_VALUE pValue;
+	HASH_FIND(hh, pKey->pValueIndex, &pNameAtom, sizeof(PK22_ATOM), pValue);
+	if (pValue == NULL) {
+		K22_LL_ALLOC_APPEND(pKey->pValues, pValue);
+		if (!K22StringDup(lpName, cchName, &pValue->lpName))
+			return FALSE;
+		pValue->pNameAtom = pNameAtom;
+		HASH_ADD(hh, pKey->pValueIndex, pNameAtom, sizeof(PK22_ATOM), pValue);
+		pK22Data->stStore.dwValues++;
+	}
+
+	// the arena is zero-filled - strings (and REG_MULTI_SZ) are always terminated
+	LPBYTE pCopy;
+	K22_ARENA_LENGTH(pCopy, cbData + 2);
+	memcpy(pCopy, pData, cbData);
+	if (dwType == REG_EXPAND_SZ) {
+		// expand it now, like RegGetValue() does - from the copy, as the registry data may not be terminated
+		LPBYTE pExpanded;
+		DWORD cchExpanded = ExpandEnvironmentStrings((LPCSTR)pCopy, NULL, 0);
+		K22_ARENA_LENGTH(pExpanded, cchExpanded + 1);
+		if (cchExpanded == 0 || ExpandEnvironmentStrings((LPCSTR)pCopy, (LPSTR)pExpanded, cchExpanded) == 0)
+			RETURN_K22_E_ERR("Couldn't expand configuration value '%s'", lpName);
+		pCopy  = pExpanded;
+		dwType = REG_SZ;
+		cbData = cchExpanded;
+	} else if ((dwType == REG_SZ || dwType == REG_MULTI_SZ) && (cbData == 0 || pCopy[cbData - 1] != '\0')) {
+		cbData++;
+	}
+	pValue->dwType	= dwType;
+	pValue->cbData	= cbData;
+	pValue->pData	= pCopy;
+	pValue->fPerApp = fPerApp;
+	return TRUE;
+}
+
+static BOOL K22StoreReadKey(HKEY hKey, PK22_CONFIG_KEY pKey, BOOL fPerApp) {
+	// merge all values and subkeys of hKey into pKey
+	DWORD cchMaxName, cbMaxData;
+	if (RegQueryInfoKey(hKey, NULL, NULL, NULL, NULL, NULL, NULL, NULL, &cchMaxName, &cbMaxData, NULL, NULL) !=
+		ERROR_SUCCESS)
+		return TRUE;
+	// one buffer for the name and the data of every value
+	BOOL bSuccess = TRUE;
+	LPSTR lpName;
+	K22_MALLOC_LENGTH(lpName, cchMaxName + 1 + cbMaxData);
+	LPBYTE pData = (LPBYTE)lpName + cchMaxName + 1;
+
+	for (DWORD dwIndex = 0; bSuccess; dwIndex++) {
+		DWORD cchName = cchMaxName + 1;
+		DWORD cbData  = cbMaxData;
+		DWORD dwType;
+		if (RegEnumValue(hKey, dwIndex, lpName, &cchName, NULL, &dwType, pData, &cbData) != ERROR_SUCCESS)
+			break;
+		bSuccess = K22StoreSetValue(pKey, lpName, cchName, dwType, pData, cbData, fPerApp);
+	}
+	K22_FREE(lpName);
+	if (!bSuccess)
+		return FALSE;
+
+	DWORD dwIndex, cbName;
+	CHAR szName[256 + 1];
+	K22_REG_ENUM_KEY(hKey, szName, cbName) {
+		if (pKey == pK22Data->stStore.pRoot && K22StoreIsRuleKey(szName))
+			continue;
+		PK22_CONFIG_KEY pSubkey;
+		HKEY hSubkey;
+		if (!K22StoreGetKey(pKey, szName, &pSubkey))
+			return FALSE;
+		if (!K22_REG_OPEN_KEY(hKey, szName, hSubkey))
+			continue;
+		bSuccess = K22StoreReadKey(hSubkey, pSubkey, fPerApp);
+		RegCloseKey(hSubkey);
+		if (!bSuccess)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+BOOL K22ConfigStoreInitialize() {
+	// merge the global key, then the per-app key
+	K22_ARENA_CALLOC(pK22Data->stStore.pRoot);
+	pK22Data->stStore.pRoot->lpPath = "";
+	pK22Data->stStore.pRoot->lpName = "";
+	pK22Data->stStore.dwKeys		= 1;
+	for (DWORD i = 0; i < 2; i++) {
+		if (pK22Data->stReg.hConfig[i] == NULL)
+			continue;
+		if (!K22StoreReadKey(pK22Data->stReg.hConfig[i], pK22Data->stStore.pRoot, i == 1))
+			return FALSE;
+	}
+	K22_D("Configuration stored - %lu keys, %lu values", pK22Data->stStore.dwKeys, pK22Data->stStore.dwValues);
+	return TRUE;
+}
+
+PK22_CONFIG_KEY K22ConfigGetKey(LPCSTR lpPath) {
+	// find a key of the merged configuration, by its path below Global or PerApp\<process name>
+	// NULL or an empty path returns the root key, whose values are read by K22ConfigReadValue()
+	if (lpPath == NULL || lpPath[0] == '\0')
+		return pK22Data->stStore.pRoot;
+	CHAR szPath[MAX_PATH];
+	DWORD cchPath = K22StringLower(lpPath, szPath, sizeof(szPath));
+	if (cchPath == 0)
+		return NULL;
+	PK22_CONFIG_KEY pKey;
+	HASH_FIND(hh, pK22Data->stStore.pKeyIndex, szPath, cchPath, pKey);
+	return pKey;
+}
+
+PK22_CONFIG_VALUE K22ConfigGetValue(LPCSTR lpPath, LPCSTR lpName) {
+	// find a value of the merged configuration; value names are matched case-insensitively, by their atoms
+	PK22_CONFIG_KEY pKey = K22ConfigGetKey(lpPath);
+	if (pKey == NULL)
+		return NULL;
+	PK22_ATOM pNameAtom = K22AtomFind(lpName, strlen(lpName));
+	if (pNameAtom == NULL)
+		return NULL;
+	PK22_CONFIG_VALUE pValue;
+	HASH_FIND(hh, pKey->pValueIndex, &pNameAtom, sizeof(PK22_ATOM), pValue);
+	return pValue;
+}
+
+BOOL K22ConfigGetDword(LPCSTR lpPath, LPCSTR lpName, PDWORD pdwValue) {
+	// read a REG_DWORD value; *pdwValue is left unchanged if it's not set
+	PK22_CONFIG_VALUE pValue = K22ConfigGetValue(lpPath, lpName);
+	if (pValue == NULL || pValue->dwType != REG_DWORD || pValue->cbData != sizeof(DWORD))
+		return FALSE;
+	*pdwValue = *(PDWORD)pValue->pData;
+	return TRUE;
+}
+
+LPCSTR K22ConfigGetString(LPCSTR lpPath, LPCSTR lpName) {
+	// read a REG_SZ (or REG_EXPAND_SZ) value; the string stays in the store
+	PK22_CONFIG_VALUE pValue = K22ConfigGetValue(lpPath, lpName);
+	if (pValue == NULL || pValue->dwType != REG_SZ)
+		return NULL;
+	return pValue->pData;
+}
@@ -3,10 +3,9 @@
 #include "kernel22.h"
 
 BOOL K22StringDup(LPCSTR lpInput, DWORD cchInput, LPSTR *ppOutput) {
-	if (*ppOutput)
-		free(*ppOutput);
+	// strings are allocated from the arena; a replaced value stays there until the process exits
 	cchInput++; // count the NULL terminator
-	K22_MALLOC_LENGTH(*ppOutput, cchInput);
+	K22_ARENA_LENGTH(*ppOutput, cchInput);
 	memcpy(*ppOutput, lpInput, cchInput);
 	return TRUE;
 }
@@ -16,7 +15,7 @@ BOOL K22StringDupFileName(LPCSTR lpInput, DWORD cchInput, LPSTR *ppOutput) {
 		return K22StringDup(lpInput, cchInput, ppOutput);
 	lpInput++; // skip the @ character; cchInput now accounts for the NULL terminator
 	DWORD cchInstallDir = pK22Data->stConfig.cchInstallDir;
-	K22_MALLOC_LENGTH(*ppOutput, cchInstallDir + cchInput);
+	K22_ARENA_LENGTH(*ppOutput, cchInstallDir + cchInput);
 	memcpy(*ppOutput, pK22Data->stConfig.lpInstallDir, cchInstallDir);
 	memcpy(*ppOutput + cchInstallDir, lpInput, cchInput);
 	return TRUE;
@@ -33,24 +32,72 @@ BOOL K22StringDupDllTarget(LPCSTR lpInput, DWORD cchInput, LPSTR *ppOutput, LPST
 	return K22StringDupFileName(lpInput, cchInput, ppOutput);
 }
 
+DWORD K22StringLower(LPCSTR lpInput, LPSTR lpOutput, DWORD cchOutput) {
+	// copy to lowercase (ASCII only, like _stricmp); return 0 if the output buffer is too small
+	DWORD cchInput = strlen(lpInput);
+	if (cchInput >= cchOutput) {
+		lpOutput[0] = '\0';
+		return 0;
+	}
+	K22StringLowerN(lpInput, lpOutput, cchInput);
+	lpOutput[cchInput] = '\0';
+	return cchInput;
+}
+
+DWORD K22StringHash(LPCSTR lpInput, DWORD cchInput) {
+	// FNV-1a of the lowercase string (ASCII only, like _stricmp)
+	DWORD dwHash = 2166136261;
+	for (DWORD i = 0; i < cchInput; i++) {
+		CHAR cInput = lpInput[i];
+		dwHash ^= (BYTE)((cInput >= 'A' && cInput <= 'Z') ? cInput + ('a' - 'A') : cInput);
+		dwHash *= 16777619;
+	}
+	return dwHash;
+}
+
+BOOL K22StringToUnicode(LPCSTR lpInput, PUNICODE_STRING pOutput) {
+	// convert to the caller's buffer (Buffer and MaximumLength of pOutput), NULL-terminated; nothing is allocated
+	ANSI_STRING stInput = {
+		.Length		   = strlen(lpInput),
+		.MaximumLength = 0,
+		.Buffer		   = (LPSTR)lpInput,
+	};
+	if (stInput.Length >= pOutput->MaximumLength / sizeof(WCHAR))
+		return FALSE;
+	return NT_SUCCESS(RtlAnsiStringToUnicodeString(pOutput, &stInput, FALSE));
+}
+
 BOOL K22PathMatches(LPCSTR lpPath, LPCSTR lpPattern) {
 	LPCSTR lpPathName	= strrchr(lpPath, '\\');
 	LPCSTR lpTargetName = strrchr(lpPattern, '\\');
 	if ((lpPathName && lpTargetName) || (!lpPathName && !lpTargetName))
 		// both are absolute or both aren't - they must be identical to match
-		return _stricmp(lpPath, lpPattern) == 0;
+		return K22StringEquals(lpPath, lpPattern);
 	if (lpPathName)
 		// path is absolute - pattern name is enough to match
-		return _stricmp(lpPathName + 1, lpPattern) == 0;
+		return K22StringEquals(lpPathName + 1, lpPattern);
 	// pattern is absolute, path isn't - impossible to determine match
 	return FALSE;
 }
 
+BOOL K22PathHasDirectory(LPCSTR lpPath) {
+	// whether the loader would use the path as-is, instead of searching for the name
+	if (lpPath[0] != '\0' && lpPath[1] == ':')
+		return TRUE;
+	return strpbrk(lpPath, "\\/") != NULL;
+}
+
 BOOL K22PathIsFile(LPCSTR lpPath) {
 	DWORD dwAttrib = GetFileAttributes(lpPath);
 	return dwAttrib != INVALID_FILE_ATTRIBUTES && !(dwAttrib & FILE_ATTRIBUTE_DIRECTORY);
 }
 
+BOOL K22PathIsFileW(PCUNICODE_STRING pPath) {
+	// pPath must be NULL-terminated
+	DWORD dwAttrib = GetFileAttributesW(pPath->Buffer);
+	return dwAttrib != INVALID_FILE_ATTRIBUTES && !(dwAttrib & FILE_ATTRIBUTE_DIRECTORY);
+}
+
 BOOL K22PathIsFileEx(LPSTR lpDirectory, DWORD cchDirectory, LPCSTR lpName) {
 	LPSTR lpSearchName = lpDirectory + cchDirectory;
 	*lpSearchName++	   = '\\';
@@ -58,3 +105,59 @@ BOOL K22PathIsFileEx(LPSTR lpDirectory, DWORD cchDirectory, LPCSTR lpName) {
 	strcpy(lpSearchName, lpName);
 	return K22PathIsFile(lpDirectory);
 }
+
+BOOL K22FileReplace(LPCSTR lpPath, LPCVOID pBuffer, DWORD cbBuffer) {
+	// write the file under a temporary name, then replace lpPath; the directory is created if needed
+	CHAR szDirectory[MAX_PATH];
+	CHAR szTempPath[MAX_PATH];
+	strcpy(szDirectory, lpPath);
+	*strrchr(szDirectory, '\\') = '\0';
+	if (!CreateDirectory(szDirectory, NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+		RETURN_K22_E_ERR("Couldn't create directory - %s", szDirectory);
+	if (FAILED(StringCbPrintf(szTempPath, sizeof(szTempPath), "%s.%lu.tmp", lpPath, GetCurrentProcessId())))
+		RETURN_K22_E("Path too long - %s", lpPath);
+
+	HANDLE hFile = CreateFile(szTempPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		RETURN_K22_E_ERR("Couldn't create file - %s", szTempPath);
+	DWORD cbWritten;
+	BOOL bWritten = WriteFile(hFile, pBuffer, cbBuffer, &cbWritten, NULL) && cbWritten == cbBuffer;
+	CloseHandle(hFile);
+	if (!bWritten) {
+		K22_E_ERR("Couldn't write file - %s", szTempPath);
+		DeleteFile(szTempPath);
+		return FALSE;
+	}
+	if (!MoveFileEx(szTempPath, lpPath, MOVEFILE_REPLACE_EXISTING)) {
+		K22_E_ERR("Couldn't replace file - %s", lpPath);
+		DeleteFile(szTempPath);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+LPVOID K22FileMapRead(LPCSTR lpPath, PSIZE_T pcbView) {
+	// map a whole file read-only; NULL if it can't be opened or is empty
+	HANDLE hFile = CreateFile(
+		lpPath,
+		GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_DELETE,
+		NULL,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		NULL
+	);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return NULL;
+	DWORD cbFile	= GetFileSize(hFile, NULL);
+	HANDLE hMapping = NULL;
+	if (cbFile != INVALID_FILE_SIZE && cbFile != 0)
+		hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(hFile);
+	if (hMapping == NULL)
+		return NULL;
+	LPVOID pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMapping);
+	*pcbView = cbFile;
+	return pView;
+}
@@ -0,0 +1,177 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-17.
+
+#include "kernel22.h"
+
+// Configuration watcher (ConfigWatch = 1).
+// A background thread waits for changes of the registry keys (and of the configuration file, if any), parses the rules
+// again into a new K22_DLL_RULES, then publishes it by swapping pK22Data->pDll. The resolver reads pDll without
+// locking - lookups running during the swap simply finish with the previous rules.
+// Previous rules are never freed. They live in the arena, and resolved routes, module caches and lazy stubs may still
+// point into them; every reload costs the size of the rule tables, so bursts of changes are coalesced first, and the
+// total size of the replaced rules is logged with every reload.
+// Only the rules are reloaded - values of the main keys, plugin settings and the configuration cache are not.
+
+#define K22_WATCH_DELAY 500 // ms to wait for more changes before reloading
+
+VOID K22DataPublishRules() {
+	// make pDllBuild the rules in use
+	PK22_DLL_RULES pDll = pK22Data->pDllBuild;
+	pK22Data->pDllBuild = NULL;
+	InterlockedExchangePointer((PVOID volatile *)&pK22Data->pDll, pDll);
+}
+
+static BOOL K22WatchRegistry() {
+	// (re)register for the next change of the registry keys
+	// this must be done by the watcher thread - notifications are cancelled when the registering thread exits
+	LONG lError = RegNotifyChangeKeyValue(
+		pK22Data->stReg.hMain,
+		TRUE,
+		REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET,
+		pK22Data->stWatch.hRegEvent,
+		TRUE
+	);
+	if (lError != ERROR_SUCCESS) {
+		SetLastError(lError);
+		RETURN_K22_E_ERR("Couldn't watch the registry keys");
+	}
+	return TRUE;
+}
+
+static BOOL K22WatchFileChanged(PFILETIME pftLastWrite) {
+	// check if the configuration file itself changed, not another file of its directory
+	WIN32_FILE_ATTRIBUTE_DATA stAttributes;
+	if (!GetFileAttributesEx(pK22Data->stConfigFile.lpPath, GetFileExInfoStandard, &stAttributes))
+		memset(&stAttributes, 0, sizeof(stAttributes));
+	if (CompareFileTime(&stAttributes.ftLastWriteTime, pftLastWrite) == 0)
+		return FALSE;
+	*pftLastWrite = stAttributes.ftLastWriteTime;
+	return TRUE;
+}
+
+static BOOL K22WatchReload() {
+	// parse the rules into a new K22_DLL_RULES; the API set schema of the system doesn't change
+	SIZE_T cbArena = pK22Data->stArena.cbAllocated;
+	K22_ARENA_CALLOC(pK22Data->pDllBuild);
+	pK22Data->pDllBuild->pDllApiSetSchema	   = pK22Data->pDll->pDllApiSetSchema;
+	pK22Data->pDllBuild->ulApiSetSchemaVersion = pK22Data->pDll->ulApiSetSchemaVersion;
+
+	// the per-app key may have been created since the process started
+	if (pK22Data->stReg.hConfig[1] == NULL) {
+		CHAR szPerApp[MAX_PATH];
+		if (SUCCEEDED(StringCbPrintf(szPerApp, sizeof(szPerApp), "PerApp\\%s", pK22Data->lpProcessName)) &&
+			K22_REG_OPEN_KEY(pK22Data->stReg.hMain, szPerApp, pK22Data->stReg.hConfig[1]))
+			K22_D("Per-app configuration key found");
+	}
+
+	// map the configuration file again, only for parsing - plugins keep reading the view mapped at startup
+	LPCSTR lpData = NULL;
+	SIZE_T cbData = 0;
+	if (pK22Data->stConfigFile.lpPath != NULL &&
+		(lpData = K22FileMapRead(pK22Data->stConfigFile.lpPath, &cbData)) == NULL)
+		K22_W_ERR("Couldn't map configuration file - %s", pK22Data->stConfigFile.lpPath);
+	BOOL bSuccess = K22ConfigParseRules(lpData, cbData) && K22ConfigCompileRoutes();
+	if (lpData != NULL)
+		UnmapViewOfFile(lpData);
+	if (!bSuccess) {
+		pK22Data->pDllBuild = NULL;
+		RETURN_K22_E("Couldn't reload the configuration, keeping the previous rules");
+	}
+	K22ConfigIndexRuleFilter();
+
+	// extra DLLs of the previous rules are loaded already - keep their handles
+	PK22_DLL_EXTRA pDllExtra, pDllExtraPrev;
+	K22_LL_FOREACH(pK22Data->pDllBuild->pDllExtra, pDllExtra) {
+		K22_LL_FIND(
+			pK22Data->pDll->pDllExtra,
+			pDllExtraPrev,
+			_stricmp(pDllExtra->lpTargetDll, pDllExtraPrev->lpTargetDll) == 0
+		);
+		if (pDllExtraPrev != NULL)
+			pDllExtra->hModule = pDllExtraPrev->hModule;
+	}
+
+	pK22Data->pDllBuild->cbArena = pK22Data->stArena.cbAllocated - cbArena;
+
+	PK22_DLL_RULES pDllPrev = pK22Data->pDll;
+	K22DataPublishRules();
+	pK22Data->stWatch.dwReloads++;
+	pK22Data->stWatch.cbRetained += pDllPrev->cbArena;
+	K22_I(
+		"Configuration reloaded (#%lu) - %lu bytes of previous rules retained",
+		pK22Data->stWatch.dwReloads,
+		(DWORD)pK22Data->stWatch.cbRetained
+	);
+	K22ArenaLogStats();
+	// load extra DLLs added by the change; removed ones stay loaded
+	return K22LoadExtraDlls();
+}
+
+static DWORD WINAPI K22WatchThread(LPVOID lpParameter) {
+	HANDLE hHandles[2]	 = {pK22Data->stWatch.hRegEvent, pK22Data->stWatch.hFileChange};
+	DWORD dwHandles		 = hHandles[1] != NULL ? 2 : 1;
+	FILETIME ftLastWrite = pK22Data->stConfigFile.ftLastWrite;
+
+	if (!K22WatchRegistry())
+		goto Error;
+	while (TRUE) {
+		DWORD dwWait = WaitForMultipleObjects(dwHandles, hHandles, FALSE, INFINITE);
+		if (dwWait >= WAIT_OBJECT_0 + dwHandles)
+			goto Error;
+		// wait for more changes - .reg imports and editors write many values in a row
+		Sleep(K22_WATCH_DELAY);
+
+		// register for the next changes before reading, so that none of them is missed
+		BOOL bChanged = FALSE;
+		if (dwWait == WAIT_OBJECT_0 || WaitForSingleObject(hHandles[0], 0) == WAIT_OBJECT_0) {
+			if (!K22WatchRegistry())
+				goto Error;
+			bChanged = TRUE;
+		}
+		if (dwHandles == 2 && WaitForSingleObject(hHandles[1], 0) == WAIT_OBJECT_0) {
+			if (!FindNextChangeNotification(hHandles[1]))
+				goto Error;
+			bChanged |= K22WatchFileChanged(&ftLastWrite);
+		}
+		if (bChanged)
+			K22WatchReload();
+	}
+
+Error:
+	K22_E_ERR("Configuration watcher stopped");
+	return 1;
+}
+
+BOOL K22WatchInitialize() {
+	if (!pK22Data->stConfig.bConfigWatch)
+		return TRUE;
+
+	pK22Data->stWatch.hRegEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (pK22Data->stWatch.hRegEvent == NULL)
+		RETURN_K22_F_ERR("Couldn't create configuration watcher event");
+
+	// watch the directory of the configuration file - files can't be watched directly
+	if (pK22Data->stConfigFile.lpPath != NULL) {
+		CHAR szDirectory[MAX_PATH];
+		StringCbCopy(szDirectory, sizeof(szDirectory), pK22Data->stConfigFile.lpPath);
+		LPSTR lpSeparator = strrchr(szDirectory, '\\');
+		if (lpSeparator != NULL) {
+			*lpSeparator				  = '\0';
+			pK22Data->stWatch.hFileChange = FindFirstChangeNotification(
+				szDirectory,
+				FALSE,
+				FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE
+			);
+			if (pK22Data->stWatch.hFileChange == INVALID_HANDLE_VALUE) {
+				K22_W_ERR("Couldn't watch configuration file directory - %s", szDirectory);
+				pK22Data->stWatch.hFileChange = NULL;
+			}
+		}
+	}
+
+	HANDLE hThread = CreateThread(NULL, 0, K22WatchThread, NULL, 0, NULL);
+	if (hThread == NULL)
+		RETURN_K22_F_ERR("Couldn't start configuration watcher thread");
+	CloseHandle(hThread);
+	K22_I("Configuration watcher started");
+	return TRUE;
+}
@@ -0,0 +1,546 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-12.
+
+#include "kernel22.h"
+
+// Persistent cache of resolved imports, one file per process image path.
+// The file is mapped read-only and used in place - K22BindCacheApply() writes the cached addresses directly into
+// the IAT of a module, if neither the configuration nor any of the participating modules have changed.
+// Imports of all modules are recorded during startup, and written to the cache file once static init is done.
+
+#define K22_BIND_CACHE_HASH_INIT 2166136261
+
+#define K22_BIND_CACHE_PTR(dwOffset) ((LPVOID)((ULONG_PTR)pK22Data->stBindCache.pHeader + (dwOffset)))
+
+static DWORD K22BindCacheHash(DWORD dwHash, LPCSTR lpString) {
+	// FNV-1a, including the NULL terminator, so that consecutive strings can't be shifted around
+	if (lpString == NULL)
+		lpString = "";
+	do {
+		dwHash = (dwHash ^ (BYTE)*lpString) * 16777619;
+	} while (*lpString++);
+	return dwHash;
+}
+
+static DWORD K22BindCacheConfigHash() {
+	// hash all parsed rules that can affect the resolved addresses
+	DWORD dwHash = K22_BIND_CACHE_HASH_INIT;
+
+	PK22_DLL_EXTRA pDllExtra;
+	K22_LL_FOREACH(pK22Data->pDll->pDllExtra, pDllExtra) {
+		dwHash = K22BindCacheHash(dwHash, pDllExtra->lpTargetDll);
+	}
+	PK22_DLL_API_SET pDllApiSet;
+	K22_LL_FOREACH(pK22Data->pDll->pDllApiSet, pDllApiSet) {
+		dwHash = K22BindCacheHash(dwHash, pDllApiSet->lpSourceDll);
+		dwHash = K22BindCacheHash(dwHash, pDllApiSet->lpSourceSymbol);
+		dwHash = K22BindCacheHash(dwHash, pDllApiSet->lpTargetDll);
+	}
+	PK22_DLL_REDIRECT pDllRedirect;
+	K22_LL_FOREACH(pK22Data->pDll->pDllRedirect, pDllRedirect) {
+		dwHash = K22BindCacheHash(dwHash, pDllRedirect->lpSourceDll);
+		dwHash = K22BindCacheHash(dwHash, pDllRedirect->lpTargetDll);
+	}
+	PK22_DLL_REWRITE pDllRewrite;
+	K22_LL_FOREACH(pK22Data->pDll->pDllRewrite, pDllRewrite) {
+		dwHash = K22BindCacheHash(dwHash, pDllRewrite->lpSourceDll);
+		dwHash = K22BindCacheHash(dwHash, pDllRewrite->lpDefaultDll);
+		dwHash = K22BindCacheHash(dwHash, pDllRewrite->lpCatchAllDll);
+		PK22_DLL_REWRITE_SYMBOL pDllRewriteSymbol;
+		K22_LL_FOREACH(pDllRewrite->pSymbols, pDllRewriteSymbol) {
+			dwHash = K22BindCacheHash(dwHash, pDllRewriteSymbol->lpSourceSymbol);
+			dwHash = K22BindCacheHash(dwHash, pDllRewriteSymbol->lpTargetDll);
+			dwHash = K22BindCacheHash(dwHash, pDllRewriteSymbol->lpTargetSymbol);
+		}
+	}
+	return dwHash;
+}
+
+static VOID K22BindCacheGetKeys(PK22_MODULE_DATA pK22ModuleData, PK22_BIND_CACHE_MODULE pModule) {
+	// PE header fields identifying a particular build of a module
+#if K22_BITS64
+	PIMAGE_OPTIONAL_HEADER64 pOptionalHeader = &pK22ModuleData->pNt->stNt64.OptionalHeader;
+#elif K22_BITS32
+	PIMAGE_OPTIONAL_HEADER32 pOptionalHeader = &pK22ModuleData->pNt->stNt32.OptionalHeader;
+#endif
+	pModule->dwTimeDateStamp = pK22ModuleData->pNt->stFile.TimeDateStamp;
+	pModule->dwCheckSum		 = pOptionalHeader->CheckSum;
+	pModule->dwSizeOfImage	 = pOptionalHeader->SizeOfImage;
+}
+
+static BOOL K22BindCacheModuleMatches(PK22_BIND_CACHE_MODULE pModule, PK22_MODULE_DATA pK22ModuleData) {
+	K22_BIND_CACHE_MODULE stKeys;
+	K22BindCacheGetKeys(pK22ModuleData, &stKeys);
+	return pModule->dwTimeDateStamp == stKeys.dwTimeDateStamp && pModule->dwCheckSum == stKeys.dwCheckSum &&
+		   pModule->dwSizeOfImage == stKeys.dwSizeOfImage;
+}
+
+static LPCSTR K22BindCacheString(DWORD dwOffset) {
+	// return a string of the cache file, or NULL if it's not terminated within the file
+	LPCSTR lpString = K22_BIND_CACHE_PTR(dwOffset);
+	if (dwOffset >= pK22Data->stBindCache.cbView ||
+		memchr(lpString, '\0', pK22Data->stBindCache.cbView - dwOffset) == NULL)
+		return NULL;
+	return lpString;
+}
+
+static BOOL K22BindCacheTableFits(DWORD dwOffset, DWORD dwCount, SIZE_T cbEntry) {
+	return (ULONGLONG)dwOffset + (ULONGLONG)dwCount * cbEntry <= pK22Data->stBindCache.cbView;
+}
+
+static BOOL K22BindCacheValidate(PK22_MODULE_DATA pProcessData) {
+	PK22_BIND_CACHE_HEADER pHeader = pK22Data->stBindCache.pHeader;
+	if (pHeader->dwMagic != K22_BIND_CACHE_MAGIC || pHeader->dwVersion != K22_BIND_CACHE_VERSION) {
+		K22_D("Binding cache has an unknown format");
+		return FALSE;
+	}
+	if (!K22BindCacheTableFits(pHeader->dwModules, pHeader->dwModuleCount, sizeof(K22_BIND_CACHE_MODULE)) ||
+		!K22BindCacheTableFits(pHeader->dwImporters, pHeader->dwImporterCount, sizeof(K22_BIND_CACHE_IMPORTER)) ||
+		!K22BindCacheTableFits(pHeader->dwThunks, pHeader->dwThunkCount, sizeof(K22_BIND_CACHE_THUNK))) {
+		K22_D("Binding cache is truncated");
+		return FALSE;
+	}
+	LPCSTR lpProcessPath = K22BindCacheString(pHeader->dwProcessPath);
+	if (lpProcessPath == NULL || strcmp(lpProcessPath, pProcessData->lpModulePath) != 0) {
+		K22_D("Binding cache belongs to another process image");
+		return FALSE;
+	}
+	if (pHeader->dwConfigHash != K22BindCacheConfigHash()) {
+		K22_D("Binding cache was created with another configuration");
+		return FALSE;
+	}
+	PK22_BIND_CACHE_IMPORTER pImporters = K22_BIND_CACHE_PTR(pHeader->dwImporters);
+	for (DWORD i = 0; i < pHeader->dwImporterCount; i++) {
+		if (pImporters[i].dwModule >= pHeader->dwModuleCount ||
+			(ULONGLONG)pImporters[i].dwFirstThunk + pImporters[i].dwThunkCount > pHeader->dwThunkCount) {
+			K22_D("Binding cache is corrupted");
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static VOID K22BindCacheUnmap() {
+	if (pK22Data->stBindCache.pHeader == NULL)
+		return;
+	UnmapViewOfFile(pK22Data->stBindCache.pHeader);
+	pK22Data->stBindCache.pHeader = NULL;
+	pK22Data->stBindCache.cbView  = 0;
+}
+
+BOOL K22BindCacheOpen() {
+	if (!pK22Data->stConfig.bBindCache)
+		return TRUE;
+	PK22_MODULE_DATA pProcessData = K22DataGetModule(pK22Data->lpProcessBase);
+	if (pProcessData == NULL || pProcessData->lpModulePath == NULL)
+		return TRUE;
+
+	// InstallDir\DLL_xx\BindCache\<process name>-<path hash>.k22bind
+	CHAR szPath[MAX_PATH];
+	if (FAILED(StringCbPrintf(
+			szPath,
+			sizeof(szPath),
+			"%sBindCache\\%s-%08lx.k22bind",
+			pK22Data->stConfig.lpInstallDir,
+			pK22Data->lpProcessName,
+			K22BindCacheHash(K22_BIND_CACHE_HASH_INIT, pProcessData->lpModulePath)
+		))) {
+		K22_W("Binding cache path too long");
+		return TRUE;
+	}
+	if (!K22StringDup(szPath, strlen(szPath), &pK22Data->stBindCache.lpPath))
+		return FALSE;
+	// record all imports from now on, whether the cache is valid or not
+	pK22Data->stBindCache.fRecording = TRUE;
+
+	pK22Data->stBindCache.pHeader = K22FileMapRead(szPath, &pK22Data->stBindCache.cbView);
+	if (pK22Data->stBindCache.pHeader == NULL) {
+		if (GetLastError() == ERROR_FILE_NOT_FOUND || GetLastError() == ERROR_PATH_NOT_FOUND)
+			K22_D("Binding cache not found - %s", szPath);
+		else
+			K22_W_ERR("Couldn't map binding cache - %s", szPath);
+		return TRUE;
+	}
+	if (pK22Data->stBindCache.cbView < sizeof(K22_BIND_CACHE_HEADER)) {
+		K22BindCacheUnmap();
+		return TRUE;
+	}
+
+	if (!K22BindCacheValidate(pProcessData)) {
+		K22BindCacheUnmap();
+		return TRUE;
+	}
+	K22_I(
+		"Binding cache loaded - %lu modules, %lu symbols",
+		pK22Data->stBindCache.pHeader->dwImporterCount,
+		pK22Data->stBindCache.pHeader->dwThunkCount
+	);
+	return TRUE;
+}
+
+static VOID K22BindCacheFreeRecords() {
+	PK22_BIND_IMPORTER pImporter, pTmp;
+	K22_LL_FOREACH_SAFE(pK22Data->stBindCache.pImporters, pImporter) {
+		K22_LL_DELETE(pK22Data->stBindCache.pImporters, pImporter);
+		K22_FREE(pImporter->pThunks);
+		K22_FREE(pImporter);
+	}
+}
+
+VOID K22BindCacheClose() {
+	K22BindCacheUnmap();
+	K22BindCacheFreeRecords();
+	pK22Data->stBindCache.fRecording = FALSE;
+}
+
+static PK22_BIND_IMPORTER K22BindCacheRecordCreate(PK22_MODULE_DATA pK22ModuleData) {
+	if (!pK22Data->stBindCache.fRecording)
+		return NULL;
+	PK22_BIND_IMPORTER pImporter;
+	K22_LL_FIND(pK22Data->stBindCache.pImporters, pImporter, pImporter->pK22ModuleData == pK22ModuleData);
+	if (pImporter == NULL) {
+		pImporter = calloc(1, sizeof(*pImporter));
+		if (pImporter == NULL)
+			return NULL;
+		pImporter->pK22ModuleData = pK22ModuleData;
+		K22_LL_APPEND(pK22Data->stBindCache.pImporters, pImporter);
+	}
+	// keep the most recent imports only
+	pImporter->fInvalid = FALSE;
+	pImporter->dwCount	= 0;
+	return pImporter;
+}
+
+PK22_BIND_IMPORTER K22BindCacheRecordStart(PK22_MODULE_DATA pK22ModuleData) {
+	// start recording imports resolved without the cache - the cache file will have to be updated
+	if (pK22Data->stBindCache.fRecording)
+		pK22Data->stBindCache.fDirty = TRUE;
+	return K22BindCacheRecordCreate(pK22ModuleData);
+}
+
+VOID K22BindCacheRecord(PK22_BIND_IMPORTER pImporter, DWORD dwThunkRva, PVOID pProc) {
+	if (pImporter == NULL || pImporter->fInvalid)
+		return;
+	if (pImporter->dwCount == pImporter->dwCapacity) {
+		DWORD dwCapacity = pImporter->dwCapacity ? pImporter->dwCapacity * 2 : 64;
+		PVOID pThunks	 = realloc(pImporter->pThunks, dwCapacity * sizeof(*pImporter->pThunks));
+		if (pThunks == NULL) {
+			pImporter->fInvalid = TRUE;
+			return;
+		}
+		pImporter->pThunks	  = pThunks;
+		pImporter->dwCapacity = dwCapacity;
+	}
+	pImporter->pThunks[pImporter->dwCount].dwThunkRva = dwThunkRva;
+	pImporter->pThunks[pImporter->dwCount].pProc	  = pProc;
+	pImporter->dwCount++;
+}
+
+VOID K22BindCacheRecordRemove(LPVOID lpImageBase) {
+	// module was unloaded - its imports can't be written to the cache anymore
+	PK22_BIND_IMPORTER pImporter;
+	K22_LL_FIND(pK22Data->stBindCache.pImporters, pImporter, pImporter->pK22ModuleData->lpModuleBase == lpImageBase);
+	if (pImporter == NULL)
+		return;
+	K22_LL_DELETE(pK22Data->stBindCache.pImporters, pImporter);
+	K22_FREE(pImporter->pThunks);
+	K22_FREE(pImporter);
+}
+
+static PK22_MODULE_DATA K22BindCacheLoadModule(PK22_BIND_CACHE_MODULE pModule) {
+	// find or load a target module by its full path, and make sure it's the same build
+	LPCSTR lpModulePath = K22BindCacheString(pModule->dwPath);
+	if (lpModulePath == NULL)
+		return NULL;
+	PK22_MODULE_DATA pK22ModuleData = K22ModuleIndexFind(lpModulePath);
+	if (pK22ModuleData == NULL) {
+		WCHAR szModulePath[MAX_PATH];
+		UNICODE_STRING stModulePath = {
+			.Length		   = 0,
+			.MaximumLength = sizeof(szModulePath),
+			.Buffer		   = szModulePath,
+		};
+		if (!K22StringToUnicode(lpModulePath, &stModulePath))
+			return NULL;
+		HINSTANCE hModule = NULL;
+		NTSTATUS ntStatus = K22RealLdrLoadDll(NULL, 0, &stModulePath, (PVOID *)&hModule);
+		if (!NT_SUCCESS(ntStatus) || hModule == NULL)
+			return NULL;
+		pK22ModuleData = K22DataGetModule(hModule);
+		if (pK22ModuleData == NULL || pK22ModuleData->fDllNotificationFailed)
+			return NULL;
+	}
+	if (!K22BindCacheModuleMatches(pModule, pK22ModuleData)) {
+		K22_D("Binding cache is outdated - %s changed", lpModulePath);
+		return NULL;
+	}
+	return pK22ModuleData;
+}
+
+static BOOL K22BindCacheIsInSpan(PDWORD pdwSpanRva, PDWORD pdwSpanFirst, DWORD dwSpan, DWORD dwThunkRva) {
+	// whether dwThunkRva lies in the FirstThunk array of descriptor dwSpan (see K22BindCacheApply())
+	if (dwThunkRva < pdwSpanRva[dwSpan])
+		return FALSE;
+	return (dwThunkRva - pdwSpanRva[dwSpan]) / sizeof(ULONG_PTR) < pdwSpanFirst[dwSpan + 1] - pdwSpanFirst[dwSpan];
+}
+
+BOOL K22BindCacheApply(PK22_MODULE_DATA pK22ModuleData, PIMAGE_IMPORT_DESCRIPTOR pImportDesc) {
+	// write all imports of pK22ModuleData from the cache file
+	// if this returns FALSE, imports have to be resolved normally (this will also overwrite partially bound thunks)
+	PK22_BIND_CACHE_HEADER pHeader = pK22Data->stBindCache.pHeader;
+	if (pHeader == NULL || pK22ModuleData->lpModulePath == NULL)
+		return FALSE;
+	LPVOID lpImageBase = pK22ModuleData->lpModuleBase;
+
+	// find the importing module by its path
+	PK22_BIND_CACHE_MODULE pModules		= K22_BIND_CACHE_PTR(pHeader->dwModules);
+	PK22_BIND_CACHE_IMPORTER pImporters = K22_BIND_CACHE_PTR(pHeader->dwImporters);
+	PK22_BIND_CACHE_IMPORTER pImporter	= NULL;
+	DWORD dwPathHash					= K22BindCacheHash(K22_BIND_CACHE_HASH_INIT, pK22ModuleData->lpModulePath);
+	for (DWORD i = 0; i < pHeader->dwImporterCount && pImporter == NULL; i++) {
+		PK22_BIND_CACHE_MODULE pModule = &pModules[pImporters[i].dwModule];
+		if (pModule->dwPathHash != dwPathHash)
+			continue;
+		LPCSTR lpModulePath = K22BindCacheString(pModule->dwPath);
+		if (lpModulePath != NULL && strcmp(lpModulePath, pK22ModuleData->lpModulePath) == 0)
+			pImporter = &pImporters[i];
+	}
+	if (pImporter == NULL) {
+		K22_D("Module %s not found in binding cache", pK22ModuleData->lpModuleName);
+		return FALSE;
+	}
+	PK22_BIND_CACHE_MODULE pImporterModule = &pModules[pImporter->dwModule];
+	if (!K22BindCacheModuleMatches(pImporterModule, pK22ModuleData)) {
+		K22_D("Binding cache is outdated - %s changed", pK22ModuleData->lpModuleName);
+		return FALSE;
+	}
+
+	// the cached thunks must cover the import descriptors exactly
+	// (without OriginalFirstThunk, the resolver couldn't recover from a partially bound IAT)
+	DWORD dwDescCount = 0;
+	for (PIMAGE_IMPORT_DESCRIPTOR pDesc = pImportDesc; pDesc->FirstThunk; pDesc++) {
+		if (pDesc->OriginalFirstThunk == 0)
+			return FALSE;
+		dwDescCount++;
+	}
+	// FirstThunk array of every descriptor - its RVA, and the index of its first thunk among all thunks
+	PDWORD pdwSpanRva = malloc((dwDescCount * 2 + 1) * sizeof(DWORD));
+	if (pdwSpanRva == NULL)
+		return FALSE;
+	PDWORD pdwSpanFirst = pdwSpanRva + dwDescCount;
+	DWORD dwThunkCount	= 0;
+	for (DWORD i = 0; i < dwDescCount; i++) {
+		pdwSpanRva[i]		  = pImportDesc[i].FirstThunk;
+		pdwSpanFirst[i]		  = dwThunkCount;
+		PULONG_PTR pThunk	  = RVA(pImportDesc[i].FirstThunk);
+		PULONG_PTR pOrigThunk = RVA(pImportDesc[i].OriginalFirstThunk);
+		for (/**/; *pThunk != 0 && *pOrigThunk != 0; pThunk++, pOrigThunk++) {
+			dwThunkCount++;
+		}
+	}
+	pdwSpanFirst[dwDescCount] = dwThunkCount;
+	if (dwThunkCount != pImporter->dwThunkCount) {
+		K22_D("Binding cache is outdated - imports of %s changed", pK22ModuleData->lpModuleName);
+		K22_FREE(pdwSpanRva);
+		return FALSE;
+	}
+	// every thunk must be written exactly once - anything else would leave some of them unbound
+	PDWORD pdwBound = calloc((dwThunkCount + 31) / 32 + 1, sizeof(DWORD));
+	if (pdwBound == NULL) {
+		K22_FREE(pdwSpanRva);
+		return FALSE;
+	}
+
+	// bind all thunks; target modules are loaded just like the resolver would
+	PK22_BIND_CACHE_THUNK pThunks  = K22_BIND_CACHE_PTR(pHeader->dwThunks);
+	PK22_BIND_CACHE_MODULE pTarget = NULL;
+	PK22_MODULE_DATA pTargetData   = NULL;
+	BOOL bValid					   = TRUE;
+	DWORD dwSpan				   = 0;
+	pThunks += pImporter->dwFirstThunk;
+	for (DWORD i = 0; i < dwThunkCount; i++) {
+		DWORD dwThunkRva = pThunks[i].dwThunkRva;
+		// thunks are mostly recorded in descriptor order - check the previous descriptor first
+		if (!K22BindCacheIsInSpan(pdwSpanRva, pdwSpanFirst, dwSpan, dwThunkRva)) {
+			for (dwSpan = 0; dwSpan < dwDescCount; dwSpan++) {
+				if (K22BindCacheIsInSpan(pdwSpanRva, pdwSpanFirst, dwSpan, dwThunkRva))
+					break;
+			}
+			if (dwSpan == dwDescCount) {
+				bValid = FALSE;
+				break;
+			}
+		}
+		DWORD dwIndex = pdwSpanFirst[dwSpan] + (dwThunkRva - pdwSpanRva[dwSpan]) / sizeof(ULONG_PTR);
+		if ((dwThunkRva - pdwSpanRva[dwSpan]) % sizeof(ULONG_PTR) != 0 ||
+			(pdwBound[dwIndex / 32] & (1UL << (dwIndex % 32))) != 0 || pThunks[i].dwModule >= pHeader->dwModuleCount) {
+			bValid = FALSE;
+			break;
+		}
+		pdwBound[dwIndex / 32] |= 1UL << (dwIndex % 32);
+		if (pTarget != &pModules[pThunks[i].dwModule]) {
+			pTarget		= &pModules[pThunks[i].dwModule];
+			pTargetData = K22BindCacheLoadModule(pTarget);
+			if (pTargetData == NULL) {
+				bValid = FALSE;
+				break;
+			}
+		}
+		if (pThunks[i].dwTargetRva >= pTarget->dwSizeOfImage) {
+			bValid = FALSE;
+			break;
+		}
+		*(PULONG_PTR)RVA(dwThunkRva) = (ULONG_PTR)pTargetData->lpModuleBase + pThunks[i].dwTargetRva;
+	}
+	K22_FREE(pdwBound);
+	K22_FREE(pdwSpanRva);
+	if (!bValid) {
+		K22_D("Binding cache doesn't match the import table of %s", pK22ModuleData->lpModuleName);
+		return FALSE;
+	}
+
+	// disable the import descriptors, just like K22ProcessImportDescriptors() does
+	for (/**/; pImportDesc->FirstThunk; pImportDesc++) {
+		pImportDesc->FirstThunk			= 0;
+		pImportDesc->OriginalFirstThunk = 0;
+	}
+
+	// keep the bound imports for the next cache file
+	PK22_BIND_IMPORTER pRecord = K22BindCacheRecordCreate(pK22ModuleData);
+	for (DWORD i = 0; i < dwThunkCount; i++) {
+		K22BindCacheRecord(pRecord, pThunks[i].dwThunkRva, *(PVOID *)RVA(pThunks[i].dwThunkRva));
+	}
+
+	K22_D("Bound %lu symbols of %s from binding cache", dwThunkCount, pK22ModuleData->lpModuleName);
+	return TRUE;
+}
+
+static DWORD K22BindCacheModuleIndex(PK22_MODULE_DATA *ppModules, PDWORD pdwModuleCount, PK22_MODULE_DATA pModule) {
+	// find or add pModule in the module table
+	// recently added modules are checked first - thunks of a descriptor usually share the target module
+	for (DWORD i = *pdwModuleCount; i > 0; i--) {
+		if (ppModules[i - 1] == pModule)
+			return i - 1;
+	}
+	ppModules[*pdwModuleCount] = pModule;
+	return (*pdwModuleCount)++;
+}
+
+BOOL K22BindCacheWrite() {
+	// store all recorded imports, if any of them were resolved without the cache
+	// called once static init is done; imports aren't recorded afterwards
+	if (!pK22Data->stBindCache.fRecording)
+		return TRUE;
+	pK22Data->stBindCache.fRecording = FALSE;
+	// the mapping must be closed before the file can be replaced
+	K22BindCacheUnmap();
+	if (!pK22Data->stBindCache.fDirty) {
+		K22_D("Binding cache is up to date");
+		K22BindCacheFreeRecords();
+		return TRUE;
+	}
+
+	// count all records, to allocate the module table
+	PK22_BIND_IMPORTER pImporter;
+	DWORD dwModuleCount = 0;
+	DWORD dwMaxModules	= 0;
+	K22_LL_FOREACH(pK22Data->stBindCache.pImporters, pImporter) {
+		dwMaxModules += 1 + pImporter->dwCount;
+	}
+	PK22_MODULE_DATA *ppModules;
+	K22_MALLOC_LENGTH(ppModules, (dwMaxModules + 1) * sizeof(*ppModules));
+
+	// find the target module of every recorded address
+	DWORD dwImporterCount = 0;
+	DWORD dwThunkCount	  = 0;
+	K22_LL_FOREACH(pK22Data->stBindCache.pImporters, pImporter) {
+		if (pImporter->fInvalid || pImporter->pK22ModuleData->lpModulePath == NULL) {
+			pImporter->fInvalid = TRUE;
+			continue;
+		}
+		for (DWORD i = 0; i < pImporter->dwCount && !pImporter->fInvalid; i++) {
+			LPVOID lpTargetBase = NULL;
+			RtlPcToFileHeader(pImporter->pThunks[i].pProc, &lpTargetBase);
+			PK22_MODULE_DATA pTargetData = lpTargetBase ? K22DataGetModule(lpTargetBase) : NULL;
+			if (pTargetData == NULL || pTargetData->lpModulePath == NULL) {
+				K22_D(
+					"Binding cache - %s imports an address outside of any module",
+					pImporter->pK22ModuleData->lpModuleName
+				);
+				pImporter->fInvalid = TRUE;
+				break;
+			}
+			pImporter->pThunks[i].dwModule = K22BindCacheModuleIndex(ppModules, &dwModuleCount, pTargetData);
+		}
+		if (pImporter->fInvalid)
+			continue;
+		pImporter->dwModule = K22BindCacheModuleIndex(ppModules, &dwModuleCount, pImporter->pK22ModuleData);
+		dwImporterCount++;
+		dwThunkCount += pImporter->dwCount;
+	}
+
+	// lay out the file - header, tables, then strings
+	PK22_MODULE_DATA pProcessData = K22DataGetModule(pK22Data->lpProcessBase);
+	DWORD cbStrings				  = strlen(pProcessData->lpModulePath) + 1;
+	for (DWORD i = 0; i < dwModuleCount; i++) {
+		cbStrings += strlen(ppModules[i]->lpModulePath) + 1;
+	}
+	K22_BIND_CACHE_HEADER stHeader = {
+		.dwMagic		 = K22_BIND_CACHE_MAGIC,
+		.dwVersion		 = K22_BIND_CACHE_VERSION,
+		.dwConfigHash	 = K22BindCacheConfigHash(),
+		.dwModuleCount	 = dwModuleCount,
+		.dwImporterCount = dwImporterCount,
+		.dwThunkCount	 = dwThunkCount,
+	};
+	stHeader.dwModules	   = sizeof(stHeader);
+	stHeader.dwImporters   = stHeader.dwModules + dwModuleCount * sizeof(K22_BIND_CACHE_MODULE);
+	stHeader.dwThunks	   = stHeader.dwImporters + dwImporterCount * sizeof(K22_BIND_CACHE_IMPORTER);
+	stHeader.dwProcessPath = stHeader.dwThunks + dwThunkCount * sizeof(K22_BIND_CACHE_THUNK);
+	DWORD cbBuffer		   = stHeader.dwProcessPath + cbStrings;
+
+	LPBYTE pBuffer = malloc(cbBuffer);
+	if (pBuffer == NULL) {
+		K22_FREE(ppModules);
+		RETURN_K22_F_ERR("Couldn't allocate memory for pBuffer");
+	}
+	memcpy(pBuffer, &stHeader, sizeof(stHeader));
+	PK22_BIND_CACHE_MODULE pModules		= (PVOID)(pBuffer + stHeader.dwModules);
+	PK22_BIND_CACHE_IMPORTER pImporters = (PVOID)(pBuffer + stHeader.dwImporters);
+	PK22_BIND_CACHE_THUNK pThunks		= (PVOID)(pBuffer + stHeader.dwThunks);
+	DWORD dwString						= stHeader.dwProcessPath;
+	strcpy((LPSTR)pBuffer + dwString, pProcessData->lpModulePath);
+	dwString += strlen(pProcessData->lpModulePath) + 1;
+
+	for (DWORD i = 0; i < dwModuleCount; i++) {
+		pModules[i].dwPath	   = dwString;
+		pModules[i].dwPathHash = K22BindCacheHash(K22_BIND_CACHE_HASH_INIT, ppModules[i]->lpModulePath);
+		K22BindCacheGetKeys(ppModules[i], &pModules[i]);
+		strcpy((LPSTR)pBuffer + dwString, ppModules[i]->lpModulePath);
+		dwString += strlen(ppModules[i]->lpModulePath) + 1;
+	}
+
+	DWORD dwImporter = 0;
+	DWORD dwThunk	 = 0;
+	K22_LL_FOREACH(pK22Data->stBindCache.pImporters, pImporter) {
+		if (pImporter->fInvalid)
+			continue;
+		pImporters[dwImporter].dwModule		= pImporter->dwModule;
+		pImporters[dwImporter].dwFirstThunk = dwThunk;
+		pImporters[dwImporter].dwThunkCount = pImporter->dwCount;
+		dwImporter++;
+		for (DWORD i = 0; i < pImporter->dwCount; i++) {
+			LPVOID lpTargetBase			 = ppModules[pImporter->pThunks[i].dwModule]->lpModuleBase;
+			pThunks[dwThunk].dwThunkRva	 = pImporter->pThunks[i].dwThunkRva;
+			pThunks[dwThunk].dwModule	 = pImporter->pThunks[i].dwModule;
+			pThunks[dwThunk].dwTargetRva = (ULONG_PTR)pImporter->pThunks[i].pProc - (ULONG_PTR)lpTargetBase;
+			dwThunk++;
+		}
+	}
+
+	if (K22FileReplace(pK22Data->stBindCache.lpPath, pBuffer, cbBuffer))
+		K22_I("Binding cache written - %lu modules, %lu symbols", dwImporterCount, dwThunkCount);
+	K22_FREE(pBuffer);
+	K22_FREE(ppModules);
+	K22BindCacheFreeRecords();
+	return TRUE;
+}
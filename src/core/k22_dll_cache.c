@@ -0,0 +1,56 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-12.
+
+#include "kernel22.h"
+
+// Resolver caches - modules and procedures cached in DLL rule entries, shared by all threads.
+// Readers take no locks; writers publish with a single CAS, so concurrent resolvers never see a torn entry.
+// Every cached value points to the K22_MODULE_DATA of its module. Module data is allocated for every load
+// and never freed, so it's always safe to read - the unload notification bumps its generation,
+// which makes all values cached from that module stale. Stale values are dropped and resolved again.
+
+PK22_MODULE_DATA K22CacheGetModule(PK22_MODULE_CACHE ppModule) {
+	PK22_MODULE_DATA pK22ModuleData = *ppModule;
+	if (pK22ModuleData == NULL || pK22ModuleData->lGeneration == 0)
+		return pK22ModuleData;
+	// unloaded since - drop it, unless someone cached a newer one already
+	InterlockedCompareExchangePointer((PVOID volatile *)ppModule, NULL, pK22ModuleData);
+	return NULL;
+}
+
+VOID K22CacheSetModule(PK22_MODULE_CACHE ppModule, PK22_MODULE_DATA pK22ModuleData) {
+	// the first writer wins; others resolved the same module anyway
+	InterlockedCompareExchangePointer((PVOID volatile *)ppModule, pK22ModuleData, NULL);
+}
+
+PVOID K22CacheGetProc(PK22_PROC_CACHE volatile *ppProc) {
+	PK22_PROC_CACHE pProcCache = *ppProc;
+	if (pProcCache == NULL)
+		return NULL;
+	if (pProcCache->pK22ModuleData->lGeneration == 0)
+		return pProcCache->pProc;
+	// unloaded since - drop it; the entry is never freed, as other readers might still use it
+	InterlockedCompareExchangePointer((PVOID volatile *)ppProc, NULL, pProcCache);
+	return NULL;
+}
+
+VOID K22CacheSetProc(PK22_PROC_CACHE volatile *ppProc, PVOID pProc, PK22_MODULE_DATA pK22ModuleData) {
+	// entries are immutable once published
+	PK22_PROC_CACHE pProcCache = K22ArenaAlloc(sizeof(*pProcCache));
+	if (pProcCache == NULL)
+		return;
+	pProcCache->pProc		   = pProc;
+	pProcCache->pK22ModuleData = pK22ModuleData;
+	// if someone published an entry first, this one is never visible (and stays in the arena)
+	InterlockedCompareExchangePointer((PVOID volatile *)ppProc, pProcCache, NULL);
+}
+
+VOID K22CacheInvalidate(LPVOID lpImageBase) {
+	// called by the unload notification, while the module is still mapped
+	PIMAGE_K22_HEADER pK22Header = K22_DOS_HDR_DATA(lpImageBase);
+	if (pK22Header->dwCoreMagic != K22_CORE_MAGIC)
+		// never seen by Kernel22 - nothing could have been cached
+		return;
+	PK22_MODULE_DATA pK22ModuleData = pK22Header->lpModuleData;
+	InterlockedIncrement(&pK22ModuleData->lGeneration);
+	K22_V("Invalidated cached symbols of %s", pK22ModuleData->lpModuleName);
+}
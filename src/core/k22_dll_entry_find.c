@@ -2,92 +2,112 @@
 
 #include "kernel22.h"
 
-PK22_DLL_API_SET K22FindDllApiSet(LPCSTR lpModuleName, LPCSTR lpSymbolName) {
+DWORD K22DllApiSetKeyLength(LPCSTR lpModuleName) {
+	// get length of the API set name without level and version - api-ms-aaa-bbb[-lX-Y-Z.dll]
+	DWORD cchKey = 0;
+	for (LPCSTR lpChar = lpModuleName; *lpChar; lpChar++) {
+		if (lpChar[0] == '-' && (lpChar[1] == 'l' || lpChar[1] == 'L') && lpChar[2] >= '0' && lpChar[2] <= '9')
+			cchKey = lpChar - lpModuleName;
+	}
+	return cchKey;
+}
+
+static DWORD K22DllApiSetKey(LPCSTR lpModuleName, LPSTR lpKey, DWORD cchKeyMax) {
 	// only try to resolve "*-ms-*" DLLs
 	DWORD cchModuleName = strlen(lpModuleName);
 	if (cchModuleName <= sizeof("api-ms-") || _strnicmp(lpModuleName + 3, "-ms-", 4) != 0)
+		return 0;
+	DWORD cchKey = K22DllApiSetKeyLength(lpModuleName);
+	if (cchKey == 0 || K22StringLower(lpModuleName, lpKey, cchKeyMax) == 0)
+		return 0;
+	return cchKey;
+}
+
+PK22_DLL_API_SET K22FindDllApiSetGroup(PK22_DLL_RULES pDll, LPCSTR lpModuleName) {
+	InterlockedIncrement(&pK22Data->stStats.lRuleLookups);
+	// find the first entry of this API set
+	CHAR szKey[MAX_PATH];
+	DWORD cchKey = K22DllApiSetKey(lpModuleName, szKey, sizeof(szKey));
+	if (cchKey == 0)
 		return NULL;
+	PK22_DLL_API_SET pDllApiSet;
+	HASH_FIND(hh, pDll->pDllApiSetIndex, szKey, cchKey, pDllApiSet);
+	return pDllApiSet;
+}
+
+PK22_DLL_API_SET K22FindDllApiSet(PK22_DLL_RULES pDll, LPCSTR lpModuleName, PK22_SYMBOL_REF pSymbol) {
+	InterlockedIncrement(&pK22Data->stStats.lRuleLookups);
+	// find the first entry of this API set
+	CHAR szKey[MAX_PATH];
+	DWORD cchKey = K22DllApiSetKey(lpModuleName, szKey, sizeof(szKey));
+	if (cchKey == 0)
+		return NULL;
+	PK22_DLL_API_SET pDllApiSet;
+	HASH_FIND(hh, pDll->pDllApiSetIndex, szKey, cchKey, pDllApiSet);
+	DWORD cchModuleName = strlen(szKey);
+	if (pDllApiSet == NULL)
+		// no registry entries - use the system's API set schema
+		goto Schema;
+
+	// symbol-specific entries are interned - a symbol without an atom can't match any of them
+	PK22_ATOM pSymbolAtom = NULL;
+	if (pSymbol && pDllApiSet && pDllApiSet->fGroupSymbols)
+		pSymbolAtom = K22SymbolRefAtom(pSymbol);
 
-	PK22_DLL_API_SET pDllApiSet			 = NULL;
 	PK22_DLL_API_SET pDllApiSetSameName	 = NULL;
 	PK22_DLL_API_SET pDllApiSetSameLevel = NULL;
-	K22_LL_FOREACH(pK22Data->stDll.pDllApiSet, pDllApiSet) {
+	for (/**/; pDllApiSet != NULL; pDllApiSet = pDllApiSet->pGroupNext) {
 		// compare module name (api-ms-aaa-bbb-lX-Y-Z.dll) without X, Y, Z
-		if (_strnicmp(lpModuleName, pDllApiSet->lpSourceDll, cchModuleName - 9) == 0) {
-			// module name matches
-			if (pDllApiSet->lpSourceSymbol && lpSymbolName) {
-				// quickly return any entry matching the source symbol
-				if (_stricmp(pDllApiSet->lpSourceSymbol, lpSymbolName) == 0)
-					return pDllApiSet;
-				// otherwise skip this entry, because it's symbol-specific
-				continue;
-			}
-			pDllApiSetSameName = pDllApiSet;
-			// try comparing with X to find level matches
-			if (_strnicmp(lpModuleName, pDllApiSet->lpSourceDll, cchModuleName - 8) == 0) {
-				pDllApiSetSameLevel = pDllApiSet;
-			}
+		if (pDllApiSet->cchSourceDll < cchModuleName - 9 ||
+			!K22StringEqualsN(szKey, pDllApiSet->lpSourceDll, cchModuleName - 9))
 			continue;
+		// module name matches
+		if (pDllApiSet->pSourceSymbol && pSymbol) {
+			// quickly return any entry matching the source symbol
+			if (pDllApiSet->pSourceSymbol == pSymbolAtom)
+				return pDllApiSet;
+			// otherwise skip this entry, because it's symbol-specific
+			continue;
+		}
+		pDllApiSetSameName = pDllApiSet;
+		// try comparing with X to find level matches
+		if (pDllApiSet->cchSourceDll >= cchModuleName - 8 &&
+			K22StringEqualsN(szKey, pDllApiSet->lpSourceDll, cchModuleName - 8)) {
+			pDllApiSetSameLevel = pDllApiSet;
 		}
-		// pDllApiSet doesn't match the API set name
-		// - check if match without source symbol already found
-		// - return it already, since no more matches will be found
-		//   (assuming that registry entries are sorted alphabetically)
-		// - prioritize matched level than just the name
-		if (pDllApiSetSameLevel != NULL)
-			return pDllApiSetSameLevel;
-		if (pDllApiSetSameName != NULL)
-			return pDllApiSetSameName;
 	}
+	// prioritize matched level than just the name
 	if (pDllApiSetSameLevel)
 		return pDllApiSetSameLevel;
 	if (pDllApiSetSameName)
 		return pDllApiSetSameName;
-	K22_E("ApiSet not resolved! %s!%s", lpModuleName, lpSymbolName);
-	return NULL;
-}
 
-PK22_DLL_REDIRECT K22FindDllRedirect(LPCSTR lpModuleName) {
-	// recursively resolve configured DLL redirects
-	// does NOT handle redirection loops!
-	PK22_DLL_REDIRECT pDllRedirect = NULL;
-	while (1) {
-		PK22_DLL_REDIRECT pFoundItem;
-		K22_LL_FIND(
-			pK22Data->stDll.pDllRedirect,
-			pFoundItem,
-			// comparison
-			K22PathMatches(lpModuleName, pFoundItem->lpSourceDll)
-		);
-		if (pFoundItem != NULL && pFoundItem != pDllRedirect) {
-			pDllRedirect = pFoundItem;
-			lpModuleName = pFoundItem->lpTargetDll;
-			continue;
-		}
-		return pDllRedirect;
-	}
+Schema:
+	pDllApiSet = K22ApiSetFind(pDll, lpModuleName);
+	if (pDllApiSet != NULL)
+		return pDllApiSet;
+	CHAR szSymbol[8];
+	K22_E("ApiSet not resolved! %s!%s", lpModuleName, pSymbol ? K22SymbolRefString(pSymbol, szSymbol) : "(null)");
+	return NULL;
 }
 
-PK22_DLL_REWRITE K22FindDllRewrite(LPCSTR lpModuleName) {
-	PK22_DLL_REWRITE pDllRewrite = NULL;
-	K22_LL_FIND(
-		pK22Data->stDll.pDllRewrite,
-		pDllRewrite,
-		// comparison
-		K22PathMatches(lpModuleName, pDllRewrite->lpSourceDll)
-	);
-	return pDllRewrite;
+PK22_DLL_ROUTE_ENTRY K22FindDllRoute(PK22_DLL_RULES pDll, LPCSTR lpModuleName) {
+	InterlockedIncrement(&pK22Data->stStats.lRuleLookups);
+	// find the compiled DllRedirect and DllRewrite rules of lpModuleName (see K22ConfigCompileRoutes())
+	PK22_DLL_ROUTE_ENTRY pRouteEntry;
+	K22_FIND_BY_PATH(pDll->pDllRouteIndex, lpModuleName, pRouteEntry);
+	return pRouteEntry;
 }
 
-PK22_DLL_REWRITE_SYMBOL K22FindDllRewriteSymbol(PK22_DLL_REWRITE pDllRewrite, LPCSTR lpSymbolName) {
-	if (pDllRewrite->pSymbols == NULL)
+PK22_DLL_REWRITE_SYMBOL K22FindDllRewriteSymbol(PK22_DLL_REWRITE pDllRewrite, PK22_SYMBOL_REF pSymbol) {
+	InterlockedIncrement(&pK22Data->stStats.lRuleLookups);
+	if (pDllRewrite->pSymbolIndex == NULL)
+		return NULL;
+	// the index is keyed by atoms - see K22ConfigParseDllRewrite()
+	PK22_ATOM pSymbolAtom = K22SymbolRefAtom(pSymbol);
+	if (pSymbolAtom == NULL)
 		return NULL;
-	PK22_DLL_REWRITE_SYMBOL pDllRewriteSymbol = NULL;
-	K22_LL_FIND(
-		pDllRewrite->pSymbols,
-		pDllRewriteSymbol,
-		// comparison
-		_stricmp(lpSymbolName, pDllRewriteSymbol->lpSourceSymbol) == 0
-	);
+	PK22_DLL_REWRITE_SYMBOL pDllRewriteSymbol;
+	HASH_FIND(hh, pDllRewrite->pSymbolIndex, &pSymbolAtom, sizeof(PK22_ATOM), pDllRewriteSymbol);
 	return pDllRewriteSymbol;
 }
@@ -0,0 +1,22 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-10.
+
+#include "kernel22.h"
+
+// Export lookups of loaded modules, used instead of LdrGetProcedureAddress() for most symbols.
+// The export table itself is parsed by the portable parser in k22_pe_export.c; this only adds the module base.
+
+BOOL K22ExportParse(PK22_MODULE_DATA pK22ModuleData) {
+	return K22PeExportParse(pK22ModuleData->lpModuleBase, &pK22ModuleData->stExports);
+}
+
+PVOID K22ExportFindByName(PK22_MODULE_DATA pK22ModuleData, LPCSTR lpSymbolName, WORD wHint) {
+	LPVOID lpImageBase = pK22ModuleData->lpModuleBase;
+	DWORD dwRva		   = K22PeExportFindByName(lpImageBase, &pK22ModuleData->stExports, lpSymbolName, wHint);
+	return dwRva != 0 ? RVA(dwRva) : NULL;
+}
+
+PVOID K22ExportFindByOrdinal(PK22_MODULE_DATA pK22ModuleData, DWORD dwOrdinal) {
+	LPVOID lpImageBase = pK22ModuleData->lpModuleBase;
+	DWORD dwRva		   = K22PeExportFindByOrdinal(lpImageBase, &pK22ModuleData->stExports, dwOrdinal);
+	return dwRva != 0 ? RVA(dwRva) : NULL;
+}
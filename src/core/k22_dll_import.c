@@ -4,7 +4,7 @@
 
 BOOL K22LoadExtraDlls() {
 	PK22_DLL_EXTRA pDllExtra = NULL;
-	K22_LL_FOREACH(pK22Data->stDll.pDllExtra, pDllExtra) {
+	K22_LL_FOREACH(pK22Data->pDll->pDllExtra, pDllExtra) {
 		if (pDllExtra->hModule != NULL)
 			continue;
 		K22_I("DLL Extra: loading %s (%s)", pDllExtra->lpKey, pDllExtra->lpTargetDll);
@@ -15,31 +15,278 @@ BOOL K22LoadExtraDlls() {
 	return TRUE;
 }
 
-BOOL K22ProcessImports(LPVOID lpImageBase) {
-	PK22_MODULE_DATA pK22ModuleData = K22DataGetModule(lpImageBase);
+static BOOL K22UnlockImports(
+	LPVOID lpImageBase,
+	PIMAGE_DATA_DIRECTORY pDataDirectory,
+	PIMAGE_IMPORT_DESCRIPTOR pImportDesc,
+	PK22_UNLOCK_BATCH pBatch
+) {
+	// find the span of all FirstThunk arrays - the IAT directory isn't guaranteed to cover them
+	PIMAGE_IMPORT_DESCRIPTOR pImportDescFirst = pImportDesc;
+	ULONG_PTR ulThunkStart					  = (ULONG_PTR)-1;
+	ULONG_PTR ulThunkEnd					  = 0;
+	for (/**/; pImportDesc->FirstThunk; pImportDesc++) {
+		PULONG_PTR pThunk = RVA(pImportDesc->FirstThunk);
+		if ((ULONG_PTR)pThunk < ulThunkStart)
+			ulThunkStart = (ULONG_PTR)pThunk;
+		while (*pThunk != 0)
+			pThunk++;
+		if ((ULONG_PTR)pThunk > ulThunkEnd)
+			ulThunkEnd = (ULONG_PTR)pThunk;
+	}
 
-	// get import directory pointer
+	if (!K22UnlockBatchAdd(pBatch, pImportDescFirst, (pImportDesc - pImportDescFirst) * sizeof(*pImportDesc)))
+		return FALSE;
+	// unlock the IAT directory as well - pages unlocked already are skipped by the batch
+	PIMAGE_DATA_DIRECTORY pIatDirectory = &pDataDirectory[IMAGE_DIRECTORY_ENTRY_IAT];
+	if (pIatDirectory->VirtualAddress != 0 && pIatDirectory->Size != 0 &&
+		!K22UnlockBatchAdd(pBatch, RVA(pIatDirectory->VirtualAddress), pIatDirectory->Size))
+		return FALSE;
+	if (ulThunkEnd > ulThunkStart && !K22UnlockBatchAdd(pBatch, (LPVOID)ulThunkStart, ulThunkEnd - ulThunkStart))
+		return FALSE;
+	return TRUE;
+}
+
+static BOOL K22IsImportRouted(LPCSTR lpModuleName) {
+	// check if any DllApiSet, DllRedirect or DllRewrite rule applies to lpModuleName
+	K22_DLL_ROUTE stRoute;
+	K22ResolveRoute(lpModuleName, NULL, &stRoute);
+	return stRoute.fPerSymbol || stRoute.pDllRewrite != NULL || stRoute.lpModuleName != lpModuleName;
+}
+
+static BOOL K22IsBoundModuleValid(LPCSTR lpModuleName, DWORD dwTimeDateStamp) {
+	// bound addresses are only right if the target is the same file, loaded at its preferred base
+	PK22_MODULE_DATA pTarget = K22ModuleIndexFind(lpModuleName);
+	if (pTarget == NULL)
+		return FALSE;
 #if K22_BITS64
-	PDWORD pImportDirectoryRva =
-		&pK22ModuleData->pNt->stNt64.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress;
+	ULONG_PTR ulImageBase = pTarget->pNt->stNt64.OptionalHeader.ImageBase;
 #elif K22_BITS32
-	PDWORD pImportDirectoryRva =
-		&pK22ModuleData->pNt->stNt32.OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress;
+	ULONG_PTR ulImageBase = pTarget->pNt->stNt32.OptionalHeader.ImageBase;
 #endif
-	DWORD dwImportDirectoryRva = *pImportDirectoryRva;
-	if (dwImportDirectoryRva == 0) {
-		K22_I("Processing imports of %p (%s) - no imports found", lpImageBase, pK22ModuleData->lpModuleName);
-		return TRUE;
+	return pTarget->pNt->stNt32.FileHeader.TimeDateStamp == dwTimeDateStamp &&
+		   (ULONG_PTR)pTarget->lpModuleBase == ulImageBase;
+}
+
+static PIMAGE_BOUND_IMPORT_DESCRIPTOR K22NextBoundImport(PIMAGE_BOUND_IMPORT_DESCRIPTOR pBound) {
+	// forwarder references follow each bound import descriptor
+	return (PIMAGE_BOUND_IMPORT_DESCRIPTOR)((PIMAGE_BOUND_FORWARDER_REF)(pBound + 1) +
+											pBound->NumberOfModuleForwarderRefs);
+}
+
+static BOOL K22IsBoundImportKept(PIMAGE_BOUND_IMPORT_DESCRIPTOR pBoundFirst, PIMAGE_BOUND_IMPORT_DESCRIPTOR pBound) {
+	LPCSTR lpModuleName = (LPCSTR)pBoundFirst + pBound->OffsetModuleName;
+	if (K22IsImportRouted(lpModuleName) || !K22IsBoundModuleValid(lpModuleName, pBound->TimeDateStamp))
+		return FALSE;
+	// modules that the bound exports are forwarded to must be valid, too
+	PIMAGE_BOUND_FORWARDER_REF pRef = (PIMAGE_BOUND_FORWARDER_REF)(pBound + 1);
+	for (WORD i = 0; i < pBound->NumberOfModuleForwarderRefs; i++) {
+		if (!K22IsBoundModuleValid((LPCSTR)pBoundFirst + pRef[i].OffsetModuleName, pRef[i].TimeDateStamp))
+			return FALSE;
 	}
+	return TRUE;
+}
 
-	K22_I("Processing imports of %p (%s)", lpImageBase, pK22ModuleData->lpModuleName);
+static DWORD K22KeepBoundImports(
+	PK22_MODULE_DATA pK22ModuleData,
+	PIMAGE_DATA_DIRECTORY pDataDirectory,
+	PIMAGE_IMPORT_DESCRIPTOR pImportDesc
+) {
+	// Keep the prebound imports of modules that no rule applies to, and which are still valid.
+	// Their import descriptors are moved to the front of the import directory (in original order)
+	// and left for ntdll.dll, which won't have to snap them. The rest is resolved by K22 as usual.
+	// Returns the number of kept import descriptors.
+	LPVOID lpImageBase					  = pK22ModuleData->lpModuleBase;
+	PIMAGE_DATA_DIRECTORY pBoundDirectory = &pDataDirectory[IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT];
+	if (pBoundDirectory->VirtualAddress == 0 || pBoundDirectory->Size == 0)
+		return 0;
+
+	// compact the bound import directory, keeping the module name strings (which follow it) in place
+	PIMAGE_BOUND_IMPORT_DESCRIPTOR pBoundFirst = RVA(pBoundDirectory->VirtualAddress);
+	PIMAGE_BOUND_IMPORT_DESCRIPTOR pBoundOut   = pBoundFirst;
+	PIMAGE_BOUND_IMPORT_DESCRIPTOR pBoundNext  = NULL;
+	if (!pK22ModuleData->fIsProcess) {
+		for (PIMAGE_BOUND_IMPORT_DESCRIPTOR pBound = pBoundFirst; pBound->OffsetModuleName; pBound = pBoundNext) {
+			pBoundNext = K22NextBoundImport(pBound);
+			if (!K22IsBoundImportKept(pBoundFirst, pBound))
+				continue;
+			memmove(pBoundOut, pBound, (LPBYTE)pBoundNext - (LPBYTE)pBound);
+			pBoundOut = K22NextBoundImport(pBoundOut);
+		}
+	}
+	if (pBoundOut == pBoundFirst) {
+		// nothing to keep - make ntdll.dll ignore the bound imports entirely
+		K22ClearBoundImportTable(lpImageBase);
+		return 0;
+	}
+	memset(pBoundOut, 0, sizeof(*pBoundOut));
+
+	// move import descriptors of kept modules to the front
+	DWORD dwKept = 0;
+	for (DWORD i = 0; pImportDesc[i].FirstThunk; i++) {
+		// only descriptors with a prebound IAT can be kept
+		if (pImportDesc[i].TimeDateStamp == 0)
+			continue;
+		LPCSTR lpImportModuleName = RVA(pImportDesc[i].Name);
+		PIMAGE_BOUND_IMPORT_DESCRIPTOR pBound;
+		for (pBound = pBoundFirst; pBound->OffsetModuleName; pBound = K22NextBoundImport(pBound)) {
+			if (_stricmp((LPCSTR)pBoundFirst + pBound->OffsetModuleName, lpImportModuleName) == 0)
+				break;
+		}
+		if (pBound->OffsetModuleName == 0)
+			continue;
+		IMAGE_IMPORT_DESCRIPTOR stImportDesc = pImportDesc[i];
+		memmove(&pImportDesc[dwKept + 1], &pImportDesc[dwKept], (i - dwKept) * sizeof(stImportDesc));
+		pImportDesc[dwKept++] = stImportDesc;
+		K22_V("Keeping bound imports of %s in %s", lpImportModuleName, pK22ModuleData->lpModuleName);
+	}
+	return dwKept;
+}
+
+static DWORD K22CountImportThunks(LPVOID lpImageBase, PIMAGE_IMPORT_DESCRIPTOR pImportDesc, PDWORD pdwDescriptors) {
+	DWORD dwCount	= 0;
+	*pdwDescriptors = 0;
+	for (/**/; pImportDesc->FirstThunk; pImportDesc++) {
+		for (PULONG_PTR pThunk = RVA(pImportDesc->FirstThunk); *pThunk != 0; pThunk++) {
+			dwCount++;
+		}
+		(*pdwDescriptors)++;
+	}
+	return dwCount;
+}
+
+static BOOL K22ProcessImportDescriptorsParallel(
+	PK22_MODULE_DATA pK22ModuleData,
+	PIMAGE_IMPORT_DESCRIPTOR pImportDesc,
+	PK22_BIND_IMPORTER pBindImporter,
+	DWORD dwDescriptors,
+	DWORD dwCount
+) {
+	// phase 1 - load all imported modules serially, stage every thunk
+	// phase 2 - look up staged symbols in export tables, in parallel (see k22_dll_parallel.c)
+	// then write the results to the IAT, resolving whatever phase 2 couldn't serially
+	LPVOID lpImageBase				= pK22ModuleData->lpModuleBase;
+	PK22_DLL_ROUTE pRoutes			= calloc(dwDescriptors, sizeof(*pRoutes));
+	PK22_PARALLEL_ITEM pItems		= calloc(dwCount, sizeof(*pItems));
+	PIMAGE_IMPORT_DESCRIPTOR pFirst = pImportDesc;
+	BOOL bRet						= FALSE;
+	if (pRoutes == NULL || pItems == NULL) {
+		K22_F_ERR("Couldn't allocate memory for %lu staged symbols", dwCount);
+		goto Cleanup;
+	}
+
+	LARGE_INTEGER stStartTime;
+	QueryPerformanceCounter(&stStartTime);
+
+	DWORD dwItem = 0;
+	for (PK22_DLL_ROUTE pRoute = pRoutes; pImportDesc->FirstThunk; pImportDesc++, pRoute++) {
+		LPCSTR lpImportModuleName = RVA(pImportDesc->Name);
+		K22_D("Module %s imports %s", pK22ModuleData->lpModuleName, lpImportModuleName);
+
+		K22ResolveRoute(lpImportModuleName, NULL, pRoute);
+		// the export table is parsed here, so that workers only read it
+		PK22_MODULE_DATA pTarget = K22ResolveRouteModule(pK22ModuleData->lpModuleName, pRoute);
+		if (pTarget != NULL && !K22ExportParse(pTarget))
+			pTarget = NULL;
+
+		PULONG_PTR pThunk	  = RVA(pImportDesc->FirstThunk);
+		PULONG_PTR pOrigThunk = RVA(pImportDesc->OriginalFirstThunk);
+		if (pImportDesc->OriginalFirstThunk == 0)
+			pOrigThunk = pThunk;
+		for (/**/; *pThunk != 0 && *pOrigThunk != 0 && dwItem < dwCount; pThunk++, pOrigThunk++) {
+			PK22_PARALLEL_ITEM pItem = &pItems[dwItem++];
+			pItem->pThunk			 = pThunk;
+			pItem->pRoute			 = pRoute;
+			pItem->pK22ModuleData	 = pTarget;
+			if (IMAGE_SNAP_BY_ORDINAL(*pOrigThunk)) {
+				K22SymbolRefOrdinal(&pItem->stSymbol, IMAGE_ORDINAL(*pOrigThunk));
+			} else {
+				PIMAGE_IMPORT_BY_NAME pImportByName = RVA(*pOrigThunk);
+				K22SymbolRefName(&pItem->stSymbol, pImportByName->Name, pImportByName->Hint);
+			}
+		}
+	}
+
+	K22ParallelRun(pItems, dwItem);
+
+	DWORD dwSerial = 0;
+	for (PK22_PARALLEL_ITEM pItem = pItems; pItem < &pItems[dwItem]; pItem++) {
+		PVOID pProcAddress = pItem->pProc;
+		if (pProcAddress == NULL) {
+			// forwarders, rewritten modules, per-symbol rules and load failures
+			pProcAddress = K22ResolveRouteSymbol(pK22ModuleData->lpModuleName, pItem->pRoute, &pItem->stSymbol);
+			if (pProcAddress == NULL)
+				goto Cleanup;
+			dwSerial++;
+		}
+		*pItem->pThunk = (ULONG_PTR)pProcAddress;
+		K22BindCacheRecord(pBindImporter, (ULONG_PTR)pItem->pThunk - (ULONG_PTR)lpImageBase, pProcAddress);
+	}
+
+	// disable the import descriptors, so that ntdll.dll doesn't use them anymore
+	for (pImportDesc = pFirst; pImportDesc->FirstThunk; pImportDesc++) {
+		pImportDesc->FirstThunk			= 0;
+		pImportDesc->OriginalFirstThunk = 0;
+	}
+
+	LARGE_INTEGER stEndTime, stFrequency;
+	QueryPerformanceCounter(&stEndTime);
+	QueryPerformanceFrequency(&stFrequency);
+	K22_D(
+		"Resolved %lu symbols of %s in parallel (%lu serially) in %lu us, %lu worker threads",
+		dwItem,
+		pK22ModuleData->lpModuleName,
+		dwSerial,
+		(DWORD)((stEndTime.QuadPart - stStartTime.QuadPart) * 1000000 / stFrequency.QuadPart),
+		pK22Data->stParallel.dwThreads
+	);
+	bRet = TRUE;
+
+Cleanup:
+	K22_FREE(pRoutes);
+	K22_FREE(pItems);
+	return bRet;
+}
+
+static BOOL K22ProcessImportDescriptors(LPVOID lpImageBase, PIMAGE_IMPORT_DESCRIPTOR pImportDesc) {
+	PK22_MODULE_DATA pK22ModuleData	 = K22DataGetModule(lpImageBase);
+	PK22_BIND_IMPORTER pBindImporter = K22BindCacheRecordStart(pK22ModuleData);
+	DWORD dwSymbols					 = 0;
+	DWORD dwRoutes					 = 0; // counted here - stStats.lRuleLookups is shared by all threads
+	BOOL bRet						 = FALSE;
+
+	// point imports at lazy binding stubs, if enabled for this module
+	K22_LAZY_BLOCK stLazyBlock;
+	BOOL fLazy = K22LazyBlockCreate(pK22ModuleData, pImportDesc, &stLazyBlock);
+
+	// fan the lookups of large import tables out to worker threads, if enabled
+	if (!fLazy && pK22Data->stParallel.dwThreads != 0) {
+		DWORD dwDescriptors;
+		DWORD dwCount = K22CountImportThunks(lpImageBase, pImportDesc, &dwDescriptors);
+		if (K22ParallelIsEnabled(dwCount))
+			return K22ProcessImportDescriptorsParallel(
+				pK22ModuleData,
+				pImportDesc,
+				pBindImporter,
+				dwDescriptors,
+				dwCount
+			);
+	}
+
+	// measured like the parallel resolver, to compare both
+	LARGE_INTEGER stStartTime;
+	QueryPerformanceCounter(&stStartTime);
 
 	// process each import descriptor
-	PIMAGE_IMPORT_DESCRIPTOR pImportDesc = RVA(dwImportDirectoryRva);
 	for (/**/; pImportDesc->FirstThunk; pImportDesc++) {
 		LPCSTR lpImportModuleName = RVA(pImportDesc->Name);
 		K22_D("Module %s imports %s", pK22ModuleData->lpModuleName, lpImportModuleName);
 
+		// apply module-level rules once for the entire descriptor
+		K22_DLL_ROUTE stRoute;
+		K22ResolveRoute(lpImportModuleName, NULL, &stRoute);
+		dwRoutes++;
+
 		PULONG_PTR pThunk	  = RVA(pImportDesc->FirstThunk);
 		PULONG_PTR pOrigThunk = RVA(pImportDesc->OriginalFirstThunk);
 		if (pImportDesc->OriginalFirstThunk == 0)
@@ -49,36 +296,214 @@ BOOL K22ProcessImports(LPVOID lpImageBase) {
 
 		for (/**/; *pThunk != 0 && *pOrigThunk != 0; pThunk++, pOrigThunk++) {
 			PVOID pProcAddress;
-			LPCSTR lpSymbolName;
-
-			CHAR szSymbolName[1 + 5 + 1] = "#";
+			K22_SYMBOL_REF stSymbol;
 			if (IMAGE_SNAP_BY_ORDINAL(*pOrigThunk)) {
-				_itoa(IMAGE_ORDINAL(*pOrigThunk), szSymbolName + 1, 10);
-				lpSymbolName = szSymbolName;
+				K22SymbolRefOrdinal(&stSymbol, IMAGE_ORDINAL(*pOrigThunk));
 			} else {
-				lpSymbolName = ((PIMAGE_IMPORT_BY_NAME)RVA(*pOrigThunk))->Name;
+				PIMAGE_IMPORT_BY_NAME pImportByName = RVA(*pOrigThunk);
+				K22SymbolRefName(&stSymbol, pImportByName->Name, pImportByName->Hint);
 			}
 
-			pProcAddress = K22ResolveSymbol(pK22ModuleData->lpModuleName, lpImportModuleName, lpSymbolName);
+			if (fLazy) {
+				pProcAddress = K22LazyStubCreate(&stLazyBlock, pK22ModuleData, &stRoute, pThunk, &stSymbol);
+				if (pProcAddress != NULL) {
+					*pThunk = (ULONG_PTR)pProcAddress;
+					continue;
+				}
+			}
+
+			pProcAddress = K22ResolveRouteSymbol(pK22ModuleData->lpModuleName, &stRoute, &stSymbol);
 			if (pProcAddress == NULL)
-				return FALSE;
+				goto Cleanup;
+			dwSymbols++;
+			// symbol-specific routes are resolved again for every symbol
+			if (stRoute.fPerSymbol)
+				dwRoutes++;
 
-			K22WithUnlocked(*pThunk) {
-				*pThunk = (ULONG_PTR)pProcAddress;
-			}
+			*pThunk = (ULONG_PTR)pProcAddress;
+			K22BindCacheRecord(pBindImporter, (ULONG_PTR)pThunk - (ULONG_PTR)lpImageBase, pProcAddress);
 		}
 
 		// disable the import descriptor, so that ntdll.dll doesn't use it anymore
 		// otherwise it would re-snap all thunks after the DLL notification callback
-		K22WithUnlocked(*pImportDesc) {
-			pImportDesc->FirstThunk			= 0;
-			pImportDesc->OriginalFirstThunk = 0;
-		}
+		pImportDesc->FirstThunk			= 0;
+		pImportDesc->OriginalFirstThunk = 0;
 	}
 
+	LARGE_INTEGER stEndTime, stFrequency;
+	QueryPerformanceCounter(&stEndTime);
+	QueryPerformanceFrequency(&stFrequency);
+	K22_D(
+		"Resolved %lu symbols of %s with %lu route lookups in %lu us",
+		dwSymbols,
+		pK22ModuleData->lpModuleName,
+		dwRoutes,
+		(DWORD)((stEndTime.QuadPart - stStartTime.QuadPart) * 1000000 / stFrequency.QuadPart)
+	);
+	bRet = TRUE;
+
+Cleanup:
+	// thunks already pointing at stubs stay valid - the block is made executable (or freed if unused) either way
+	if (fLazy && !K22LazyBlockFinish(&stLazyBlock))
+		bRet = FALSE;
+	return bRet;
+}
+
+static BOOL K22IsDelayImportRouted(LPVOID lpImageBase, PIMAGE_DELAYLOAD_DESCRIPTOR pDelayDesc) {
+	// only DLLs that rules apply to are bound by Kernel22 - others are left to the linker's delay helper,
+	// as are descriptors of ancient linkers (VC6), which hold VAs instead of RVAs
+	return pDelayDesc->Attributes.RvaBased && K22IsImportRouted(RVA(pDelayDesc->DllNameRVA));
+}
+
+static BOOL K22UnlockDelayImports(
+	LPVOID lpImageBase,
+	PIMAGE_DELAYLOAD_DESCRIPTOR pDelayDesc,
+	PK22_UNLOCK_BATCH pBatch,
+	PDWORD pdwCount
+) {
+	*pdwCount = 0;
+	for (/**/; pDelayDesc->DllNameRVA; pDelayDesc++) {
+		if (!K22IsDelayImportRouted(lpImageBase, pDelayDesc))
+			continue;
+		PULONG_PTR pThunk = RVA(pDelayDesc->ImportAddressTableRVA);
+		DWORD dwCount	  = 0;
+		while (pThunk[dwCount] != 0)
+			dwCount++;
+		if (dwCount != 0 && !K22UnlockBatchAdd(pBatch, pThunk, dwCount * sizeof(*pThunk)))
+			return FALSE;
+		*pdwCount += dwCount;
+	}
 	return TRUE;
 }
 
+static BOOL K22ProcessDelayImports(LPVOID lpImageBase, PIMAGE_DELAYLOAD_DESCRIPTOR pDelayDesc, DWORD dwCount) {
+	PK22_MODULE_DATA pK22ModuleData = K22DataGetModule(lpImageBase);
+
+	// point routed delay-loaded imports at lazy binding stubs, instead of the linker-generated helper
+	// this makes them go through the resolver (and DLL rules) on the first call, like any other import
+	K22_LAZY_BLOCK stLazyBlock;
+	if (!K22LazyBlockAlloc(&stLazyBlock, dwCount)) {
+		K22_W("Delay-loaded imports of %s won't be resolved by Kernel22", pK22ModuleData->lpModuleName);
+		return TRUE;
+	}
+
+	for (/**/; pDelayDesc->DllNameRVA; pDelayDesc++) {
+		if (!K22IsDelayImportRouted(lpImageBase, pDelayDesc))
+			continue;
+		LPCSTR lpImportModuleName = RVA(pDelayDesc->DllNameRVA);
+		K22_D("Module %s delay-imports %s", pK22ModuleData->lpModuleName, lpImportModuleName);
+
+		PULONG_PTR pThunk	  = RVA(pDelayDesc->ImportAddressTableRVA);
+		PULONG_PTR pOrigThunk = RVA(pDelayDesc->ImportNameTableRVA);
+		for (/**/; *pThunk != 0 && *pOrigThunk != 0; pThunk++, pOrigThunk++) {
+			K22_SYMBOL_REF stSymbol;
+			if (IMAGE_SNAP_BY_ORDINAL(*pOrigThunk)) {
+				K22SymbolRefOrdinal(&stSymbol, IMAGE_ORDINAL(*pOrigThunk));
+			} else {
+				PIMAGE_IMPORT_BY_NAME pImportByName = RVA(*pOrigThunk);
+				K22SymbolRefName(&stSymbol, pImportByName->Name, pImportByName->Hint);
+			}
+
+			PVOID pProcAddress =
+				K22LazyStubAdd(&stLazyBlock, pK22ModuleData, lpImportModuleName, pThunk, &stSymbol, pDelayDesc);
+			if (pProcAddress == NULL)
+				break;
+			*pThunk = (ULONG_PTR)pProcAddress;
+		}
+	}
+
+	return K22LazyBlockFinish(&stLazyBlock);
+}
+
+BOOL K22HasRoutedImports(LPVOID lpImageBase) {
+	// check if any rule might apply to imports of the module, or if it has to be processed anyway
+	// this only scans the import names against the rule filter - no rule lookups are made
+	PK22_MODULE_DATA pK22ModuleData = K22DataGetModule(lpImageBase);
+	if (pK22ModuleData->fIsProcess || (pK22Data->stConfig.bLazyBinding && !pK22Data->fDelayDllInit))
+		return TRUE;
+
+#if K22_BITS64
+	PIMAGE_DATA_DIRECTORY pDataDirectory = pK22ModuleData->pNt->stNt64.OptionalHeader.DataDirectory;
+#elif K22_BITS32
+	PIMAGE_DATA_DIRECTORY pDataDirectory = pK22ModuleData->pNt->stNt32.OptionalHeader.DataDirectory;
+#endif
+	DWORD dwImportDirectoryRva = pDataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress;
+	DWORD dwDelayDirectoryRva  = pDataDirectory[IMAGE_DIRECTORY_ENTRY_DELAY_IMPORT].VirtualAddress;
+
+	if (dwImportDirectoryRva != 0) {
+		for (PIMAGE_IMPORT_DESCRIPTOR pImportDesc = RVA(dwImportDirectoryRva); pImportDesc->FirstThunk; pImportDesc++) {
+			if (K22ConfigRuleFilterMatches(RVA(pImportDesc->Name)))
+				return TRUE;
+		}
+	}
+	if (dwDelayDirectoryRva != 0) {
+		for (PIMAGE_DELAYLOAD_DESCRIPTOR pDelayDesc = RVA(dwDelayDirectoryRva); pDelayDesc->DllNameRVA; pDelayDesc++) {
+			if (pDelayDesc->Attributes.RvaBased && K22ConfigRuleFilterMatches(RVA(pDelayDesc->DllNameRVA)))
+				return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+BOOL K22ProcessImports(LPVOID lpImageBase) {
+	PK22_MODULE_DATA pK22ModuleData = K22DataGetModule(lpImageBase);
+
+	// get import directory pointer
+#if K22_BITS64
+	PIMAGE_DATA_DIRECTORY pDataDirectory = pK22ModuleData->pNt->stNt64.OptionalHeader.DataDirectory;
+#elif K22_BITS32
+	PIMAGE_DATA_DIRECTORY pDataDirectory = pK22ModuleData->pNt->stNt32.OptionalHeader.DataDirectory;
+#endif
+	DWORD dwImportDirectoryRva = pDataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress;
+	DWORD dwDelayDirectoryRva  = pDataDirectory[IMAGE_DIRECTORY_ENTRY_DELAY_IMPORT].VirtualAddress;
+	if (dwImportDirectoryRva == 0 && dwDelayDirectoryRva == 0) {
+		K22_I("Processing imports of %p (%s) - no imports found", lpImageBase, pK22ModuleData->lpModuleName);
+		return TRUE;
+	}
+
+	K22_I("Processing imports of %p (%s)", lpImageBase, pK22ModuleData->lpModuleName);
+
+	// unlock the whole IAT and import directory once, instead of every single thunk
+	LARGE_INTEGER stStartTime;
+	QueryPerformanceCounter(&stStartTime);
+	K22_UNLOCK_BATCH stBatch = {0};
+	if (dwImportDirectoryRva != 0 &&
+		!K22UnlockImports(lpImageBase, pDataDirectory, RVA(dwImportDirectoryRva), &stBatch))
+		RETURN_K22_F("Couldn't unlock import table of %s", pK22ModuleData->lpModuleName);
+	PIMAGE_DATA_DIRECTORY pBoundDirectory = &pDataDirectory[IMAGE_DIRECTORY_ENTRY_BOUND_IMPORT];
+	if (dwImportDirectoryRva != 0 && pBoundDirectory->VirtualAddress != 0 &&
+		!K22UnlockBatchAdd(&stBatch, RVA(pBoundDirectory->VirtualAddress), pBoundDirectory->Size))
+		RETURN_K22_F("Couldn't unlock bound import table of %s", pK22ModuleData->lpModuleName);
+	DWORD dwDelayCount = 0;
+	if (dwDelayDirectoryRva != 0 &&
+		!K22UnlockDelayImports(lpImageBase, RVA(dwDelayDirectoryRva), &stBatch, &dwDelayCount))
+		RETURN_K22_F("Couldn't unlock delay import table of %s", pK22ModuleData->lpModuleName);
+	LARGE_INTEGER stEndTime, stFrequency;
+	QueryPerformanceCounter(&stEndTime);
+	QueryPerformanceFrequency(&stFrequency);
+	K22_D(
+		"Unlocked import table of %s - %lu regions in %lu us",
+		pK22ModuleData->lpModuleName,
+		stBatch.dwCount,
+		(DWORD)((stEndTime.QuadPart - stStartTime.QuadPart) * 1000000 / stFrequency.QuadPart)
+	);
+
+	BOOL bRet = TRUE;
+	K22WithUnlockedBatch(&stBatch) {
+		// use the binding cache if possible, resolve all symbols otherwise
+		if (dwImportDirectoryRva != 0) {
+			// leave valid bound imports of unaffected modules to ntdll.dll
+			PIMAGE_IMPORT_DESCRIPTOR pImportDesc = RVA(dwImportDirectoryRva);
+			pImportDesc += K22KeepBoundImports(pK22ModuleData, pDataDirectory, pImportDesc);
+			bRet = K22BindCacheApply(pK22ModuleData, pImportDesc) ||
+				   K22ProcessImportDescriptors(lpImageBase, pImportDesc);
+		}
+		if (bRet && dwDelayCount != 0)
+			bRet = K22ProcessDelayImports(lpImageBase, RVA(dwDelayDirectoryRva), dwDelayCount);
+	}
+	return bRet;
+}
+
 VOID K22DisableInitRoutine(LPVOID lpImageBase) {
 	PK22_MODULE_DATA pK22ModuleData = K22DataGetModule(lpImageBase);
 	PLDR_DATA_TABLE_ENTRY pLdrEntry = pK22ModuleData->pLdrEntry;
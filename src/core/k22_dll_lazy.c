@@ -0,0 +1,415 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-12.
+
+#include "kernel22.h"
+
+// Lazy import binding (LazyBinding), similar to how delay-loaded imports work.
+// Imports of modules loaded after process startup are pointed at small generated stubs, instead of being resolved.
+// The first call of a stub resolves the symbol, patches the IAT entry and jumps to the real target.
+// Delay-loaded imports of DLLs that rules apply to are always bound this way, so that they go through the resolver,
+// too - following the contract of the linker's delay helper (module handle, failure hook, VC++ exceptions).
+// Only exports in executable sections get stubs - data imports (and anything that can't be inspected) are bound
+// eagerly. Targets that aren't loaded yet are inspected by mapping their file as an image, without loading them.
+// Stubs and their entries live as long as the process - unloaded modules don't free them.
+
+#if K22_BITS64
+// load the entry, jump to the trampoline
+#define K22_LAZY_STUB_SIZE 32
+static const BYTE bLazyStub[] = {
+	0x49, 0xBB, 0, 0, 0, 0, 0, 0, 0, 0, // mov r11, <entry>
+	0xFF, 0x25, 0, 0, 0, 0,				// jmp [rip+0]
+	0, 0, 0, 0, 0, 0, 0, 0,				// dq <trampoline>
+};
+#define K22_LAZY_STUB_ENTRY		 2
+#define K22_LAZY_STUB_TRAMPOLINE 16
+
+// save argument registers, call K22LazyResolve(r11), restore registers and jump to the result
+// xmm0-5 are saved - __vectorcall passes arguments (and HVAs) in all of them
+static const BYTE bLazyTrampoline[] = {
+	0x51, 0x52, 0x41, 0x50, 0x41, 0x51,		  // push rcx, rdx, r8, r9
+	0x48, 0x81, 0xEC, 0x88, 0x00, 0x00, 0x00, // sub rsp, 0x88
+	0xF3, 0x0F, 0x7F, 0x44, 0x24, 0x20,		  // movdqu [rsp+0x20], xmm0
+	0xF3, 0x0F, 0x7F, 0x4C, 0x24, 0x30,		  // movdqu [rsp+0x30], xmm1
+	0xF3, 0x0F, 0x7F, 0x54, 0x24, 0x40,		  // movdqu [rsp+0x40], xmm2
+	0xF3, 0x0F, 0x7F, 0x5C, 0x24, 0x50,		  // movdqu [rsp+0x50], xmm3
+	0xF3, 0x0F, 0x7F, 0x64, 0x24, 0x60,		  // movdqu [rsp+0x60], xmm4
+	0xF3, 0x0F, 0x7F, 0x6C, 0x24, 0x70,		  // movdqu [rsp+0x70], xmm5
+	0x4C, 0x89, 0xD9,						  // mov rcx, r11
+	0x48, 0xB8, 0, 0, 0, 0, 0, 0, 0, 0,		  // mov rax, K22LazyResolve
+	0xFF, 0xD0,								  // call rax
+	0xF3, 0x0F, 0x6F, 0x44, 0x24, 0x20,		  // movdqu xmm0, [rsp+0x20]
+	0xF3, 0x0F, 0x6F, 0x4C, 0x24, 0x30,		  // movdqu xmm1, [rsp+0x30]
+	0xF3, 0x0F, 0x6F, 0x54, 0x24, 0x40,		  // movdqu xmm2, [rsp+0x40]
+	0xF3, 0x0F, 0x6F, 0x5C, 0x24, 0x50,		  // movdqu xmm3, [rsp+0x50]
+	0xF3, 0x0F, 0x6F, 0x64, 0x24, 0x60,		  // movdqu xmm4, [rsp+0x60]
+	0xF3, 0x0F, 0x6F, 0x6C, 0x24, 0x70,		  // movdqu xmm5, [rsp+0x70]
+	0x48, 0x81, 0xC4, 0x88, 0x00, 0x00, 0x00, // add rsp, 0x88
+	0x41, 0x59, 0x41, 0x58, 0x5A, 0x59,		  // pop r9, r8, rdx, rcx
+	0xFF, 0xE0,								  // jmp rax
+};
+#define K22_LAZY_TRAMPOLINE_RESOLVE 54
+
+// unwind info of the trampoline's prolog (UNWIND_INFO isn't in winnt.h), registered in K22LazyInitialize()
+// without it, an exception raised by K22LazyResolve() couldn't be unwound past the trampoline's frame
+// (the epilog doesn't end with ret - it can't be recognized, but nothing can raise an exception there)
+static const BYTE bLazyTrampolineUnwind[] = {
+	0x01,		// version 1, no flags
+	0x0D,		// size of prolog
+	0x06,		// count of unwind codes
+	0x00,		// no frame register
+	0x0D, 0x01, // sub rsp, 0x88 - UWOP_ALLOC_LARGE, size / 8 in the next code (over 0x80 - too large for SMALL)
+	0x11, 0x00, // 0x88 / 8
+	0x06, 0x90, // push r9 - UWOP_PUSH_NONVOL
+	0x04, 0x80, // push r8
+	0x02, 0x20, // push rdx
+	0x01, 0x10, // push rcx
+};
+#define K22_LAZY_TRAMPOLINE_UNWIND	 ((sizeof(bLazyTrampoline) + 3) & ~3)
+#define K22_LAZY_TRAMPOLINE_FUNCTION (K22_LAZY_TRAMPOLINE_UNWIND + sizeof(bLazyTrampolineUnwind))
+#define K22_LAZY_TRAMPOLINE_SIZE	 (K22_LAZY_TRAMPOLINE_FUNCTION + sizeof(RUNTIME_FUNCTION))
+#elif K22_BITS32
+// push the entry, jump to the trampoline
+#define K22_LAZY_STUB_SIZE 16
+static const BYTE bLazyStub[] = {
+	0x68, 0, 0, 0, 0, // push <entry>
+	0xB8, 0, 0, 0, 0, // mov eax, <trampoline>
+	0xFF, 0xE0,		  // jmp eax
+};
+#define K22_LAZY_STUB_ENTRY		 1
+#define K22_LAZY_STUB_TRAMPOLINE 6
+
+// save argument registers, call K22LazyResolve([esp]), restore registers, drop the entry and jump to the result
+static const BYTE bLazyTrampoline[] = {
+	0x51, 0x52,				// push ecx, edx
+	0xFF, 0x74, 0x24, 0x08, // push dword [esp+8]
+	0xB8, 0, 0, 0, 0,		// mov eax, K22LazyResolve
+	0xFF, 0xD0,				// call eax
+	0x83, 0xC4, 0x04,		// add esp, 4
+	0x5A, 0x59,				// pop edx, ecx
+	0x83, 0xC4, 0x04,		// add esp, 4
+	0xFF, 0xE0,				// jmp eax
+};
+#define K22_LAZY_TRAMPOLINE_RESOLVE 7
+// x86 uses the SEH chain - no unwind info is needed
+#define K22_LAZY_TRAMPOLINE_SIZE sizeof(bLazyTrampoline)
+#endif
+
+static PVOID K22LazyDelayBind(PK22_LAZY_ENTRY pEntry, PVOID pProc) {
+	// finish binding a delay-loaded import like the linker's delay helper would - its module handle is stored
+	// in the descriptor, for __FUnloadDelayLoadedDLL2() and the helper itself (e.g. __HrLoadAllImportsForDll())
+	// failures go to the module's failure hook, then raise the VC++ exception that DELAYLOAD_EXCEPTION_FILTER()
+	// and similar handlers expect - both may still supply the address
+	LPVOID lpImageBase					   = pEntry->pK22ModuleData->lpModuleBase;
+	PIMAGE_DELAYLOAD_DESCRIPTOR pDelayDesc = pEntry->pDelayDesc;
+	PK22_SYMBOL_REF pSymbol				   = &pEntry->stSymbol;
+
+	DelayLoadInfo stInfo = {
+		.cb		 = sizeof(stInfo),
+		.pidd	 = (PCImgDelayDescr)pDelayDesc,
+		.ppfn	 = (FARPROC *)pEntry->pThunk,
+		.szDll	 = RVA(pDelayDesc->DllNameRVA),
+		.hmodCur = K22ResolveModule(pEntry->pK22ModuleData->lpModuleName, pEntry->lpModuleName),
+		.pfnCur	 = pProc,
+	};
+	stInfo.dlp.fImportByName = pSymbol->lpName != NULL;
+	if (stInfo.dlp.fImportByName)
+		stInfo.dlp.szProcName = pSymbol->lpName;
+	else
+		stInfo.dlp.dwOrdinal = pSymbol->wOrdinal;
+
+	if (stInfo.pfnCur != NULL) {
+		// symbols may be routed away from a module that can't be loaded itself
+		if (stInfo.hmodCur == NULL)
+			RtlPcToFileHeader(pProc, (PVOID *)&stInfo.hmodCur);
+		goto End;
+	}
+
+	// the hook is a variable of the module - it can only be found if the module exports it
+	PfnDliHook *ppfnFailureHook = K22ExportFindByName(pEntry->pK22ModuleData, "__pfnDliFailureHook2", 0);
+	PfnDliHook pfnFailureHook	= ppfnFailureHook != NULL ? *ppfnFailureHook : NULL;
+	if (stInfo.hmodCur == NULL) {
+		// the hook may supply a module to look the symbol up in
+		stInfo.dwLastError = ERROR_MOD_NOT_FOUND;
+		if (pfnFailureHook != NULL)
+			stInfo.hmodCur = (HMODULE)pfnFailureHook(dliFailLoadLib, &stInfo);
+		if (stInfo.hmodCur == NULL)
+			goto Raise;
+		stInfo.pfnCur = GetProcAddress(
+			stInfo.hmodCur,
+			pSymbol->lpName != NULL ? pSymbol->lpName : MAKEINTRESOURCEA(pSymbol->wOrdinal)
+		);
+		if (stInfo.pfnCur != NULL)
+			goto End;
+	}
+	stInfo.dwLastError = ERROR_PROC_NOT_FOUND;
+	if (pfnFailureHook != NULL)
+		stInfo.pfnCur = pfnFailureHook(dliFailGetProc, &stInfo);
+	if (stInfo.pfnCur != NULL)
+		goto End;
+
+Raise:;
+	PDelayLoadInfo pInfo = &stInfo;
+	RaiseException(VcppException(ERROR_SEVERITY_ERROR, stInfo.dwLastError), 0, 1, (ULONG_PTR *)&pInfo);
+	if (stInfo.pfnCur == NULL)
+		return NULL;
+
+End:
+	// the handle holds a reference of its own - __FUnloadDelayLoadedDLL2() frees it
+	if (pDelayDesc->ModuleHandleRVA != 0 && stInfo.hmodCur != NULL) {
+		HMODULE *phModule = RVA(pDelayDesc->ModuleHandleRVA);
+		HMODULE hModule;
+		if (*phModule == NULL &&
+			GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCSTR)stInfo.hmodCur, &hModule) &&
+			InterlockedCompareExchangePointer((PVOID *)phModule, hModule, NULL) != NULL)
+			FreeLibrary(hModule);
+	}
+	return stInfo.pfnCur;
+}
+
+static PVOID __cdecl K22LazyResolve(PK22_LAZY_ENTRY pEntry) {
+	// called by the trampoline on the first call of a stub (possibly from multiple threads at once)
+	PVOID pProc = pEntry->pProc;
+	if (pProc != NULL)
+		return pProc;
+
+	CHAR szSymbol[1 + 5 + 1];
+	pProc = K22ResolveSymbolEx(pEntry->pK22ModuleData->lpModuleName, pEntry->lpModuleName, &pEntry->stSymbol);
+	if (pEntry->pDelayDesc != NULL)
+		pProc = K22LazyDelayBind(pEntry, pProc);
+	if (pProc == NULL) {
+		// there's nothing to return to - fail like a delay-loaded import would
+		K22_F("Couldn't bind %s!%s lazily", pEntry->lpModuleName, K22SymbolRefString(&pEntry->stSymbol, szSymbol));
+		RaiseException(STATUS_ENTRYPOINT_NOT_FOUND, EXCEPTION_NONCONTINUABLE, 0, NULL);
+		return NULL;
+	}
+
+	InterlockedExchangePointer(&pEntry->pProc, pProc);
+	AcquireSRWLockExclusive(&pK22Data->stLazy.stLock);
+	K22WithUnlocked(*pEntry->pThunk) {
+		*pEntry->pThunk = (ULONG_PTR)pProc;
+	}
+	ReleaseSRWLockExclusive(&pK22Data->stLazy.stLock);
+	K22_V("Bound %s!%s lazily -> %p", pEntry->lpModuleName, K22SymbolRefString(&pEntry->stSymbol, szSymbol), pProc);
+	return pProc;
+}
+
+BOOL K22LazyInitialize() {
+	// the trampoline is also used by delay-loaded imports, so it's always needed
+	LPBYTE pTrampoline = VirtualAlloc(NULL, K22_LAZY_TRAMPOLINE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (pTrampoline == NULL)
+		RETURN_K22_F_ERR("Couldn't allocate lazy binding trampoline");
+	memcpy(pTrampoline, bLazyTrampoline, sizeof(bLazyTrampoline));
+	*(PVOID *)(pTrampoline + K22_LAZY_TRAMPOLINE_RESOLVE) = K22LazyResolve;
+#if K22_BITS64
+	memcpy(pTrampoline + K22_LAZY_TRAMPOLINE_UNWIND, bLazyTrampolineUnwind, sizeof(bLazyTrampolineUnwind));
+	PRUNTIME_FUNCTION pFunction = (PRUNTIME_FUNCTION)(pTrampoline + K22_LAZY_TRAMPOLINE_FUNCTION);
+	pFunction->BeginAddress		= 0;
+	pFunction->EndAddress		= sizeof(bLazyTrampoline);
+	pFunction->UnwindData		= K22_LAZY_TRAMPOLINE_UNWIND;
+#endif
+	DWORD dwOldProtect;
+	if (!VirtualProtect(pTrampoline, K22_LAZY_TRAMPOLINE_SIZE, PAGE_EXECUTE_READ, &dwOldProtect))
+		RETURN_K22_F_ERR("Couldn't protect lazy binding trampoline");
+	FlushInstructionCache(GetCurrentProcess(), pTrampoline, sizeof(bLazyTrampoline));
+#if K22_BITS64
+	// the trampoline is never freed - neither is its function table
+	if (!RtlAddFunctionTable(pFunction, 1, (DWORD64)pTrampoline))
+		RETURN_K22_F("Couldn't register lazy binding trampoline unwind info");
+#endif
+
+	pK22Data->stLazy.pTrampoline = pTrampoline;
+	if (pK22Data->stConfig.bLazyBinding)
+		K22_I("Lazy binding enabled for modules loaded after startup");
+	return TRUE;
+}
+
+BOOL K22LazyBlockAlloc(PK22_LAZY_BLOCK pBlock, DWORD dwCapacity) {
+	// allocate entries and (writable) code for dwCapacity stubs
+	memset(pBlock, 0, sizeof(*pBlock));
+	if (pK22Data->stLazy.pTrampoline == NULL || dwCapacity == 0)
+		return FALSE;
+	pBlock->pEntries = calloc(dwCapacity, sizeof(*pBlock->pEntries));
+	pBlock->pStubs	 = VirtualAlloc(NULL, dwCapacity * K22_LAZY_STUB_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (pBlock->pEntries == NULL || pBlock->pStubs == NULL) {
+		K22_W_ERR("Couldn't allocate %lu lazy binding stubs", dwCapacity);
+		K22LazyBlockFinish(pBlock);
+		return FALSE;
+	}
+	pBlock->dwCapacity = dwCapacity;
+	return TRUE;
+}
+
+BOOL K22LazyBlockCreate(PK22_MODULE_DATA pK22ModuleData, PIMAGE_IMPORT_DESCRIPTOR pImportDesc, PK22_LAZY_BLOCK pBlock) {
+	// prepare stubs for all imports of pK22ModuleData, if it's going to be bound lazily
+	// the process and modules loaded during its static init are always bound eagerly
+	memset(pBlock, 0, sizeof(*pBlock));
+	if (!pK22Data->stConfig.bLazyBinding || pK22Data->fDelayDllInit || pK22ModuleData->fIsProcess)
+		return FALSE;
+
+	LPVOID lpImageBase = pK22ModuleData->lpModuleBase;
+	DWORD dwCapacity   = 0;
+	for (/**/; pImportDesc->FirstThunk; pImportDesc++) {
+		for (PULONG_PTR pThunk = RVA(pImportDesc->FirstThunk); *pThunk != 0; pThunk++) {
+			dwCapacity++;
+		}
+	}
+	return K22LazyBlockAlloc(pBlock, dwCapacity);
+}
+
+PVOID K22LazyStubAdd(
+	PK22_LAZY_BLOCK pBlock,
+	PK22_MODULE_DATA pK22ModuleData,
+	LPCSTR lpModuleName,
+	PULONG_PTR pThunk,
+	PK22_SYMBOL_REF pSymbol,
+	PIMAGE_DELAYLOAD_DESCRIPTOR pDelayDesc
+) {
+	// return a stub binding lpModuleName!pSymbol into pThunk on the first call
+	if (pBlock->dwCount == pBlock->dwCapacity)
+		return NULL;
+	PK22_LAZY_ENTRY pEntry = &pBlock->pEntries[pBlock->dwCount];
+	LPBYTE pStub		   = pBlock->pStubs + pBlock->dwCount * K22_LAZY_STUB_SIZE;
+	pBlock->dwCount++;
+
+	pEntry->pThunk		   = pThunk;
+	pEntry->pK22ModuleData = pK22ModuleData;
+	pEntry->lpModuleName   = lpModuleName;
+	pEntry->stSymbol	   = *pSymbol;
+	pEntry->pDelayDesc	   = pDelayDesc;
+
+	memcpy(pStub, bLazyStub, sizeof(bLazyStub));
+	*(PVOID *)(pStub + K22_LAZY_STUB_ENTRY)		 = pEntry;
+	*(PVOID *)(pStub + K22_LAZY_STUB_TRAMPOLINE) = pK22Data->stLazy.pTrampoline;
+	return pStub;
+}
+
+static BOOL K22LazyMapImage(PK22_LAZY_BLOCK pBlock, LPCSTR lpModuleName) {
+	// map the file of a module that isn't loaded as an image (without loading it), to read its exports
+	// only the last module is kept - imports are grouped by descriptor, so it's usually the same one
+	if (pBlock->lpImageName != NULL && _stricmp(pBlock->lpImageName, lpModuleName) == 0)
+		return pBlock->lpImage != NULL;
+	if (pBlock->lpImage != NULL)
+		UnmapViewOfFile(pBlock->lpImage);
+	pBlock->lpImageName = lpModuleName;
+	pBlock->lpImage		= NULL;
+	memset(&pBlock->stImageExports, 0, sizeof(pBlock->stImageExports));
+
+	WCHAR szModuleName[MAX_PATH];
+	UNICODE_STRING stModuleName = {
+		.Length		   = 0,
+		.MaximumLength = sizeof(szModuleName),
+		.Buffer		   = szModuleName,
+	};
+	// leave space for the terminator, as CreateFileW() needs one
+	WCHAR szModulePath[MAX_PATH + 1];
+	UNICODE_STRING stModulePath = {
+		.Length		   = 0,
+		.MaximumLength = sizeof(szModulePath) - sizeof(WCHAR),
+		.Buffer		   = szModulePath,
+	};
+	if (!K22StringToUnicode(lpModuleName, &stModuleName) ||
+		!K22ResolveModulePath(lpModuleName, &stModuleName, &stModulePath, NULL))
+		return FALSE;
+	szModulePath[stModulePath.Length / sizeof(WCHAR)] = L'\0';
+
+	HANDLE hFile = CreateFileW(
+		szModulePath,
+		GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_DELETE,
+		NULL,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		NULL
+	);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return FALSE;
+	HANDLE hMapping = CreateFileMapping(hFile, NULL, PAGE_READONLY | SEC_IMAGE, 0, 0, NULL);
+	CloseHandle(hFile);
+	if (hMapping == NULL)
+		return FALSE;
+	pBlock->lpImage = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMapping);
+	return pBlock->lpImage != NULL;
+}
+
+static BOOL K22LazyIsCode(
+	PK22_LAZY_BLOCK pBlock,
+	LPCSTR lpModuleName,
+	PK22_MODULE_CACHE ppModule,
+	PK22_SYMBOL_REF pSymbol
+) {
+	// check if lpModuleName exports pSymbol from an executable section - data can't be called through a stub
+	// FALSE if that can't be told (not found, forwarded, or the module can't be inspected) - it's bound eagerly then
+	if (pSymbol->lpName == NULL)
+		return FALSE;
+	LPCVOID lpImageBase;
+	PK22_PE_EXPORTS pExports;
+	PK22_MODULE_DATA pTarget = ppModule != NULL ? K22CacheGetModule(ppModule) : NULL;
+	if (pTarget == NULL)
+		pTarget = K22ModuleIndexFind(lpModuleName);
+	if (pTarget != NULL) {
+		lpImageBase = pTarget->lpModuleBase;
+		pExports	= &pTarget->stExports;
+	} else if (K22LazyMapImage(pBlock, lpModuleName)) {
+		lpImageBase = pBlock->lpImage;
+		pExports	= &pBlock->stImageExports;
+	} else {
+		return FALSE;
+	}
+	DWORD dwRva = K22PeExportFindByName(lpImageBase, pExports, pSymbol->lpName, pSymbol->wHint);
+	return dwRva != 0 && K22PeIsCodeRva(lpImageBase, dwRva);
+}
+
+PVOID K22LazyStubCreate(
+	PK22_LAZY_BLOCK pBlock,
+	PK22_MODULE_DATA pK22ModuleData,
+	PK22_DLL_ROUTE pRoute,
+	PULONG_PTR pThunk,
+	PK22_SYMBOL_REF pSymbol
+) {
+	// return a stub for the import at pThunk, or NULL if it has to be resolved right away
+	// ordinals say nothing about the symbol (e.g. MFC exports data by ordinal)
+	if (pSymbol->lpName == NULL)
+		return NULL;
+	// symbol-specific routes are resolved here already - it's only a rule lookup
+	K22_DLL_ROUTE stRoute;
+	if (pRoute->fPerSymbol) {
+		K22ResolveRouteRules(pRoute->pDll, pRoute->lpModuleNameOrig, pSymbol, &stRoute);
+		pRoute = &stRoute;
+	}
+	// resolving symbols of loaded modules is cheap - loading modules, and rewritten symbols, is what's worth deferring
+	if (pRoute->pDllRewrite == NULL &&
+		(K22CacheGetModule(pRoute->ppModule) != NULL || K22ModuleIndexFind(pRoute->lpModuleName) != NULL))
+		return NULL;
+	// data imports must be bound eagerly - check the export of the module the symbol is rewritten to, if any
+	PK22_DLL_REWRITE_SYMBOL pDllRewriteSymbol =
+		pRoute->pDllRewrite != NULL ? K22FindDllRewriteSymbol(pRoute->pDllRewrite, pSymbol) : NULL;
+	BOOL fIsCode;
+	if (pDllRewriteSymbol != NULL)
+		fIsCode = K22LazyIsCode(pBlock, pDllRewriteSymbol->lpTargetDll, NULL, &pDllRewriteSymbol->stTarget);
+	else
+		fIsCode = K22LazyIsCode(pBlock, pRoute->lpModuleName, pRoute->ppModule, pSymbol);
+	if (!fIsCode)
+		return NULL;
+	return K22LazyStubAdd(pBlock, pK22ModuleData, pRoute->lpModuleNameOrig, pThunk, pSymbol, NULL);
+}
+
+BOOL K22LazyBlockFinish(PK22_LAZY_BLOCK pBlock) {
+	// make the stubs executable, or free the block if nothing is bound lazily
+	if (pBlock->lpImage != NULL) {
+		UnmapViewOfFile(pBlock->lpImage);
+		pBlock->lpImage = NULL;
+	}
+	if (pBlock->dwCount == 0) {
+		if (pBlock->pStubs != NULL)
+			VirtualFree(pBlock->pStubs, 0, MEM_RELEASE);
+		K22_FREE(pBlock->pEntries);
+		memset(pBlock, 0, sizeof(*pBlock));
+		return TRUE;
+	}
+	DWORD dwOldProtect;
+	if (!VirtualProtect(pBlock->pStubs, pBlock->dwCapacity * K22_LAZY_STUB_SIZE, PAGE_EXECUTE_READ, &dwOldProtect))
+		RETURN_K22_F_ERR("Couldn't protect lazy binding stubs");
+	FlushInstructionCache(GetCurrentProcess(), pBlock->pStubs, pBlock->dwCapacity * K22_LAZY_STUB_SIZE);
+	K22_D("Deferred %lu symbols to lazy binding stubs", pBlock->dwCount);
+	return TRUE;
+}
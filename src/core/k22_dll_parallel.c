@@ -0,0 +1,151 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-13.
+
+#include "kernel22.h"
+
+// Parallel symbol resolution (ParallelResolve = number of worker threads).
+// Large import tables are resolved in two phases - target modules are loaded serially first,
+// then the symbols are looked up in their export tables by a small pool of workers.
+// Workers only read PE structures of loaded modules - they never load modules, log, or take the loader lock.
+// They're started with no loader initialization, so that they can run while the loader lock is held.
+// The calling thread processes the job, too, then blocks until every woken worker is done with it.
+
+// these aren't in ntdll.h yet (Windows 10 1809+)
+#define K22_THREAD_CREATE_FLAGS_SKIP_THREAD_ATTACH 0x00000002
+#define K22_THREAD_CREATE_FLAGS_LOADER_WORKER	   0x00000010
+#define K22_THREAD_CREATE_FLAGS_SKIP_LOADER_INIT   0x00000020
+
+static VOID K22ParallelWork(PK22_PARALLEL_JOB pJob) {
+	// claim chunks of the job until none are left
+	LONG lChunk;
+	while ((lChunk = InterlockedIncrement(&pJob->lNextChunk) - 1) < (LONG)pJob->dwChunks) {
+		DWORD dwStart = lChunk * K22_PARALLEL_CHUNK;
+		DWORD dwEnd	  = min(dwStart + K22_PARALLEL_CHUNK, pJob->dwCount);
+		for (PK22_PARALLEL_ITEM pItem = &pJob->pItems[dwStart]; pItem < &pJob->pItems[dwEnd]; pItem++) {
+			if (pItem->pK22ModuleData == NULL)
+				continue;
+			if (pItem->stSymbol.lpName == NULL)
+				pItem->pProc = K22ExportFindByOrdinal(pItem->pK22ModuleData, pItem->stSymbol.wOrdinal);
+			else
+				pItem->pProc =
+					K22ExportFindByName(pItem->pK22ModuleData, pItem->stSymbol.lpName, pItem->stSymbol.wHint);
+		}
+	}
+}
+
+static NTSTATUS NTAPI K22ParallelWorker(PVOID pArgument) {
+	// every semaphore release wakes one worker for the published job
+	while (WaitForSingleObject(pK22Data->stParallel.hSemaphore, INFINITE) == WAIT_OBJECT_0) {
+		if (pK22Data->stParallel.fStop)
+			break;
+		PK22_PARALLEL_JOB pJob = pK22Data->stParallel.pJob;
+		K22ParallelWork(pJob);
+		// the last woken worker lets K22ParallelRun() return - pJob can't be touched afterwards
+		if (InterlockedDecrement(&pJob->lPending) == 0)
+			SetEvent(pK22Data->stParallel.hDone);
+	}
+	return STATUS_SUCCESS;
+}
+
+BOOL K22ParallelInitialize() {
+	DWORD dwThreads = min(pK22Data->stConfig.dwParallelResolve, K22_PARALLEL_MAX_THREADS);
+	if (dwThreads == 0)
+		return TRUE;
+
+	pK22Data->stParallel.hSemaphore = CreateSemaphore(NULL, 0, MAXLONG, NULL);
+	if (pK22Data->stParallel.hSemaphore == NULL)
+		RETURN_K22_F_ERR("Couldn't create parallel resolver semaphore");
+	pK22Data->stParallel.hDone = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (pK22Data->stParallel.hDone == NULL)
+		RETURN_K22_F_ERR("Couldn't create parallel resolver event");
+
+	for (DWORD i = 0; i < dwThreads; i++) {
+		HANDLE hThread;
+		NTSTATUS ntStatus = NtCreateThreadEx(
+			&hThread,
+			THREAD_ALL_ACCESS,
+			NULL,
+			NtCurrentProcess,
+			K22ParallelWorker,
+			NULL,
+			K22_THREAD_CREATE_FLAGS_SKIP_THREAD_ATTACH | K22_THREAD_CREATE_FLAGS_LOADER_WORKER |
+				K22_THREAD_CREATE_FLAGS_SKIP_LOADER_INIT,
+			0,
+			0,
+			0,
+			NULL
+		);
+		if (!NT_SUCCESS(ntStatus)) {
+			// older systems don't support these flags - continue with the threads started so far
+			K22_W("Couldn't start parallel resolver thread #%lu - status %08lx", i, ntStatus);
+			break;
+		}
+		// kept for K22ParallelShutdown()
+		pK22Data->stParallel.hThreads[pK22Data->stParallel.dwThreads++] = hThread;
+	}
+
+	if (pK22Data->stParallel.dwThreads != 0)
+		K22_I("Parallel symbol resolution enabled - %lu worker threads", pK22Data->stParallel.dwThreads);
+	return TRUE;
+}
+
+VOID K22ParallelShutdown(BOOL fProcessExit) {
+	// stop the workers when the core is detached
+	// on process exit, they've been terminated already (and waiting for them would deadlock)
+	if (pK22Data == NULL || pK22Data->stParallel.dwThreads == 0)
+		return;
+	AcquireSRWLockExclusive(&pK22Data->stParallel.stLock);
+	DWORD dwThreads				   = pK22Data->stParallel.dwThreads;
+	pK22Data->stParallel.dwThreads = 0;
+	pK22Data->stParallel.fStop	   = TRUE;
+	ReleaseSRWLockExclusive(&pK22Data->stParallel.stLock);
+
+	if (!fProcessExit) {
+		ReleaseSemaphore(pK22Data->stParallel.hSemaphore, dwThreads, NULL);
+		WaitForMultipleObjects(dwThreads, pK22Data->stParallel.hThreads, TRUE, INFINITE);
+	}
+	for (DWORD i = 0; i < dwThreads; i++) {
+		CloseHandle(pK22Data->stParallel.hThreads[i]);
+	}
+	CloseHandle(pK22Data->stParallel.hSemaphore);
+	CloseHandle(pK22Data->stParallel.hDone);
+}
+
+BOOL K22ParallelIsEnabled(DWORD dwSymbols) {
+	// resolver debugging logs every symbol, which workers can't do
+	return pK22Data->stParallel.dwThreads != 0 && dwSymbols >= K22_PARALLEL_MIN_SYMBOLS &&
+		   !pK22Data->stConfig.bDebugImportResolver;
+}
+
+VOID K22ParallelRun(PK22_PARALLEL_ITEM pItems, DWORD dwCount) {
+	// look up all items that have a module set, store the results in pItems
+	// export tables of all modules must be parsed already (see K22ExportParse())
+	K22_PARALLEL_JOB stJob = {
+		.pItems	  = pItems,
+		.dwCount  = dwCount,
+		.dwChunks = (dwCount + K22_PARALLEL_CHUNK - 1) / K22_PARALLEL_CHUNK,
+	};
+
+	if (stJob.dwChunks < 2 || !TryAcquireSRWLockExclusive(&pK22Data->stParallel.stLock)) {
+		// another thread is using the workers - do it alone
+		K22ParallelWork(&stJob);
+		return;
+	}
+	if (pK22Data->stParallel.dwThreads == 0) {
+		// the workers were stopped
+		ReleaseSRWLockExclusive(&pK22Data->stParallel.stLock);
+		K22ParallelWork(&stJob);
+		return;
+	}
+
+	// wake no more workers than there are chunks; each of them checks out of the job exactly once
+	DWORD dwWorkers = min(pK22Data->stParallel.dwThreads, stJob.dwChunks);
+	stJob.lPending	= dwWorkers;
+	InterlockedExchangePointer((PVOID volatile *)&pK22Data->stParallel.pJob, &stJob);
+	ReleaseSemaphore(pK22Data->stParallel.hSemaphore, dwWorkers, NULL);
+	K22ParallelWork(&stJob);
+	// wait for the workers' chunks - this thread holds the loader lock, so block instead of spinning
+	WaitForSingleObject(pK22Data->stParallel.hDone, INFINITE);
+	InterlockedExchangePointer((PVOID volatile *)&pK22Data->stParallel.pJob, NULL);
+
+	ReleaseSRWLockExclusive(&pK22Data->stParallel.stLock);
+}
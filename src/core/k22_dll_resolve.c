@@ -5,11 +5,11 @@
 static PVOID K22LoadAndResolve(
 	LPCSTR lpCallerName,
 	LPCSTR lpModuleName,
-	HINSTANCE *ppModule,
-	LPCSTR lpSymbolName,
-	PVOID *ppProc,
+	PK22_MODULE_CACHE ppModule,
+	PK22_SYMBOL_REF pSymbol,
+	PK22_PROC_CACHE volatile *ppProc,
 	LPCSTR lpModuleNameOrig,
-	LPCSTR lpSymbolNameOrig,
+	PK22_SYMBOL_REF pSymbolOrig,
 	LPCSTR *ppErrorName
 );
 
@@ -37,187 +37,299 @@ static PVOID K22LoadAndResolve(
  */
 //
 
-LPCSTR K22ResolveModulePath(LPCSTR lpModuleName, HINSTANCE *ppModule) {
-	// resolve DLL name to full absolute path
-	LPSTR lpModulePath;
-	K22_MALLOC_LENGTH(lpModulePath, MAX_PATH);
+BOOL K22ResolveModulePath(
+	LPCSTR lpModuleName,
+	PCUNICODE_STRING pModuleName,
+	PUNICODE_STRING pModulePath,
+	HINSTANCE *ppModule
+) {
+	// resolve DLL name (given in ANSI and Unicode) to full absolute path, written to pModulePath's buffer
+	// paths are only handled in Unicode; the ANSI name is used to look up the in-memory caches
 	if (ppModule)
 		*ppModule = NULL;
 
-	// 0. Full path.
-	if (K22PathIsFile(lpModuleName)) {
-		strcpy(lpModulePath, lpModuleName);
-		return lpModulePath;
-	}
 	// 4. Loaded-module list.
-	K22_LDR_ENUM(pLdrEntry, InLoadOrderModuleList, InLoadOrderLinks) {
-		wcstombs(lpModulePath, pLdrEntry->FullDllName.Buffer, MAX_PATH);
-		if (K22PathMatches(lpModulePath, lpModuleName)) {
-			if (ppModule)
-				*ppModule = pLdrEntry->DllBase;
-			return lpModulePath;
-		}
+	// (checked first - loaded modules, by name or by full path, need no filesystem access)
+	PK22_MODULE_DATA pK22ModuleData = K22ModuleIndexFind(lpModuleName);
+	if (pK22ModuleData != NULL) {
+		if (ppModule)
+			*ppModule = pK22ModuleData->lpModuleBase;
+		if (pK22ModuleData->pLdrEntry == NULL)
+			return K22StringToUnicode(pK22ModuleData->lpModulePath, pModulePath);
+		pModulePath->Length = 0;
+		return NT_SUCCESS(RtlAppendUnicodeStringToString(pModulePath, &pK22ModuleData->pLdrEntry->FullDllName));
+	}
+	// 0. Full path.
+	// (only names with a directory or a drive - bare names must not hit the filesystem here)
+	if (K22PathHasDirectory(lpModuleName) && K22PathIsFileW(pModuleName)) {
+		pModulePath->Length = 0;
+		return NT_SUCCESS(RtlAppendUnicodeStringToString(pModulePath, pModuleName));
 	}
+	// skip names that weren't found before
+	if (K22SearchIsMissing(lpModuleName))
+		return FALSE;
 	// 7. The folder from which the application loaded.
-	strcpy(lpModulePath, pK22Data->lpProcessDir);
-	if (K22PathIsFileEx(lpModulePath, strlen(lpModulePath), lpModuleName))
-		return lpModulePath;
 	// 8. The system folder. Use the GetSystemDirectory function to retrieve the path of this folder.
-	DWORD cchSystemDirectory = GetSystemDirectory(lpModulePath, MAX_PATH);
-	if (K22PathIsFileEx(lpModulePath, cchSystemDirectory, lpModuleName))
-		return lpModulePath;
 	// 10. The Windows folder. Use the GetWindowsDirectory function to get the path of this folder.
-	DWORD cchWindowsDirectory = GetWindowsDirectory(lpModulePath, MAX_PATH);
-	if (K22PathIsFileEx(lpModulePath, cchWindowsDirectory, lpModuleName))
-		return lpModulePath;
 	// 11. The current folder.
-	DWORD cchCurrentDirectory = GetCurrentDirectory(MAX_PATH, lpModulePath);
-	if (K22PathIsFileEx(lpModulePath, cchCurrentDirectory, lpModuleName))
-		return lpModulePath;
+	// (these are listed once and cached, see k22_dll_search.c)
+	if (K22SearchFind(lpModuleName, pModuleName, pModulePath))
+		return TRUE;
 	// 12. The directories that are listed in the PATH environment variable.
-	if (SearchPath(NULL, lpModuleName, NULL, MAX_PATH, lpModulePath, NULL) != 0)
-		return lpModulePath;
-	return NULL;
+	// (this also finds files created after listing the directories above)
+	DWORD cchModulePath = pModulePath->MaximumLength / sizeof(WCHAR);
+	cchModulePath		= SearchPathW(NULL, pModuleName->Buffer, NULL, cchModulePath, pModulePath->Buffer, NULL);
+	if (cchModulePath != 0 && cchModulePath < pModulePath->MaximumLength / sizeof(WCHAR)) {
+		pModulePath->Length = cchModulePath * sizeof(WCHAR);
+		return TRUE;
+	}
+	K22SearchSetMissing(lpModuleName);
+	return FALSE;
 }
 
 HINSTANCE K22ResolveModule(LPCSTR lpCallerName, LPCSTR lpModuleName) {
 	LPCSTR lpModuleNameOrig = lpModuleName;
 	LPCSTR lpErrorName		= NULL;
 
-	HINSTANCE hModule	= NULL;
-	HINSTANCE *ppModule = &hModule;
+	K22_MODULE_CACHE pModule   = NULL;
+	PK22_MODULE_CACHE ppModule = &pModule;
+	// the rules may be replaced meanwhile (see k22_data_watch.c) - use the same ones for all lookups
+	PK22_DLL_RULES pDll = pK22Data->pDll;
 
-	PK22_DLL_API_SET pDllApiSet = K22FindDllApiSet(lpModuleName, NULL);
+	PK22_DLL_API_SET pDllApiSet = K22FindDllApiSet(pDll, lpModuleName, NULL);
 	if (pDllApiSet != NULL) {
 		// apply DLL ApiSet redirect entry first
 		lpModuleName = pDllApiSet->lpTargetDll;
-		ppModule	 = &pDllApiSet->hModule; // cache module handle in redirect entry
+		ppModule	 = &pDllApiSet->pModule; // cache module in redirect entry
 	}
 
-	PK22_DLL_REDIRECT pDllRedirect = K22FindDllRedirect(lpModuleName);
-	if (pDllRedirect != NULL) {
+	PK22_DLL_ROUTE_ENTRY pRouteEntry = K22FindDllRoute(pDll, lpModuleName);
+	if (pRouteEntry != NULL && pRouteEntry->lpTargetDll != NULL) {
 		// then apply other DLL redirect entries
-		lpModuleName = pDllRedirect->lpTargetDll;
-		ppModule	 = &pDllRedirect->hModule; // cache module handle in redirect entry
+		lpModuleName = pRouteEntry->lpTargetDll;
+		ppModule	 = pRouteEntry->ppModule; // cache module in redirect entry
 	}
 
-	if (K22LoadAndResolve(lpCallerName, lpModuleName, ppModule, NULL, NULL, lpModuleNameOrig, NULL, &lpErrorName))
-		return *ppModule;
+	HINSTANCE hModule =
+		K22LoadAndResolve(lpCallerName, lpModuleName, ppModule, NULL, NULL, lpModuleNameOrig, NULL, &lpErrorName);
+	if (hModule != NULL)
+		return hModule;
 
 	K22_F_ERR("%s - %s -> %s -> %s", lpErrorName, lpCallerName, lpModuleNameOrig, lpModuleName);
 	return NULL;
 }
 
+VOID K22SymbolRefName(PK22_SYMBOL_REF pSymbol, LPCSTR lpName, WORD wHint) {
+	// measure and hash the name once, instead of in every lookup
+	pSymbol->lpName	  = lpName;
+	pSymbol->cchName  = strlen(lpName);
+	pSymbol->dwHash	  = K22StringHash(lpName, pSymbol->cchName);
+	pSymbol->wOrdinal = 0;
+	pSymbol->wHint	  = wHint;
+}
+
+VOID K22SymbolRefOrdinal(PK22_SYMBOL_REF pSymbol, WORD wOrdinal) {
+	pSymbol->lpName	  = NULL;
+	pSymbol->cchName  = 0;
+	pSymbol->dwHash	  = 0;
+	pSymbol->wOrdinal = wOrdinal;
+	pSymbol->wHint	  = 0;
+}
+
+VOID K22SymbolRefParse(PK22_SYMBOL_REF pSymbol, LPCSTR lpSymbolName) {
+	// parse a symbol name given as string - "#<ordinal>" or a name
+	if (lpSymbolName[0] == '#')
+		K22SymbolRefOrdinal(pSymbol, (WORD)strtol(lpSymbolName + 1, NULL, 10));
+	else
+		K22SymbolRefName(pSymbol, lpSymbolName, 0);
+}
+
+LPCSTR K22SymbolRefString(PK22_SYMBOL_REF pSymbol, LPSTR lpBuffer) {
+	// get a printable symbol name; lpBuffer must fit "#<ordinal>" (1 + 5 + 1 characters)
+	if (pSymbol->lpName != NULL)
+		return pSymbol->lpName;
+	lpBuffer[0] = '#';
+	_itoa(pSymbol->wOrdinal, lpBuffer + 1, 10);
+	return lpBuffer;
+}
+
+PK22_ATOM K22SymbolRefAtom(PK22_SYMBOL_REF pSymbol) {
+	// find the atom of the symbol name ("#<ordinal>" for ordinals); NULL if no rule uses it
+	if (pSymbol->lpName != NULL)
+		return K22AtomFindHash(pSymbol->lpName, pSymbol->cchName, pSymbol->dwHash);
+	// ordinals are rarely used in rules - format them only when needed
+	CHAR szSymbol[8];
+	K22SymbolRefString(pSymbol, szSymbol);
+	return K22AtomFind(szSymbol, strlen(szSymbol));
+}
+
 PVOID K22ResolveSymbol(LPCSTR lpCallerName, LPCSTR lpModuleName, LPCSTR lpSymbolName) {
-	LPCSTR lpModuleNameOrig = lpModuleName;
-	LPCSTR lpSymbolNameOrig = lpSymbolName;
-	LPCSTR lpErrorName		= NULL;
+	K22_SYMBOL_REF stSymbol;
+	K22SymbolRefParse(&stSymbol, lpSymbolName);
+	return K22ResolveSymbolEx(lpCallerName, lpModuleName, &stSymbol);
+}
+
+PVOID K22ResolveSymbolEx(LPCSTR lpCallerName, LPCSTR lpModuleName, PK22_SYMBOL_REF pSymbol) {
+	K22_DLL_ROUTE stRoute;
+	K22ResolveRoute(lpModuleName, pSymbol, &stRoute);
+	return K22ResolveRouteSymbol(lpCallerName, &stRoute, pSymbol);
+}
+
+VOID K22ResolveRouteRules(
+	PK22_DLL_RULES pDll,
+	LPCSTR lpModuleName,
+	PK22_SYMBOL_REF pSymbol,
+	PK22_DLL_ROUTE pRoute
+) {
+	pRoute->pDll			 = pDll;
+	pRoute->lpModuleNameOrig = lpModuleName;
+	pRoute->pModule			 = NULL;
+	pRoute->ppModule		 = &pRoute->pModule;
+	pRoute->pDllRewrite		 = NULL;
+	pRoute->fPerSymbol		 = FALSE;
 
-	HINSTANCE hModule	= NULL;
-	PVOID pProc			= NULL;
-	HINSTANCE *ppModule = &hModule;
-	PVOID *ppProc		= &pProc;
+	if (pSymbol == NULL) {
+		PK22_DLL_API_SET pDllApiSetGroup = K22FindDllApiSetGroup(pDll, lpModuleName);
+		if (pDllApiSetGroup != NULL && pDllApiSetGroup->fGroupSymbols) {
+			// symbol-specific ApiSet entries - each symbol must be routed separately
+			pRoute->lpModuleName = lpModuleName;
+			pRoute->fPerSymbol	 = TRUE;
+			return;
+		}
+	}
 
-	PK22_DLL_API_SET pDllApiSet = K22FindDllApiSet(lpModuleName, lpSymbolName);
+	PK22_DLL_API_SET pDllApiSet = K22FindDllApiSet(pDll, lpModuleName, pSymbol);
 	if (pDllApiSet != NULL) {
 		// apply DLL ApiSet redirect entry first
-		lpModuleName = pDllApiSet->lpTargetDll;
-		ppModule	 = &pDllApiSet->hModule; // cache module handle in redirect entry
+		lpModuleName	 = pDllApiSet->lpTargetDll;
+		pRoute->ppModule = &pDllApiSet->pModule; // cache module in redirect entry
 	}
 
-	PK22_DLL_REDIRECT pDllRedirect = K22FindDllRedirect(lpModuleName);
-	if (pDllRedirect != NULL) {
-		// then apply other DLL redirect entries
-		lpModuleName = pDllRedirect->lpTargetDll;
-		ppModule	 = &pDllRedirect->hModule; // cache module handle in redirect entry
+	PK22_DLL_ROUTE_ENTRY pRouteEntry = K22FindDllRoute(pDll, lpModuleName);
+	if (pRouteEntry != NULL && pRouteEntry->lpTargetDll != NULL) {
+		// then apply other DLL redirect entries (collapsed when compiling the routes)
+		lpModuleName	 = pRouteEntry->lpTargetDll;
+		pRoute->ppModule = pRouteEntry->ppModule; // cache module in redirect entry
 	}
 
-	PK22_DLL_REWRITE pDllRewrite = K22FindDllRewrite(lpModuleName);
+	pRoute->lpModuleName = lpModuleName;
+	pRoute->pDllRewrite	 = pRouteEntry != NULL ? pRouteEntry->pDllRewrite : NULL;
+}
+
+VOID K22ResolveRoute(LPCSTR lpModuleName, PK22_SYMBOL_REF pSymbol, PK22_DLL_ROUTE pRoute) {
+	// apply all module-level rules to lpModuleName
+	// pSymbol can be NULL to find a route for all symbols of the module (i.e. import descriptor)
+	// the rules may be replaced meanwhile (see k22_data_watch.c) - the whole route uses the ones loaded here
+	K22ResolveRouteRules(pK22Data->pDll, lpModuleName, pSymbol, pRoute);
+}
+
+PVOID K22ResolveRouteSymbol(LPCSTR lpCallerName, PK22_DLL_ROUTE pRoute, PK22_SYMBOL_REF pSymbol) {
+	if (pRoute->fPerSymbol) {
+		// same rules as the module's route
+		K22_DLL_ROUTE stRoute;
+		K22ResolveRouteRules(pRoute->pDll, pRoute->lpModuleNameOrig, pSymbol, &stRoute);
+		return K22ResolveRouteSymbol(lpCallerName, &stRoute, pSymbol);
+	}
+
+	LPCSTR lpModuleName			= pRoute->lpModuleName;
+	LPCSTR lpModuleNameOrig		= pRoute->lpModuleNameOrig;
+	PK22_SYMBOL_REF pSymbolOrig = pSymbol;
+	LPCSTR lpErrorName			= NULL;
+	CHAR szSymbolOrig[1 + 5 + 1], szSymbol[1 + 5 + 1]; // printable ordinals, for errors
+
+	K22_MODULE_CACHE pModule		 = NULL;
+	PVOID pProc						 = NULL;
+	PK22_MODULE_CACHE ppModule		 = pRoute->ppModule;
+	PK22_PROC_CACHE volatile *ppProc = NULL;
+
+	PK22_DLL_REWRITE pDllRewrite = pRoute->pDllRewrite;
 	if (pDllRewrite == NULL) {
 		// no DLL rewrite entry - nothing else to do
-		if (K22LoadAndResolve(
-				lpCallerName,
-				lpModuleName,
-				ppModule,
-				lpSymbolName,
-				ppProc,
-				lpModuleNameOrig,
-				lpSymbolNameOrig,
-				&lpErrorName
-			))
-			return *ppProc;
+		pProc = K22LoadAndResolve(
+			lpCallerName,
+			lpModuleName,
+			ppModule,
+			pSymbol,
+			ppProc,
+			lpModuleNameOrig,
+			pSymbolOrig,
+			&lpErrorName
+		);
+		if (pProc != NULL)
+			return pProc;
 		goto Error;
 	}
 
-	PK22_DLL_REWRITE_SYMBOL pDllRewriteSymbol = K22FindDllRewriteSymbol(pDllRewrite, lpSymbolName);
+	PK22_DLL_REWRITE_SYMBOL pDllRewriteSymbol = K22FindDllRewriteSymbol(pDllRewrite, pSymbol);
 	if (pDllRewriteSymbol != NULL) {
 		// got DLL rewrite symbol entry
-		// return if already cached
-		if (pDllRewriteSymbol->pProc)
-			return pDllRewriteSymbol->pProc;
-		// otherwise load and resolve
+		// load and resolve, unless already cached
 		lpModuleName = pDllRewriteSymbol->lpTargetDll;
-		lpSymbolName = pDllRewriteSymbol->lpTargetSymbol;
-		ppModule	 = &hModule;				  // nowhere to cache the module handle in
-		ppProc		 = &pDllRewriteSymbol->pProc; // only cache the procedure address
+		pSymbol		 = &pDllRewriteSymbol->stTarget;
+		ppModule	 = &pModule;					   // nowhere to cache the module in
+		ppProc		 = &pDllRewriteSymbol->pProcCache; // only cache the procedure address
 		// this must resolve
-		if (K22LoadAndResolve(
-				lpCallerName,
-				lpModuleName,
-				ppModule,
-				lpSymbolName,
-				ppProc,
-				lpModuleNameOrig,
-				lpSymbolNameOrig,
-				&lpErrorName
-			))
-			return *ppProc;
+		pProc = K22LoadAndResolve(
+			lpCallerName,
+			lpModuleName,
+			ppModule,
+			pSymbol,
+			ppProc,
+			lpModuleNameOrig,
+			pSymbolOrig,
+			&lpErrorName
+		);
+		if (pProc != NULL)
+			return pProc;
 		goto Error;
 	}
 
 	// procedure not found so far - use Catch-All if set
 	if (pDllRewrite->lpCatchAllDll != NULL) {
 		// only return if valid procedure was found; also cache the module handle
-		if (K22LoadAndResolve(
-				lpCallerName,
-				pDllRewrite->lpCatchAllDll,
-				&pDllRewrite->hCatchAll,
-				lpSymbolName,
-				ppProc,
-				lpModuleNameOrig,
-				lpSymbolNameOrig,
-				&lpErrorName
-			))
-			return *ppProc;
-	}
-
-	// try importing normally; will only cache in DLL redirect entry
-	if (K22LoadAndResolve(
+		pProc = K22LoadAndResolve(
 			lpCallerName,
-			lpModuleName,
-			ppModule,
-			lpSymbolName,
+			pDllRewrite->lpCatchAllDll,
+			&pDllRewrite->pCatchAll,
+			pSymbol,
 			ppProc,
 			lpModuleNameOrig,
-			lpSymbolNameOrig,
+			pSymbolOrig,
 			&lpErrorName
-		))
-		return *ppProc;
+		);
+		if (pProc != NULL)
+			return pProc;
+	}
+
+	// try importing normally; will only cache in DLL redirect entry
+	pProc = K22LoadAndResolve(
+		lpCallerName,
+		lpModuleName,
+		ppModule,
+		pSymbol,
+		ppProc,
+		lpModuleNameOrig,
+		pSymbolOrig,
+		&lpErrorName
+	);
+	if (pProc != NULL)
+		return pProc;
 
 	// procedure still not found - use Default if set
 	if (pDllRewrite->lpDefaultDll != NULL) {
 		// only return if valid procedure was found; also cache the module handle
-		if (K22LoadAndResolve(
-				lpCallerName,
-				pDllRewrite->lpDefaultDll,
-				&pDllRewrite->hDefault,
-				lpSymbolName,
-				ppProc,
-				lpModuleNameOrig,
-				lpSymbolNameOrig,
-				&lpErrorName
-			))
-			return *ppProc;
+		pProc = K22LoadAndResolve(
+			lpCallerName,
+			pDllRewrite->lpDefaultDll,
+			&pDllRewrite->pDefault,
+			pSymbol,
+			ppProc,
+			lpModuleNameOrig,
+			pSymbolOrig,
+			&lpErrorName
+		);
+		if (pProc != NULL)
+			return pProc;
 	}
 
 	// nothing works
@@ -227,104 +339,146 @@ Error:
 		lpErrorName,
 		lpCallerName,
 		lpModuleNameOrig,
-		lpSymbolNameOrig,
+		K22SymbolRefString(pSymbolOrig, szSymbolOrig),
 		lpModuleName,
-		lpSymbolName
+		K22SymbolRefString(pSymbol, szSymbol)
 	);
 	return NULL;
 }
 
+PK22_MODULE_DATA K22ResolveRouteModule(LPCSTR lpCallerName, PK22_DLL_ROUTE pRoute) {
+	// load the module of a route, for looking up its symbols directly
+	// NULL if the route can't be resolved per-module, or if loading fails (K22ResolveRouteSymbol() will report it)
+	if (pRoute->fPerSymbol || pRoute->pDllRewrite != NULL)
+		return NULL;
+	LPCSTR lpErrorName = NULL;
+	HINSTANCE hModule  = K22LoadAndResolve(
+		lpCallerName,
+		pRoute->lpModuleName,
+		pRoute->ppModule,
+		NULL,
+		NULL,
+		pRoute->lpModuleNameOrig,
+		NULL,
+		&lpErrorName
+	);
+	if (hModule == NULL)
+		return NULL;
+	return K22DataGetModule(hModule);
+}
+
 static PVOID K22LoadAndResolve(
 	LPCSTR lpCallerName,
 	LPCSTR lpModuleName,
-	HINSTANCE *ppModule,
-	LPCSTR lpSymbolName,
-	PVOID *ppProc,
+	PK22_MODULE_CACHE ppModule,
+	PK22_SYMBOL_REF pSymbol,
+	PK22_PROC_CACHE volatile *ppProc,
 	LPCSTR lpModuleNameOrig,
-	LPCSTR lpSymbolNameOrig,
+	PK22_SYMBOL_REF pSymbolOrig,
 	LPCSTR *ppErrorName
 ) {
-	if (ppProc != NULL && *ppProc != NULL)
-		return *ppProc;
+	// ppModule and ppProc point to caches shared by all threads (ppProc is NULL if not caching the procedure)
+	PVOID pProc = ppProc != NULL ? K22CacheGetProc(ppProc) : NULL;
+	if (pProc != NULL)
+		return pProc;
 
-	LPCSTR lpModulePath = lpModuleName;
-	if (*ppModule == NULL) {
-		// resolve full module path, check if loaded already
-		lpModulePath = K22ResolveModulePath(lpModuleName, ppModule);
-		if (lpModulePath == NULL) {
-			*ppErrorName = "Module not found";
-			return NULL;
-		}
-	}
-	if (*ppModule == NULL) {
-		// otherwise load it by full path
-		ANSI_STRING stModuleNameAnsi = {
-			.Length		   = strlen(lpModuleName),
-			.MaximumLength = 0,
-			.Buffer		   = (LPSTR)lpModuleName,
+	PK22_MODULE_DATA pK22ModuleData = K22CacheGetModule(ppModule);
+	if (pK22ModuleData == NULL) {
+		// convert the name once - paths and the loader only use Unicode
+		WCHAR szModuleName[MAX_PATH];
+		UNICODE_STRING stModuleName = {
+			.Length		   = 0,
+			.MaximumLength = sizeof(szModuleName),
+			.Buffer		   = szModuleName,
 		};
-		UNICODE_STRING stModuleName;
-		if (!NT_SUCCESS(RtlAnsiStringToUnicodeString(&stModuleName, &stModuleNameAnsi, TRUE))) {
-			*ppErrorName = "String alloc failed";
-			return NULL;
-		}
-		NTSTATUS ntStatus = K22RealLdrLoadDll(NULL, 0, &stModuleName, (PVOID *)ppModule);
-		RtlFreeUnicodeString(&stModuleName);
-		if (!NT_SUCCESS(ntStatus)) {
-			*ppErrorName = "Module load failed";
+		if (!K22StringToUnicode(lpModuleName, &stModuleName)) {
+			*ppErrorName = "Module name too long";
 			return NULL;
 		}
-		if (*ppModule == NULL) {
-			*ppErrorName = "Module is NULL";
+		// resolve full module path, check if loaded already
+		HINSTANCE hModule = NULL;
+		WCHAR szModulePath[MAX_PATH];
+		UNICODE_STRING stModulePath = {
+			.Length		   = 0,
+			.MaximumLength = sizeof(szModulePath),
+			.Buffer		   = szModulePath,
+		};
+		if (!K22ResolveModulePath(lpModuleName, &stModuleName, &stModulePath, &hModule)) {
+			*ppErrorName = "Module not found";
 			return NULL;
 		}
-		PK22_MODULE_DATA pK22ModuleData = K22DataGetModule(*ppModule);
-		if (pK22ModuleData->fDllNotificationFailed) {
-			*ppErrorName = "Module load failed in DLL notification";
-			return NULL;
+		if (hModule == NULL) {
+			// otherwise load it
+			NTSTATUS ntStatus = K22RealLdrLoadDll(NULL, 0, &stModuleName, (PVOID *)&hModule);
+			if (!NT_SUCCESS(ntStatus)) {
+				*ppErrorName = "Module load failed";
+				return NULL;
+			}
+			if (hModule == NULL) {
+				*ppErrorName = "Module is NULL";
+				return NULL;
+			}
+			pK22ModuleData = K22DataGetModule(hModule);
+			if (pK22ModuleData->fDllNotificationFailed) {
+				*ppErrorName = "Module load failed in DLL notification";
+				return NULL;
+			}
+		} else {
+			pK22ModuleData = K22DataGetModule(hModule);
 		}
+		// publish the module for other callers
+		K22CacheSetModule(ppModule, pK22ModuleData);
 	}
 
-	// module handle is already loaded
+	// module is already loaded
 	// return if no symbol to find
-	if (lpSymbolName == NULL)
-		return *ppModule;
+	HINSTANCE hModule = pK22ModuleData->lpModuleBase;
+	if (pSymbol == NULL)
+		return hModule;
 
 	// otherwise find the procedure by ordinal or name
-	if (lpSymbolName[0] == '#') {
-		ULONG_PTR ulOrdinal = strtol(lpSymbolName + 1, NULL, 10);
-		if (!NT_SUCCESS(K22RealLdrGetProcedureAddress(*ppModule, NULL, ulOrdinal, ppProc))) {
+	// the export table is parsed directly; forwarders are left to ntdll
+	if (pSymbol->lpName == NULL) {
+		pProc = K22ExportFindByOrdinal(pK22ModuleData, pSymbol->wOrdinal);
+		if (pProc == NULL && !NT_SUCCESS(K22RealLdrGetProcedureAddress(hModule, NULL, pSymbol->wOrdinal, &pProc))) {
 			*ppErrorName = "Ordinal not found";
 			return NULL;
 		}
 	} else {
-		ANSI_STRING stSymbolName = {
-			.Length		   = strlen(lpSymbolName),
-			.MaximumLength = 0,
-			.Buffer		   = (LPSTR)lpSymbolName,
-		};
-		if (!NT_SUCCESS(K22RealLdrGetProcedureAddress(*ppModule, &stSymbolName, 0, ppProc))) {
-			*ppErrorName = "Symbol not found";
-			return NULL;
+		// the hint is only valid for the originally imported symbol name
+		pProc = K22ExportFindByName(pK22ModuleData, pSymbol->lpName, pSymbol == pSymbolOrig ? pSymbol->wHint : 0);
+		if (pProc == NULL) {
+			ANSI_STRING stSymbolName = {
+				.Length		   = pSymbol->cchName,
+				.MaximumLength = 0,
+				.Buffer		   = (LPSTR)pSymbol->lpName,
+			};
+			if (!NT_SUCCESS(K22RealLdrGetProcedureAddress(hModule, &stSymbolName, 0, &pProc))) {
+				*ppErrorName = "Symbol not found";
+				return NULL;
+			}
 		}
 	}
 
-	PVOID pProc = *ppProc;
 	if (pProc == NULL) {
 		*ppErrorName = "Procedure not found";
 		return NULL;
 	}
+	if (ppProc != NULL)
+		K22CacheSetProc(ppProc, pProc, pK22ModuleData);
 
-	if (pK22Data->stConfig.bDebugImportResolver)
+	if (pK22Data->stConfig.bDebugImportResolver) {
+		CHAR szSymbolOrig[1 + 5 + 1], szSymbol[1 + 5 + 1];
 		K22_I(
 			"Resolved - %s -> %s!%s -> %s!%s -> %p",
 			lpCallerName,
 			lpModuleNameOrig,
-			lpSymbolNameOrig,
+			K22SymbolRefString(pSymbolOrig, szSymbolOrig),
 			lpModuleName,
-			lpSymbolName,
+			K22SymbolRefString(pSymbol, szSymbol),
 			pProc
 		);
+	}
 
 	*ppErrorName = NULL;
 	return pProc;
@@ -0,0 +1,226 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-11.
+
+#include "kernel22.h"
+
+// Snapshots of the standard DLL search directories, used by K22ResolveModulePath().
+// Each directory is listed once, module names are then looked up in memory instead of probing the filesystem.
+// Names that couldn't be found anywhere (including PATH) are remembered, too.
+// Directory paths are kept in Unicode, so that directories with non-ANSI names work, too.
+
+#define K22_SEARCH_DIR_PROCESS 0
+#define K22_SEARCH_DIR_SYSTEM  1
+#define K22_SEARCH_DIR_WINDOWS 2
+#define K22_SEARCH_DIR_CURRENT 3
+#define K22_SEARCH_DIR_COUNT   4
+
+static PK22_SEARCH_NAME K22SearchFindName(PK22_SEARCH_NAME pNames, LPCSTR lpName) {
+	CHAR szKey[MAX_PATH];
+	DWORD cchKey = K22StringLower(lpName, szKey, sizeof(szKey));
+	if (cchKey == 0)
+		return NULL;
+	PK22_SEARCH_NAME pName;
+	HASH_FIND(hh, pNames, szKey, cchKey, pName);
+	return pName;
+}
+
+static BOOL K22SearchAddName(PK22_SEARCH_NAME *ppNames, LPCSTR lpName) {
+	CHAR szKey[MAX_PATH];
+	DWORD cchKey = K22StringLower(lpName, szKey, sizeof(szKey));
+	if (cchKey == 0)
+		return TRUE;
+	PK22_SEARCH_NAME pName;
+	HASH_FIND(hh, *ppNames, szKey, cchKey, pName);
+	if (pName != NULL)
+		return TRUE;
+	K22_MALLOC_LENGTH(pName, sizeof(*pName) + cchKey + 1);
+	memcpy(pName->szName, szKey, cchKey + 1);
+	HASH_ADD(hh, *ppNames, szName, cchKey, pName);
+	return TRUE;
+}
+
+static VOID K22SearchFreeNames(PK22_SEARCH_NAME *ppNames) {
+	PK22_SEARCH_NAME pName, pTmp;
+	HASH_ITER(hh, *ppNames, pName, pTmp) {
+		HASH_DEL(*ppNames, pName);
+		K22_FREE(pName);
+	}
+}
+
+static BOOL K22SearchListDirectory(DWORD dwDir) {
+	WCHAR szPath[MAX_PATH + 2];
+	DWORD cchPath = 0;
+
+	if (pK22Data->stSearch.stDir[dwDir].lpPath == NULL) {
+		switch (dwDir) {
+			case K22_SEARCH_DIR_PROCESS:
+				cchPath = GetModuleFileNameW(NULL, szPath, MAX_PATH);
+				if (cchPath != 0 && cchPath < MAX_PATH)
+					cchPath = wcsrchr(szPath, L'\\') - szPath;
+				break;
+			case K22_SEARCH_DIR_SYSTEM:
+				cchPath = GetSystemDirectoryW(szPath, MAX_PATH);
+				break;
+			case K22_SEARCH_DIR_WINDOWS:
+				cchPath = GetWindowsDirectoryW(szPath, MAX_PATH);
+				break;
+			case K22_SEARCH_DIR_CURRENT:
+				cchPath = GetCurrentDirectoryW(MAX_PATH, szPath);
+				break;
+		}
+		if (cchPath == 0 || cchPath >= MAX_PATH)
+			RETURN_K22_E("Couldn't get search directory #%lu", dwDir);
+		if (szPath[cchPath - 1] == L'\\')
+			cchPath--;
+		szPath[cchPath] = L'\0';
+		// freed when flushing the directory - don't use the arena
+		if ((pK22Data->stSearch.stDir[dwDir].lpPath = _wcsdup(szPath)) == NULL)
+			RETURN_K22_F_ERR("Couldn't allocate memory for search directory #%lu", dwDir);
+	} else {
+		cchPath = wcslen(pK22Data->stSearch.stDir[dwDir].lpPath);
+		wcscpy(szPath, pK22Data->stSearch.stDir[dwDir].lpPath);
+	}
+
+	// list all files in the directory
+	wcscpy(szPath + cchPath, L"\\*");
+	WIN32_FIND_DATAW stFindData;
+	HANDLE hFind =
+		FindFirstFileExW(szPath, FindExInfoBasic, &stFindData, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+	if (hFind != INVALID_HANDLE_VALUE) {
+		do {
+			if (stFindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				continue;
+			// module names are ANSI - files that can't be named in ANSI can't be imported anyway
+			CHAR szFileName[MAX_PATH];
+			BOOL bUsedDefault = FALSE;
+			if (WideCharToMultiByte(
+					CP_ACP,
+					WC_NO_BEST_FIT_CHARS,
+					stFindData.cFileName,
+					-1,
+					szFileName,
+					sizeof(szFileName),
+					NULL,
+					&bUsedDefault
+				) == 0 ||
+				bUsedDefault)
+				continue;
+			if (!K22SearchAddName(&pK22Data->stSearch.stDir[dwDir].pNames, szFileName)) {
+				FindClose(hFind);
+				return FALSE;
+			}
+		} while (FindNextFileW(hFind, &stFindData));
+		FindClose(hFind);
+	}
+
+	K22_D(
+		"Listed search directory %ls - %lu files",
+		pK22Data->stSearch.stDir[dwDir].lpPath,
+		HASH_COUNT(pK22Data->stSearch.stDir[dwDir].pNames)
+	);
+	pK22Data->stSearch.stDir[dwDir].fListed = TRUE;
+	return TRUE;
+}
+
+BOOL K22SearchFind(LPCSTR lpModuleName, PCUNICODE_STRING pModuleName, PUNICODE_STRING pModulePath) {
+	// find lpModuleName in the process, system, Windows and current directories (in this order)
+	// write the full path to pModulePath if found (pModuleName is the same name in Unicode)
+	BOOL bFound		   = FALSE;
+	BOOL bHasDirectory = strchr(lpModuleName, '\\') != NULL || strchr(lpModuleName, '/') != NULL;
+
+	AcquireSRWLockExclusive(&pK22Data->stSearch.stLock);
+	for (DWORD dwDir = 0; dwDir < K22_SEARCH_DIR_COUNT && !bFound; dwDir++) {
+		if (!pK22Data->stSearch.stDir[dwDir].fListed && !K22SearchListDirectory(dwDir))
+			continue;
+		// names without a directory must be in the snapshot
+		if (!bHasDirectory && K22SearchFindName(pK22Data->stSearch.stDir[dwDir].pNames, lpModuleName) == NULL)
+			continue;
+		pModulePath->Length = 0;
+		if (!NT_SUCCESS(RtlAppendUnicodeToString(pModulePath, pK22Data->stSearch.stDir[dwDir].lpPath)) ||
+			!NT_SUCCESS(RtlAppendUnicodeToString(pModulePath, L"\\")) ||
+			!NT_SUCCESS(RtlAppendUnicodeStringToString(pModulePath, pModuleName)))
+			continue;
+		// names with a directory can't be found in the snapshot - check the filesystem
+		bFound = !bHasDirectory || K22PathIsFileW(pModulePath);
+	}
+	ReleaseSRWLockExclusive(&pK22Data->stSearch.stLock);
+	return bFound;
+}
+
+BOOL K22SearchIsMissing(LPCSTR lpModuleName) {
+	AcquireSRWLockShared(&pK22Data->stSearch.stLock);
+	BOOL bMissing = K22SearchFindName(pK22Data->stSearch.pMissing, lpModuleName) != NULL;
+	ReleaseSRWLockShared(&pK22Data->stSearch.stLock);
+	return bMissing;
+}
+
+VOID K22SearchSetMissing(LPCSTR lpModuleName) {
+	AcquireSRWLockExclusive(&pK22Data->stSearch.stLock);
+	K22SearchAddName(&pK22Data->stSearch.pMissing, lpModuleName);
+	ReleaseSRWLockExclusive(&pK22Data->stSearch.stLock);
+}
+
+static VOID K22SearchFlushDirectory(DWORD dwDir) {
+	// forget the directory contents and its path
+	K22SearchFreeNames(&pK22Data->stSearch.stDir[dwDir].pNames);
+	K22_FREE(pK22Data->stSearch.stDir[dwDir].lpPath);
+	pK22Data->stSearch.stDir[dwDir].lpPath	= NULL;
+	pK22Data->stSearch.stDir[dwDir].fListed = FALSE;
+}
+
+static VOID K22SearchFlushCurrentDirectory() {
+	// current directory changed - missing names might be found there now
+	AcquireSRWLockExclusive(&pK22Data->stSearch.stLock);
+	K22SearchFlushDirectory(K22_SEARCH_DIR_CURRENT);
+	K22SearchFreeNames(&pK22Data->stSearch.pMissing);
+	ReleaseSRWLockExclusive(&pK22Data->stSearch.stLock);
+}
+
+VOID K22SearchFlush() {
+	AcquireSRWLockExclusive(&pK22Data->stSearch.stLock);
+	for (DWORD dwDir = 0; dwDir < K22_SEARCH_DIR_COUNT; dwDir++) {
+		K22SearchFlushDirectory(dwDir);
+	}
+	K22SearchFreeNames(&pK22Data->stSearch.pMissing);
+	ReleaseSRWLockExclusive(&pK22Data->stSearch.stLock);
+	K22_D("Search cache flushed");
+}
+
+K22_HOOK_PROC(BOOL, SetCurrentDirectoryA, (LPCSTR lpPathName)) {
+	BOOL bRet = RealSetCurrentDirectoryA(lpPathName);
+	K22SearchFlushCurrentDirectory();
+	return bRet;
+}
+
+K22_HOOK_PROC(BOOL, SetCurrentDirectoryW, (LPCWSTR lpPathName)) {
+	BOOL bRet = RealSetCurrentDirectoryW(lpPathName);
+	K22SearchFlushCurrentDirectory();
+	return bRet;
+}
+
+K22_HOOK_PROC(BOOL, SetDllDirectoryA, (LPCSTR lpPathName)) {
+	BOOL bRet = RealSetDllDirectoryA(lpPathName);
+	K22SearchFlush();
+	return bRet;
+}
+
+K22_HOOK_PROC(BOOL, SetDllDirectoryW, (LPCWSTR lpPathName)) {
+	BOOL bRet = RealSetDllDirectoryW(lpPathName);
+	K22SearchFlush();
+	return bRet;
+}
+
+BOOL K22SearchHookCreate() {
+	K22_HOOK_CREATE(SetCurrentDirectoryA);
+	K22_HOOK_CREATE(SetCurrentDirectoryW);
+	K22_HOOK_CREATE(SetDllDirectoryA);
+	K22_HOOK_CREATE(SetDllDirectoryW);
+	return TRUE;
+}
+
+BOOL K22SearchHookRemove() {
+	K22_HOOK_REMOVE(SetCurrentDirectoryA);
+	K22_HOOK_REMOVE(SetCurrentDirectoryW);
+	K22_HOOK_REMOVE(SetDllDirectoryA);
+	K22_HOOK_REMOVE(SetDllDirectoryW);
+	return TRUE;
+}
@@ -0,0 +1,146 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-20.
+
+#include "k22_ini.h"
+
+// Configuration file parser - an INI-style alternative to the registry keys (see k22_data_config.c).
+// K22IniParse() reads the file once, checking the syntax of every line and recording where each section starts and
+// ends. Readers then only walk the lines of the sections they need (K22IniReadSection(), K22IniRead()).
+// No Windows headers are needed - this is also built natively on other hosts (see test/k22_test_ini_parse.c).
+
+#define K22_INI_LINE_END	 0 // end of the file or section
+#define K22_INI_LINE_SKIP	 1 // empty line or comment
+#define K22_INI_LINE_SECTION 2 // section header
+#define K22_INI_LINE_VALUE	 3 // "name=value"
+#define K22_INI_LINE_ERROR	 4 // anything else
+
+static VOID K22IniTrim(PK22_STRING_VIEW pView) {
+	while (pView->cchData != 0 && (pView->lpData[0] == ' ' || pView->lpData[0] == '\t')) {
+		pView->lpData++;
+		pView->cchData--;
+	}
+	while (pView->cchData != 0) {
+		CHAR cLast = pView->lpData[pView->cchData - 1];
+		if (cLast != ' ' && cLast != '\t' && cLast != '\r')
+			break;
+		pView->cchData--;
+	}
+}
+
+static DWORD K22IniReadLine(PK22_INI_READER pReader, PK22_STRING_VIEW pName, PK22_STRING_VIEW pValue) {
+	// read the next line and return its type; pName is the section name of a header
+	// comments start with ';' or '#'
+	if (pReader->lpNext >= pReader->lpEnd)
+		return K22_INI_LINE_END;
+	LPCSTR lpLine = pReader->lpNext;
+	LPCSTR lpEol  = memchr(lpLine, '\n', pReader->lpEnd - lpLine);
+	if (lpEol == NULL)
+		lpEol = pReader->lpEnd;
+	pReader->lpNext = lpEol < pReader->lpEnd ? lpEol + 1 : lpEol;
+	pReader->dwLine++;
+
+	K22_STRING_VIEW stLine = {.lpData = lpLine, .cchData = (DWORD)(lpEol - lpLine)};
+	K22IniTrim(&stLine);
+	if (stLine.cchData == 0 || stLine.lpData[0] == ';' || stLine.lpData[0] == '#')
+		return K22_INI_LINE_SKIP;
+	if (stLine.lpData[0] == '[') {
+		if (stLine.cchData < 2 || stLine.lpData[stLine.cchData - 1] != ']')
+			return K22_INI_LINE_ERROR;
+		pName->lpData  = stLine.lpData + 1;
+		pName->cchData = stLine.cchData - 2;
+		K22IniTrim(pName);
+		return K22_INI_LINE_SECTION;
+	}
+
+	LPCSTR lpEquals = memchr(stLine.lpData, '=', stLine.cchData);
+	if (lpEquals == NULL)
+		return K22_INI_LINE_ERROR;
+	pName->lpData	= stLine.lpData;
+	pName->cchData	= (DWORD)(lpEquals - stLine.lpData);
+	pValue->lpData	= lpEquals + 1;
+	pValue->cchData = (DWORD)(stLine.lpData + stLine.cchData - pValue->lpData);
+	K22IniTrim(pName);
+	K22IniTrim(pValue);
+	// values can be quoted, to keep leading or trailing spaces
+	if (pValue->cchData >= 2 && pValue->lpData[0] == '"' && pValue->lpData[pValue->cchData - 1] == '"') {
+		pValue->lpData++;
+		pValue->cchData -= 2;
+	}
+	return K22_INI_LINE_VALUE;
+}
+
+BOOL K22IniParse(PK22_INI_FILE pFile, LPCSTR lpData, SIZE_T cbData, PVOID (*pAlloc)(SIZE_T)) {
+	// index the sections of the file, in a single pass; FALSE if pAlloc fails
+	// section entries are allocated with pAlloc, and never freed by the parser
+	memset(pFile, 0, sizeof(*pFile));
+	// skip the UTF-8 BOM
+	if (cbData >= 3 && memcmp(lpData, "\xEF\xBB\xBF", 3) == 0) {
+		lpData += 3;
+		cbData -= 3;
+	}
+
+	K22_INI_READER stReader	  = {.lpNext = lpData, .lpEnd = lpData + cbData, .dwLine = 0};
+	PK22_INI_SECTION *ppNext  = &pFile->pSections;
+	PK22_INI_SECTION pSection = NULL;
+	K22_STRING_VIEW stName	  = {0};
+	K22_STRING_VIEW stValue	  = {0};
+	while (TRUE) {
+		LPCSTR lpLine = stReader.lpNext;
+		DWORD dwType  = K22IniReadLine(&stReader, &stName, &stValue);
+		if (dwType == K22_INI_LINE_END) {
+			if (pSection != NULL)
+				pSection->lpEnd = lpLine;
+			break;
+		}
+		if (dwType == K22_INI_LINE_ERROR) {
+			if (pFile->dwErrors++ == 0)
+				pFile->dwErrorLine = stReader.dwLine;
+			continue;
+		}
+		if (dwType == K22_INI_LINE_VALUE) {
+			pFile->dwValues++;
+			// values before the first header get a section without a name
+			if (pSection != NULL)
+				continue;
+			stName.lpData  = lpData;
+			stName.cchData = 0;
+		} else if (dwType != K22_INI_LINE_SECTION) {
+			continue;
+		}
+
+		if (pSection != NULL)
+			pSection->lpEnd = lpLine;
+		pSection = pAlloc(sizeof(*pSection));
+		if (pSection == NULL)
+			return FALSE;
+		pSection->stName  = stName;
+		pSection->lpStart = dwType == K22_INI_LINE_SECTION ? stReader.lpNext : lpData;
+		pSection->lpEnd	  = stReader.lpEnd;
+		pSection->dwLine  = dwType == K22_INI_LINE_SECTION ? stReader.dwLine : 0;
+		pSection->pNext	  = NULL;
+		*ppNext			  = pSection;
+		ppNext			  = &pSection->pNext;
+		pFile->dwSections++;
+	}
+	pFile->dwLines = stReader.dwLine;
+	return TRUE;
+}
+
+VOID K22IniReadSection(PK22_INI_READER pReader, PK22_INI_SECTION pSection) {
+	// start reading the lines of a section
+	pReader->lpNext = pSection->lpStart;
+	pReader->lpEnd	= pSection->lpEnd;
+	pReader->dwLine = pSection->dwLine;
+}
+
+BOOL K22IniRead(PK22_INI_READER pReader, PK22_STRING_VIEW pName, PK22_STRING_VIEW pValue) {
+	// read the next "name=value" line of the section; FALSE at its end
+	// invalid lines are skipped - K22IniParse() counts them already
+	while (TRUE) {
+		switch (K22IniReadLine(pReader, pName, pValue)) {
+			case K22_INI_LINE_END:
+				return FALSE;
+			case K22_INI_LINE_VALUE:
+				return TRUE;
+		}
+	}
+}
@@ -0,0 +1,151 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-19.
+
+#include "k22_pe_export.h"
+
+// Export table parser, used instead of LdrGetProcedureAddress() for most symbols (see k22_dll_export.c).
+// This only reads the PE structures of an image laid out in memory (sections at their RVAs) - no system calls,
+// no Windows headers. It's built into the core, and natively on other hosts for tests and benchmarks.
+
+#define K22_PE_RVA(dwRva) ((LPCVOID)((ULONG_PTR)(lpImageBase) + (dwRva)))
+
+static BOOL K22PeIsRangeValid(PK22_PE_EXPORTS pExports, DWORD dwRva, DWORD cbSize) {
+	return dwRva < pExports->dwSizeOfImage && cbSize <= pExports->dwSizeOfImage - dwRva;
+}
+
+BOOL K22PeExportParse(LPCVOID lpImageBase, PK22_PE_EXPORTS pExports) {
+	// parse the export directory once; returns FALSE if the image has no (valid) exports
+	// pExports must be zero-filled initially - it may be parsed by two threads at once, writing the same values;
+	// fParsed is published last, so that threads seeing it set also see the tables
+	if (K22_LOAD_ACQUIRE(&pExports->fParsed))
+		return pExports->pFunctions != NULL;
+
+	const IMAGE_DOS_HEADER *pDosHeader = lpImageBase;
+	if (pDosHeader->e_magic != IMAGE_DOS_SIGNATURE || pDosHeader->e_lfanew <= 0)
+		goto End;
+	const IMAGE_NT_HEADERS32 *pNt32 = K22_PE_RVA(pDosHeader->e_lfanew);
+	const IMAGE_NT_HEADERS64 *pNt64 = K22_PE_RVA(pDosHeader->e_lfanew);
+	if (pNt32->Signature != IMAGE_NT_SIGNATURE)
+		goto End;
+
+	const IMAGE_DATA_DIRECTORY *pDataDirectory;
+	if (pNt64->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC) {
+		if (pNt64->OptionalHeader.NumberOfRvaAndSizes <= IMAGE_DIRECTORY_ENTRY_EXPORT)
+			goto End;
+		pExports->dwSizeOfImage = pNt64->OptionalHeader.SizeOfImage;
+		pDataDirectory			= &pNt64->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+	} else if (pNt32->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC) {
+		if (pNt32->OptionalHeader.NumberOfRvaAndSizes <= IMAGE_DIRECTORY_ENTRY_EXPORT)
+			goto End;
+		pExports->dwSizeOfImage = pNt32->OptionalHeader.SizeOfImage;
+		pDataDirectory			= &pNt32->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+	} else {
+		goto End;
+	}
+
+	// tables outside of the image (corrupted or truncated files) are ignored entirely
+	if (pDataDirectory->VirtualAddress == 0 || pDataDirectory->Size == 0 ||
+		!K22PeIsRangeValid(pExports, pDataDirectory->VirtualAddress, sizeof(IMAGE_EXPORT_DIRECTORY)))
+		goto End;
+	const IMAGE_EXPORT_DIRECTORY *pExportDirectory = K22_PE_RVA(pDataDirectory->VirtualAddress);
+	if (pExportDirectory->NumberOfFunctions > 0xFFFF + 1 || pExportDirectory->NumberOfNames > 0xFFFF + 1 ||
+		!K22PeIsRangeValid(pExports, pExportDirectory->AddressOfFunctions, pExportDirectory->NumberOfFunctions * 4) ||
+		!K22PeIsRangeValid(pExports, pExportDirectory->AddressOfNames, pExportDirectory->NumberOfNames * 4) ||
+		!K22PeIsRangeValid(pExports, pExportDirectory->AddressOfNameOrdinals, pExportDirectory->NumberOfNames * 2))
+		goto End;
+
+	pExports->dwDirectoryStart	  = pDataDirectory->VirtualAddress;
+	pExports->dwDirectoryEnd	  = pDataDirectory->VirtualAddress + pDataDirectory->Size;
+	pExports->dwOrdinalBase		  = pExportDirectory->Base;
+	pExports->dwNumberOfFunctions = pExportDirectory->NumberOfFunctions;
+	pExports->dwNumberOfNames	  = pExportDirectory->NumberOfNames;
+	pExports->pFunctions		  = (PDWORD)K22_PE_RVA(pExportDirectory->AddressOfFunctions);
+	pExports->pNames			  = (PDWORD)K22_PE_RVA(pExportDirectory->AddressOfNames);
+	pExports->pNameOrdinals		  = (PWORD)K22_PE_RVA(pExportDirectory->AddressOfNameOrdinals);
+
+End:
+	K22_STORE_RELEASE(&pExports->fParsed, TRUE);
+	return pExports->pFunctions != NULL;
+}
+
+static DWORD K22PeExportGetRva(PK22_PE_EXPORTS pExports, DWORD dwIndex) {
+	if (dwIndex >= pExports->dwNumberOfFunctions)
+		return 0;
+	DWORD dwRva = pExports->pFunctions[dwIndex];
+	// forwarded exports point to a string in the export directory - let the caller handle them
+	if (dwRva >= pExports->dwDirectoryStart && dwRva < pExports->dwDirectoryEnd)
+		return 0;
+	return dwRva;
+}
+
+static INT K22PeExportCompare(LPCVOID lpImageBase, PK22_PE_EXPORTS pExports, LPCSTR lpSymbolName, DWORD dwIndex) {
+	DWORD dwNameRva = pExports->pNames[dwIndex];
+	if (dwNameRva >= pExports->dwSizeOfImage)
+		return -1;
+	return strcmp(lpSymbolName, K22_PE_RVA(dwNameRva));
+}
+
+DWORD K22PeExportFindByName(LPCVOID lpImageBase, PK22_PE_EXPORTS pExports, LPCSTR lpSymbolName, WORD wHint) {
+	// find the RVA of an exported symbol; 0 if not found, or forwarded
+	if (!K22PeExportParse(lpImageBase, pExports))
+		return 0;
+	PWORD pNameOrdinals = pExports->pNameOrdinals;
+
+	// try the hint from the import descriptor first
+	if (wHint < pExports->dwNumberOfNames && K22PeExportCompare(lpImageBase, pExports, lpSymbolName, wHint) == 0)
+		return K22PeExportGetRva(pExports, pNameOrdinals[wHint]);
+
+	// otherwise binary search the name pointer table, which is sorted lexically
+	DWORD dwLow	 = 0;
+	DWORD dwHigh = pExports->dwNumberOfNames;
+	while (dwLow < dwHigh) {
+		DWORD dwMiddle = dwLow + (dwHigh - dwLow) / 2;
+		INT iCompare   = K22PeExportCompare(lpImageBase, pExports, lpSymbolName, dwMiddle);
+		if (iCompare == 0)
+			return K22PeExportGetRva(pExports, pNameOrdinals[dwMiddle]);
+		if (iCompare < 0)
+			dwHigh = dwMiddle;
+		else
+			dwLow = dwMiddle + 1;
+	}
+	return 0;
+}
+
+DWORD K22PeExportFindByOrdinal(LPCVOID lpImageBase, PK22_PE_EXPORTS pExports, DWORD dwOrdinal) {
+	// find the RVA of a symbol exported by ordinal; 0 if not found, or forwarded
+	if (!K22PeExportParse(lpImageBase, pExports))
+		return 0;
+	if (dwOrdinal < pExports->dwOrdinalBase)
+		return 0;
+	return K22PeExportGetRva(pExports, dwOrdinal - pExports->dwOrdinalBase);
+}
+
+BOOL K22PeIsCodeRva(LPCVOID lpImageBase, DWORD dwRva) {
+	// check if dwRva is in an executable section - exports anywhere else are data (variables, vtables, ...)
+	const IMAGE_DOS_HEADER *pDosHeader = lpImageBase;
+	if (pDosHeader->e_magic != IMAGE_DOS_SIGNATURE || pDosHeader->e_lfanew <= 0)
+		return FALSE;
+	const IMAGE_NT_HEADERS32 *pNt32 = K22_PE_RVA(pDosHeader->e_lfanew);
+	const IMAGE_NT_HEADERS64 *pNt64 = K22_PE_RVA(pDosHeader->e_lfanew);
+	if (pNt32->Signature != IMAGE_NT_SIGNATURE)
+		return FALSE;
+	DWORD dwSizeOfImage;
+	if (pNt64->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+		dwSizeOfImage = pNt64->OptionalHeader.SizeOfImage;
+	else if (pNt32->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR32_MAGIC)
+		dwSizeOfImage = pNt32->OptionalHeader.SizeOfImage;
+	else
+		return FALSE;
+
+	const IMAGE_SECTION_HEADER *pSection = IMAGE_FIRST_SECTION(pNt32);
+	DWORD dwSections					 = pNt32->FileHeader.NumberOfSections;
+	if ((ULONG_PTR)(pSection + dwSections) - (ULONG_PTR)lpImageBase > dwSizeOfImage)
+		return FALSE;
+	for (DWORD i = 0; i < dwSections; i++, pSection++) {
+		// VirtualSize is 0 in images of some linkers
+		DWORD cbSection = pSection->VirtualSize > pSection->SizeOfRawData ? pSection->VirtualSize
+																		  : pSection->SizeOfRawData;
+		if (dwRva >= pSection->VirtualAddress && dwRva - pSection->VirtualAddress < cbSection)
+			return (pSection->Characteristics & IMAGE_SCN_MEM_EXECUTE) != 0;
+	}
+	return FALSE;
+}
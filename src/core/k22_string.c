@@ -0,0 +1,117 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-15.
+
+#include "k22_string.h"
+
+// Case-insensitive (ASCII only, like _stricmp) string kernels for the resolver's hot paths.
+// Names are folded and compared 16 bytes at a time with SSE2; other architectures use the scalar loop.
+// Strings shorter than 16 bytes are loaded whole, as long as the load doesn't cross a page boundary -
+// memory past the string is only read within its page, then masked out.
+// No Windows headers are needed - this is also built natively on other hosts (see test/k22_test_string.c).
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define K22_STRING_SSE2
+#include <emmintrin.h>
+#endif
+
+#define K22_CHAR_LOWER(c) (((c) >= 'A' && (c) <= 'Z') ? (CHAR)((c) + ('a' - 'A')) : (c))
+
+#ifdef K22_STRING_SSE2
+
+#define K22_PAGE_SIZE	   0x1000
+#define K22_CAN_LOAD16(lp) (((ULONG_PTR)(lp) & (K22_PAGE_SIZE - 1)) <= K22_PAGE_SIZE - 16)
+
+// reading past the string is intended - don't let AddressSanitizer (host tests) report it
+#if defined(__GNUC__)
+#define K22_STRING_NO_ASAN __attribute__((no_sanitize_address))
+#elif defined(_MSC_VER) && defined(__SANITIZE_ADDRESS__)
+#define K22_STRING_NO_ASAN __declspec(no_sanitize_address)
+#else
+#define K22_STRING_NO_ASAN
+#endif
+
+static __forceinline __m128i K22StringFold16(__m128i xInput) {
+	// shift 'A'..'Z' to -128..-103, so that a single signed compare finds them
+	__m128i xRange = _mm_add_epi8(xInput, _mm_set1_epi8(0x80 - 'A'));
+	__m128i xUpper = _mm_cmplt_epi8(xRange, _mm_set1_epi8(-128 + 26));
+	return _mm_or_si128(xInput, _mm_and_si128(xUpper, _mm_set1_epi8(0x20)));
+}
+
+K22_STRING_NO_ASAN static __forceinline DWORD K22StringDiff16(LPCSTR lpString1, LPCSTR lpString2) {
+	// bit mask of bytes that differ after folding
+	__m128i xString1 = K22StringFold16(_mm_loadu_si128((const __m128i *)lpString1));
+	__m128i xString2 = K22StringFold16(_mm_loadu_si128((const __m128i *)lpString2));
+	return ~_mm_movemask_epi8(_mm_cmpeq_epi8(xString1, xString2)) & 0xFFFF;
+}
+
+#else
+#define K22_STRING_NO_ASAN
+#endif
+
+K22_STRING_NO_ASAN BOOL K22StringEqualsN(LPCSTR lpString1, LPCSTR lpString2, DWORD cchString) {
+	// compare cchString characters case-insensitively; the strings don't have to be NULL-terminated
+#ifdef K22_STRING_SSE2
+	if (cchString < 16) {
+		if (cchString != 0 && K22_CAN_LOAD16(lpString1) && K22_CAN_LOAD16(lpString2))
+			return (K22StringDiff16(lpString1, lpString2) & ((1 << cchString) - 1)) == 0;
+	} else {
+		DWORD i;
+		for (i = 0; i + 16 <= cchString; i += 16) {
+			if (K22StringDiff16(lpString1 + i, lpString2 + i) != 0)
+				return FALSE;
+		}
+		// the last block overlaps the previous one
+		return i == cchString || K22StringDiff16(lpString1 + cchString - 16, lpString2 + cchString - 16) == 0;
+	}
+#endif
+	for (DWORD i = 0; i < cchString; i++) {
+		if (K22_CHAR_LOWER(lpString1[i]) != K22_CHAR_LOWER(lpString2[i]))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+K22_STRING_NO_ASAN BOOL K22StringEquals(LPCSTR lpString1, LPCSTR lpString2) {
+	// _stricmp(lpString1, lpString2) == 0
+	// a single pass, finding the terminator along with the first difference (no strlen())
+	for (;;) {
+#ifdef K22_STRING_SSE2
+		if (K22_CAN_LOAD16(lpString1) && K22_CAN_LOAD16(lpString2)) {
+			__m128i xString1 = K22StringFold16(_mm_loadu_si128((const __m128i *)lpString1));
+			__m128i xString2 = K22StringFold16(_mm_loadu_si128((const __m128i *)lpString2));
+			DWORD dwDiff	 = ~_mm_movemask_epi8(_mm_cmpeq_epi8(xString1, xString2)) & 0xFFFF;
+			DWORD dwEnd		 = _mm_movemask_epi8(_mm_cmpeq_epi8(xString1, _mm_setzero_si128()));
+			if ((dwDiff | dwEnd) != 0) {
+				// equal if the first stop is the end of both strings, not a difference
+				DWORD dwStop = dwDiff | dwEnd;
+				return (dwDiff & (dwStop & (0 - dwStop))) == 0;
+			}
+			lpString1 += 16;
+			lpString2 += 16;
+			continue;
+		}
+#endif
+		// close to the end of a page
+		CHAR cChar1 = K22_CHAR_LOWER(*lpString1);
+		if (cChar1 != K22_CHAR_LOWER(*lpString2))
+			return FALSE;
+		if (cChar1 == '\0')
+			return TRUE;
+		lpString1++;
+		lpString2++;
+	}
+}
+
+DWORD K22StringLowerN(LPCSTR lpInput, LPSTR lpOutput, DWORD cchInput) {
+	// copy cchInput characters to lowercase; the output is not NULL-terminated
+	DWORD i = 0;
+#ifdef K22_STRING_SSE2
+	for (/**/; i + 16 <= cchInput; i += 16) {
+		__m128i xInput = _mm_loadu_si128((const __m128i *)(lpInput + i));
+		_mm_storeu_si128((__m128i *)(lpOutput + i), K22StringFold16(xInput));
+	}
+#endif
+	for (/**/; i < cchInput; i++) {
+		lpOutput[i] = K22_CHAR_LOWER(lpInput[i]);
+	}
+	return cchInput;
+}
@@ -83,6 +83,9 @@ BOOL K22DebugDumpModules(LPCSTR lpOutputDirName, LPVOID lpImageBase) {
 }
 
 PLDR_DATA_TABLE_ENTRY K22GetLdrEntry(LPVOID lpImageBase) {
+	PK22_MODULE_DATA pK22ModuleData = K22ModuleIndexFindBase(lpImageBase);
+	if (pK22ModuleData != NULL)
+		return pK22ModuleData->pLdrEntry;
 	K22_LDR_ENUM(pLdrEntry, InLoadOrderModuleList, InLoadOrderLinks) {
 		if (pLdrEntry->DllBase == lpImageBase)
 			return pLdrEntry;
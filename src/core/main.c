@@ -16,6 +16,11 @@ static BOOL DllInitialize(HANDLE hDll, LPVOID lpContext) {
 	return K22CoreMain(pK22Header, lpContext);
 }
 
+static VOID DllShutdown(LPVOID lpContext) {
+	// lpContext is non-NULL if the process is terminating
+	K22ParallelShutdown(lpContext != NULL);
+}
+
 static VOID DllError() {
 	K22LogShowErrorMessage("Kernel22 Core initialization failed:\r\n\r\n");
 }
@@ -28,6 +33,10 @@ static VOID DllError() {
 #pragma ide diagnostic ignored "ConstantConditionsOC"
 
 BOOL APIENTRY DllMain(HANDLE hDll, DWORD dwReason, LPVOID lpContext) {
+	if (dwReason == DLL_PROCESS_DETACH) {
+		DllShutdown(lpContext);
+		return TRUE;
+	}
 	// ignore any other events
 	if (dwReason != DLL_PROCESS_ATTACH)
 		return TRUE;
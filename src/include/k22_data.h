@@ -9,15 +9,34 @@
 
 typedef struct K22_DATA *PK22_DATA;
 typedef struct K22_MODULE_DATA *PK22_MODULE_DATA;
+typedef struct K22_CONFIG_KEY *PK22_CONFIG_KEY;
+typedef struct K22_CONFIG_VALUE *PK22_CONFIG_VALUE;
+typedef struct K22_DLL_RULES *PK22_DLL_RULES;
 typedef struct K22_DLL_EXTRA *PK22_DLL_EXTRA;
 typedef struct K22_DLL_API_SET *PK22_DLL_API_SET;
 typedef struct K22_DLL_REDIRECT *PK22_DLL_REDIRECT;
 typedef struct K22_DLL_REWRITE *PK22_DLL_REWRITE;
+typedef struct K22_DLL_ROUTE *PK22_DLL_ROUTE;
+typedef struct K22_DLL_ROUTE_ENTRY *PK22_DLL_ROUTE_ENTRY;
+typedef struct K22_SEARCH_NAME *PK22_SEARCH_NAME;
+typedef struct K22_BIND_IMPORTER *PK22_BIND_IMPORTER;
+typedef struct K22_LAZY_ENTRY *PK22_LAZY_ENTRY;
+typedef struct K22_SYMBOL_REF *PK22_SYMBOL_REF;
+typedef struct K22_PROC_CACHE *PK22_PROC_CACHE;
+typedef struct K22_PARALLEL_ITEM *PK22_PARALLEL_ITEM;
+typedef struct K22_PARALLEL_JOB *PK22_PARALLEL_JOB;
+typedef struct K22_ARENA_BLOCK *PK22_ARENA_BLOCK;
+typedef struct K22_ATOM *PK22_ATOM;
 
 #if K22_CORE
 extern PK22_DATA pK22Data;
 #endif
 
+// size of the DLL rule membership filter, see K22ConfigIndexRuleFilter()
+#define K22_RULE_FILTER_BITS 4096
+// maximum number of parallel resolver workers - all of them are waited for at once, see K22ParallelShutdown()
+#define K22_PARALLEL_MAX_THREADS MAXIMUM_WAIT_OBJECTS
+
 // Runtime per-process data structure
 typedef struct K22_DATA {
 	union {
@@ -37,22 +56,152 @@ typedef struct K22_DATA {
 		HKEY hConfig[2];
 	} stReg;
 
+	// values of the Global and per-app keys, merged at startup - see k22_data_store.c
+	struct {
+		PK22_CONFIG_KEY pRoot;	   // values of the keys themselves
+		PK22_CONFIG_KEY pKeyIndex; // hash table of all keys, by lowercase path
+		DWORD dwKeys;			   // number of stored keys, including pRoot
+		DWORD dwValues;			   // number of stored values, after merging
+	} stStore;
+
+	// configuration file, see k22_data_config.c
+	struct {
+		LPSTR lpPath;		  // file path, from the ConfigFile value
+		LPCSTR lpData;		  // mapped file
+		SIZE_T cbData;		  // size of the mapped file
+		FILETIME ftLastWrite; // last write time of the file, for the configuration cache
+		K22_INI_FILE stIni;	  // sections of the mapped file
+	} stConfigFile;
+
 	struct {
 		DWORD dwLogLevel;
 		LPSTR lpInstallDir;
 		SIZE_T cchInstallDir;
 		DWORD dwDllNotificationMode;
 		BOOL bDebugImportResolver;
+		BOOL bBindCache;
+		BOOL bConfigCache;
+		BOOL bConfigWatch;
+		BOOL bLazyBinding;
+		DWORD dwParallelResolve;
 	} stConfig;
 
+	// DLL rules, see k22_data_config.c
+	// replaced as a whole when the configuration changes (see k22_data_watch.c) - entries are never modified or freed
+	PK22_DLL_RULES volatile pDll; // rules in use, read without locking
+	PK22_DLL_RULES pDllBuild;	  // rules being parsed, not visible to the resolver yet
+
+	// long-lived allocations, see k22_arena.c
+	struct {
+		SRWLOCK stLock;
+		PK22_ARENA_BLOCK pBlock; // block being filled, followed by full ones
+		SIZE_T cbAllocated;		 // bytes handed out
+		SIZE_T cbReserved;		 // bytes taken from the system
+		DWORD dwAllocations;	 // number of K22ArenaAlloc() calls
+		DWORD dwBlocks;			 // number of blocks
+	} stArena;
+
+	// interned module and symbol names, see k22_atom.c
 	struct {
-		PK22_DLL_EXTRA pDllExtra;
-		PK22_DLL_API_SET pDllApiSet;
-		PK22_DLL_REDIRECT pDllRedirect;
-		PK22_DLL_REWRITE pDllRewrite;
-	} stDll;
+		SRWLOCK stLock;
+		PK22_ATOM *ppBuckets; // hash table of atoms, chained in pNext
+		DWORD dwBuckets;	  // number of buckets (power of two)
+		DWORD dwCount;		  // number of atoms
+	} stAtoms;
+
+	// updated by any thread (and parallel workers) - only with Interlocked*()
+	struct {
+		volatile LONG lRuleLookups;	   // number of K22Find*() calls
+		volatile LONG lModules;		   // modules processed by the DLL notification callback
+		volatile LONG lModulesSkipped; // modules left to ntdll.dll, as no rule applies to their imports
+	} stStats;
+
+	// loaded module index, see k22_data_module.c
+	struct {
+		SRWLOCK stLock;
+		BOOL fEnabled;			  // index is maintained by the DLL notification callback
+		PK22_MODULE_DATA pByName; // keyed by base name atom (first loaded module only)
+		PK22_MODULE_DATA pByPath; // keyed by lowercase full path
+		PK22_MODULE_DATA pByBase; // keyed by image base
+	} stModules;
+
+	// DLL search directory cache, see k22_dll_search.c
+	struct {
+		SRWLOCK stLock;
+		struct {
+			LPWSTR lpPath;			 // directory path, without trailing backslash
+			BOOL fListed;			 // pNames is a snapshot of the directory
+			PK22_SEARCH_NAME pNames; // hash table of file names in the directory
+		} stDir[4];					 // process, system, Windows and current directory
+		PK22_SEARCH_NAME pMissing;	 // hash table of module names not found anywhere
+	} stSearch;
+
+	// import binding cache, see k22_dll_bindcache.c
+	struct {
+		LPSTR lpPath;					// cache file path
+		PK22_BIND_CACHE_HEADER pHeader; // mapped cache file, if valid
+		SIZE_T cbView;					// size of the mapped cache file
+		BOOL fRecording;				// resolved imports are being recorded
+		BOOL fDirty;					// some imports were resolved without the cache
+		PK22_BIND_IMPORTER pImporters;	// recorded imports of each module
+	} stBindCache;
+
+	// parsed configuration cache, see k22_data_cache.c
+	struct {
+		LPSTR lpPath;					  // cache file path
+		LPSTR lpSection;				  // shared section name
+		ULONGLONG ullGeneration;		  // K22ConfigCacheGeneration() of the registry keys
+		PK22_CONFIG_CACHE_HEADER pHeader; // mapped cache file or section, if valid - strings of the rules point into it
+		SIZE_T cbView;					  // size of the mapped cache file or section
+		HANDLE hSection;				  // shared section published by this process, kept open until exit
+		LPSTR lpUserSid;				  // string SID of this process' user
+		LPSTR lpLabelSid;				  // string SID of this process' integrity level
+		PSID pUserSid;					  // SID of this process' user - sections of other owners aren't trusted
+	} stConfigCache;
+
+	// configuration watcher, see k22_data_watch.c
+	struct {
+		HANDLE hRegEvent;	// signaled when the registry keys change
+		HANDLE hFileChange; // signaled when the directory of the configuration file changes
+		DWORD dwReloads;	// number of published rule sets, after the first one
+		SIZE_T cbRetained;	// arena bytes of replaced rules, which are never freed
+	} stWatch;
+
+	// lazy import binding, see k22_dll_lazy.c
+	struct {
+		SRWLOCK stLock;		// serializes IAT patching
+		LPBYTE pTrampoline; // code shared by all stubs
+	} stLazy;
+
+	// parallel symbol resolution, see k22_dll_parallel.c
+	struct {
+		SRWLOCK stLock;							   // one job at a time
+		DWORD dwThreads;						   // number of started worker threads
+		HANDLE hThreads[K22_PARALLEL_MAX_THREADS]; // handles of started worker threads
+		HANDLE hSemaphore;						   // released once per worker for every job
+		HANDLE hDone;							   // set by the last worker to finish a job
+		PK22_PARALLEL_JOB volatile pJob;		   // job being processed, if any
+		volatile BOOL fStop;					   // set by K22ParallelShutdown()
+	} stParallel;
 } K22_DATA;
 
+// Arena memory block
+
+typedef struct K22_ARENA_BLOCK {
+	struct K22_ARENA_BLOCK *pNext;
+	SIZE_T cbSize; // usable size, following the (aligned) header
+	SIZE_T cbUsed; // bytes handed out
+} K22_ARENA_BLOCK;
+
+// Interned name, see K22AtomAdd()
+
+typedef struct K22_ATOM {
+	struct K22_ATOM *pNext; // next atom in the same bucket
+	DWORD dwHash;			// K22StringHash() of szName
+	DWORD cchName;			// length of szName
+	CHAR szName[];			// lowercase name
+} K22_ATOM;
+
 // Runtime per-module data structure
 typedef struct K22_MODULE_DATA {
 	union {
@@ -63,13 +212,79 @@ typedef struct K22_MODULE_DATA {
 	PIMAGE_NT_HEADERS3264 pNt;
 	PLDR_DATA_TABLE_ENTRY pLdrEntry;
 	LPSTR lpModulePath;
-	LPSTR lpModuleName;
+	LPSTR lpModuleName;	   // base name, szName of pModuleAtom
+	PK22_ATOM pModuleAtom; // base name
 	BOOL fIsProcess;
 	BOOL fDllNotificationFailed;
+	volatile LONG lGeneration; // bumped when unloaded, invalidates values cached by K22Cache*()
 
 	PDLL_INIT_ROUTINE lpDelayedInitRoutine;
+
+	// loaded module index entries
+	BOOL fIndexedByName;
+	UT_hash_handle hhName;
+	UT_hash_handle hhPath;
+	UT_hash_handle hhBase;
+
+	// export directory, parsed on first use by K22Export*()
+	K22_PE_EXPORTS stExports;
 } K22_MODULE_DATA;
 
+// Resolver cache slots, see k22_dll_cache.c
+
+typedef PK22_MODULE_DATA volatile K22_MODULE_CACHE, *PK22_MODULE_CACHE;
+
+typedef struct K22_PROC_CACHE {
+	PVOID pProc;					 // resolved address
+	PK22_MODULE_DATA pK22ModuleData; // module containing pProc
+} K22_PROC_CACHE;
+
+// Merged configuration value, see K22ConfigGetValue()
+
+typedef struct K22_CONFIG_VALUE {
+	LPSTR lpName;		 // value name, empty for the default value
+	PK22_ATOM pNameAtom; // value name (key)
+	DWORD dwType;		 // REG_DWORD, REG_SZ (also for expanded REG_EXPAND_SZ), ...
+	DWORD cbData;		 // size of pData; includes the NULL terminator of strings
+	LPCVOID pData;		 // value data; strings are always NULL-terminated
+	BOOL fPerApp;		 // value comes from the per-app key
+	struct K22_CONFIG_VALUE *pPrev;
+	struct K22_CONFIG_VALUE *pNext;
+	UT_hash_handle hh;
+} K22_CONFIG_VALUE;
+
+// Merged configuration key, see K22ConfigGetKey()
+
+typedef struct K22_CONFIG_KEY {
+	LPSTR lpPath;				   // lowercase path below Global or PerApp\<process name> (key), empty for the root
+	LPSTR lpName;				   // last component of the path
+	PK22_CONFIG_VALUE pValues;	   // list of values, global ones first
+	PK22_CONFIG_VALUE pValueIndex; // hash table of pValues, keyed by name atom
+	PK22_CONFIG_KEY pSubkeys;	   // list of subkeys
+	struct K22_CONFIG_KEY *pPrev;
+	struct K22_CONFIG_KEY *pNext;
+	UT_hash_handle hh;
+} K22_CONFIG_KEY;
+
+// DLL rules of the configuration
+
+typedef struct K22_DLL_RULES {
+	PK22_DLL_EXTRA pDllExtra;
+	PK22_DLL_API_SET pDllApiSet;
+	PK22_DLL_REDIRECT pDllRedirect;
+	PK22_DLL_REWRITE pDllRewrite;
+	// hash tables, keyed by lowercase source DLL
+	PK22_DLL_API_SET pDllApiSetIndex;	 // first entry of each API set (name without level/version)
+	PK22_DLL_REDIRECT pDllRedirectIndex; // entries of pDllRedirect
+	PK22_DLL_REWRITE pDllRewriteIndex;	 // entries of pDllRewrite
+	PK22_DLL_ROUTE_ENTRY pDllRouteIndex; // compiled pDllRedirect and pDllRewrite rules
+	PK22_DLL_API_SET pDllApiSetSchema;	 // API sets of the system (see k22_apiset.c)
+	ULONG ulApiSetSchemaVersion;		 // version of the system's API set schema
+	// bloom filter of source DLL names of all rules above
+	BYTE bRuleFilter[K22_RULE_FILTER_BITS / 8];
+	SIZE_T cbArena; // arena bytes used to build the rules, without the API set schema
+} K22_DLL_RULES;
+
 // DllExtra
 
 typedef struct K22_DLL_EXTRA {
@@ -83,42 +298,151 @@ typedef struct K22_DLL_EXTRA {
 // DllApiSet
 
 typedef struct K22_DLL_API_SET {
-	LPSTR lpSourceDll;	  // source DLL
-	LPSTR lpSourceSymbol; // source symbol to match
-	LPSTR lpTargetDll;	  // target DLL
-	HINSTANCE hModule;	  // handle to lpTargetDll
+	LPSTR lpSourceDll;		  // source DLL
+	DWORD cchSourceDll;		  // length of lpSourceDll
+	LPSTR lpSourceSymbol;	  // source symbol to match, szName of pSourceSymbol
+	PK22_ATOM pSourceSymbol;  // source symbol to match
+	LPSTR lpTargetDll;		  // target DLL
+	K22_MODULE_CACHE pModule; // lpTargetDll, once loaded
 	struct K22_DLL_API_SET *pPrev;
 	struct K22_DLL_API_SET *pNext;
+	struct K22_DLL_API_SET *pGroupNext; // next entry of the same API set (sorted)
+	struct K22_DLL_API_SET *pGroupLast; // last entry of the same API set (first entry only)
+	BOOL fGroupSymbols;					// API set has symbol-specific entries (first entry only)
+	UT_hash_handle hh;
 } K22_DLL_API_SET;
 
 // DllRedirect
 
 typedef struct K22_DLL_REDIRECT {
-	LPSTR lpSourceDll; // source DLL
-	LPSTR lpTargetDll; // target DLL
-	HINSTANCE hModule; // handle to lpTargetDll
+	LPSTR lpSourceDll;					 // source DLL
+	LPSTR lpTargetDll;					 // target DLL
+	K22_MODULE_CACHE pModule;			 // lpTargetDll, once loaded
+	struct K22_DLL_REDIRECT *pChainLast; // last entry of the redirect chain starting here
+	DWORD dwChainWalk;					 // last K22ConfigCompileRoutes() walk that visited this entry
 	struct K22_DLL_REDIRECT *pPrev;
 	struct K22_DLL_REDIRECT *pNext;
+	UT_hash_handle hh;
 } K22_DLL_REDIRECT;
 
+// Symbol to resolve, imported by name or by ordinal (see K22SymbolRefName())
+
+typedef struct K22_SYMBOL_REF {
+	LPCSTR lpName; // symbol name, NULL if imported by ordinal
+	DWORD cchName; // length of lpName
+	DWORD dwHash;  // K22StringHash() of lpName
+	WORD wOrdinal; // ordinal, if lpName is NULL
+	WORD wHint;	   // export name table hint, 0 if unknown
+} K22_SYMBOL_REF;
+
 // DllRewrite
 
 typedef struct K22_DLL_REWRITE_SYMBOL {
-	LPSTR lpSourceSymbol; // source symbol to match
-	LPSTR lpTargetDll;	  // target DLL
-	LPSTR lpTargetSymbol; // symbol to redirect to
-	PVOID pProc;		  // pointer to target function
+	LPSTR lpSourceSymbol;				 // source symbol to match, szName of pSourceSymbol
+	PK22_ATOM pSourceSymbol;			 // source symbol to match (key)
+	LPSTR lpTargetDll;					 // target DLL
+	LPSTR lpTargetSymbol;				 // symbol to redirect to
+	K22_SYMBOL_REF stTarget;			 // lpTargetSymbol, parsed
+	PK22_PROC_CACHE volatile pProcCache; // target function, once resolved
 	struct K22_DLL_REWRITE_SYMBOL *pPrev;
 	struct K22_DLL_REWRITE_SYMBOL *pNext;
+	UT_hash_handle hh;
 } K22_DLL_REWRITE_SYMBOL, *PK22_DLL_REWRITE_SYMBOL;
 
 typedef struct K22_DLL_REWRITE {
-	LPSTR lpSourceDll;				  // source DLL
-	LPSTR lpDefaultDll;				  // optional, target DLL for missing symbols
-	LPSTR lpCatchAllDll;			  // optional, target DLL for all symbols
-	HINSTANCE hDefault;				  // optional, handle to lpDefaultDll
-	HINSTANCE hCatchAll;			  // optional, handle to lpCatchAllDll
-	PK22_DLL_REWRITE_SYMBOL pSymbols; // list of specific symbols to rewrite
+	LPSTR lpSourceDll;					  // source DLL
+	LPSTR lpDefaultDll;					  // optional, target DLL for missing symbols
+	LPSTR lpCatchAllDll;				  // optional, target DLL for all symbols
+	K22_MODULE_CACHE pDefault;			  // optional, lpDefaultDll, once loaded
+	K22_MODULE_CACHE pCatchAll;			  // optional, lpCatchAllDll, once loaded
+	PK22_DLL_REWRITE_SYMBOL pSymbols;	  // list of specific symbols to rewrite
+	PK22_DLL_REWRITE_SYMBOL pSymbolIndex; // hash table of pSymbols, keyed by source symbol atom
 	struct K22_DLL_REWRITE *pPrev;
 	struct K22_DLL_REWRITE *pNext;
+	UT_hash_handle hh;
 } K22_DLL_REWRITE;
+
+// Compiled DllRedirect and DllRewrite rules of a source DLL
+
+typedef struct K22_DLL_ROUTE_ENTRY {
+	LPCSTR lpSourceDll;			  // source DLL (key)
+	LPCSTR lpTargetDll;			  // final target DLL, or NULL if not redirected
+	PK22_MODULE_CACHE ppModule;	  // where to cache lpTargetDll, if redirected
+	PK22_DLL_REWRITE pDllRewrite; // DLL rewrite entry of the final target DLL, if any
+	UT_hash_handle hh;
+} K22_DLL_ROUTE_ENTRY;
+
+// DLL route of an imported module, resolved once per import descriptor
+
+typedef struct K22_DLL_ROUTE {
+	PK22_DLL_RULES pDll;		  // rules the route was resolved with
+	LPCSTR lpModuleNameOrig;	  // imported module name
+	LPCSTR lpModuleName;		  // module name after applying DllApiSet and DllRedirect
+	K22_MODULE_CACHE pModule;	  // lpModuleName, if not cached in an entry
+	PK22_MODULE_CACHE ppModule;	  // where to cache lpModuleName
+	PK22_DLL_REWRITE pDllRewrite; // DLL rewrite entry of lpModuleName, if any
+	BOOL fPerSymbol;			  // DllApiSet entries are symbol-specific - route each symbol separately
+} K22_DLL_ROUTE;
+
+// DLL search cache entry
+
+typedef struct K22_SEARCH_NAME {
+	UT_hash_handle hh;
+	CHAR szName[]; // lowercase file name
+} K22_SEARCH_NAME;
+
+// Binding cache record of a single importing module
+
+typedef struct K22_BIND_IMPORTER {
+	PK22_MODULE_DATA pK22ModuleData; // importing module
+	BOOL fInvalid;					 // some thunks couldn't be recorded
+	DWORD dwModule;					 // index of the importing module (when writing)
+	DWORD dwCount;					 // number of recorded thunks
+	DWORD dwCapacity;				 // allocated size of pThunks
+	struct {
+		DWORD dwThunkRva; // RVA of the IAT entry
+		DWORD dwModule;	  // index of the target module (when writing)
+		PVOID pProc;	  // resolved address
+	} *pThunks;
+	struct K22_BIND_IMPORTER *pPrev;
+	struct K22_BIND_IMPORTER *pNext;
+} K22_BIND_IMPORTER;
+
+// Lazily bound import, called through a generated stub
+
+typedef struct K22_LAZY_ENTRY {
+	PULONG_PTR pThunk;						// IAT entry pointing to the stub
+	PK22_MODULE_DATA pK22ModuleData;		// importing module
+	LPCSTR lpModuleName;					// imported module name
+	K22_SYMBOL_REF stSymbol;				// imported symbol
+	PVOID pProc;							// resolved address, after the first call
+	PIMAGE_DELAYLOAD_DESCRIPTOR pDelayDesc;	// descriptor of a delay-loaded import, NULL otherwise
+} K22_LAZY_ENTRY;
+
+typedef struct {
+	DWORD dwCount;				   // number of used entries and stubs
+	DWORD dwCapacity;			   // number of allocated entries and stubs
+	PK22_LAZY_ENTRY pEntries;	   // stub data
+	LPBYTE pStubs;				   // stub code
+	LPCSTR lpImageName;			   // module inspected last, if it wasn't loaded (see K22LazyMapImage())
+	LPVOID lpImage;				   // its file mapped as an image, NULL if it couldn't be mapped
+	K22_PE_EXPORTS stImageExports; // its export directory
+} K22_LAZY_BLOCK, *PK22_LAZY_BLOCK;
+
+// Symbol looked up by the parallel resolver
+
+typedef struct K22_PARALLEL_ITEM {
+	PULONG_PTR pThunk;				 // IAT entry to write pProc to
+	PK22_DLL_ROUTE pRoute;			 // route of the imported module
+	PK22_MODULE_DATA pK22ModuleData; // module to find the symbol in, NULL if it must be resolved serially
+	K22_SYMBOL_REF stSymbol;		 // imported symbol
+	PVOID pProc;					 // found address, NULL if it must be resolved serially
+} K22_PARALLEL_ITEM;
+
+typedef struct K22_PARALLEL_JOB {
+	PK22_PARALLEL_ITEM pItems; // symbols to look up
+	DWORD dwCount;			   // number of pItems
+	DWORD dwChunks;			   // number of chunks of pItems
+	volatile LONG lNextChunk;  // next chunk to claim
+	volatile LONG lPending;	   // woken workers that haven't finished yet
+} K22_PARALLEL_JOB;
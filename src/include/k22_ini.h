@@ -0,0 +1,41 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-20.
+
+#pragma once
+
+#include "k22_portable.h"
+
+// Configuration file parser (see k22_ini.c)
+// The file is parsed in place - names, values and sections are views into it, not NULL-terminated.
+
+typedef struct {
+	LPCSTR lpData;
+	DWORD cchData;
+} K22_STRING_VIEW, *PK22_STRING_VIEW;
+
+typedef struct K22_INI_SECTION {
+	K22_STRING_VIEW stName;		   // name of the section, empty for the lines before the first header
+	LPCSTR lpStart;				   // first line after the header
+	LPCSTR lpEnd;				   // next section header, or end of the file
+	DWORD dwLine;				   // number of the header line (0 for the lines before the first header)
+	struct K22_INI_SECTION *pNext; // next section, in file order
+} K22_INI_SECTION, *PK22_INI_SECTION;
+
+typedef struct {
+	PK22_INI_SECTION pSections; // sections in file order - a section may appear more than once
+	DWORD dwSections;			// number of pSections
+	DWORD dwValues;				// number of "name=value" lines
+	DWORD dwLines;				// number of lines
+	DWORD dwErrors;				// number of lines that couldn't be parsed
+	DWORD dwErrorLine;			// number of the first such line
+} K22_INI_FILE, *PK22_INI_FILE;
+
+typedef struct {
+	LPCSTR lpNext; // start of the next line
+	LPCSTR lpEnd;  // end of the section
+	DWORD dwLine;  // number of the last line read
+} K22_INI_READER, *PK22_INI_READER;
+
+// k22_ini.c
+BOOL K22IniParse(PK22_INI_FILE pFile, LPCSTR lpData, SIZE_T cbData, PVOID (*pAlloc)(SIZE_T));
+VOID K22IniReadSection(PK22_INI_READER pReader, PK22_INI_SECTION pSection);
+BOOL K22IniRead(PK22_INI_READER pReader, PK22_STRING_VIEW pName, PK22_STRING_VIEW pValue);
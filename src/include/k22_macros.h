@@ -40,6 +40,9 @@
 		 UNIQ(dwLoop);                                                                                                 \
 		 UNIQ(dwLoop) = FALSE, VirtualProtectEx(hProcess, lpAddress, dwSize, UNIQ(dwOldProtect), &UNIQ(dwUnused)))
 
+#define K22WithUnlockedBatch(pBatch)                                                                                   \
+	for (DWORD UNIQ(dwLoop) = TRUE; UNIQ(dwLoop); UNIQ(dwLoop) = FALSE, K22UnlockBatchRestore(pBatch))
+
 #define K22WithUnlocked(vIn)				  K22WithUnlockedMemory((PVOID)&vIn, sizeof(vIn))
 #define K22WithUnlockedLength(pvIn, cbLength) K22WithUnlockedMemory((PVOID)pvIn, cbLength)
 #define K22WithUnlockedArray(pvIn)			  K22WithUnlockedMemory((PVOID)pvIn, sizeof(pvIn))
@@ -84,6 +87,35 @@
 		 pLdrListNext					 = (PVOID)((PLIST_ENTRY)pLdrListNext)->Flink,                                  \
 							   pLdrEntry = CONTAINING_RECORD(pLdrListNext, LDR_DATA_TABLE_ENTRY, Links))
 
+// same as K22_LDR_ENUM, but starting from the most recently loaded module
+#define K22_LDR_ENUM_REVERSE(pLdrEntry, ModuleList, Links)                                                             \
+	for (PLDR_DATA_TABLE_ENTRY pLdrListHead = (PVOID)&NtCurrentPeb()->Ldr->ModuleList,                                 \
+							   pLdrListNext = (PVOID)((PLIST_ENTRY)pLdrListHead)->Blink,                               \
+							   pLdrEntry	= CONTAINING_RECORD(pLdrListNext, LDR_DATA_TABLE_ENTRY, Links);            \
+		 pLdrListHead != pLdrListNext;                                                                                 \
+		 pLdrListNext					 = (PVOID)((PLIST_ENTRY)pLdrListNext)->Blink,                                  \
+							   pLdrEntry = CONTAINING_RECORD(pLdrListNext, LDR_DATA_TABLE_ENTRY, Links))
+
+// DLL rule helper macros
+
+// find an entry matching lpModuleName (see K22PathMatches()) in a hash table keyed by lowercase source DLL
+#define K22_FIND_BY_PATH(pIndex, lpModuleName, pFound)                                                                 \
+	do {                                                                                                               \
+		CHAR szKey[MAX_PATH];                                                                                          \
+		DWORD cchKey = K22StringLower(lpModuleName, szKey, sizeof(szKey));                                             \
+		pFound		 = NULL;                                                                                           \
+		if (cchKey == 0)                                                                                               \
+			break;                                                                                                     \
+		/* both are absolute or both aren't - they must be identical to match */                                       \
+		HASH_FIND(hh, pIndex, szKey, cchKey, pFound);                                                                  \
+		LPCSTR lpKeyName = strrchr(szKey, '\\');                                                                       \
+		if (pFound != NULL || lpKeyName == NULL)                                                                       \
+			break;                                                                                                     \
+		/* path is absolute - pattern name is enough to match */                                                       \
+		lpKeyName++;                                                                                                   \
+		HASH_FIND(hh, pIndex, lpKeyName, cchKey - (lpKeyName - szKey), pFound);                                        \
+	} while (0)
+
 // Memory allocation macros
 
 #define K22_MALLOC(pVar)                                                                                               \
@@ -110,6 +142,16 @@
 
 #define K22_FREE(pVar) free(pVar)
 
+// allocate from the process-lifetime arena (see k22_arena.c) - zero-filled, never freed
+#define K22_ARENA_LENGTH(pVar, cbLength)                                                                               \
+	do {                                                                                                               \
+		pVar = K22ArenaAlloc(cbLength);                                                                                \
+		if (pVar == NULL)                                                                                              \
+			RETURN_K22_F_ERR("Couldn't allocate memory for " #pVar);                                                   \
+	} while (0)
+
+#define K22_ARENA_CALLOC(pVar) K22_ARENA_LENGTH(pVar, sizeof(*pVar))
+
 // Linked list macros
 
 #define K22_LL_PREPEND(pHead, pElem)	  DL_PREPEND2(pHead, pElem, pPrev, pNext)
@@ -121,12 +163,12 @@
 
 #define K22_LL_ALLOC_APPEND(pHead, pElem)                                                                              \
 	do {                                                                                                               \
-		K22_CALLOC(pElem);                                                                                             \
+		K22_ARENA_CALLOC(pElem);                                                                                       \
 		K22_LL_APPEND(pHead, pElem);                                                                                   \
 	} while (0)
 #define K22_LL_ALLOC_PREPEND(pHead, pElem)                                                                             \
 	do {                                                                                                               \
-		K22_CALLOC(pElem);                                                                                             \
+		K22_ARENA_CALLOC(pElem);                                                                                       \
 		K22_LL_PREPEND(pHead, pElem);                                                                                  \
 	} while (0)
 #define K22_LL_FIND(pHead, pElem, cond)                                                                                \
@@ -42,3 +42,13 @@
 #ifndef K22_REG_KEY_PATH
 #define K22_REG_KEY_PATH "SOFTWARE\\kuba2k2\\Kernel22"
 #endif
+
+// Parallel symbol resolution - import tables smaller than this are always resolved serially
+#ifndef K22_PARALLEL_MIN_SYMBOLS
+#define K22_PARALLEL_MIN_SYMBOLS 1024
+#endif
+
+// Parallel symbol resolution - number of symbols claimed by a worker at once
+#ifndef K22_PARALLEL_CHUNK
+#define K22_PARALLEL_CHUNK 128
+#endif
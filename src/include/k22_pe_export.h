@@ -0,0 +1,134 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-19.
+
+#pragma once
+
+#include "k22_portable.h"
+
+#ifndef _WINNT_
+// PE structures used by the export parser, for builds without Windows headers (same layout as in winnt.h)
+
+#define IMAGE_DOS_SIGNATURE				 0x5A4D		// MZ
+#define IMAGE_NT_SIGNATURE				 0x00004550 // PE00
+#define IMAGE_NT_OPTIONAL_HDR32_MAGIC	 0x10b
+#define IMAGE_NT_OPTIONAL_HDR64_MAGIC	 0x20b
+#define IMAGE_DIRECTORY_ENTRY_EXPORT	 0
+#define IMAGE_NUMBEROF_DIRECTORY_ENTRIES 16
+#define IMAGE_SIZEOF_SHORT_NAME			 8
+#define IMAGE_SCN_MEM_EXECUTE			 0x20000000
+
+typedef struct {
+	WORD e_magic;
+	WORD e_cblp, e_cp, e_crlc, e_cparhdr, e_minalloc, e_maxalloc, e_ss, e_sp, e_csum, e_ip, e_cs, e_lfarlc, e_ovno;
+	WORD e_res[4];
+	WORD e_oemid, e_oeminfo;
+	WORD e_res2[10];
+	LONG e_lfanew;
+} IMAGE_DOS_HEADER, *PIMAGE_DOS_HEADER;
+
+typedef struct {
+	WORD Machine;
+	WORD NumberOfSections;
+	DWORD TimeDateStamp;
+	DWORD PointerToSymbolTable;
+	DWORD NumberOfSymbols;
+	WORD SizeOfOptionalHeader;
+	WORD Characteristics;
+} IMAGE_FILE_HEADER, *PIMAGE_FILE_HEADER;
+
+typedef struct {
+	DWORD VirtualAddress;
+	DWORD Size;
+} IMAGE_DATA_DIRECTORY, *PIMAGE_DATA_DIRECTORY;
+
+typedef struct {
+	WORD Magic;
+	BYTE MajorLinkerVersion, MinorLinkerVersion;
+	DWORD SizeOfCode, SizeOfInitializedData, SizeOfUninitializedData, AddressOfEntryPoint, BaseOfCode, BaseOfData;
+	DWORD ImageBase, SectionAlignment, FileAlignment;
+	WORD MajorOperatingSystemVersion, MinorOperatingSystemVersion, MajorImageVersion, MinorImageVersion;
+	WORD MajorSubsystemVersion, MinorSubsystemVersion;
+	DWORD Win32VersionValue, SizeOfImage, SizeOfHeaders, CheckSum;
+	WORD Subsystem, DllCharacteristics;
+	DWORD SizeOfStackReserve, SizeOfStackCommit, SizeOfHeapReserve, SizeOfHeapCommit, LoaderFlags;
+	DWORD NumberOfRvaAndSizes;
+	IMAGE_DATA_DIRECTORY DataDirectory[IMAGE_NUMBEROF_DIRECTORY_ENTRIES];
+} IMAGE_OPTIONAL_HEADER32, *PIMAGE_OPTIONAL_HEADER32;
+
+typedef struct {
+	WORD Magic;
+	BYTE MajorLinkerVersion, MinorLinkerVersion;
+	DWORD SizeOfCode, SizeOfInitializedData, SizeOfUninitializedData, AddressOfEntryPoint, BaseOfCode;
+	ULONGLONG ImageBase;
+	DWORD SectionAlignment, FileAlignment;
+	WORD MajorOperatingSystemVersion, MinorOperatingSystemVersion, MajorImageVersion, MinorImageVersion;
+	WORD MajorSubsystemVersion, MinorSubsystemVersion;
+	DWORD Win32VersionValue, SizeOfImage, SizeOfHeaders, CheckSum;
+	WORD Subsystem, DllCharacteristics;
+	ULONGLONG SizeOfStackReserve, SizeOfStackCommit, SizeOfHeapReserve, SizeOfHeapCommit;
+	DWORD LoaderFlags;
+	DWORD NumberOfRvaAndSizes;
+	IMAGE_DATA_DIRECTORY DataDirectory[IMAGE_NUMBEROF_DIRECTORY_ENTRIES];
+} IMAGE_OPTIONAL_HEADER64, *PIMAGE_OPTIONAL_HEADER64;
+
+typedef struct {
+	DWORD Signature;
+	IMAGE_FILE_HEADER FileHeader;
+	IMAGE_OPTIONAL_HEADER32 OptionalHeader;
+} IMAGE_NT_HEADERS32, *PIMAGE_NT_HEADERS32;
+
+typedef struct {
+	DWORD Signature;
+	IMAGE_FILE_HEADER FileHeader;
+	IMAGE_OPTIONAL_HEADER64 OptionalHeader;
+} IMAGE_NT_HEADERS64, *PIMAGE_NT_HEADERS64;
+
+typedef struct {
+	BYTE Name[IMAGE_SIZEOF_SHORT_NAME];
+	DWORD VirtualSize;
+	DWORD VirtualAddress;
+	DWORD SizeOfRawData;
+	DWORD PointerToRawData;
+	DWORD PointerToRelocations, PointerToLinenumbers;
+	WORD NumberOfRelocations, NumberOfLinenumbers;
+	DWORD Characteristics;
+} IMAGE_SECTION_HEADER, *PIMAGE_SECTION_HEADER;
+
+typedef struct {
+	DWORD Characteristics;
+	DWORD TimeDateStamp;
+	WORD MajorVersion;
+	WORD MinorVersion;
+	DWORD Name;
+	DWORD Base;
+	DWORD NumberOfFunctions;
+	DWORD NumberOfNames;
+	DWORD AddressOfFunctions;
+	DWORD AddressOfNames;
+	DWORD AddressOfNameOrdinals;
+} IMAGE_EXPORT_DIRECTORY, *PIMAGE_EXPORT_DIRECTORY;
+
+#define IMAGE_FIRST_SECTION(pNt)                                                                                       \
+	((PIMAGE_SECTION_HEADER)((ULONG_PTR)(pNt) + offsetof(IMAGE_NT_HEADERS32, OptionalHeader) +                         \
+							 (pNt)->FileHeader.SizeOfOptionalHeader))
+#endif
+
+// Export directory of a PE image, parsed by K22PeExportParse()
+
+typedef struct K22_PE_EXPORTS {
+	BOOL fParsed;			// set last (K22_STORE_RELEASE()) - read with K22_LOAD_ACQUIRE()
+	DWORD dwSizeOfImage;	// names and tables outside of the image are ignored
+	DWORD dwDirectoryStart; // RVA of the export directory
+	DWORD dwDirectoryEnd;	// end RVA of the export directory (forwarders point here)
+	DWORD dwOrdinalBase;
+	DWORD dwNumberOfFunctions;
+	DWORD dwNumberOfNames;
+	PDWORD pFunctions;	 // export address table
+	PDWORD pNames;		 // sorted export name pointer table
+	PWORD pNameOrdinals; // export ordinal table
+} K22_PE_EXPORTS, *PK22_PE_EXPORTS;
+
+// k22_pe_export.c
+BOOL K22PeExportParse(LPCVOID lpImageBase, PK22_PE_EXPORTS pExports);
+DWORD K22PeExportFindByName(LPCVOID lpImageBase, PK22_PE_EXPORTS pExports, LPCSTR lpSymbolName, WORD wHint);
+DWORD K22PeExportFindByOrdinal(LPCVOID lpImageBase, PK22_PE_EXPORTS pExports, DWORD dwOrdinal);
+BOOL K22PeIsCodeRva(LPCVOID lpImageBase, DWORD dwRva);
@@ -0,0 +1,72 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-19.
+
+#pragma once
+
+// Base types of the portable units (string kernels, PE export parser, INI parser).
+// These don't include any Windows headers, so that they build natively on other hosts as well
+// (see test/CMakeLists.txt). When included after Windows.h, the system definitions are used.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifndef _WINDEF_
+#ifdef _WIN32
+typedef unsigned long DWORD;
+typedef long LONG;
+#else
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+#endif
+typedef int BOOL;
+typedef int INT;
+typedef char CHAR;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef uint64_t ULONGLONG;
+typedef uintptr_t ULONG_PTR;
+typedef size_t SIZE_T;
+typedef void *PVOID, *LPVOID;
+typedef const void *LPCVOID;
+typedef char *LPSTR;
+typedef const char *LPCSTR;
+typedef BYTE *LPBYTE;
+typedef WORD *PWORD;
+typedef DWORD *PDWORD;
+typedef SIZE_T *PSIZE_T;
+#define VOID  void
+#define CONST const
+#ifndef TRUE
+#define TRUE  1
+#define FALSE 0
+#endif
+#endif
+
+#if !defined(_MSC_VER) && !defined(__forceinline)
+#define __forceinline inline __attribute__((always_inline))
+#endif
+
+#if !defined(_WIN32) || K22_HOST_BUILD
+// host builds link the portable units statically
+#define K22_CORE_PROC
+#elif K22_CORE
+// core exports public functions
+#define K22_CORE_PROC __declspec(dllexport)
+#elif K22_VERIFIER
+// verifier has its own copy
+#define K22_CORE_PROC
+#else
+// everything else imports from core
+#define K22_CORE_PROC __declspec(dllimport)
+#endif
+
+// Flags published to other threads after the data they guard - stored with release, read with acquire semantics.
+// MSVC reads volatiles with acquire semantics on x86/x64 (/volatile:ms, the default there).
+#ifdef _MSC_VER
+#include <intrin.h>
+#define K22_STORE_RELEASE(pVar, lValue) _InterlockedExchange((volatile long *)(pVar), (lValue))
+#define K22_LOAD_ACQUIRE(pVar)			(*(volatile const long *)(pVar))
+#else
+#define K22_STORE_RELEASE(pVar, lValue) __atomic_store_n((pVar), (lValue), __ATOMIC_RELEASE)
+#define K22_LOAD_ACQUIRE(pVar)			__atomic_load_n((pVar), __ATOMIC_ACQUIRE)
+#endif
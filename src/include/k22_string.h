@@ -0,0 +1,12 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-15.
+
+#pragma once
+
+#include "k22_portable.h"
+
+// Case-insensitive (ASCII only, like _stricmp) string kernels, see k22_string.c
+
+// k22_string.c
+K22_CORE_PROC BOOL K22StringEqualsN(LPCSTR lpString1, LPCSTR lpString2, DWORD cchString);
+K22_CORE_PROC BOOL K22StringEquals(LPCSTR lpString1, LPCSTR lpString2);
+K22_CORE_PROC DWORD K22StringLowerN(LPCSTR lpInput, LPSTR lpOutput, DWORD cchInput);
@@ -40,6 +40,195 @@ typedef struct {
 	};
 } IMAGE_K22_HEADER, *PIMAGE_K22_HEADER;
 
+// Batch of memory regions made writable together (see K22UnlockBatchAdd())
+#define K22_UNLOCK_BATCH_MAX 16
+
+typedef struct {
+	DWORD dwCount;
+	struct {
+		LPVOID lpAddress;	// page-aligned start of the region
+		SIZE_T cbSize;		// page-aligned size of the region
+		DWORD dwOldProtect; // protection to restore
+	} stRegion[K22_UNLOCK_BATCH_MAX];
+} K22_UNLOCK_BATCH, *PK22_UNLOCK_BATCH;
+
+// Binding cache file (see k22_dll_bindcache.c)
+// All offsets are relative to the start of the file; strings are NULL-terminated.
+#define K22_BIND_CACHE_MAGIC   0x4232324b // "K22B"
+#define K22_BIND_CACHE_VERSION 1
+
+typedef struct {
+	DWORD dwMagic;
+	DWORD dwVersion;
+	DWORD dwConfigHash;	   // K22BindCacheConfigHash() of the configuration in use
+	DWORD dwProcessPath;   // offset of the lowercase process image path
+	DWORD dwModuleCount;   // number of K22_BIND_CACHE_MODULE entries
+	DWORD dwModules;	   // offset of the module table
+	DWORD dwImporterCount; // number of K22_BIND_CACHE_IMPORTER entries
+	DWORD dwImporters;	   // offset of the importer table
+	DWORD dwThunkCount;	   // number of K22_BIND_CACHE_THUNK entries
+	DWORD dwThunks;		   // offset of the thunk table
+} K22_BIND_CACHE_HEADER, *PK22_BIND_CACHE_HEADER;
+
+typedef struct {
+	DWORD dwPath;		   // offset of the lowercase module path
+	DWORD dwPathHash;	   // hash of the module path
+	DWORD dwTimeDateStamp; // IMAGE_FILE_HEADER.TimeDateStamp
+	DWORD dwCheckSum;	   // IMAGE_OPTIONAL_HEADER.CheckSum
+	DWORD dwSizeOfImage;   // IMAGE_OPTIONAL_HEADER.SizeOfImage
+} K22_BIND_CACHE_MODULE, *PK22_BIND_CACHE_MODULE;
+
+typedef struct {
+	DWORD dwModule;		// index of the importing module
+	DWORD dwFirstThunk; // index of the first thunk of this module
+	DWORD dwThunkCount; // number of thunks of this module
+} K22_BIND_CACHE_IMPORTER, *PK22_BIND_CACHE_IMPORTER;
+
+typedef struct {
+	DWORD dwThunkRva;  // RVA of the IAT entry, in the importing module
+	DWORD dwModule;	   // index of the target module
+	DWORD dwTargetRva; // RVA of the resolved symbol, in the target module
+} K22_BIND_CACHE_THUNK, *PK22_BIND_CACHE_THUNK;
+
+// Configuration cache file (see k22_data_cache.c)
+// All offsets are relative to the start of the file; strings are NULL-terminated, offset 0 means no string.
+// The same layout is published in a named section, shared by all processes (see K22ConfigCachePublish()).
+#define K22_CONFIG_CACHE_MAGIC	 0x4332324b // "K22C"
+#define K22_CONFIG_CACHE_VERSION 2
+
+typedef struct {
+	DWORD dwMagic;			  // written last, when published in a section
+	DWORD dwVersion;
+	DWORD dwSize;			  // size of the whole cache, in bytes
+	DWORD dwReserved;
+	ULONGLONG ullGeneration;  // K22ConfigCacheGeneration() of the registry keys
+	DWORD dwDllExtraCount;	  // number of K22_CONFIG_CACHE_ENTRY entries
+	DWORD dwDllExtra;		  // offset of the DllExtra table
+	DWORD dwDllApiSetCount;	  // number of K22_CONFIG_CACHE_API_SET entries
+	DWORD dwDllApiSet;		  // offset of the DllApiSet table, sorted
+	DWORD dwDllRedirectCount; // number of K22_CONFIG_CACHE_ENTRY entries
+	DWORD dwDllRedirect;	  // offset of the DllRedirect table
+	DWORD dwDllRewriteCount;  // number of K22_CONFIG_CACHE_REWRITE entries
+	DWORD dwDllRewrite;		  // offset of the DllRewrite table
+	DWORD dwSymbolCount;	  // number of K22_CONFIG_CACHE_SYMBOL entries
+	DWORD dwSymbols;		  // offset of the DllRewrite symbol table
+} K22_CONFIG_CACHE_HEADER, *PK22_CONFIG_CACHE_HEADER;
+
+typedef struct {
+	DWORD dwSource; // offset of the entry name (DllExtra) or lowercase source DLL (DllRedirect)
+	DWORD dwTarget; // offset of the target DLL
+} K22_CONFIG_CACHE_ENTRY, *PK22_CONFIG_CACHE_ENTRY;
+
+typedef struct {
+	DWORD dwSourceDll;	  // offset of the lowercase source DLL
+	DWORD dwSourceSymbol; // offset of the source symbol
+	DWORD dwTargetDll;	  // offset of the target DLL
+} K22_CONFIG_CACHE_API_SET, *PK22_CONFIG_CACHE_API_SET;
+
+typedef struct {
+	DWORD dwSourceDll;	 // offset of the lowercase source DLL
+	DWORD dwDefaultDll;	 // offset of the DLL for missing symbols
+	DWORD dwCatchAllDll; // offset of the DLL for all symbols
+	DWORD dwFirstSymbol; // index of the first symbol of this DLL
+	DWORD dwSymbolCount; // number of symbols of this DLL
+} K22_CONFIG_CACHE_REWRITE, *PK22_CONFIG_CACHE_REWRITE;
+
+typedef struct {
+	DWORD dwSourceSymbol; // offset of the lowercase source symbol
+	DWORD dwTargetDll;	  // offset of the target DLL
+	DWORD dwTargetSymbol; // offset of the target symbol
+} K22_CONFIG_CACHE_SYMBOL, *PK22_CONFIG_CACHE_SYMBOL;
+
+// API set schema of the running system, PEB->ApiSetMap (see k22_apiset.c)
+// Names are UTF-16, not NULL-terminated; all offsets are relative to the start of the map, lengths are in bytes.
+// Version 2 (Windows 7, 8)
+
+typedef struct {
+	ULONG NameOffset;
+	ULONG NameLength;
+	ULONG ValueOffset;
+	ULONG ValueLength;
+} API_SET_VALUE_ENTRY_V2, *PAPI_SET_VALUE_ENTRY_V2;
+
+typedef struct {
+	ULONG Count;
+	API_SET_VALUE_ENTRY_V2 Array[];
+} API_SET_VALUE_ARRAY_V2, *PAPI_SET_VALUE_ARRAY_V2;
+
+typedef struct {
+	ULONG NameOffset; // name without "api-" and ".dll"
+	ULONG NameLength;
+	ULONG DataOffset; // API_SET_VALUE_ARRAY_V2
+} API_SET_NAMESPACE_ENTRY_V2, *PAPI_SET_NAMESPACE_ENTRY_V2;
+
+typedef struct {
+	ULONG Version;
+	ULONG Count;
+	API_SET_NAMESPACE_ENTRY_V2 Array[];
+} API_SET_NAMESPACE_ARRAY_V2, *PAPI_SET_NAMESPACE_ARRAY_V2;
+
+// Version 4 (Windows 8.1)
+
+typedef struct {
+	ULONG Flags;
+	ULONG NameOffset;
+	ULONG NameLength;
+	ULONG ValueOffset;
+	ULONG ValueLength;
+} API_SET_VALUE_ENTRY_V4, *PAPI_SET_VALUE_ENTRY_V4;
+
+typedef struct {
+	ULONG Flags;
+	ULONG Count;
+	API_SET_VALUE_ENTRY_V4 Array[];
+} API_SET_VALUE_ARRAY_V4, *PAPI_SET_VALUE_ARRAY_V4;
+
+typedef struct {
+	ULONG Flags;
+	ULONG NameOffset; // name without "api-" and ".dll"
+	ULONG NameLength;
+	ULONG AliasOffset;
+	ULONG AliasLength;
+	ULONG DataOffset; // API_SET_VALUE_ARRAY_V4
+} API_SET_NAMESPACE_ENTRY_V4, *PAPI_SET_NAMESPACE_ENTRY_V4;
+
+typedef struct {
+	ULONG Version;
+	ULONG Size;
+	ULONG Flags;
+	ULONG Count;
+	API_SET_NAMESPACE_ENTRY_V4 Array[];
+} API_SET_NAMESPACE_ARRAY_V4, *PAPI_SET_NAMESPACE_ARRAY_V4;
+
+// Version 6 (Windows 10+)
+
+typedef struct {
+	ULONG Flags;
+	ULONG NameOffset;
+	ULONG NameLength;
+	ULONG ValueOffset;
+	ULONG ValueLength;
+} API_SET_VALUE_ENTRY_V6, *PAPI_SET_VALUE_ENTRY_V6;
+
+typedef struct {
+	ULONG Flags;
+	ULONG NameOffset;	// full name without ".dll"
+	ULONG NameLength;
+	ULONG HashedLength; // length of the name without the last "-<version>"
+	ULONG ValueOffset;	// API_SET_VALUE_ENTRY_V6[ValueCount]
+	ULONG ValueCount;
+} API_SET_NAMESPACE_ENTRY_V6, *PAPI_SET_NAMESPACE_ENTRY_V6;
+
+typedef struct {
+	ULONG Version;
+	ULONG Size;
+	ULONG Flags;
+	ULONG Count;
+	ULONG EntryOffset; // API_SET_NAMESPACE_ENTRY_V6[Count]
+	ULONG HashOffset;
+	ULONG HashFactor;
+} API_SET_NAMESPACE_V6, *PAPI_SET_NAMESPACE_V6;
+
 #define K22_DOS_HDR_DATA(lpImageBase) ((PIMAGE_K22_HEADER)(lpImageBase))
 
 #define K22_COOKIE			"K22"
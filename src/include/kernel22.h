@@ -9,28 +9,27 @@
 #include <string.h>
 
 #include <Windows.h>
+#include <aclapi.h>
+#include <delayimp.h>
 #include <processthreadsapi.h>
 #include <psapi.h>
+#include <sddl.h>
 #include <strsafe.h>
 
 #include "ntdll.h"
+#include "uthash.h"
 #include "utlist.h"
 
 #define BUILD_BUG_ON(condition) ((void)sizeof(char[1 - 2 * !!(condition)]))
 #define K22_DLL_EXPORT			__declspec(dllexport)
 
-#if K22_CORE
-// core exports public functions
-#define K22_CORE_PROC __declspec(dllexport)
-#elif K22_VERIFIER
-// verifier has its own copy
-#define K22_CORE_PROC
-#else
-// everything else imports from core
-#define K22_CORE_PROC __declspec(dllimport)
-#endif
+// K22_CORE_PROC and base types of the portable units
+#include "k22_portable.h"
 
+#include "k22_ini.h"
 #include "k22_options.h"
+#include "k22_pe_export.h"
+#include "k22_string.h"
 
 #include "k22_data.h"
 #include "k22_extern.h"
@@ -59,9 +58,17 @@ K22_CORE_PROC BOOL K22PatchImportTable(BYTE bSource, LPVOID lpImageBase);
 K22_CORE_PROC BOOL K22PatchImportTableProcess(BYTE bSource, HANDLE hProcess, LPVOID lpImageBase);
 K22_CORE_PROC BOOL K22PatchImportTableFile(BYTE bSource, HANDLE hFile);
 K22_CORE_PROC BOOL K22ClearBoundImportTable(LPVOID lpImageBase);
+// k22_memory.c
+K22_CORE_PROC BOOL K22UnlockBatchAdd(PK22_UNLOCK_BATCH pBatch, LPVOID lpAddress, SIZE_T cbSize);
+K22_CORE_PROC VOID K22UnlockBatchRestore(PK22_UNLOCK_BATCH pBatch);
 
 /* Public core functions */
 
+// k22_arena.c
+K22_CORE_PROC PVOID K22ArenaAlloc(SIZE_T cbSize);
+// k22_atom.c
+K22_CORE_PROC PK22_ATOM K22AtomAdd(LPCSTR lpName, DWORD cchName);
+K22_CORE_PROC PK22_ATOM K22AtomFind(LPCSTR lpName, DWORD cchName);
 // k22_data_common.c
 K22_CORE_PROC PK22_DATA K22DataGet();
 K22_CORE_PROC PK22_MODULE_DATA K22DataGetModule(LPVOID lpImageBase);
@@ -69,13 +76,25 @@ K22_CORE_PROC PK22_MODULE_DATA K22DataGetModule(LPVOID lpImageBase);
 K22_CORE_PROC DWORD K22ConfigReadValueGlobal(LPCSTR lpName, PVOID pValue, DWORD cbValue);
 K22_CORE_PROC DWORD K22ConfigReadValue(LPCSTR lpName, PVOID pValue, DWORD cbValue);
 K22_CORE_PROC BOOL K22ConfigReadKey(LPCSTR lpName, BOOL (*pProc)(HKEY));
+K22_CORE_PROC BOOL K22ConfigReadSection(LPCSTR lpName, BOOL (*pProc)(LPSTR, LPSTR, DWORD, LPSTR, DWORD));
+// k22_data_store.c
+K22_CORE_PROC PK22_CONFIG_KEY K22ConfigGetKey(LPCSTR lpPath);
+K22_CORE_PROC PK22_CONFIG_VALUE K22ConfigGetValue(LPCSTR lpPath, LPCSTR lpName);
+K22_CORE_PROC BOOL K22ConfigGetDword(LPCSTR lpPath, LPCSTR lpName, PDWORD pdwValue);
+K22_CORE_PROC LPCSTR K22ConfigGetString(LPCSTR lpPath, LPCSTR lpName);
 // k22_data_utils.c
 K22_CORE_PROC BOOL K22StringDup(LPCSTR lpInput, DWORD cchInput, LPSTR *ppOutput);
 K22_CORE_PROC BOOL K22StringDupFileName(LPCSTR lpInput, DWORD cchInput, LPSTR *ppOutput);
 K22_CORE_PROC BOOL K22StringDupDllTarget(LPCSTR lpInput, DWORD cchInput, LPSTR *ppOutput, LPSTR *ppSymbol);
+K22_CORE_PROC DWORD K22StringLower(LPCSTR lpInput, LPSTR lpOutput, DWORD cchOutput);
+K22_CORE_PROC DWORD K22StringHash(LPCSTR lpInput, DWORD cchInput);
+K22_CORE_PROC BOOL K22StringToUnicode(LPCSTR lpInput, PUNICODE_STRING pOutput);
 K22_CORE_PROC BOOL K22PathMatches(LPCSTR lpPath, LPCSTR lpPattern);
 K22_CORE_PROC BOOL K22PathIsFile(LPCSTR lpPath);
+K22_CORE_PROC BOOL K22PathIsFileW(PCUNICODE_STRING pPath);
 K22_CORE_PROC BOOL K22PathIsFileEx(LPSTR lpDirectory, DWORD cchDirectory, LPCSTR lpName);
+// k22_dll_search.c
+K22_CORE_PROC VOID K22SearchFlush();
 // k22_dll_ldrapi.c
 K22_HOOK_REAL_DEF(
 	NTSTATUS,
@@ -111,27 +130,126 @@ K22_CORE_PROC BOOL K22HookRemove(LPVOID pProc);
 #if K22_CORE
 // k22_core.c
 BOOL K22CoreMain(PIMAGE_K22_HEADER pK22Header, LPVOID lpContext);
+// k22_arena.c
+VOID K22ArenaLogStats();
+// k22_apiset.c
+BOOL K22ApiSetInitialize();
+PK22_DLL_API_SET K22ApiSetFind(PK22_DLL_RULES pDll, LPCSTR lpModuleName);
+// k22_atom.c
+PK22_ATOM K22AtomFindHash(LPCSTR lpName, DWORD cchName, DWORD dwHash);
+// k22_data_utils.c
+BOOL K22PathHasDirectory(LPCSTR lpPath);
+LPVOID K22FileMapRead(LPCSTR lpPath, PSIZE_T pcbView);
+BOOL K22FileReplace(LPCSTR lpPath, LPCVOID pBuffer, DWORD cbBuffer);
+// k22_data_cache.c
+BOOL K22ConfigCacheOpen();
+BOOL K22ConfigCacheWrite();
+// k22_data_store.c
+BOOL K22ConfigStoreInitialize();
+// k22_data_watch.c
+VOID K22DataPublishRules();
+BOOL K22WatchInitialize();
+// k22_data_module.c
+BOOL K22ModuleIndexEnable();
+VOID K22ModuleIndexDisable();
+VOID K22ModuleIndexAdd(PK22_MODULE_DATA pK22ModuleData);
+VOID K22ModuleIndexRemove(LPVOID lpImageBase);
+PK22_MODULE_DATA K22ModuleIndexFind(LPCSTR lpModuleName);
+PK22_MODULE_DATA K22ModuleIndexFindBase(LPVOID lpImageBase);
 // k22_data_config.c
+BOOL K22ConfigOpenFile();
 BOOL K22ConfigParseDllExtra(HKEY hDllExtra);
 BOOL K22ConfigParseDllApiSet(HKEY hDllApiSet);
 BOOL K22ConfigParseDllRedirect(HKEY hDllRedirect);
 BOOL K22ConfigParseDllRewrite(HKEY hDllRewrite);
+BOOL K22ConfigParseFile(LPCSTR lpData, SIZE_T cbData);
+BOOL K22ConfigParseRules(LPCSTR lpData, SIZE_T cbData);
+VOID K22ConfigIndexDllApiSet();
+BOOL K22ConfigCompileRoutes();
+VOID K22ConfigIndexRuleFilter();
+BOOL K22ConfigRuleFilterMatches(LPCSTR lpModuleName);
+// k22_dll_bindcache.c
+BOOL K22BindCacheOpen();
+VOID K22BindCacheClose();
+BOOL K22BindCacheApply(PK22_MODULE_DATA pK22ModuleData, PIMAGE_IMPORT_DESCRIPTOR pImportDesc);
+PK22_BIND_IMPORTER K22BindCacheRecordStart(PK22_MODULE_DATA pK22ModuleData);
+VOID K22BindCacheRecord(PK22_BIND_IMPORTER pImporter, DWORD dwThunkRva, PVOID pProc);
+VOID K22BindCacheRecordRemove(LPVOID lpImageBase);
+BOOL K22BindCacheWrite();
+// k22_dll_cache.c
+PK22_MODULE_DATA K22CacheGetModule(PK22_MODULE_CACHE ppModule);
+VOID K22CacheSetModule(PK22_MODULE_CACHE ppModule, PK22_MODULE_DATA pK22ModuleData);
+PVOID K22CacheGetProc(PK22_PROC_CACHE volatile *ppProc);
+VOID K22CacheSetProc(PK22_PROC_CACHE volatile *ppProc, PVOID pProc, PK22_MODULE_DATA pK22ModuleData);
+VOID K22CacheInvalidate(LPVOID lpImageBase);
 // k22_dll_entry_find.c
-PK22_DLL_API_SET K22FindDllApiSet(LPCSTR lpModuleName, LPCSTR lpSymbolName);
-PK22_DLL_REDIRECT K22FindDllRedirect(LPCSTR lpModuleName);
-PK22_DLL_REWRITE K22FindDllRewrite(LPCSTR lpModuleName);
-PK22_DLL_REWRITE_SYMBOL K22FindDllRewriteSymbol(PK22_DLL_REWRITE pDllRewrite, LPCSTR lpSymbolName);
+DWORD K22DllApiSetKeyLength(LPCSTR lpModuleName);
+PK22_DLL_API_SET K22FindDllApiSetGroup(PK22_DLL_RULES pDll, LPCSTR lpModuleName);
+PK22_DLL_API_SET K22FindDllApiSet(PK22_DLL_RULES pDll, LPCSTR lpModuleName, PK22_SYMBOL_REF pSymbol);
+PK22_DLL_ROUTE_ENTRY K22FindDllRoute(PK22_DLL_RULES pDll, LPCSTR lpModuleName);
+PK22_DLL_REWRITE_SYMBOL K22FindDllRewriteSymbol(PK22_DLL_REWRITE pDllRewrite, PK22_SYMBOL_REF pSymbol);
+// k22_dll_export.c
+BOOL K22ExportParse(PK22_MODULE_DATA pK22ModuleData);
+PVOID K22ExportFindByName(PK22_MODULE_DATA pK22ModuleData, LPCSTR lpSymbolName, WORD wHint);
+PVOID K22ExportFindByOrdinal(PK22_MODULE_DATA pK22ModuleData, DWORD dwOrdinal);
 // k22_dll_import.c
 BOOL K22LoadExtraDlls();
+BOOL K22HasRoutedImports(LPVOID lpImageBase);
 BOOL K22ProcessImports(LPVOID lpImageBase);
 VOID K22DisableInitRoutine(LPVOID lpImageBase);
 BOOL K22CallInitRoutines(LPVOID lpContext);
 BOOL K22DummyEntryPoint(HANDLE hDll, DWORD dwReason, LPVOID lpContext);
+// k22_dll_lazy.c
+BOOL K22LazyInitialize();
+BOOL K22LazyBlockAlloc(PK22_LAZY_BLOCK pBlock, DWORD dwCapacity);
+BOOL K22LazyBlockCreate(PK22_MODULE_DATA pK22ModuleData, PIMAGE_IMPORT_DESCRIPTOR pImportDesc, PK22_LAZY_BLOCK pBlock);
+PVOID K22LazyStubCreate(
+	PK22_LAZY_BLOCK pBlock,
+	PK22_MODULE_DATA pK22ModuleData,
+	PK22_DLL_ROUTE pRoute,
+	PULONG_PTR pThunk,
+	PK22_SYMBOL_REF pSymbol
+);
+PVOID K22LazyStubAdd(
+	PK22_LAZY_BLOCK pBlock,
+	PK22_MODULE_DATA pK22ModuleData,
+	LPCSTR lpModuleName,
+	PULONG_PTR pThunk,
+	PK22_SYMBOL_REF pSymbol,
+	PIMAGE_DELAYLOAD_DESCRIPTOR pDelayDesc
+);
+BOOL K22LazyBlockFinish(PK22_LAZY_BLOCK pBlock);
+// k22_dll_parallel.c
+BOOL K22ParallelInitialize();
+BOOL K22ParallelIsEnabled(DWORD dwSymbols);
+VOID K22ParallelRun(PK22_PARALLEL_ITEM pItems, DWORD dwCount);
+VOID K22ParallelShutdown(BOOL fProcessExit);
 // k22_dll_ldrapi.c
 BOOL K22LdrApiHookCreate();
 BOOL K22LdrApiHookRemove();
+// k22_dll_search.c
+BOOL K22SearchFind(LPCSTR lpModuleName, PCUNICODE_STRING pModuleName, PUNICODE_STRING pModulePath);
+BOOL K22SearchIsMissing(LPCSTR lpModuleName);
+VOID K22SearchSetMissing(LPCSTR lpModuleName);
+BOOL K22SearchHookCreate();
+BOOL K22SearchHookRemove();
 // k22_dll_resolve.c
-LPCSTR K22ResolveModulePath(LPCSTR lpModuleName, HINSTANCE *ppModule);
+BOOL K22ResolveModulePath(
+	LPCSTR lpModuleName,
+	PCUNICODE_STRING pModuleName,
+	PUNICODE_STRING pModulePath,
+	HINSTANCE *ppModule
+);
 HINSTANCE K22ResolveModule(LPCSTR lpCallerName, LPCSTR lpModuleName);
 PVOID K22ResolveSymbol(LPCSTR lpCallerName, LPCSTR lpModuleName, LPCSTR lpSymbolName);
+PVOID K22ResolveSymbolEx(LPCSTR lpCallerName, LPCSTR lpModuleName, PK22_SYMBOL_REF pSymbol);
+VOID K22ResolveRouteRules(PK22_DLL_RULES pDll, LPCSTR lpModuleName, PK22_SYMBOL_REF pSymbol, PK22_DLL_ROUTE pRoute);
+VOID K22ResolveRoute(LPCSTR lpModuleName, PK22_SYMBOL_REF pSymbol, PK22_DLL_ROUTE pRoute);
+PVOID K22ResolveRouteSymbol(LPCSTR lpCallerName, PK22_DLL_ROUTE pRoute, PK22_SYMBOL_REF pSymbol);
+PK22_MODULE_DATA K22ResolveRouteModule(LPCSTR lpCallerName, PK22_DLL_ROUTE pRoute);
+VOID K22SymbolRefName(PK22_SYMBOL_REF pSymbol, LPCSTR lpName, WORD wHint);
+VOID K22SymbolRefOrdinal(PK22_SYMBOL_REF pSymbol, WORD wOrdinal);
+VOID K22SymbolRefParse(PK22_SYMBOL_REF pSymbol, LPCSTR lpSymbolName);
+LPCSTR K22SymbolRefString(PK22_SYMBOL_REF pSymbol, LPSTR lpBuffer);
+PK22_ATOM K22SymbolRefAtom(PK22_SYMBOL_REF pSymbol);
 #endif
@@ -9412,6 +9412,16 @@ RtlUnicodeStringToAnsiString(
     _In_ BOOLEAN AllocateDestinationString
 );
 
+NTSYSAPI
+ULONG
+NTAPI
+RtlxUnicodeStringToAnsiSize(
+    _In_ PCUNICODE_STRING UnicodeString
+);
+
+// size in bytes, including the terminator - always asks the current code page (DBCS included)
+#define RtlUnicodeStringToAnsiSize(STRING) RtlxUnicodeStringToAnsiSize(STRING)
+
 NTSYSAPI
 CHAR
 NTAPI
@@ -0,0 +1,172 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-20.
+
+#include "k22_test_ini.h"
+
+#include "k22_string.h"
+
+// INI parser benchmark: k22_bench_ini_parse [-i <iterations>] [<file.ini> ...]
+// Without files, a synthetic file with 100k values is used - 1000 sections of 100 rules, most of them per-app.
+// Measures indexing the file, then reading the rules like K22ConfigParseFile() does (4 rule sections, global and
+// per-app) - from the index, and by scanning the whole file once per section like the reference reader.
+
+#define K22_BENCH_SECTIONS 1000
+#define K22_BENCH_VALUES   100
+
+static volatile DWORD dwSink;
+
+static LPCSTR lpRules[] = {"DllExtra", "DllApiSet", "DllRedirect", "DllRewrite"};
+
+static BOOL K22BenchSectionMatches(PK22_STRING_VIEW pSection, LPCSTR lpPrefix) {
+	// [prefix] or [prefix\subsection], as in K22ConfigReadView()
+	DWORD cchPrefix = strlen(lpPrefix);
+	if (pSection->cchData < cchPrefix || !K22StringEqualsN(pSection->lpData, lpPrefix, cchPrefix))
+		return FALSE;
+	return pSection->cchData == cchPrefix || pSection->lpData[cchPrefix] == '\\';
+}
+
+static DWORD K22BenchReadIndex(PK22_INI_FILE pFile, LPCSTR lpPrefix) {
+	DWORD dwValues = 0;
+	for (PK22_INI_SECTION pSection = pFile->pSections; pSection != NULL; pSection = pSection->pNext) {
+		if (!K22BenchSectionMatches(&pSection->stName, lpPrefix))
+			continue;
+		K22_INI_READER stReader;
+		K22_STRING_VIEW stName, stValue;
+		K22IniReadSection(&stReader, pSection);
+		while (K22IniRead(&stReader, &stName, &stValue)) {
+			dwValues += stName.cchData + stValue.cchData != 0;
+		}
+	}
+	return dwValues;
+}
+
+static DWORD K22BenchReadScan(LPCSTR lpData, SIZE_T cbData, LPCSTR lpPrefix) {
+	DWORD dwValues = 0;
+	K22_TEST_INI_READER stReader;
+	K22_STRING_VIEW stName, stValue;
+	K22TestIniInit(&stReader, lpData, cbData);
+	while (K22TestIniRead(&stReader, &stName, &stValue)) {
+		if (K22BenchSectionMatches(&stReader.stSection, lpPrefix))
+			dwValues += stName.cchData + stValue.cchData != 0;
+	}
+	return dwValues;
+}
+
+static LPSTR K22BenchBuildFile(PSIZE_T pcbData) {
+	// rule sections of many processes and modules, with plugin sections in between
+	SIZE_T cbCapacity = (SIZE_T)K22_BENCH_SECTIONS * K22_BENCH_VALUES * 64;
+	LPSTR lpData	  = malloc(cbCapacity);
+	SIZE_T cbData	  = 0;
+	DWORD dwSeed	  = 2024;
+	for (DWORD i = 0; lpData != NULL && i < K22_BENCH_SECTIONS; i++) {
+		LPCSTR lpRule = lpRules[i % 4];
+		switch (i % 5) {
+			case 0:
+				cbData += sprintf(lpData + cbData, "[%s\\module%lu.dll]\n", lpRule, (unsigned long)i);
+				break;
+			case 1:
+				cbData += sprintf(lpData + cbData, "[Plugin%lu]\n", (unsigned long)i);
+				break;
+			default:
+				cbData += sprintf(lpData + cbData, "[PerApp\\app%lu.exe\\%s]\n", (unsigned long)i, lpRule);
+				break;
+		}
+		for (DWORD j = 0; j < K22_BENCH_VALUES; j++) {
+			DWORD dwRandom = K22TestRandom(&dwSeed);
+			if (j % 10 == 0)
+				cbData += sprintf(lpData + cbData, "; comment %lu\n", (unsigned long)j);
+			cbData += sprintf(
+				lpData + cbData,
+				"Symbol%08lx = target%lu.dll!Function%lu\r\n",
+				(unsigned long)dwRandom,
+				(unsigned long)(dwRandom % 100),
+				(unsigned long)j
+			);
+		}
+	}
+	*pcbData = cbData;
+	return lpData;
+}
+
+static VOID K22BenchFile(LPCSTR lpName, LPCSTR lpData, SIZE_T cbData, DWORD dwIterations) {
+	// indexing
+	K22_INI_FILE stFile;
+	ULONGLONG ullStart = K22TestTimeNs();
+	for (DWORD n = 0; n < dwIterations; n++) {
+		K22IniParse(&stFile, lpData, cbData, K22TestIniAlloc);
+		dwSink += stFile.dwSections;
+		if (n + 1 < dwIterations)
+			K22TestIniFreeAll();
+	}
+	double dParseNs = (double)(K22TestTimeNs() - ullStart) / dwIterations;
+
+	// reading the rules of the global and the per-app sections of one process, like K22ConfigParseFile()
+	CHAR szPrefixes[8][64];
+	for (DWORD i = 0; i < 4; i++) {
+		sprintf(szPrefixes[i * 2], "%s", lpRules[i]);
+		sprintf(
+			szPrefixes[i * 2 + 1],
+			"PerApp\\app%lu.exe\\%s",
+			(unsigned long)(K22_BENCH_SECTIONS / 2 + 2),
+			lpRules[i]
+		);
+	}
+	ullStart = K22TestTimeNs();
+	for (DWORD n = 0; n < dwIterations; n++) {
+		for (DWORD i = 0; i < 8; i++) {
+			dwSink += K22BenchReadIndex(&stFile, szPrefixes[i]);
+		}
+	}
+	double dIndexNs = (double)(K22TestTimeNs() - ullStart) / dwIterations;
+
+	ullStart = K22TestTimeNs();
+	for (DWORD n = 0; n < dwIterations; n++) {
+		for (DWORD i = 0; i < 8; i++) {
+			dwSink += K22BenchReadScan(lpData, cbData, szPrefixes[i]);
+		}
+	}
+	double dScanNs = (double)(K22TestTimeNs() - ullStart) / dwIterations;
+
+	printf(
+		"%s: %lu lines, %lu values, %lu sections - index %.2f ms (%.0f MB/s, %.1f ns/line), "
+		"rules %.3f ms (index), %.2f ms (scan per section)\n",
+		lpName,
+		(unsigned long)stFile.dwLines,
+		(unsigned long)stFile.dwValues,
+		(unsigned long)stFile.dwSections,
+		dParseNs / 1e6,
+		cbData / (dParseNs / 1e9) / 1e6,
+		dParseNs / (stFile.dwLines ? stFile.dwLines : 1),
+		dIndexNs / 1e6,
+		dScanNs / 1e6
+	);
+	K22TestIniFreeAll();
+}
+
+int main(int argc, char **argv) {
+	DWORD dwIterations = K22TestIterations(argc, argv, 20);
+	int iFirstFile	   = argc >= 3 && strcmp(argv[1], "-i") == 0 ? 3 : 1;
+
+	if (iFirstFile >= argc) {
+		SIZE_T cbData;
+		LPSTR lpData = K22BenchBuildFile(&cbData);
+		if (lpData == NULL) {
+			printf("Couldn't build the synthetic file\n");
+			return 1;
+		}
+		K22BenchFile("synthetic", lpData, cbData, dwIterations);
+		free(lpData);
+		return 0;
+	}
+
+	for (int i = iFirstFile; i < argc; i++) {
+		SIZE_T cbData;
+		LPBYTE pData = K22TestReadFile(argv[i], &cbData);
+		if (pData == NULL) {
+			printf("%s: couldn't read the file\n", argv[i]);
+			return 1;
+		}
+		K22BenchFile(argv[i], (LPCSTR)pData, cbData, dwIterations);
+		free(pData);
+	}
+	return 0;
+}
@@ -0,0 +1,272 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-20.
+
+#include "k22_test_pe.h"
+
+#include "k22_options.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+// Parallel resolution benchmark: k22_bench_parallel [-i <iterations>] [<file.dll> ...]
+// Models phase two of ParallelResolve (see k22_dll_parallel.c) - the names of a large import table are looked up in
+// export tables of loaded modules, in chunks of K22_PARALLEL_CHUNK claimed by the calling thread and its workers.
+// Every name exported by the files is imported once, grouped by module like import descriptors are; without files,
+// synthetic images with about as many exports as kernel32.dll are used. The job is run with 1..N threads (N being
+// the number of CPUs), looked up by binary search and with the right hints.
+// Workers spin on each job instead of waiting on a semaphore - the cost of waking them isn't measured.
+
+#define K22_BENCH_MAX_THREADS 64
+#define K22_BENCH_SYNTHETIC	  8 // synthetic modules, 1700 names each
+
+#ifdef _WIN32
+#define K22BenchIncrement(plValue) InterlockedIncrement(plValue)
+#define K22BenchDecrement(plValue) InterlockedDecrement(plValue)
+#define K22BenchYield()			   SwitchToThread()
+#else
+#define K22BenchIncrement(plValue) __atomic_add_fetch((plValue), 1, __ATOMIC_ACQ_REL)
+#define K22BenchDecrement(plValue) __atomic_sub_fetch((plValue), 1, __ATOMIC_ACQ_REL)
+#define K22BenchYield()			   sched_yield()
+#endif
+
+typedef struct {
+	LPCVOID lpImageBase;	  // module the symbol is imported from
+	PK22_PE_EXPORTS pExports; // its parsed export table
+	LPCSTR lpName;			  // imported name
+	WORD wHint;				  // export name table index of lpName
+	DWORD dwExpected;		  // result of a serial lookup
+	DWORD dwRva;			  // lookup result
+} K22_BENCH_ITEM, *PK22_BENCH_ITEM;
+
+typedef struct {
+	PK22_BENCH_ITEM pItems;
+	DWORD dwCount;
+	DWORD dwChunks;
+	BOOL fHints;			  // look up with the hints
+	volatile LONG lJob;		  // number of the published job, -1 to stop the workers
+	volatile LONG lNextChunk; // next chunk to claim in the current job
+	volatile LONG lPending;	  // threads still working on the current job
+} K22_BENCH_JOB, *PK22_BENCH_JOB;
+
+static VOID K22BenchWork(PK22_BENCH_JOB pJob) {
+	// claim chunks of the job until none are left - like K22ParallelWork()
+	LONG lChunk;
+	while ((lChunk = K22BenchIncrement(&pJob->lNextChunk) - 1) < (LONG)pJob->dwChunks) {
+		DWORD dwStart = lChunk * K22_PARALLEL_CHUNK;
+		DWORD dwEnd	  = dwStart + K22_PARALLEL_CHUNK < pJob->dwCount ? dwStart + K22_PARALLEL_CHUNK : pJob->dwCount;
+		for (PK22_BENCH_ITEM pItem = &pJob->pItems[dwStart]; pItem < &pJob->pItems[dwEnd]; pItem++) {
+			pItem->dwRva = K22PeExportFindByName(
+				pItem->lpImageBase,
+				pItem->pExports,
+				pItem->lpName,
+				pJob->fHints ? pItem->wHint : 0
+			);
+		}
+	}
+	K22BenchDecrement(&pJob->lPending);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI K22BenchWorker(LPVOID lpParameter) {
+#else
+static void *K22BenchWorker(void *lpParameter) {
+#endif
+	// run every published job once, until -1 is published
+	PK22_BENCH_JOB pJob = lpParameter;
+	LONG lLastJob		= 0;
+	while (TRUE) {
+		LONG lJob;
+		while ((lJob = K22_LOAD_ACQUIRE(&pJob->lJob)) == lLastJob)
+			K22BenchYield();
+		if (lJob < 0)
+			return 0;
+		lLastJob = lJob;
+		K22BenchWork(pJob);
+	}
+}
+
+static double K22BenchRun(PK22_BENCH_JOB pJob, DWORD dwThreads, DWORD dwIterations) {
+	// average time of the job with dwThreads threads, in microseconds
+#ifdef _WIN32
+	HANDLE hThreads[K22_BENCH_MAX_THREADS];
+#else
+	pthread_t hThreads[K22_BENCH_MAX_THREADS];
+#endif
+	pJob->lJob = 0;
+	for (DWORD i = 1; i < dwThreads; i++) {
+#ifdef _WIN32
+		hThreads[i] = CreateThread(NULL, 0, K22BenchWorker, pJob, 0, NULL);
+#else
+		pthread_create(&hThreads[i], NULL, K22BenchWorker, pJob);
+#endif
+	}
+
+	ULONGLONG ullStart = K22TestTimeNs();
+	for (DWORD n = 1; n <= dwIterations; n++) {
+		pJob->lNextChunk = 0;
+		pJob->lPending	 = (LONG)dwThreads;
+		K22_STORE_RELEASE(&pJob->lJob, (LONG)n);
+		K22BenchWork(pJob);
+		while (K22_LOAD_ACQUIRE(&pJob->lPending) != 0)
+			K22BenchYield();
+	}
+	double dJobUs = (double)(K22TestTimeNs() - ullStart) / dwIterations / 1000;
+
+	K22_STORE_RELEASE(&pJob->lJob, -1);
+	for (DWORD i = 1; i < dwThreads; i++) {
+#ifdef _WIN32
+		WaitForSingleObject(hThreads[i], INFINITE);
+		CloseHandle(hThreads[i]);
+#else
+		pthread_join(hThreads[i], NULL);
+#endif
+	}
+	return dJobUs;
+}
+
+static DWORD K22BenchCpuCount() {
+#ifdef _WIN32
+	SYSTEM_INFO stInfo;
+	GetSystemInfo(&stInfo);
+	DWORD dwCpus = stInfo.dwNumberOfProcessors;
+#else
+	long lCpus	 = sysconf(_SC_NPROCESSORS_ONLN);
+	DWORD dwCpus = lCpus > 0 ? (DWORD)lCpus : 1;
+#endif
+	return dwCpus < K22_BENCH_MAX_THREADS ? dwCpus : K22_BENCH_MAX_THREADS;
+}
+
+static BOOL K22BenchAddModule(PK22_BENCH_JOB pJob, LPCSTR lpName, LPCVOID lpImageBase, PK22_PE_EXPORTS pExports) {
+	// import every name of the module, in random order (import tables are sorted by the linker, not by address)
+	if (!K22PeExportParse(lpImageBase, pExports) || pExports->dwNumberOfNames == 0) {
+		printf("%s: no exported names\n", lpName);
+		return FALSE;
+	}
+	DWORD dwNames		   = pExports->dwNumberOfNames;
+	PK22_BENCH_ITEM pItems = realloc(pJob->pItems, (pJob->dwCount + dwNames) * sizeof(K22_BENCH_ITEM));
+	if (pItems == NULL)
+		return FALSE;
+	pJob->pItems = pItems;
+	pItems += pJob->dwCount;
+	for (DWORD i = 0; i < dwNames; i++) {
+		pItems[i].lpImageBase = lpImageBase;
+		pItems[i].pExports	  = pExports;
+		pItems[i].lpName	  = (LPCSTR)lpImageBase + pExports->pNames[i];
+		pItems[i].wHint		  = (WORD)i;
+		pItems[i].dwExpected  = K22PeExportFindByName(lpImageBase, pExports, pItems[i].lpName, 0);
+	}
+	DWORD dwSeed = 2024;
+	for (DWORD i = dwNames - 1; i > 0; i--) {
+		DWORD j				 = K22TestRandom(&dwSeed) % (i + 1);
+		K22_BENCH_ITEM stTmp = pItems[i];
+		pItems[i]			 = pItems[j];
+		pItems[j]			 = stTmp;
+	}
+	pJob->dwCount += dwNames;
+	printf("%s: %lu names\n", lpName, (unsigned long)dwNames);
+	return TRUE;
+}
+
+static BOOL K22BenchCheck(PK22_BENCH_JOB pJob) {
+	// every lookup must match the serial one (forwarders aren't found by either)
+	for (DWORD i = 0; i < pJob->dwCount; i++) {
+		if (pJob->pItems[i].dwRva != pJob->pItems[i].dwExpected) {
+			printf("%s: wrong lookup result\n", pJob->pItems[i].lpName);
+			return FALSE;
+		}
+		pJob->pItems[i].dwRva = 0;
+	}
+	return TRUE;
+}
+
+static BOOL K22BenchJob(PK22_BENCH_JOB pJob, DWORD dwIterations) {
+	pJob->dwChunks = (pJob->dwCount + K22_PARALLEL_CHUNK - 1) / K22_PARALLEL_CHUNK;
+	DWORD dwCpus   = K22BenchCpuCount();
+	printf(
+		"%lu imports, %lu chunks, %lu CPUs - time per job (speedup over 1 thread):\n",
+		(unsigned long)pJob->dwCount,
+		(unsigned long)pJob->dwChunks,
+		(unsigned long)dwCpus
+	);
+
+	double dSearchUs = 0, dHintUs = 0;
+	// 1, 2, 4, ... threads, and all CPUs
+	for (DWORD dwThreads = 1;; dwThreads = dwThreads * 2 < dwCpus ? dwThreads * 2 : dwCpus) {
+		pJob->fHints   = FALSE;
+		double dSearch = K22BenchRun(pJob, dwThreads, dwIterations);
+		if (!K22BenchCheck(pJob))
+			return FALSE;
+		pJob->fHints = TRUE;
+		double dHint = K22BenchRun(pJob, dwThreads, dwIterations);
+		if (!K22BenchCheck(pJob))
+			return FALSE;
+		if (dwThreads == 1) {
+			dSearchUs = dSearch;
+			dHintUs	  = dHint;
+		}
+		printf(
+			"%2lu threads: %8.1f us (%.2fx) binary search, %8.1f us (%.2fx) hint\n",
+			(unsigned long)dwThreads,
+			dSearch,
+			dSearchUs / dSearch,
+			dHint,
+			dHintUs / dHint
+		);
+		if (dwThreads == dwCpus)
+			return TRUE;
+	}
+}
+
+int main(int argc, char **argv) {
+	DWORD dwIterations	= K22TestIterations(argc, argv, 200);
+	int iFirstFile		= argc >= 3 && strcmp(argv[1], "-i") == 0 ? 3 : 1;
+	K22_BENCH_JOB stJob = {0};
+	BOOL bSuccess		= TRUE;
+
+	if (iFirstFile >= argc) {
+		// about as many exports as kernel32.dll, in each module
+		K22_TEST_PE stPe[K22_BENCH_SYNTHETIC];
+		K22_PE_EXPORTS stExports[K22_BENCH_SYNTHETIC] = {0};
+		LPSTR *ppNames[K22_BENCH_SYNTHETIC];
+		for (DWORD i = 0; i < K22_BENCH_SYNTHETIC; i++) {
+			ppNames[i] = K22TestPeRandomNames(1700, i + 1);
+			if (ppNames[i] == NULL || !K22TestPeBuild(&stPe[i], TRUE, (LPCSTR *)ppNames[i], 1700, 0, 1) ||
+				!K22BenchAddModule(&stJob, "synthetic", stPe[i].pImage, &stExports[i])) {
+				printf("Couldn't build the synthetic image\n");
+				return 1;
+			}
+		}
+		bSuccess = K22BenchJob(&stJob, dwIterations);
+		for (DWORD i = 0; i < K22_BENCH_SYNTHETIC; i++) {
+			K22TestPeFree(&stPe[i]);
+			K22TestPeFreeNames(ppNames[i], 1700);
+		}
+		free(stJob.pItems);
+		return bSuccess ? 0 : 1;
+	}
+
+	DWORD dwFiles			 = argc - iFirstFile;
+	LPBYTE *ppImages		 = calloc(dwFiles, sizeof(LPBYTE));
+	PK22_PE_EXPORTS pExports = calloc(dwFiles, sizeof(K22_PE_EXPORTS));
+	for (DWORD i = 0; i < dwFiles; i++) {
+		DWORD cbImage;
+		ppImages[i] = K22TestPeLoad(argv[iFirstFile + i], &cbImage);
+		if (ppImages[i] == NULL) {
+			printf("%s: not a PE file\n", argv[iFirstFile + i]);
+			return 1;
+		}
+		// DLLs without exported names (e.g. resource-only) are skipped
+		K22BenchAddModule(&stJob, argv[iFirstFile + i], ppImages[i], &pExports[i]);
+	}
+	if (stJob.dwCount != 0)
+		bSuccess = K22BenchJob(&stJob, dwIterations);
+	for (DWORD i = 0; i < dwFiles; i++) {
+		free(ppImages[i]);
+	}
+	free(ppImages);
+	free(pExports);
+	free(stJob.pItems);
+	return bSuccess ? 0 : 1;
+}
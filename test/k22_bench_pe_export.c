@@ -0,0 +1,124 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-19.
+
+#include "k22_test_pe.h"
+
+// Export parser benchmark: k22_bench_pe_export [-i <iterations>] [<file.dll> ...]
+// PE files are read from disk and laid out like the loader maps them; without files, a synthetic image is used.
+// Every exported name is looked up in random order - by binary search, with the right hint (as imports have),
+// and by a linear scan of the name table for comparison.
+
+static volatile DWORD dwSink;
+
+static DWORD K22BenchLinearFind(LPCVOID lpImageBase, PK22_PE_EXPORTS pExports, LPCSTR lpSymbolName) {
+	for (DWORD i = 0; i < pExports->dwNumberOfNames; i++) {
+		if (strcmp((LPCSTR)lpImageBase + pExports->pNames[i], lpSymbolName) == 0)
+			return pExports->pFunctions[pExports->pNameOrdinals[i]];
+	}
+	return 0;
+}
+
+static VOID K22BenchImage(LPCSTR lpName, LPCVOID lpImageBase, DWORD dwIterations) {
+	K22_PE_EXPORTS stExports = {0};
+	if (!K22PeExportParse(lpImageBase, &stExports)) {
+		printf("%s: no exports\n", lpName);
+		return;
+	}
+	DWORD dwNames = stExports.dwNumberOfNames;
+	if (dwNames == 0) {
+		printf("%s: no exported names\n", lpName);
+		return;
+	}
+
+	// parsing the headers and the export directory
+	ULONGLONG ullStart = K22TestTimeNs();
+	for (DWORD i = 0; i < dwIterations * 1000; i++) {
+		K22_PE_EXPORTS stParse = {0};
+		dwSink += K22PeExportParse(lpImageBase, &stParse);
+	}
+	double dParseNs = (double)(K22TestTimeNs() - ullStart) / (dwIterations * 1000);
+
+	// lookup order - a random permutation of all names, each with its hint
+	LPCSTR *ppNames = malloc(dwNames * sizeof(LPCSTR));
+	PWORD pHints	= malloc(dwNames * sizeof(WORD));
+	for (DWORD i = 0; i < dwNames; i++) {
+		ppNames[i] = (LPCSTR)lpImageBase + stExports.pNames[i];
+		pHints[i]  = (WORD)i;
+	}
+	DWORD dwSeed = 2024;
+	for (DWORD i = dwNames - 1; i > 0; i--) {
+		DWORD j		  = K22TestRandom(&dwSeed) % (i + 1);
+		LPCSTR lpName = ppNames[i];
+		WORD wHint	  = pHints[i];
+		ppNames[i]	  = ppNames[j];
+		pHints[i]	  = pHints[j];
+		ppNames[j]	  = lpName;
+		pHints[j]	  = wHint;
+	}
+
+	ullStart = K22TestTimeNs();
+	for (DWORD n = 0; n < dwIterations; n++) {
+		for (DWORD i = 0; i < dwNames; i++) {
+			dwSink += K22PeExportFindByName(lpImageBase, &stExports, ppNames[i], 0);
+		}
+	}
+	double dSearchNs = (double)(K22TestTimeNs() - ullStart) / ((double)dwIterations * dwNames);
+
+	ullStart = K22TestTimeNs();
+	for (DWORD n = 0; n < dwIterations; n++) {
+		for (DWORD i = 0; i < dwNames; i++) {
+			dwSink += K22PeExportFindByName(lpImageBase, &stExports, ppNames[i], pHints[i]);
+		}
+	}
+	double dHintNs = (double)(K22TestTimeNs() - ullStart) / ((double)dwIterations * dwNames);
+
+	ullStart = K22TestTimeNs();
+	for (DWORD n = 0; n < dwIterations; n++) {
+		for (DWORD i = 0; i < dwNames; i++) {
+			dwSink += K22BenchLinearFind(lpImageBase, &stExports, ppNames[i]);
+		}
+	}
+	double dLinearNs = (double)(K22TestTimeNs() - ullStart) / ((double)dwIterations * dwNames);
+
+	printf(
+		"%s: %lu names - parse %.1f ns, lookup %.1f ns (binary search), %.1f ns (hint), %.1f ns (linear scan)\n",
+		lpName,
+		(unsigned long)dwNames,
+		dParseNs,
+		dSearchNs,
+		dHintNs,
+		dLinearNs
+	);
+	free(ppNames);
+	free(pHints);
+}
+
+int main(int argc, char **argv) {
+	DWORD dwIterations = K22TestIterations(argc, argv, 200);
+	int iFirstFile	   = argc >= 3 && strcmp(argv[1], "-i") == 0 ? 3 : 1;
+
+	if (iFirstFile >= argc) {
+		// about as many exports as kernel32.dll
+		LPSTR *ppNames = K22TestPeRandomNames(1700, 1);
+		K22_TEST_PE stPe;
+		if (ppNames == NULL || !K22TestPeBuild(&stPe, TRUE, (LPCSTR *)ppNames, 1700, 0, 1)) {
+			printf("Couldn't build the synthetic image\n");
+			return 1;
+		}
+		K22BenchImage("synthetic", stPe.pImage, dwIterations);
+		K22TestPeFree(&stPe);
+		K22TestPeFreeNames(ppNames, 1700);
+		return 0;
+	}
+
+	for (int i = iFirstFile; i < argc; i++) {
+		DWORD cbImage;
+		LPBYTE pImage = K22TestPeLoad(argv[i], &cbImage);
+		if (pImage == NULL) {
+			printf("%s: not a PE file\n", argv[i]);
+			return 1;
+		}
+		K22BenchImage(argv[i], pImage, dwIterations);
+		free(pImage);
+	}
+	return 0;
+}
@@ -0,0 +1,88 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-19.
+
+#include "k22_test.h"
+
+#include "k22_string.h"
+
+#ifdef _WIN32
+#define K22BenchStricmp	 _stricmp
+#define K22BenchStrnicmp _strnicmp
+#else
+#include <strings.h>
+#define K22BenchStricmp	 strcasecmp
+#define K22BenchStrnicmp strncasecmp
+#endif
+
+// String kernel benchmark: k22_bench_string [-i <iterations>]
+// Pairs of module-name-like strings (same text, random case) are compared with the K22String kernels
+// and with the C runtime's case-insensitive functions, for a few typical lengths.
+
+#define K22_BENCH_PAIRS 1024
+
+static volatile DWORD dwSink;
+
+static VOID K22BenchLength(DWORD cchString, DWORD dwIterations) {
+	LPSTR *ppStrings1 = malloc(K22_BENCH_PAIRS * sizeof(LPSTR));
+	LPSTR *ppStrings2 = malloc(K22_BENCH_PAIRS * sizeof(LPSTR));
+	DWORD dwSeed	  = cchString + 1;
+	for (DWORD i = 0; i < K22_BENCH_PAIRS; i++) {
+		ppStrings1[i] = malloc(cchString + 1);
+		ppStrings2[i] = malloc(cchString + 1);
+		for (DWORD j = 0; j < cchString; j++) {
+			CHAR cChar		 = (CHAR)('a' + K22TestRandom(&dwSeed) % 26);
+			ppStrings1[i][j] = cChar;
+			ppStrings2[i][j] = (K22TestRandom(&dwSeed) & 1) ? (CHAR)(cChar - ('a' - 'A')) : cChar;
+		}
+		ppStrings1[i][cchString] = '\0';
+		ppStrings2[i][cchString] = '\0';
+	}
+
+	double dNs[4];
+	for (DWORD dwMethod = 0; dwMethod < 4; dwMethod++) {
+		ULONGLONG ullStart = K22TestTimeNs();
+		for (DWORD n = 0; n < dwIterations; n++) {
+			for (DWORD i = 0; i < K22_BENCH_PAIRS; i++) {
+				switch (dwMethod) {
+					case 0:
+						dwSink += K22StringEquals(ppStrings1[i], ppStrings2[i]);
+						break;
+					case 1:
+						dwSink += K22BenchStricmp(ppStrings1[i], ppStrings2[i]) == 0;
+						break;
+					case 2:
+						dwSink += K22StringEqualsN(ppStrings1[i], ppStrings2[i], cchString);
+						break;
+					case 3:
+						dwSink += K22BenchStrnicmp(ppStrings1[i], ppStrings2[i], cchString) == 0;
+						break;
+				}
+			}
+		}
+		dNs[dwMethod] = (double)(K22TestTimeNs() - ullStart) / ((double)dwIterations * K22_BENCH_PAIRS);
+	}
+
+	printf(
+		"%2lu chars: K22StringEquals %5.1f ns, stricmp %5.1f ns | K22StringEqualsN %5.1f ns, strnicmp %5.1f ns\n",
+		(unsigned long)cchString,
+		dNs[0],
+		dNs[1],
+		dNs[2],
+		dNs[3]
+	);
+	for (DWORD i = 0; i < K22_BENCH_PAIRS; i++) {
+		free(ppStrings1[i]);
+		free(ppStrings2[i]);
+	}
+	free(ppStrings1);
+	free(ppStrings2);
+}
+
+int main(int argc, char **argv) {
+	DWORD dwIterations = K22TestIterations(argc, argv, 2000);
+	// short names (ntdll.dll), typical ones (kernel32.dll), API sets and long paths
+	DWORD dwLengths[] = {4, 9, 12, 16, 24, 36, 64};
+	for (DWORD i = 0; i < sizeof(dwLengths) / sizeof(*dwLengths); i++) {
+		K22BenchLength(dwLengths[i], dwIterations);
+	}
+	return 0;
+}
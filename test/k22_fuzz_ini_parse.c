@@ -0,0 +1,77 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-20.
+
+#include "k22_test_ini.h"
+
+// INI parser fuzz target - every input is parsed by K22IniParse() and compared with the reference reader.
+// With libFuzzer (clang, -DK22_FUZZ=ON): k22_fuzz_ini_parse [<libFuzzer options>] [<corpus dir> ...]
+// Standalone: k22_fuzz_ini_parse [-i <iterations>] [<file> ...] - runs the given files, or mutations of random files.
+// Inputs are copied to buffers of their exact size - build with ASan to catch reads past the end.
+
+int LLVMFuzzerTestOneInput(const BYTE *pData, SIZE_T cbData) {
+	if (K22TestIniCompare((LPCSTR)pData, cbData) != 0) {
+		printf("FAIL - parser and reference reader differ\n");
+		abort();
+	}
+	return 0;
+}
+
+#ifndef K22_FUZZ_LIBFUZZER
+
+static VOID K22FuzzRun(const BYTE *pInput, SIZE_T cbInput) {
+	LPBYTE pData = malloc(cbInput != 0 ? cbInput : 1);
+	if (pData == NULL)
+		return;
+	memcpy(pData, pInput, cbInput);
+	LLVMFuzzerTestOneInput(pData, cbInput);
+	free(pData);
+}
+
+static VOID K22FuzzMutate(LPBYTE pData, SIZE_T cbData, PDWORD pdwSeed) {
+	// overwrite some bytes with characters that the parser cares about, or with anything
+	static const CHAR szSyntax[] = "[]=;#\"\r\n \t\xEF\xBB\xBF";
+	DWORD dwCount				 = K22TestRandom(pdwSeed) % 8;
+	for (DWORD i = 0; i < dwCount && cbData != 0; i++) {
+		SIZE_T iByte = K22TestRandom(pdwSeed) % cbData;
+		if (K22TestRandom(pdwSeed) & 1)
+			pData[iByte] = (BYTE)szSyntax[K22TestRandom(pdwSeed) % (sizeof(szSyntax) - 1)];
+		else
+			pData[iByte] = (BYTE)K22TestRandom(pdwSeed);
+	}
+}
+
+int main(int argc, char **argv) {
+	DWORD dwIterations = K22TestIterations(argc, argv, 100000);
+	int iFirstFile	   = argc >= 3 && strcmp(argv[1], "-i") == 0 ? 3 : 1;
+
+	if (iFirstFile < argc) {
+		for (int i = iFirstFile; i < argc; i++) {
+			SIZE_T cbData;
+			LPBYTE pData = K22TestReadFile(argv[i], &cbData);
+			if (pData == NULL) {
+				printf("%s: couldn't read the file\n", argv[i]);
+				return 1;
+			}
+			K22FuzzRun(pData, cbData);
+			free(pData);
+		}
+		printf("PASSED - %d files\n", argc - iFirstFile);
+		return 0;
+	}
+
+	DWORD dwSeed = 2024;
+	for (DWORD i = 0; i < dwIterations; i++) {
+		SIZE_T cbData;
+		LPBYTE pData = (LPBYTE)K22TestIniRandom(K22TestRandom(&dwSeed) % 32, K22TestRandom(&dwSeed), &cbData);
+		if (pData == NULL)
+			return 1;
+		K22FuzzMutate(pData, cbData, &dwSeed);
+		// a random prefix, too
+		K22FuzzRun(pData, cbData != 0 ? K22TestRandom(&dwSeed) % (cbData + 1) : 0);
+		LLVMFuzzerTestOneInput(pData, cbData);
+		free(pData);
+	}
+	printf("PASSED - %lu inputs\n", (unsigned long)dwIterations * 2);
+	return 0;
+}
+
+#endif
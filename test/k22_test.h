@@ -0,0 +1,87 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-19.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "k22_portable.h"
+
+// Minimal test and benchmark helpers - the portable units can't use the core's logger.
+
+static inline PDWORD K22TestFailures() {
+	static DWORD dwFailures = 0;
+	return &dwFailures;
+}
+
+#define K22_TEST_CHECK(bCondition, ...)                                                                                \
+	do {                                                                                                               \
+		if (!(bCondition)) {                                                                                           \
+			printf("FAIL %s:%d: %s - ", __FILE__, __LINE__, #bCondition);                                              \
+			printf(__VA_ARGS__);                                                                                       \
+			printf("\n");                                                                                              \
+			(*K22TestFailures())++;                                                                                    \
+		}                                                                                                              \
+	} while (0)
+
+#define K22_TEST_RESULT()                                                                                              \
+	(printf("%s - %lu failures\n", *K22TestFailures() ? "FAILED" : "PASSED", (unsigned long)*K22TestFailures()),       \
+	 *K22TestFailures() ? 1 : 0)
+
+static inline ULONGLONG K22TestTimeNs() {
+	// monotonic time in nanoseconds
+#ifdef _WIN32
+	LARGE_INTEGER stTime, stFrequency;
+	QueryPerformanceCounter(&stTime);
+	QueryPerformanceFrequency(&stFrequency);
+	return (ULONGLONG)(stTime.QuadPart * 1000000000.0 / stFrequency.QuadPart);
+#else
+	struct timespec stTime;
+	clock_gettime(CLOCK_MONOTONIC, &stTime);
+	return (ULONGLONG)stTime.tv_sec * 1000000000 + stTime.tv_nsec;
+#endif
+}
+
+static inline DWORD K22TestRandom(PDWORD pdwState) {
+	// xorshift32 - deterministic input data for tests and benchmarks
+	DWORD dwValue = *pdwState;
+	dwValue ^= dwValue << 13;
+	dwValue ^= dwValue >> 17;
+	dwValue ^= dwValue << 5;
+	return *pdwState = dwValue;
+}
+
+static inline DWORD K22TestIterations(int argc, char **argv, DWORD dwDefault) {
+	// benchmarks take "-i <iterations>" as the first two arguments
+	if (argc >= 3 && strcmp(argv[1], "-i") == 0)
+		return (DWORD)strtoul(argv[2], NULL, 10);
+	return dwDefault;
+}
+
+static inline LPBYTE K22TestReadFile(LPCSTR lpPath, PSIZE_T pcbData) {
+	// read a whole file into memory (malloc), NULL-terminated
+	FILE *pFile = fopen(lpPath, "rb");
+	if (pFile == NULL)
+		return NULL;
+	LPBYTE pData = NULL;
+	if (fseek(pFile, 0, SEEK_END) == 0) {
+		long lSize = ftell(pFile);
+		if (lSize >= 0 && fseek(pFile, 0, SEEK_SET) == 0 && (pData = malloc(lSize + 1)) != NULL) {
+			if (fread(pData, 1, lSize, pFile) == (size_t)lSize) {
+				pData[lSize] = '\0';
+				*pcbData	 = lSize;
+			} else {
+				free(pData);
+				pData = NULL;
+			}
+		}
+	}
+	fclose(pFile);
+	return pData;
+}
@@ -0,0 +1,241 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-20.
+
+#include "k22_test_ini.h"
+
+typedef struct K22_TEST_INI_BLOCK {
+	struct K22_TEST_INI_BLOCK *pNext;
+} K22_TEST_INI_BLOCK, *PK22_TEST_INI_BLOCK;
+
+static PK22_TEST_INI_BLOCK pBlocks = NULL;
+
+PVOID K22TestIniAlloc(SIZE_T cbSize) {
+	// allocator for K22IniParse() - every entry is a separate malloc(), so that ASan checks its bounds
+	PK22_TEST_INI_BLOCK pBlock = malloc(sizeof(K22_TEST_INI_BLOCK) + cbSize);
+	if (pBlock == NULL)
+		return NULL;
+	pBlock->pNext = pBlocks;
+	pBlocks		  = pBlock;
+	return pBlock + 1;
+}
+
+VOID K22TestIniFreeAll() {
+	while (pBlocks != NULL) {
+		PK22_TEST_INI_BLOCK pNext = pBlocks->pNext;
+		free(pBlocks);
+		pBlocks = pNext;
+	}
+}
+
+static VOID K22TestIniTrim(PK22_STRING_VIEW pView) {
+	while (pView->cchData != 0 && (pView->lpData[0] == ' ' || pView->lpData[0] == '\t')) {
+		pView->lpData++;
+		pView->cchData--;
+	}
+	while (pView->cchData != 0) {
+		CHAR cLast = pView->lpData[pView->cchData - 1];
+		if (cLast != ' ' && cLast != '\t' && cLast != '\r')
+			break;
+		pView->cchData--;
+	}
+}
+
+VOID K22TestIniInit(PK22_TEST_INI_READER pReader, LPCSTR lpData, SIZE_T cbData) {
+	memset(pReader, 0, sizeof(*pReader));
+	// skip the UTF-8 BOM
+	if (cbData >= 3 && memcmp(lpData, "\xEF\xBB\xBF", 3) == 0) {
+		lpData += 3;
+		cbData -= 3;
+	}
+	pReader->lpNext = lpData;
+	pReader->lpEnd	= lpData + cbData;
+}
+
+BOOL K22TestIniRead(PK22_TEST_INI_READER pReader, PK22_STRING_VIEW pName, PK22_STRING_VIEW pValue) {
+	// read the next "name=value" line of the file; FALSE at the end of the file
+	// section headers only change stSection; empty lines and comments (starting with ';' or '#') are skipped
+	while (pReader->lpNext < pReader->lpEnd) {
+		LPCSTR lpLine = pReader->lpNext;
+		LPCSTR lpEol  = memchr(lpLine, '\n', pReader->lpEnd - lpLine);
+		if (lpEol == NULL)
+			lpEol = pReader->lpEnd;
+		pReader->lpNext = lpEol < pReader->lpEnd ? lpEol + 1 : lpEol;
+		pReader->dwLine++;
+
+		K22_STRING_VIEW stLine = {.lpData = lpLine, .cchData = (DWORD)(lpEol - lpLine)};
+		K22TestIniTrim(&stLine);
+		if (stLine.cchData == 0 || stLine.lpData[0] == ';' || stLine.lpData[0] == '#')
+			continue;
+		if (stLine.lpData[0] == '[') {
+			if (stLine.cchData < 2 || stLine.lpData[stLine.cchData - 1] != ']')
+				goto Error;
+			pReader->stSection.lpData  = stLine.lpData + 1;
+			pReader->stSection.cchData = stLine.cchData - 2;
+			K22TestIniTrim(&pReader->stSection);
+			continue;
+		}
+
+		LPCSTR lpEquals = memchr(stLine.lpData, '=', stLine.cchData);
+		if (lpEquals == NULL)
+			goto Error;
+		pName->lpData	= stLine.lpData;
+		pName->cchData	= (DWORD)(lpEquals - stLine.lpData);
+		pValue->lpData	= lpEquals + 1;
+		pValue->cchData = (DWORD)(stLine.lpData + stLine.cchData - pValue->lpData);
+		K22TestIniTrim(pName);
+		K22TestIniTrim(pValue);
+		if (pValue->cchData >= 2 && pValue->lpData[0] == '"' && pValue->lpData[pValue->cchData - 1] == '"') {
+			pValue->lpData++;
+			pValue->cchData -= 2;
+		}
+		return TRUE;
+
+	Error:
+		if (pReader->dwErrors++ == 0)
+			pReader->dwErrorLine = pReader->dwLine;
+	}
+	return FALSE;
+}
+
+static BOOL K22TestIniEquals(PK22_STRING_VIEW pView1, PK22_STRING_VIEW pView2) {
+	return pView1->cchData == pView2->cchData &&
+		   (pView1->cchData == 0 || memcmp(pView1->lpData, pView2->lpData, pView1->cchData) == 0);
+}
+
+DWORD K22TestIniCompare(LPCSTR lpData, SIZE_T cbData) {
+	// parse the file and compare every value of every section with the reference reader; returns the mismatches
+	K22_INI_FILE stFile;
+	if (!K22IniParse(&stFile, lpData, cbData, K22TestIniAlloc)) {
+		K22TestIniFreeAll();
+		return 1;
+	}
+	DWORD dwMismatches = 0;
+	DWORD dwSections   = 0;
+	K22_TEST_INI_READER stExpected;
+	K22_STRING_VIEW stExpectedName, stExpectedValue;
+	K22TestIniInit(&stExpected, lpData, cbData);
+
+	for (PK22_INI_SECTION pSection = stFile.pSections; pSection != NULL; pSection = pSection->pNext) {
+		dwSections++;
+		if (pSection->lpStart < lpData || pSection->lpStart > pSection->lpEnd || pSection->lpEnd > lpData + cbData)
+			dwMismatches++;
+		K22_INI_READER stReader;
+		K22_STRING_VIEW stName, stValue;
+		K22IniReadSection(&stReader, pSection);
+		while (K22IniRead(&stReader, &stName, &stValue)) {
+			if (!K22TestIniRead(&stExpected, &stExpectedName, &stExpectedValue)) {
+				dwMismatches++;
+				break;
+			}
+			dwMismatches += !K22TestIniEquals(&pSection->stName, &stExpected.stSection);
+			dwMismatches += !K22TestIniEquals(&stName, &stExpectedName);
+			dwMismatches += !K22TestIniEquals(&stValue, &stExpectedValue);
+			dwMismatches += stReader.dwLine != stExpected.dwLine;
+		}
+	}
+	// no values left, and the same counts
+	dwMismatches += K22TestIniRead(&stExpected, &stExpectedName, &stExpectedValue);
+	dwMismatches += dwSections != stFile.dwSections;
+	dwMismatches += stFile.dwLines != stExpected.dwLine;
+	dwMismatches += stFile.dwErrors != stExpected.dwErrors;
+	dwMismatches += stFile.dwErrorLine != stExpected.dwErrorLine;
+	K22TestIniFreeAll();
+	return dwMismatches;
+}
+
+static VOID K22TestIniAppend(LPSTR *ppData, PSIZE_T pcbData, PSIZE_T pcbCapacity, LPCSTR lpText, SIZE_T cbText) {
+	if (*ppData == NULL)
+		return;
+	if (*pcbData + cbText > *pcbCapacity) {
+		*pcbCapacity = (*pcbData + cbText) * 2;
+		LPSTR lpData = realloc(*ppData, *pcbCapacity);
+		if (lpData == NULL)
+			free(*ppData);
+		*ppData = lpData;
+		if (lpData == NULL)
+			return;
+	}
+	memcpy(*ppData + *pcbData, lpText, cbText);
+	*pcbData += cbText;
+}
+
+LPSTR K22TestIniRandom(DWORD dwLines, DWORD dwSeed, PSIZE_T pcbData) {
+	// headers, values, comments and invalid lines, with various spacing and line endings
+	// the file isn't NULL-terminated - it's allocated with its exact size, so that ASan catches reads past the end
+	static LPCSTR lpSections[] = {
+		"DllExtra",
+		"DllApiSet",
+		"DllRedirect",
+		"DllRewrite",
+		"DllRewrite\\kernel32.dll",
+		"PerApp\\app.exe\\DllRedirect",
+		"PerApp\\app.exe\\DllRewrite\\user32.dll",
+		"Plugin",
+	};
+	static LPCSTR lpNames[]	 = {"kernel32.dll", "user32.dll", "CreateFileW", "*", "", "a b", "x=y"};
+	static LPCSTR lpValues[] = {"kernelbase.dll", "", "\"  quoted  \"", "\"", "a=b", "ntdll.dll!NtClose", "\xC4\x85"};
+	static LPCSTR lpSpaces[] = {"", " ", "\t", "  \t "};
+	static LPCSTR lpEols[]	 = {"\n", "\r\n", "\r\r\n", "\n\n"};
+
+	SIZE_T cbData	  = 0;
+	SIZE_T cbCapacity = 256;
+	LPSTR lpData	  = malloc(cbCapacity);
+	CHAR szLine[256];
+	if (dwSeed & 1)
+		K22TestIniAppend(&lpData, &cbData, &cbCapacity, "\xEF\xBB\xBF", 3);
+	for (DWORD i = 0; i < dwLines; i++) {
+		LPCSTR lpSpace = lpSpaces[K22TestRandom(&dwSeed) % 4];
+		switch (K22TestRandom(&dwSeed) % 10) {
+			case 0:
+			case 1: {
+				LPCSTR lpSection = lpSections[K22TestRandom(&dwSeed) % 8];
+				sprintf(szLine, "%s[%s%s%s]%s", lpSpace, lpSpace, lpSection, lpSpace, lpSpace);
+				break;
+			}
+			case 2:
+				sprintf(szLine, "%s%s", lpSpace, (K22TestRandom(&dwSeed) & 1) ? "; comment" : "#[Section]=value");
+				break;
+			case 3:
+				sprintf(szLine, "%s", lpSpace);
+				break;
+			case 4:
+				sprintf(szLine, "%s%s", (K22TestRandom(&dwSeed) & 1) ? "[Unterminated" : "no equals sign", lpSpace);
+				break;
+			case 5: {
+				// random bytes
+				DWORD cchLine = K22TestRandom(&dwSeed) % 32;
+				for (DWORD j = 0; j < cchLine; j++) {
+					szLine[j] = (CHAR)(K22TestRandom(&dwSeed) % 255 + 1);
+				}
+				szLine[cchLine] = '\0';
+				break;
+			}
+			default:
+				sprintf(
+					szLine,
+					"%s%s%s=%s%s%s",
+					lpSpace,
+					lpNames[K22TestRandom(&dwSeed) % 7],
+					lpSpace,
+					lpSpace,
+					lpValues[K22TestRandom(&dwSeed) % 7],
+					lpSpace
+				);
+				break;
+		}
+		K22TestIniAppend(&lpData, &cbData, &cbCapacity, szLine, strlen(szLine));
+		// the last line may be unterminated
+		if (i + 1 < dwLines || (dwSeed & 2)) {
+			LPCSTR lpEol = lpEols[K22TestRandom(&dwSeed) % 4];
+			K22TestIniAppend(&lpData, &cbData, &cbCapacity, lpEol, strlen(lpEol));
+		}
+	}
+	if (lpData == NULL)
+		return NULL;
+	// exact size - at least one byte, as malloc(0) may return NULL
+	LPSTR lpExact = malloc(cbData != 0 ? cbData : 1);
+	if (lpExact != NULL)
+		memcpy(lpExact, lpData, cbData);
+	free(lpData);
+	*pcbData = cbData;
+	return lpExact;
+}
@@ -0,0 +1,27 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-20.
+
+#pragma once
+
+#include "k22_test.h"
+
+#include "k22_ini.h"
+
+// Configuration files for the INI parser tests - random files, and a reference reader to compare the parser with.
+// The reference reads the whole file line by line, tracking the current section (like the reader K22IniParse()
+// replaced); walking all sections of the index must give the same values, in the same order.
+
+typedef struct {
+	LPCSTR lpNext;			   // start of the next line
+	LPCSTR lpEnd;			   // end of the file
+	DWORD dwLine;			   // number of the last line read
+	DWORD dwErrors;			   // number of lines that couldn't be parsed
+	DWORD dwErrorLine;		   // number of the first such line
+	K22_STRING_VIEW stSection; // name of the current section
+} K22_TEST_INI_READER, *PK22_TEST_INI_READER;
+
+VOID K22TestIniInit(PK22_TEST_INI_READER pReader, LPCSTR lpData, SIZE_T cbData);
+BOOL K22TestIniRead(PK22_TEST_INI_READER pReader, PK22_STRING_VIEW pName, PK22_STRING_VIEW pValue);
+DWORD K22TestIniCompare(LPCSTR lpData, SIZE_T cbData);
+LPSTR K22TestIniRandom(DWORD dwLines, DWORD dwSeed, PSIZE_T pcbData);
+PVOID K22TestIniAlloc(SIZE_T cbSize);
+VOID K22TestIniFreeAll();
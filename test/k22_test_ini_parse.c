@@ -0,0 +1,132 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-20.
+
+#include "k22_test_ini.h"
+
+static BOOL K22TestViewIs(PK22_STRING_VIEW pView, LPCSTR lpExpected) {
+	return pView->cchData == strlen(lpExpected) && memcmp(pView->lpData, lpExpected, pView->cchData) == 0;
+}
+
+static VOID K22TestSections() {
+	static const CHAR szFile[] = "\xEF\xBB\xBF"
+								 "; comment\n"
+								 "Early=value\n"
+								 "[DllRedirect]\r\n"
+								 "  kernel32.dll = kernelbase.dll  \r\n"
+								 "\n"
+								 "# comment\n"
+								 "invalid line\n"
+								 "[ DllRewrite\\user32.dll ]\n"
+								 "Spaced=\"  quoted  \"\n"
+								 "[Unterminated\n"
+								 "Equals=a=b\n"
+								 "[DllRedirect]\n"
+								 "last=line";
+	K22_INI_FILE stFile;
+	if (!K22IniParse(&stFile, szFile, sizeof(szFile) - 1, K22TestIniAlloc)) {
+		K22_TEST_CHECK(FALSE, "couldn't parse");
+		return;
+	}
+	K22_TEST_CHECK(stFile.dwSections == 4, "%lu sections", (unsigned long)stFile.dwSections);
+	K22_TEST_CHECK(stFile.dwValues == 5, "%lu values", (unsigned long)stFile.dwValues);
+	K22_TEST_CHECK(stFile.dwLines == 13, "%lu lines", (unsigned long)stFile.dwLines);
+	K22_TEST_CHECK(stFile.dwErrors == 2, "%lu errors", (unsigned long)stFile.dwErrors);
+	K22_TEST_CHECK(stFile.dwErrorLine == 7, "first error at %lu", (unsigned long)stFile.dwErrorLine);
+
+	// section name, header line, then name, value and line of each value
+	static const struct {
+		LPCSTR lpSection;
+		DWORD dwLine;
+		LPCSTR lpValues[2][2];
+		DWORD dwValueLines[2];
+	} stExpected[] = {
+		{"", 0, {{"Early", "value"}}, {2}},
+		{"DllRedirect", 3, {{"kernel32.dll", "kernelbase.dll"}}, {4}},
+		{"DllRewrite\\user32.dll", 8, {{"Spaced", "  quoted  "}, {"Equals", "a=b"}}, {9, 11}},
+		{"DllRedirect", 12, {{"last", "line"}}, {13}},
+	};
+	PK22_INI_SECTION pSection = stFile.pSections;
+	for (DWORD i = 0; i < 4 && pSection != NULL; i++, pSection = pSection->pNext) {
+		K22_TEST_CHECK(K22TestViewIs(&pSection->stName, stExpected[i].lpSection), "section %lu", (unsigned long)i);
+		K22_TEST_CHECK(pSection->dwLine == stExpected[i].dwLine, "section %lu line", (unsigned long)i);
+		K22_INI_READER stReader;
+		K22_STRING_VIEW stName, stValue;
+		K22IniReadSection(&stReader, pSection);
+		DWORD dwValue = 0;
+		while (K22IniRead(&stReader, &stName, &stValue)) {
+			if (dwValue >= 2 || stExpected[i].lpValues[dwValue][0] == NULL) {
+				K22_TEST_CHECK(FALSE, "section %lu, extra value", (unsigned long)i);
+				break;
+			}
+			const LPCSTR *ppExpected = stExpected[i].lpValues[dwValue];
+			K22_TEST_CHECK(K22TestViewIs(&stName, ppExpected[0]), "section %lu name", (unsigned long)i);
+			K22_TEST_CHECK(K22TestViewIs(&stValue, ppExpected[1]), "section %lu value", (unsigned long)i);
+			K22_TEST_CHECK(
+				stReader.dwLine == stExpected[i].dwValueLines[dwValue],
+				"section %lu line",
+				(unsigned long)i
+			);
+			dwValue++;
+		}
+		K22_TEST_CHECK(dwValue == 2 || stExpected[i].lpValues[dwValue][0] == NULL, "section %lu", (unsigned long)i);
+	}
+	K22_TEST_CHECK(pSection == NULL, "extra sections");
+	K22TestIniFreeAll();
+}
+
+static VOID K22TestEmpty() {
+	// empty files, and files without values - no sections at all
+	LPCSTR lpFiles[] = {"", "\xEF\xBB\xBF", "\n\n", "; comment", "junk", "[Unterminated"};
+	for (DWORD i = 0; i < sizeof(lpFiles) / sizeof(*lpFiles); i++) {
+		K22_INI_FILE stFile;
+		BOOL bParsed = K22IniParse(&stFile, lpFiles[i], strlen(lpFiles[i]), K22TestIniAlloc);
+		K22_TEST_CHECK(bParsed, "file %lu", (unsigned long)i);
+		K22_TEST_CHECK(stFile.pSections == NULL && stFile.dwValues == 0, "file %lu", (unsigned long)i);
+	}
+	K22_INI_FILE stFile;
+	K22_TEST_CHECK(K22IniParse(&stFile, NULL, 0, K22TestIniAlloc) && stFile.pSections == NULL, "no file");
+
+	// an empty section has an empty range
+	K22_TEST_CHECK(K22IniParse(&stFile, "[a]\n[b]", 7, K22TestIniAlloc), "empty sections");
+	K22_TEST_CHECK(stFile.dwSections == 2, "%lu sections", (unsigned long)stFile.dwSections);
+	if (stFile.dwSections == 2) {
+		K22_TEST_CHECK(stFile.pSections->lpStart == stFile.pSections->lpEnd, "first range");
+		K22_TEST_CHECK(stFile.pSections->pNext->lpStart == stFile.pSections->pNext->lpEnd, "second range");
+	}
+	K22TestIniFreeAll();
+}
+
+static PVOID K22TestAllocFail(SIZE_T cbSize) {
+	(void)cbSize;
+	return NULL;
+}
+
+static VOID K22TestRandomFiles() {
+	// random files give the same values as the reference reader
+	for (DWORD dwSeed = 1; dwSeed <= 2000; dwSeed++) {
+		SIZE_T cbData;
+		LPSTR lpData = K22TestIniRandom(dwSeed % 64, dwSeed, &cbData);
+		if (lpData == NULL) {
+			K22_TEST_CHECK(FALSE, "couldn't build the file");
+			return;
+		}
+		DWORD dwMismatches = K22TestIniCompare(lpData, cbData);
+		K22_TEST_CHECK(
+			dwMismatches == 0,
+			"seed %lu, %lu mismatches",
+			(unsigned long)dwSeed,
+			(unsigned long)dwMismatches
+		);
+		free(lpData);
+	}
+
+	// allocation failures are reported
+	K22_INI_FILE stFile;
+	K22_TEST_CHECK(!K22IniParse(&stFile, "[a]\nb=c\n", 8, K22TestAllocFail), "allocation failure");
+}
+
+int main() {
+	K22TestSections();
+	K22TestEmpty();
+	K22TestRandomFiles();
+	return K22_TEST_RESULT();
+}
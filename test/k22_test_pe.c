@@ -0,0 +1,209 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-19.
+
+#include "k22_test_pe.h"
+
+#define K22_TEST_PE_NT_OFFSET	0x40
+#define K22_TEST_PE_EXPORTS_RVA 0x1000
+#define K22_TEST_PE_ALIGN(x)	(((x) + 0xFFF) & ~0xFFF)
+
+static int K22TestPeCompareNames(const void *pName1, const void *pName2) {
+	return strcmp(*(LPCSTR *)pName1, *(LPCSTR *)pName2);
+}
+
+BOOL K22TestPeBuild(
+	PK22_TEST_PE pPe,
+	BOOL fPe64,
+	LPCSTR *ppNames,
+	DWORD dwNames,
+	DWORD dwForwarders,
+	DWORD dwOrdinalBase
+) {
+	// build an image exporting ppNames (sorted and deduplicated here), followed by dwForwarders forwarded functions
+	memset(pPe, 0, sizeof(*pPe));
+	LPCSTR *ppSorted = malloc((dwNames + 1) * sizeof(LPCSTR));
+	if (ppSorted == NULL)
+		return FALSE;
+	memcpy(ppSorted, ppNames, dwNames * sizeof(LPCSTR));
+	qsort(ppSorted, dwNames, sizeof(LPCSTR), K22TestPeCompareNames);
+	DWORD dwUnique = 0;
+	for (DWORD i = 0; i < dwNames; i++) {
+		if (dwUnique == 0 || strcmp(ppSorted[dwUnique - 1], ppSorted[i]) != 0)
+			ppSorted[dwUnique++] = ppSorted[i];
+	}
+	dwNames = dwUnique;
+
+	// export directory, tables and strings - all within the directory, like linkers put them
+	DWORD dwFunctions	 = dwNames + dwForwarders;
+	DWORD dwFunctionsRva = K22_TEST_PE_EXPORTS_RVA + sizeof(IMAGE_EXPORT_DIRECTORY);
+	DWORD dwNamesRva	 = dwFunctionsRva + dwFunctions * 4;
+	DWORD dwOrdinalsRva	 = dwNamesRva + dwNames * 4;
+	DWORD dwStringsRva	 = dwOrdinalsRva + dwNames * 2;
+	DWORD cbStrings		 = 0;
+	for (DWORD i = 0; i < dwNames; i++) {
+		cbStrings += strlen(ppSorted[i]) + 1;
+	}
+	cbStrings += dwForwarders * sizeof("OTHER.Forwarded00000");
+	DWORD dwDirectoryEnd = dwStringsRva + cbStrings;
+	DWORD dwCodeRva		 = K22_TEST_PE_ALIGN(dwDirectoryEnd);
+	DWORD cbImage		 = K22_TEST_PE_ALIGN(dwCodeRva + dwFunctions * 16);
+
+	LPBYTE pImage = calloc(1, cbImage);
+	if (pImage == NULL) {
+		free(ppSorted);
+		return FALSE;
+	}
+	PIMAGE_DOS_HEADER pDosHeader = (PIMAGE_DOS_HEADER)pImage;
+	pDosHeader->e_magic			 = IMAGE_DOS_SIGNATURE;
+	pDosHeader->e_lfanew		 = K22_TEST_PE_NT_OFFSET;
+	PIMAGE_DATA_DIRECTORY pDataDirectory;
+	if (fPe64) {
+		PIMAGE_NT_HEADERS64 pNt					= (PIMAGE_NT_HEADERS64)(pImage + K22_TEST_PE_NT_OFFSET);
+		pNt->Signature							= IMAGE_NT_SIGNATURE;
+		pNt->FileHeader.SizeOfOptionalHeader	= sizeof(pNt->OptionalHeader);
+		pNt->OptionalHeader.Magic				= IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+		pNt->OptionalHeader.SizeOfImage			= cbImage;
+		pNt->OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+		pDataDirectory							= pNt->OptionalHeader.DataDirectory;
+	} else {
+		PIMAGE_NT_HEADERS32 pNt					= (PIMAGE_NT_HEADERS32)(pImage + K22_TEST_PE_NT_OFFSET);
+		pNt->Signature							= IMAGE_NT_SIGNATURE;
+		pNt->FileHeader.SizeOfOptionalHeader	= sizeof(pNt->OptionalHeader);
+		pNt->OptionalHeader.Magic				= IMAGE_NT_OPTIONAL_HDR32_MAGIC;
+		pNt->OptionalHeader.SizeOfImage			= cbImage;
+		pNt->OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+		pDataDirectory							= pNt->OptionalHeader.DataDirectory;
+	}
+	pDataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress = K22_TEST_PE_EXPORTS_RVA;
+	pDataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].Size			= dwDirectoryEnd - K22_TEST_PE_EXPORTS_RVA;
+
+	// a read-only section with the export directory, and an executable one with the functions
+	PIMAGE_NT_HEADERS32 pNt			 = (PIMAGE_NT_HEADERS32)(pImage + K22_TEST_PE_NT_OFFSET);
+	PIMAGE_SECTION_HEADER pSections	 = IMAGE_FIRST_SECTION(pNt);
+	pNt->FileHeader.NumberOfSections = 2;
+	pSections[0].VirtualAddress		 = K22_TEST_PE_EXPORTS_RVA;
+	pSections[0].VirtualSize		 = dwDirectoryEnd - K22_TEST_PE_EXPORTS_RVA;
+	pSections[0].Characteristics	 = 0x40000040; // initialized data, readable
+	pSections[1].VirtualAddress		 = dwCodeRva;
+	pSections[1].VirtualSize		 = dwFunctions * 16;
+	pSections[1].Characteristics	 = 0x60000020; // code, executable, readable
+
+	PIMAGE_EXPORT_DIRECTORY pExportDirectory = (PIMAGE_EXPORT_DIRECTORY)(pImage + K22_TEST_PE_EXPORTS_RVA);
+	pExportDirectory->Base					 = dwOrdinalBase;
+	pExportDirectory->NumberOfFunctions		 = dwFunctions;
+	pExportDirectory->NumberOfNames			 = dwNames;
+	pExportDirectory->AddressOfFunctions	 = dwFunctionsRva;
+	pExportDirectory->AddressOfNames		 = dwNamesRva;
+	pExportDirectory->AddressOfNameOrdinals	 = dwOrdinalsRva;
+
+	PDWORD pFunctions	= (PDWORD)(pImage + dwFunctionsRva);
+	PDWORD pNames		= (PDWORD)(pImage + dwNamesRva);
+	PWORD pNameOrdinals = (PWORD)(pImage + dwOrdinalsRva);
+	DWORD dwStringRva	= dwStringsRva;
+	for (DWORD i = 0; i < dwNames; i++) {
+		pFunctions[i]	 = dwCodeRva + i * 16;
+		pNames[i]		 = dwStringRva;
+		pNameOrdinals[i] = (WORD)(dwNames - 1 - i);
+		strcpy((LPSTR)pImage + dwStringRva, ppSorted[i]);
+		ppSorted[i] = (LPCSTR)pImage + dwStringRva;
+		dwStringRva += strlen(ppSorted[i]) + 1;
+	}
+	for (DWORD i = dwNames; i < dwFunctions; i++) {
+		pFunctions[i] = dwStringRva;
+		dwStringRva += sprintf((LPSTR)pImage + dwStringRva, "OTHER.Forwarded%05lu", (unsigned long)i) + 1;
+	}
+
+	pPe->pImage		   = pImage;
+	pPe->cbImage	   = cbImage;
+	pPe->ppNames	   = ppSorted;
+	pPe->dwNames	   = dwNames;
+	pPe->dwFunctions   = dwFunctions;
+	pPe->dwOrdinalBase = dwOrdinalBase;
+	pPe->dwCodeRva	   = dwCodeRva;
+	return TRUE;
+}
+
+VOID K22TestPeFree(PK22_TEST_PE pPe) {
+	free(pPe->pImage);
+	free(pPe->ppNames);
+	memset(pPe, 0, sizeof(*pPe));
+}
+
+LPSTR *K22TestPeRandomNames(DWORD dwCount, DWORD dwSeed) {
+	// API-like names (CreateFileW, RtlQueryProcessHeap, ...) - duplicates are possible
+	static LPCSTR lpPrefixes[] = {"", "Rtl", "Nt", "Zw", "Ldr", "Csr", "Etw", "Tp", "Wer", "Base"};
+	static LPCSTR lpVerbs[]	   = {"Create", "Get", "Set", "Query", "Open", "Close", "Enum", "Find", "Load", "Map"};
+	static LPCSTR lpNouns[]	   = {"File", "Process", "Thread", "Heap", "Module", "Section", "Event", "Key",
+								  "Value", "Console", "Window", "Timer", "Token", "Path", "String", "Memory"};
+	static LPCSTR lpSuffixes[] = {"", "A", "W", "Ex", "ExA", "ExW", "Internal", "2"};
+	LPSTR *ppNames			   = malloc(dwCount * sizeof(LPSTR));
+	for (DWORD i = 0; ppNames != NULL && i < dwCount; i++) {
+		ppNames[i] = malloc(64);
+		sprintf(
+			ppNames[i],
+			"%s%s%s%s%s",
+			lpPrefixes[K22TestRandom(&dwSeed) % 10],
+			lpVerbs[K22TestRandom(&dwSeed) % 10],
+			lpNouns[K22TestRandom(&dwSeed) % 16],
+			lpNouns[K22TestRandom(&dwSeed) % 16],
+			lpSuffixes[K22TestRandom(&dwSeed) % 8]
+		);
+	}
+	return ppNames;
+}
+
+VOID K22TestPeFreeNames(LPSTR *ppNames, DWORD dwCount) {
+	for (DWORD i = 0; ppNames != NULL && i < dwCount; i++) {
+		free(ppNames[i]);
+	}
+	free(ppNames);
+}
+
+LPBYTE K22TestPeLoad(LPCSTR lpPath, PDWORD pcbImage) {
+	// read a PE file and lay its sections out at their RVAs, like the loader does (without relocations)
+	SIZE_T cbFile;
+	LPBYTE pFile = K22TestReadFile(lpPath, &cbFile);
+	if (pFile == NULL)
+		return NULL;
+	LPBYTE pImage				 = NULL;
+	PIMAGE_DOS_HEADER pDosHeader = (PIMAGE_DOS_HEADER)pFile;
+	if (cbFile < sizeof(*pDosHeader) || pDosHeader->e_magic != IMAGE_DOS_SIGNATURE || pDosHeader->e_lfanew <= 0 ||
+		(SIZE_T)pDosHeader->e_lfanew + sizeof(IMAGE_NT_HEADERS64) > cbFile)
+		goto End;
+	PIMAGE_NT_HEADERS32 pNt32 = (PIMAGE_NT_HEADERS32)(pFile + pDosHeader->e_lfanew);
+	PIMAGE_NT_HEADERS64 pNt64 = (PIMAGE_NT_HEADERS64)pNt32;
+	if (pNt32->Signature != IMAGE_NT_SIGNATURE)
+		goto End;
+	DWORD cbImage, cbHeaders;
+	if (pNt64->OptionalHeader.Magic == IMAGE_NT_OPTIONAL_HDR64_MAGIC) {
+		cbImage	  = pNt64->OptionalHeader.SizeOfImage;
+		cbHeaders = pNt64->OptionalHeader.SizeOfHeaders;
+	} else {
+		cbImage	  = pNt32->OptionalHeader.SizeOfImage;
+		cbHeaders = pNt32->OptionalHeader.SizeOfHeaders;
+	}
+	if (cbImage == 0 || cbImage > 0x20000000 || cbHeaders > cbImage || cbHeaders > cbFile)
+		goto End;
+	PIMAGE_SECTION_HEADER pSection = IMAGE_FIRST_SECTION(pNt32);
+	if ((LPBYTE)(pSection + pNt32->FileHeader.NumberOfSections) > pFile + cbFile)
+		goto End;
+
+	pImage = calloc(1, cbImage);
+	if (pImage == NULL)
+		goto End;
+	memcpy(pImage, pFile, cbHeaders);
+	for (WORD i = 0; i < pNt32->FileHeader.NumberOfSections; i++, pSection++) {
+		DWORD cbRaw = pSection->SizeOfRawData;
+		if (pSection->VirtualSize != 0 && pSection->VirtualSize < cbRaw)
+			cbRaw = pSection->VirtualSize;
+		if (pSection->PointerToRawData > cbFile || cbRaw > cbFile - pSection->PointerToRawData)
+			cbRaw = 0;
+		if (pSection->VirtualAddress > cbImage || cbRaw > cbImage - pSection->VirtualAddress)
+			cbRaw = 0;
+		memcpy(pImage + pSection->VirtualAddress, pFile + pSection->PointerToRawData, cbRaw);
+	}
+	*pcbImage = cbImage;
+
+End:
+	free(pFile);
+	return pImage;
+}
@@ -0,0 +1,32 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-19.
+
+#pragma once
+
+#include "k22_test.h"
+
+#include "k22_pe_export.h"
+
+// Synthetic PE images with an export table, and PE files laid out like the loader maps them.
+
+typedef struct {
+	LPBYTE pImage;		 // image laid out in memory
+	DWORD cbImage;		 // SizeOfImage
+	LPCSTR *ppNames;	 // exported names, sorted (pointing into pImage)
+	DWORD dwNames;		 // number of exported names; name i is function dwNames - 1 - i
+	DWORD dwFunctions;	 // named functions, then forwarders (exported by ordinal only)
+	DWORD dwOrdinalBase; // ordinal of function 0
+	DWORD dwCodeRva;	 // function i is at dwCodeRva + i * 16, in the only executable section
+} K22_TEST_PE, *PK22_TEST_PE;
+
+BOOL K22TestPeBuild(
+	PK22_TEST_PE pPe,
+	BOOL fPe64,
+	LPCSTR *ppNames,
+	DWORD dwNames,
+	DWORD dwForwarders,
+	DWORD dwOrdinalBase
+);
+VOID K22TestPeFree(PK22_TEST_PE pPe);
+LPSTR *K22TestPeRandomNames(DWORD dwCount, DWORD dwSeed);
+VOID K22TestPeFreeNames(LPSTR *ppNames, DWORD dwCount);
+LPBYTE K22TestPeLoad(LPCSTR lpPath, PDWORD pcbImage);
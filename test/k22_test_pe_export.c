@@ -0,0 +1,178 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-19.
+
+#include "k22_test_pe.h"
+
+static VOID K22TestLookups(BOOL fPe64) {
+	LPCSTR lpNames[] = {"GetProcAddress", "LoadLibraryA", "LoadLibraryW", "CreateFileW", "ExitProcess", "a", "z"};
+	K22_TEST_PE stPe;
+	if (!K22TestPeBuild(&stPe, fPe64, lpNames, 7, 3, 5)) {
+		K22_TEST_CHECK(FALSE, "couldn't build the image");
+		return;
+	}
+	K22_PE_EXPORTS stExports = {0};
+	K22_TEST_CHECK(K22PeExportParse(stPe.pImage, &stExports), "PE%d", fPe64 ? 64 : 32);
+	K22_TEST_CHECK(stExports.dwNumberOfNames == 7, "%lu names", (unsigned long)stExports.dwNumberOfNames);
+	K22_TEST_CHECK(stExports.dwNumberOfFunctions == 10, "%lu funcs", (unsigned long)stExports.dwNumberOfFunctions);
+
+	for (DWORD i = 0; i < stPe.dwNames; i++) {
+		DWORD dwExpected = stPe.dwCodeRva + (stPe.dwNames - 1 - i) * 16;
+		LPCSTR lpName	 = stPe.ppNames[i];
+		// binary search, right hint, wrong hint
+		K22_TEST_CHECK(K22PeExportFindByName(stPe.pImage, &stExports, lpName, 0) == dwExpected, "%s", lpName);
+		K22_TEST_CHECK(K22PeExportFindByName(stPe.pImage, &stExports, lpName, i) == dwExpected, "%s, hint", lpName);
+		K22_TEST_CHECK(K22PeExportFindByName(stPe.pImage, &stExports, lpName, 999) == dwExpected, "%s, hint", lpName);
+		// by ordinal
+		DWORD dwOrdinal = stPe.dwOrdinalBase + stPe.dwNames - 1 - i;
+		DWORD dwRva		= K22PeExportFindByOrdinal(stPe.pImage, &stExports, dwOrdinal);
+		K22_TEST_CHECK(dwRva == dwExpected, "#%lu", (unsigned long)dwOrdinal);
+	}
+
+	// names sorting before, between and after the exported ones, and case mismatches
+	LPCSTR lpMissing[] = {"", "A", "GetProcAddressA", "GetProcAddres", "getprocaddress", "zz", "\xff"};
+	for (DWORD i = 0; i < sizeof(lpMissing) / sizeof(*lpMissing); i++) {
+		K22_TEST_CHECK(K22PeExportFindByName(stPe.pImage, &stExports, lpMissing[i], 0) == 0, "'%s'", lpMissing[i]);
+	}
+	// ordinals below the base, forwarders and past the end
+	K22_TEST_CHECK(K22PeExportFindByOrdinal(stPe.pImage, &stExports, 0) == 0, "#0");
+	K22_TEST_CHECK(K22PeExportFindByOrdinal(stPe.pImage, &stExports, 4) == 0, "#4");
+	for (DWORD i = stPe.dwNames; i < stPe.dwFunctions; i++) {
+		DWORD dwOrdinal = stPe.dwOrdinalBase + i;
+		DWORD dwRva		= K22PeExportFindByOrdinal(stPe.pImage, &stExports, dwOrdinal);
+		K22_TEST_CHECK(dwRva == 0, "forwarder #%lu", (unsigned long)dwOrdinal);
+	}
+	K22_TEST_CHECK(K22PeExportFindByOrdinal(stPe.pImage, &stExports, 5 + stPe.dwFunctions) == 0, "past the end");
+	K22TestPeFree(&stPe);
+}
+
+static VOID K22TestManyNames() {
+	// every name of a large table is found, with the binary search only
+	LPSTR *ppNames = K22TestPeRandomNames(5000, 22);
+	K22_TEST_PE stPe;
+	if (ppNames == NULL || !K22TestPeBuild(&stPe, TRUE, (LPCSTR *)ppNames, 5000, 0, 1)) {
+		K22_TEST_CHECK(FALSE, "couldn't build the image");
+		return;
+	}
+	K22_PE_EXPORTS stExports = {0};
+	DWORD dwFound			 = 0;
+	for (DWORD i = 0; i < stPe.dwNames; i++) {
+		DWORD dwRva = K22PeExportFindByName(stPe.pImage, &stExports, stPe.ppNames[i], 0);
+		if (dwRva == stPe.dwCodeRva + (stPe.dwNames - 1 - i) * 16)
+			dwFound++;
+	}
+	K22_TEST_CHECK(dwFound == stPe.dwNames, "found %lu of %lu", (unsigned long)dwFound, (unsigned long)stPe.dwNames);
+	K22TestPeFree(&stPe);
+	K22TestPeFreeNames(ppNames, 5000);
+}
+
+static VOID K22TestInvalid() {
+	LPCSTR lpNames[] = {"Function"};
+	K22_TEST_PE stPe;
+	if (!K22TestPeBuild(&stPe, TRUE, lpNames, 1, 0, 1)) {
+		K22_TEST_CHECK(FALSE, "couldn't build the image");
+		return;
+	}
+	PIMAGE_NT_HEADERS64 pNt				   = (PIMAGE_NT_HEADERS64)(stPe.pImage + 0x40);
+	PIMAGE_DATA_DIRECTORY pDirectory	   = &pNt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+	PIMAGE_EXPORT_DIRECTORY pExportDir	   = (PIMAGE_EXPORT_DIRECTORY)(stPe.pImage + pDirectory->VirtualAddress);
+	IMAGE_EXPORT_DIRECTORY stExportDirOrig = *pExportDir;
+	IMAGE_DATA_DIRECTORY stDirectoryOrig   = *pDirectory;
+	K22_PE_EXPORTS stExports;
+
+	// the result is remembered, also when parsing fails
+	memset(&stExports, 0, sizeof(stExports));
+	pNt->OptionalHeader.Magic = 0x1234;
+	K22_TEST_CHECK(!K22PeExportParse(stPe.pImage, &stExports), "bad optional header magic");
+	K22_TEST_CHECK(stExports.fParsed, "parse result not remembered");
+	K22_TEST_CHECK(K22PeExportFindByName(stPe.pImage, &stExports, "Function", 0) == 0, "lookup without exports");
+	pNt->OptionalHeader.Magic = IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+
+	memset(&stExports, 0, sizeof(stExports));
+	pNt->Signature = 0;
+	K22_TEST_CHECK(!K22PeExportParse(stPe.pImage, &stExports), "bad signature");
+	pNt->Signature = IMAGE_NT_SIGNATURE;
+
+	memset(&stExports, 0, sizeof(stExports));
+	pNt->OptionalHeader.NumberOfRvaAndSizes = 0;
+	K22_TEST_CHECK(!K22PeExportParse(stPe.pImage, &stExports), "no data directories");
+	pNt->OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+
+	memset(&stExports, 0, sizeof(stExports));
+	pDirectory->VirtualAddress = stPe.cbImage - 8;
+	K22_TEST_CHECK(!K22PeExportParse(stPe.pImage, &stExports), "directory past the image");
+	*pDirectory = stDirectoryOrig;
+
+	memset(&stExports, 0, sizeof(stExports));
+	pExportDir->NumberOfNames = 0x10000000;
+	K22_TEST_CHECK(!K22PeExportParse(stPe.pImage, &stExports), "name table past the image");
+	*pExportDir = stExportDirOrig;
+
+	memset(&stExports, 0, sizeof(stExports));
+	pExportDir->AddressOfFunctions = stPe.cbImage;
+	K22_TEST_CHECK(!K22PeExportParse(stPe.pImage, &stExports), "address table past the image");
+	*pExportDir = stExportDirOrig;
+
+	// a name pointing outside of the image is skipped, not read
+	memset(&stExports, 0, sizeof(stExports));
+	PDWORD pNames = (PDWORD)(stPe.pImage + pExportDir->AddressOfNames);
+	DWORD dwName  = pNames[0];
+	pNames[0]	  = 0xFFFFFFF0;
+	K22_TEST_CHECK(K22PeExportFindByName(stPe.pImage, &stExports, "Function", 0) == 0, "name past the image");
+	pNames[0] = dwName;
+
+	memset(&stExports, 0, sizeof(stExports));
+	pDirectory->Size = 0;
+	K22_TEST_CHECK(!K22PeExportParse(stPe.pImage, &stExports), "empty directory");
+	*pDirectory = stDirectoryOrig;
+
+	memset(&stExports, 0, sizeof(stExports));
+	K22_TEST_CHECK(K22PeExportParse(stPe.pImage, &stExports), "restored image");
+	K22TestPeFree(&stPe);
+}
+
+static VOID K22TestCodeRva(BOOL fPe64) {
+	LPCSTR lpNames[] = {"Function", "Variable"};
+	K22_TEST_PE stPe;
+	if (!K22TestPeBuild(&stPe, fPe64, lpNames, 2, 0, 1)) {
+		K22_TEST_CHECK(FALSE, "couldn't build the image");
+		return;
+	}
+	// functions are code; headers, the export directory and anything past the sections aren't
+	for (DWORD i = 0; i < stPe.dwFunctions; i++) {
+		K22_TEST_CHECK(
+			K22PeIsCodeRva(stPe.pImage, stPe.dwCodeRva + i * 16),
+			"PE%d, function %lu",
+			fPe64 ? 64 : 32,
+			(unsigned long)i
+		);
+	}
+	K22_TEST_CHECK(!K22PeIsCodeRva(stPe.pImage, 0), "headers");
+	K22_TEST_CHECK(!K22PeIsCodeRva(stPe.pImage, 0x1000), "export directory");
+	K22_TEST_CHECK(!K22PeIsCodeRva(stPe.pImage, stPe.dwCodeRva + stPe.dwFunctions * 16), "past the code");
+	K22_TEST_CHECK(!K22PeIsCodeRva(stPe.pImage, 0xFFFFFFF0), "past the image");
+
+	// an export pointing outside of the executable section, like a variable
+	K22_PE_EXPORTS stExports		   = {0};
+	PIMAGE_EXPORT_DIRECTORY pExportDir = (PIMAGE_EXPORT_DIRECTORY)(stPe.pImage + 0x1000);
+	PDWORD pFunctions				   = (PDWORD)(stPe.pImage + pExportDir->AddressOfFunctions);
+	pFunctions[1]					   = 0x100;
+	DWORD dwRva						   = K22PeExportFindByName(stPe.pImage, &stExports, stPe.ppNames[0], 0);
+	K22_TEST_CHECK(dwRva == 0x100 && !K22PeIsCodeRva(stPe.pImage, dwRva), "data export");
+	dwRva = K22PeExportFindByName(stPe.pImage, &stExports, stPe.ppNames[1], 0);
+	K22_TEST_CHECK(dwRva == stPe.dwCodeRva && K22PeIsCodeRva(stPe.pImage, dwRva), "code export");
+
+	// section headers past the image are ignored
+	PIMAGE_NT_HEADERS32 pNt			 = (PIMAGE_NT_HEADERS32)(stPe.pImage + 0x40);
+	pNt->FileHeader.NumberOfSections = 0xFFFF;
+	K22_TEST_CHECK(!K22PeIsCodeRva(stPe.pImage, stPe.dwCodeRva), "section headers past the image");
+	K22TestPeFree(&stPe);
+}
+
+int main() {
+	K22TestLookups(FALSE);
+	K22TestLookups(TRUE);
+	K22TestManyNames();
+	K22TestInvalid();
+	K22TestCodeRva(FALSE);
+	K22TestCodeRva(TRUE);
+	return K22_TEST_RESULT();
+}
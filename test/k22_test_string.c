@@ -0,0 +1,208 @@
+// Copyright (c) Kuba Szczodrzyński 2024-8-19.
+
+#include "k22_test.h"
+
+#include "k22_string.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static CHAR K22TestLower(CHAR cInput) {
+	return (cInput >= 'A' && cInput <= 'Z') ? (CHAR)(cInput + ('a' - 'A')) : cInput;
+}
+
+static BOOL K22TestEqualsN(LPCSTR lpString1, LPCSTR lpString2, DWORD cchString) {
+	// reference implementation - the scalar loop
+	for (DWORD i = 0; i < cchString; i++) {
+		if (K22TestLower(lpString1[i]) != K22TestLower(lpString2[i]))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static LPBYTE K22TestGuardPage(PSIZE_T pcbPage) {
+	// two pages - the second one is inaccessible, so that any read past the first one crashes
+#ifdef _WIN32
+	SYSTEM_INFO stInfo;
+	GetSystemInfo(&stInfo);
+	SIZE_T cbPage = stInfo.dwPageSize;
+	LPBYTE pPages = VirtualAlloc(NULL, cbPage * 2, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	DWORD dwOldProtect;
+	if (pPages == NULL || !VirtualProtect(pPages + cbPage, cbPage, PAGE_NOACCESS, &dwOldProtect))
+		return NULL;
+#else
+	SIZE_T cbPage = sysconf(_SC_PAGESIZE);
+	LPBYTE pPages = mmap(NULL, cbPage * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pPages == MAP_FAILED || mprotect(pPages + cbPage, cbPage, PROT_NONE) != 0)
+		return NULL;
+#endif
+	*pcbPage = cbPage;
+	return pPages;
+}
+
+static VOID K22TestGuardPageFree(LPBYTE pPages, SIZE_T cbPage) {
+#ifdef _WIN32
+	VirtualFree(pPages, 0, MEM_RELEASE);
+#else
+	munmap(pPages, cbPage * 2);
+#endif
+}
+
+static VOID K22TestRandomString(LPSTR lpOutput, DWORD cchOutput, PDWORD pdwSeed) {
+	// identifier-like characters of both cases, and some punctuation
+	static const CHAR szChars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_.@[`{";
+	for (DWORD i = 0; i < cchOutput; i++) {
+		lpOutput[i] = szChars[K22TestRandom(pdwSeed) % (sizeof(szChars) - 1)];
+	}
+}
+
+static VOID K22TestFlipCase(LPSTR lpString, DWORD cchString, PDWORD pdwSeed) {
+	for (DWORD i = 0; i < cchString; i++) {
+		CHAR cInput = lpString[i];
+		if ((K22TestRandom(pdwSeed) & 1) && K22TestLower(cInput) >= 'a' && K22TestLower(cInput) <= 'z')
+			lpString[i] = (CHAR)(cInput ^ 0x20);
+	}
+}
+
+static VOID K22TestLengths() {
+	// every length up to 64, at every alignment within 16 bytes; equal, and different at every position
+	CHAR szBuffer1[64 + 16 + 1];
+	CHAR szBuffer2[64 + 16 + 1];
+	CHAR szLower[64];
+	DWORD dwSeed = 18;
+	for (DWORD cchString = 0; cchString <= 64; cchString++) {
+		for (DWORD dwAlign = 0; dwAlign < 16; dwAlign++) {
+			LPSTR lpString1 = szBuffer1 + dwAlign;
+			LPSTR lpString2 = szBuffer2 + 15 - dwAlign;
+			K22TestRandomString(lpString1, cchString, &dwSeed);
+			memcpy(lpString2, lpString1, cchString);
+			K22TestFlipCase(lpString2, cchString, &dwSeed);
+			// the bytes right after the strings differ - they must never be compared
+			lpString1[cchString] = 'x';
+			lpString2[cchString] = 'y';
+
+			K22_TEST_CHECK(K22StringEqualsN(lpString1, lpString2, cchString), "length %lu", (unsigned long)cchString);
+			for (DWORD i = 0; i < cchString; i++) {
+				CHAR cSaved	 = lpString2[i];
+				lpString2[i] = '#';
+				K22_TEST_CHECK(
+					!K22StringEqualsN(lpString1, lpString2, cchString),
+					"length %lu, difference at %lu",
+					(unsigned long)cchString,
+					(unsigned long)i
+				);
+				lpString2[i] = cSaved;
+			}
+
+			lpString1[cchString] = '\0';
+			lpString2[cchString] = '\0';
+			K22_TEST_CHECK(K22StringEquals(lpString1, lpString2), "length %lu, terminated", (unsigned long)cchString);
+			if (cchString != 0) {
+				lpString2[cchString - 1] = '\0';
+				K22_TEST_CHECK(!K22StringEquals(lpString1, lpString2), "length %lu, shorter", (unsigned long)cchString);
+			}
+
+			DWORD cchLower = K22StringLowerN(lpString1, szLower, cchString);
+			K22_TEST_CHECK(cchLower == cchString, "lowercase, length %lu", (unsigned long)cchString);
+			BOOL bLower = TRUE;
+			for (DWORD i = 0; i < cchString; i++) {
+				bLower = bLower && szLower[i] == K22TestLower(lpString1[i]);
+			}
+			K22_TEST_CHECK(bLower, "lowercase, length %lu", (unsigned long)cchString);
+		}
+	}
+}
+
+static VOID K22TestPageEnd() {
+	// strings ending right before an inaccessible page - they mustn't be loaded as whole 16 bytes there
+	SIZE_T cbPage;
+	LPBYTE pPages1 = K22TestGuardPage(&cbPage);
+	LPBYTE pPages2 = K22TestGuardPage(&cbPage);
+	if (pPages1 == NULL || pPages2 == NULL) {
+		K22_TEST_CHECK(FALSE, "couldn't allocate guard pages");
+		return;
+	}
+	DWORD dwSeed = 22;
+	for (DWORD cchString = 0; cchString <= 64; cchString++) {
+		// ending at the page end, and ending 1..16 bytes before it
+		for (DWORD dwGap = 0; dwGap <= 16; dwGap++) {
+			LPSTR lpString1 = (LPSTR)pPages1 + cbPage - dwGap - cchString;
+			LPSTR lpString2 = (LPSTR)pPages2 + cbPage - cchString;
+			K22TestRandomString(lpString1, cchString, &dwSeed);
+			memcpy(lpString2, lpString1, cchString);
+			K22TestFlipCase(lpString2, cchString, &dwSeed);
+			K22_TEST_CHECK(K22StringEqualsN(lpString1, lpString2, cchString), "length %lu", (unsigned long)cchString);
+			K22_TEST_CHECK(K22StringEqualsN(lpString2, lpString1, cchString), "length %lu", (unsigned long)cchString);
+			if (cchString != 0) {
+				lpString2[cchString - 1] = '#';
+				K22_TEST_CHECK(
+					!K22StringEqualsN(lpString1, lpString2, cchString),
+					"length %lu, last character",
+					(unsigned long)cchString
+				);
+			}
+			CHAR szLower[64];
+			K22StringLowerN(lpString1, szLower, cchString);
+
+			// NULL-terminated, with the terminator in the page's last byte
+			lpString1 = (LPSTR)pPages1 + cbPage - dwGap - cchString - 1;
+			lpString2 = (LPSTR)pPages2 + cbPage - cchString - 1;
+			K22TestRandomString(lpString1, cchString, &dwSeed);
+			memcpy(lpString2, lpString1, cchString);
+			K22TestFlipCase(lpString2, cchString, &dwSeed);
+			lpString1[cchString] = '\0';
+			lpString2[cchString] = '\0';
+			K22_TEST_CHECK(K22StringEquals(lpString1, lpString2), "length %lu, terminated", (unsigned long)cchString);
+			K22_TEST_CHECK(K22StringEquals(lpString2, lpString1), "length %lu, terminated", (unsigned long)cchString);
+			if (cchString != 0) {
+				lpString2[cchString - 1] = '\0';
+				K22_TEST_CHECK(!K22StringEquals(lpString1, lpString2), "length %lu, shorter", (unsigned long)cchString);
+				K22_TEST_CHECK(!K22StringEquals(lpString2, lpString1), "length %lu, longer", (unsigned long)cchString);
+			}
+		}
+	}
+	K22TestGuardPageFree(pPages1, cbPage);
+	K22TestGuardPageFree(pPages2, cbPage);
+}
+
+static VOID K22TestCasePairs() {
+	// every pair of byte values, alone and at every position of a 32-byte block - ASCII letters only are folded
+	CHAR szString1[32];
+	CHAR szString2[32];
+	DWORD dwMismatches = 0;
+	for (DWORD c1 = 0; c1 < 256; c1++) {
+		for (DWORD c2 = 0; c2 < 256; c2++) {
+			CHAR cChar1	  = (CHAR)c1;
+			CHAR cChar2	  = (CHAR)c2;
+			BOOL bExpect  = K22TestEqualsN(&cChar1, &cChar2, 1);
+			dwMismatches += K22StringEqualsN(&cChar1, &cChar2, 1) != bExpect;
+
+			DWORD dwPosition = (c1 + c2) % 32;
+			memset(szString1, 'a', sizeof(szString1));
+			memset(szString2, 'A', sizeof(szString2));
+			szString1[dwPosition] = cChar1;
+			szString2[dwPosition] = cChar2;
+			dwMismatches += K22StringEqualsN(szString1, szString2, 32) != bExpect;
+			dwMismatches += K22StringEqualsN(szString1, szString2, dwPosition + 1) != bExpect;
+
+			CHAR cLower;
+			K22StringLowerN(&cChar1, &cLower, 1);
+			dwMismatches += cLower != K22TestLower(cChar1);
+		}
+	}
+	K22_TEST_CHECK(dwMismatches == 0, "%lu mismatches", (unsigned long)dwMismatches);
+
+	// letters' neighbours, and bytes that only differ in the case bit
+	K22_TEST_CHECK(!K22StringEquals("@[`{", "`{@["), "punctuation");
+	K22_TEST_CHECK(!K22StringEquals("\xC1\xC9", "\xE1\xE9"), "non-ASCII letters");
+	K22_TEST_CHECK(K22StringEquals("KERNEL32.DLL", "kernel32.dll"), "module name");
+}
+
+int main() {
+	K22TestLengths();
+	K22TestPageEnd();
+	K22TestCasePairs();
+	return K22_TEST_RESULT();
+}